@@ -25,5 +25,33 @@ periodic flush interval:
 A value of 0 for sqlSaveInterval will completely disable MySQL
 logging of traps.
 
+The traps queued are written in one transaction.  By default each
+trap, and each of its varbinds, takes an INSERT of its own; larger
+batches need fewer round trips to the server:
+
+	# rows written by one INSERT (1 to 512)
+	sqlBatchSize 64
+
+	# write queued traps at least every 250 milliseconds
+	# (instead of every sqlSaveInterval seconds)
+	sqlMaxDelay 250
+
+The ids of the traps written by one INSERT are taken to be
+consecutive (allowing for auto_increment_increment), which holds for
+InnoDB tables unless innodb_autoinc_lock_mode is 2 and other clients
+insert into the notifications table at the same time.
+
+When the database can't be reached, the queued traps are normally
+logged through snmptrapd's own logging instead.  sqlMaxBacklog keeps
+up to that many traps queued, to be written once the database is back:
+
+	sqlMaxBacklog 10000
+
+If snmptrapd was configured with --enable-reentrant, the database
+writes can be moved to a background thread, so that a slow database
+doesn't hold up receiving traps:
+
+	sqlWriterThread yes
+
 The schema must be loaded into MySQL before running snmptrapd.
 The schema can be found in dist/schema-snmptrapd.sql
@@ -495,7 +495,7 @@ netsnmp_call_handler(netsnmp_mib_handler *next_handler,
                      netsnmp_request_info *requests)
 {
     Netsnmp_Node_Handler *nh;
-    int             ret;
+    int             ret, skip_auto_next;
 
     if (next_handler == NULL || reginfo == NULL || reqinfo == NULL ||
         requests == NULL) {
@@ -535,9 +535,21 @@ netsnmp_call_handler(netsnmp_mib_handler *next_handler,
         DEBUGMSGTL(("handler:returned", "handler %s returned %d\n",
                     next_handler->handler_name, ret));
 
+        skip_auto_next = reqinfo->asp &&
+            reqinfo->asp->skip_auto_next == next_handler;
+        if (skip_auto_next)
+            reqinfo->asp->skip_auto_next = NULL;
+
         if (! (next_handler->flags & MIB_HANDLER_AUTO_NEXT))
             break;
 
+        /*
+         * the handler handed the request back to the main thread
+         */
+        if (reqinfo->asp &&
+            (reqinfo->asp->flags & SNMP_AGENT_FLAGS_NOT_THREAD_SAFE))
+            break;
+
         /*
          * did handler signal that it didn't want auto next this time around?
          */
@@ -545,6 +557,8 @@ netsnmp_call_handler(netsnmp_mib_handler *next_handler,
             next_handler->flags &= ~MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
             break;
         }
+        if (skip_auto_next)
+            break;
 
         next_handler = next_handler->next;
 
@@ -608,6 +622,19 @@ netsnmp_call_handlers(netsnmp_handler_registration *reginfo,
         snmp_log(LOG_ERR, "unknown mode in netsnmp_call_handlers! bug!\n");
         return SNMP_ERR_GENERR;
     }
+
+    /*
+     * a worker thread gives up on the request when it reaches a
+     * handler that has not declared itself thread safe; the request is
+     * then processed again on the main thread.
+     */
+    if (!(reginfo->modes & HANDLER_CAN_THREAD_SAFE) &&
+        netsnmp_agent_workers_hand_back(reqinfo)) {
+        DEBUGMSGTL(("handler:calling", "main handler %s is not thread safe\n",
+                    reginfo->handler->handler_name));
+        return SNMP_ERR_GENERR;
+    }
+
     DEBUGMSGTL(("handler:calling", "main handler %s\n",
                 reginfo->handler->handler_name));
 
@@ -615,7 +642,9 @@ netsnmp_call_handlers(netsnmp_handler_registration *reginfo,
         request->processed = 0;
     }
 
+    netsnmp_agent_workers_enter(reginfo, reqinfo);
     status = netsnmp_call_handler(reginfo->handler, reginfo, reqinfo, requests);
+    netsnmp_agent_workers_leave(reginfo, reqinfo);
 
     return status;
 }
@@ -679,6 +708,25 @@ netsnmp_call_next_handler_one_request(netsnmp_mib_handler *current,
 }
 #endif /* NETSNMP_FEATURE_REMOVE_NETSNMP_CALL_NEXT_HANDLER_ONE_REQUEST */
 
+/** Tells netsnmp_call_handler() not to call the handler after the given
+ *  one automatically when it returns from the current request, as the
+ *  MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE flag does.  This is remembered
+ *  with the request rather than in the handler, which may be processing
+ *  other requests on agent worker threads at the same time.
+ *
+ *  @param handler is the MIB Handler that has called the next one itself
+ *  @param reqinfo is the request being processed
+ */
+void
+netsnmp_handler_skip_auto_next(netsnmp_mib_handler *handler,
+                               netsnmp_agent_request_info *reqinfo)
+{
+    if (reqinfo && reqinfo->asp)
+        reqinfo->asp->skip_auto_next = handler;
+    else
+        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+}
+
 /** Deallocates resources associated with a given handler.
  *  The handler is removed from chain and then freed.
  *  After calling this function, the handler pointer is invalid
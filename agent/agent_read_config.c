@@ -246,6 +246,13 @@ init_agent_read_config(const char *app)
                                 snmpd_free_trapcommunity,
                                 "community-string");
 #endif /* support for community based SNMP */
+    netsnmp_ds_register_config(ASN_INTEGER, app, "notificationQueueSize",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NOTIFICATION_QUEUE_SIZE);
+    register_app_config_handler("notificationQueuePolicy",
+                                snmpd_parse_config_notification_queue_policy,
+                                snmpd_free_notification_queue_policy,
+                                "dropNewest | dropOldest | coalesce");
     netsnmp_ds_register_config(ASN_OCTET_STR, app, "v1trapaddress", 
                                NETSNMP_DS_APPLICATION_ID, 
                                NETSNMP_DS_AGENT_TRAP_ADDR);
@@ -275,6 +282,18 @@ init_agent_read_config(const char *app)
     netsnmp_ds_register_config(ASN_INTEGER, app, "maxGetbulkResponses",
                                NETSNMP_DS_APPLICATION_ID,
                                NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "agentWorkerThreads",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_WORKER_THREADS);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "udpBatchSize",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_UDP_BATCH_SIZE);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "udpBatchBufferSize",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_UDP_BATCH_BUFFER);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "udpListenSockets",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_UDP_LISTEN_SOCKETS);
     netsnmp_init_handler_conf();
 
 #include "agent_module_dot_conf.h"
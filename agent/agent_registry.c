@@ -110,6 +110,9 @@ static lookup_cache_context *thecontextcache = NULL;
  * @param newsize set to the maximum size of a cache for a given
  * context.  Set to 0 to completely disable caching, or to -1 to set
  * to the default cache size (8), or to a number of your chosing.  The
+ *
+ * Searches covering a whole context are answered by the subtree index,
+ * so the cache is only consulted should that index be unavailable.
  */
 void
 netsnmp_set_lookup_cache_size(int newsize) {
@@ -274,6 +277,282 @@ clear_lookup_cache(void) {
 /**  @} */
 /* End of Lookup cache code */
 
+/** @defgroup agent_subtree_index Subtree index, locating subtrees by OID.
+ *     Maintain a per-context trie of the subtree list, keyed on the start
+ *     OID of every top level list entry, so that the subtree covering a
+ *     given OID can be found in time proportional to the OID length
+ *     rather than to the number of registrations.
+ *   @ingroup agent_registry
+ *
+ * @{
+ */
+
+typedef struct subtree_index_node_s {
+    netsnmp_subtree             *subtree;  /* list entry starting here */
+    oid                         *subids;   /* sorted, one per child */
+    struct subtree_index_node_s **children;
+    size_t                       children_len;
+    size_t                       children_max;
+} subtree_index_node;
+
+/** @private
+ *  Finds the position of a sub-identifier among the children of a node.
+ *
+ *  @return the index of the first child whose subid is not less than
+ *          the one given (which may be children_len).
+ */
+NETSNMP_STATIC_INLINE size_t
+subtree_index_position(const subtree_index_node *node, oid subid)
+{
+    size_t lo = 0, hi = node->children_len, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (node->subids[mid] < subid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** @private
+ *  Returns the subtree with the greatest start OID below a node.
+ *  Every leaf of the trie holds a subtree, so this always succeeds.
+ */
+NETSNMP_STATIC_INLINE netsnmp_subtree *
+subtree_index_last(const subtree_index_node *node)
+{
+    while (node->children_len)
+        node = node->children[node->children_len - 1];
+    return node->subtree;
+}
+
+static void
+subtree_index_free(subtree_index_node *node)
+{
+    size_t i;
+
+    if (!node)
+        return;
+    for (i = 0; i < node->children_len; i++)
+        subtree_index_free(node->children[i]);
+    SNMP_FREE(node->subids);
+    SNMP_FREE(node->children);
+    SNMP_FREE(node);
+}
+
+/** @private
+ *  Finds the context cache entry whose index maps the start OID of a
+ *  subtree to that very subtree, i.e. the context in which the subtree
+ *  is a top level list entry.
+ */
+static subtree_context_cache *
+subtree_index_owner(const netsnmp_subtree *sub)
+{
+    subtree_context_cache *ptr;
+    subtree_index_node *node;
+    size_t i, pos;
+
+    for (ptr = get_top_context_cache(); ptr; ptr = ptr->next) {
+        for (node = ptr->subtree_index, i = 0;
+             node && i < sub->start_len; i++) {
+            pos = subtree_index_position(node, sub->start_a[i]);
+            if (pos == node->children_len ||
+                node->subids[pos] != sub->start_a[i])
+                node = NULL;
+            else
+                node = node->children[pos];
+        }
+        if (node && node->subtree == sub)
+            return ptr;
+    }
+    return NULL;
+}
+
+/** @private
+ *  Finds the context cache entry of the given name.
+ */
+static subtree_context_cache *
+subtree_index_context(const char *context_name)
+{
+    subtree_context_cache *ptr;
+
+    if (!context_name)
+        context_name = "";
+    for (ptr = get_top_context_cache(); ptr; ptr = ptr->next)
+        if (ptr->context_name && strcmp(ptr->context_name, context_name) == 0)
+            break;
+    return ptr;
+}
+
+/** @private
+ *  Records a subtree as the top level list entry for its start OID,
+ *  replacing any entry previously recorded for the same OID.
+ *
+ *  @return SNMPERR_SUCCESS, or SNMPERR_MALLOC if the index could not
+ *          be extended.
+ */
+static int
+subtree_index_insert(subtree_index_node *node, netsnmp_subtree *sub)
+{
+    subtree_index_node *child, **tmp;
+    oid *tmp_subids;
+    size_t i, pos;
+
+    for (i = 0; i < sub->start_len; i++) {
+        pos = subtree_index_position(node, sub->start_a[i]);
+        if (pos < node->children_len &&
+            node->subids[pos] == sub->start_a[i]) {
+            node = node->children[pos];
+            continue;
+        }
+        if (node->children_len == node->children_max) {
+            size_t newmax = node->children_max ? 2 * node->children_max : 4;
+            tmp_subids = (oid *)
+                realloc(node->subids, newmax * sizeof(*tmp_subids));
+            if (!tmp_subids)
+                return SNMPERR_MALLOC;
+            node->subids = tmp_subids;
+            tmp = (subtree_index_node **)
+                realloc(node->children, newmax * sizeof(*tmp));
+            if (!tmp)
+                return SNMPERR_MALLOC;
+            node->children = tmp;
+            node->children_max = newmax;
+        }
+        child = SNMP_MALLOC_TYPEDEF(subtree_index_node);
+        if (!child)
+            return SNMPERR_MALLOC;
+        memmove(&node->subids[pos + 1], &node->subids[pos],
+                (node->children_len - pos) * sizeof(*node->subids));
+        memmove(&node->children[pos + 1], &node->children[pos],
+                (node->children_len - pos) * sizeof(*node->children));
+        node->subids[pos] = sub->start_a[i];
+        node->children[pos] = child;
+        node->children_len++;
+        node = child;
+    }
+    node->subtree = sub;
+    return SNMPERR_SUCCESS;
+}
+
+/** @private
+ *  Builds the index of a context from its subtree list.
+ *
+ *  @return SNMPERR_SUCCESS, or SNMPERR_MALLOC in which case the context
+ *          is left without an index.
+ */
+static int
+subtree_index_build(subtree_context_cache *ptr)
+{
+    subtree_index_node *index;
+    netsnmp_subtree *sub;
+
+    /* only published once complete, for lookups from worker threads */
+    index = SNMP_MALLOC_TYPEDEF(subtree_index_node);
+    if (!index)
+        return SNMPERR_MALLOC;
+    for (sub = ptr->first_subtree; sub; sub = sub->next) {
+        if (subtree_index_insert(index, sub) != SNMPERR_SUCCESS) {
+            subtree_index_free(index);
+            return SNMPERR_MALLOC;
+        }
+    }
+    ptr->subtree_index = index;
+    DEBUGMSGTL(("subtree", "built index for context \"%s\"\n",
+                ptr->context_name));
+    return SNMPERR_SUCCESS;
+}
+
+/** @private
+ *  Keeps an existing index in step with a new top level list entry.
+ *  Contexts that have no index yet get one built on their next lookup;
+ *  an index that cannot be extended is dropped and rebuilt likewise.
+ */
+static void
+subtree_index_set(subtree_context_cache *ptr, netsnmp_subtree *sub)
+{
+    if (!ptr || !ptr->subtree_index)
+        return;
+    if (subtree_index_insert(ptr->subtree_index, sub) != SNMPERR_SUCCESS) {
+        subtree_index_free(ptr->subtree_index);
+        ptr->subtree_index = NULL;
+    }
+}
+
+/** @private
+ *  Forgets the entry for the start OID of a subtree, provided it still
+ *  refers to that subtree, and prunes any nodes left empty.
+ */
+static void
+subtree_index_remove_node(subtree_index_node *node,
+                          const netsnmp_subtree *sub, size_t depth)
+{
+    subtree_index_node *child;
+    size_t pos;
+
+    if (depth == sub->start_len) {
+        if (node->subtree == sub)
+            node->subtree = NULL;
+        return;
+    }
+
+    pos = subtree_index_position(node, sub->start_a[depth]);
+    if (pos == node->children_len ||
+        node->subids[pos] != sub->start_a[depth])
+        return;
+    child = node->children[pos];
+    subtree_index_remove_node(child, sub, depth + 1);
+    if (child->subtree == NULL && child->children_len == 0) {
+        subtree_index_free(child);
+        node->children_len--;
+        memmove(&node->subids[pos], &node->subids[pos + 1],
+                (node->children_len - pos) * sizeof(*node->subids));
+        memmove(&node->children[pos], &node->children[pos + 1],
+                (node->children_len - pos) * sizeof(*node->children));
+    }
+}
+
+static void
+subtree_index_remove(subtree_context_cache *ptr, const netsnmp_subtree *sub)
+{
+    if (ptr && ptr->subtree_index)
+        subtree_index_remove_node(ptr->subtree_index, sub, 0);
+}
+
+/** @private
+ *  Finds the top level list entry with the greatest start OID which is
+ *  less than or equal to the given OID - the same entry a linear walk
+ *  of the subtree list from its head would stop at.
+ */
+static netsnmp_subtree *
+subtree_index_find_prev(const subtree_index_node *node,
+                        const oid *name, size_t len)
+{
+    netsnmp_subtree *best = NULL;
+    size_t i, pos;
+
+    for (i = 0; node; i++) {
+        /* A prefix of the OID sorts before it ... */
+        if (node->subtree)
+            best = node->subtree;
+        if (i == len)
+            break;
+        /* ... but after anything diverging with a smaller subid here. */
+        pos = subtree_index_position(node, name[i]);
+        if (pos > 0)
+            best = subtree_index_last(node->children[pos - 1]);
+        if (pos == node->children_len || node->subids[pos] != name[i])
+            break;
+        node = node->children[pos];
+    }
+    return best;
+}
+
+/**  @} */
+/* End of Subtree index code */
+
 /** @defgroup agent_context_cache Context cache, storing the OIDs under their contexts.
  *     Maintain the cache used for locating sub-trees registered under different contexts.
  *   @ingroup agent_registry
@@ -360,6 +639,8 @@ netsnmp_remove_subtree(netsnmp_subtree *tree)
 {
     subtree_context_cache *ptr;
 
+    subtree_index_remove(subtree_index_owner(tree), tree);
+
     if (!tree->prev) {
         for (ptr = context_subtrees; ptr; ptr = ptr->next)
             if (ptr->first_subtree == tree)
@@ -426,6 +707,7 @@ clear_context(void) {
 	    clear_subtree(t);
 	}
 
+        subtree_index_free(ptr->subtree_index);
         free(NETSNMP_REMOVE_CONST(char*, ptr->context_name));
         SNMP_FREE(ptr);
 
@@ -615,6 +897,7 @@ netsnmp_subtree_join(netsnmp_subtree *root)
                 d = c->children;
                 netsnmp_subtree_free(c);
             }
+            subtree_index_remove(subtree_index_owner(s), s);
             netsnmp_subtree_free(s);
             s = tmp;
         }
@@ -736,6 +1019,9 @@ netsnmp_subtree_split(netsnmp_subtree *current, oid name[], int name_len)
         netsnmp_subtree_change_prev(ptr, new_sub);
     }
 
+    /* A split of a top level entry adds a new one alongside it */
+    subtree_index_set(subtree_index_owner(current), new_sub);
+
     return new_sub;
 }
 
@@ -830,6 +1116,7 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 	    }
 #endif
 	}
+        subtree_index_set(subtree_index_context(context_name), new_sub);
     } else {
 	/*  If the new subtree starts *within* an existing registration
 	    (rather than at the same point as it), then split the existing
@@ -923,6 +1210,8 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 		for (prev = new_sub->prev; prev != NULL;prev = prev->children){
                     netsnmp_subtree_change_next(prev, new_sub);
 		}
+                subtree_index_set(subtree_index_context(context_name),
+                                  new_sub);
 	    }
 	    break;
 
@@ -972,9 +1261,31 @@ netsnmp_subtree_find_prev(const oid *name, size_t len, netsnmp_subtree *subtree,
 {
     lookup_cache *lookup_cache = NULL;
     netsnmp_subtree *myptr = NULL, *previous = NULL;
+    subtree_context_cache *ptr;
     int cmp = 1;
     size_t ll_off = 0;
 
+    if (!subtree || !subtree->prev) {
+        /* A search of the whole context can be answered by its index */
+        ptr = subtree_index_context(context_name);
+        if (ptr && (!subtree || subtree == ptr->first_subtree)) {
+            if (!ptr->subtree_index) {
+                snmp_res_lock(MT_LIBRARY_ID, MT_LIB_REGISTRY);
+                if (!ptr->subtree_index)
+                    subtree_index_build(ptr);
+                snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_REGISTRY);
+            }
+            if (ptr->subtree_index)
+                return subtree_index_find_prev(ptr->subtree_index,
+                                               name, len);
+        }
+    }
+
+    /*
+     * The lookup cache is updated by lookups, which may run on several
+     * agent worker threads at once.
+     */
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_REGISTRY);
     if (subtree) {
         myptr = subtree;
     } else {
@@ -1031,9 +1342,10 @@ netsnmp_subtree_find_prev(const oid *name, size_t len, netsnmp_subtree *subtree,
                     lookup_cache_add(context_name, myptr, previous);
                 }
             }
-            return previous;
+            break;
         }
     }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_REGISTRY);
     return previous;
 }
 
@@ -1203,6 +1515,7 @@ netsnmp_register_mib(const char *moduleName,
     subtree->flags |= SUBTREE_ATTACHED;
     subtree->global_cacheid = reginfo->global_cacheid;
 
+    netsnmp_agent_workers_lock();
     netsnmp_set_lookup_cache_size(0);
     res = netsnmp_subtree_load(subtree, context);
 
@@ -1219,6 +1532,7 @@ netsnmp_register_mib(const char *moduleName,
                                        range_subid, range_ubound, context);
                 netsnmp_set_lookup_cache_size(old_lookup_cache_val);
                 invalidate_lookup_cache(context);
+                netsnmp_agent_workers_unlock();
                 return MIB_REGISTRATION_FAILED;
             }
 
@@ -1241,6 +1555,7 @@ netsnmp_register_mib(const char *moduleName,
 		netsnmp_subtree_free(sub2);
                 netsnmp_set_lookup_cache_size(old_lookup_cache_val);
                 invalidate_lookup_cache(context);
+                netsnmp_agent_workers_unlock();
                 return res;
             }
         }
@@ -1248,6 +1563,7 @@ netsnmp_register_mib(const char *moduleName,
                res == MIB_REGISTRATION_FAILED) {
         netsnmp_set_lookup_cache_size(old_lookup_cache_val);
         invalidate_lookup_cache(context);
+        netsnmp_agent_workers_unlock();
         netsnmp_subtree_free(subtree);
         return res;
     }
@@ -1282,6 +1598,7 @@ netsnmp_register_mib(const char *moduleName,
 
     netsnmp_set_lookup_cache_size(old_lookup_cache_val);
     invalidate_lookup_cache(context);
+    netsnmp_agent_workers_unlock();
     return res;
 }
 
@@ -1632,6 +1949,7 @@ netsnmp_subtree_unload(netsnmp_subtree *sub, netsnmp_subtree *prev, const char *
 	if (sub->prev == NULL) {
 	    netsnmp_subtree_replace_first(sub->next, context);
 	}
+        subtree_index_remove(subtree_index_context(context), sub);
 
     } else {
         for (ptr = sub->prev; ptr; ptr = ptr->children)
@@ -1642,6 +1960,7 @@ netsnmp_subtree_unload(netsnmp_subtree *sub, netsnmp_subtree *prev, const char *
 	if (sub->prev == NULL) {
 	    netsnmp_subtree_replace_first(sub->children, context);
 	}
+        subtree_index_set(subtree_index_context(context), sub->children);
     }
     invalidate_lookup_cache(context);
 }
@@ -1690,6 +2009,7 @@ unregister_mib_context(oid * name, size_t len, int priority,
     int unregistering = 1;
     int orig_subid_val = -1;
 
+    netsnmp_agent_workers_lock();
     netsnmp_set_lookup_cache_size(0);
 
     if ((range_subid > 0) &&  ((size_t)range_subid <= len))
@@ -1703,6 +2023,7 @@ unregister_mib_context(oid * name, size_t len, int priority,
         list = netsnmp_subtree_find(name, len, netsnmp_subtree_find_first(context),
                     context);
         if (list == NULL) {
+            netsnmp_agent_workers_unlock();
             return MIB_NO_SUCH_REGISTRATION;
         }
 
@@ -1715,6 +2036,7 @@ unregister_mib_context(oid * name, size_t len, int priority,
         }
 
         if (child == NULL) {
+            netsnmp_agent_workers_unlock();
             return MIB_NO_SUCH_REGISTRATION;
         }
 
@@ -1774,6 +2096,7 @@ unregister_mib_context(oid * name, size_t len, int priority,
     netsnmp_subtree_free(myptr);
     netsnmp_set_lookup_cache_size(old_lookup_cache_val);
     invalidate_lookup_cache(context);
+    netsnmp_agent_workers_unlock();
     return MIB_UNREGISTERED_OK;
 }
 
@@ -1792,6 +2115,7 @@ netsnmp_unregister_mib_table_row(oid * name, size_t len, int priority,
     DEBUGMSGOIDRANGE(("register_mib", name, len, var_subid, range_ubound));
     DEBUGMSG(("register_mib", "\n"));
 
+    netsnmp_agent_workers_lock();
     for (; name[var_subid - 1] <= range_ubound; name[var_subid - 1]++) {
         list = netsnmp_subtree_find(name, len, 
 				netsnmp_subtree_find_first(context), context);
@@ -1841,6 +2165,7 @@ netsnmp_unregister_mib_table_row(oid * name, size_t len, int priority,
         }
         netsnmp_subtree_free(myptr);
     }
+    netsnmp_agent_workers_unlock();
 
     name[var_subid - 1] = range_lbound;
     memset(&reg_parms, 0x0, sizeof(reg_parms));
@@ -1962,6 +2287,7 @@ unregister_mibs_by_session(netsnmp_session * ss)
     DEBUGMSGTL(("register_mib", "unregister_mibs_by_session(%p) ctxt \"%s\"\n",
 		ss, (ss && ss->contextName) ? ss->contextName : "[NIL]"));
 
+    netsnmp_agent_workers_lock();
     for (contextptr = get_top_context_cache(); contextptr != NULL;
          contextptr = contextptr->next) {
         for (list = contextptr->first_subtree; list != NULL; list = list2) {
@@ -2010,6 +2336,7 @@ unregister_mibs_by_session(netsnmp_session * ss)
         }
         netsnmp_subtree_join(contextptr->first_subtree);
     }
+    netsnmp_agent_workers_unlock();
 }
 
 /** Determines if given PDU is allowed to see (or update) a given OID.
@@ -50,6 +50,7 @@
 #if HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
+#include <errno.h>
 #include <net-snmp/utilities.h>
 
 #include <net-snmp/net-snmp-includes.h>
@@ -311,7 +312,10 @@ create_v2_inform_session(const char *sink, const char *sinkport, char *com)
 void
 snmpd_free_trapsinks(void)
 {
-    struct trap_sink *sp = sinks;
+    struct trap_sink *sp;
+
+    netsnmp_trap_queue_flush();
+    sp = sinks;
     DEBUGMSGTL(("trap", "freeing trap sessions\n"));
     while (sp) {
         sinks = sinks->next;
@@ -575,6 +579,351 @@ convert_v1pdu_to_v2( netsnmp_pdu* template_v1pdu )
     return template_v2pdu;
 }
 
+        /*******************
+	 *
+	 * Notification fan-out and queueing
+	 *
+	 *******************/
+
+/*
+ * SNMPv1 and SNMPv2c traps going to sinks with the same version and
+ * community are the same message, so each such message is encoded once
+ * per notification and the octets sent to every sink that wants them.
+ */
+#define TRAP_ENCODINGS_MAX 8
+
+struct trap_encoding {
+    long            version;
+    int             command;
+    u_char         *community;
+    size_t          community_len;
+    u_char         *pktbuf;         /* NULL if the encoding failed */
+    u_char         *packet;
+    size_t          length;
+};
+
+/*
+ * Sends a notification to a v1 or v2c trap sink using (and if needed,
+ * adding) the encoding made for its version and community.  Returns 0
+ * if the sink is not one whose messages can be shared, in which case
+ * the caller sends to it as usual.
+ */
+static int
+_send_encoded_trap(netsnmp_session * sess, netsnmp_pdu *template_pdu,
+                   struct trap_encoding *encodings, int *nencodings)
+{
+    struct trap_encoding *enc = NULL;
+    netsnmp_transport *transport;
+    netsnmp_pdu    *pdu;
+    void           *sessp, *opaque = NULL;
+    int             i, olength = 0;
+
+    if (sess->version != SNMP_VERSION_1 && sess->version != SNMP_VERSION_2c)
+        return 0;
+    if (template_pdu->command != (sess->version == SNMP_VERSION_1 ?
+                                  SNMP_MSG_TRAP : SNMP_MSG_TRAP2))
+        return 0;
+    sessp = snmp_sess_pointer(sess);
+    transport = sessp ? snmp_sess_transport(sessp) : NULL;
+    if (transport == NULL)
+        return 0;
+
+    for (i = 0; i < *nencodings; i++)
+        if (encodings[i].version == sess->version &&
+            encodings[i].command == template_pdu->command &&
+            encodings[i].community_len == sess->community_len &&
+            memcmp(encodings[i].community, sess->community,
+                   sess->community_len) == 0) {
+            enc = &encodings[i];
+            break;
+        }
+    if (enc == NULL) {
+        if (*nencodings == TRAP_ENCODINGS_MAX)
+            return 0;
+        enc = &encodings[(*nencodings)++];
+        memset(enc, 0, sizeof(*enc));
+        enc->version = sess->version;
+        enc->command = template_pdu->command;
+        enc->community = sess->community;
+        enc->community_len = sess->community_len;
+        template_pdu->version = sess->version;
+        pdu = snmp_clone_pdu(template_pdu);
+        if (pdu) {
+            if (!snmp_sess_encode(sessp, pdu, &enc->pktbuf, &enc->packet,
+                                  &enc->length))
+                snmp_sess_perror("snmpd: send_trap", sess);
+            snmp_free_pdu(pdu);
+        }
+        DEBUGMSGTL(("trap", "encoded trap type=%d, version=%ld: %"
+                    NETSNMP_PRIz "u octets\n", enc->command, enc->version,
+                    enc->length));
+    }
+    if (enc->pktbuf == NULL)
+        return 1;
+
+    if (netsnmp_transport_send(transport, enc->packet, enc->length,
+                               &opaque, &olength) < 0) {
+        sess->s_snmp_errno = SNMPERR_BAD_SENDTO;
+        sess->s_errno = errno;
+        snmp_sess_perror("snmpd: send_trap", sess);
+    } else {
+        snmp_increment_statistic(STAT_SNMPOUTTRAPS);
+        snmp_increment_statistic(STAT_SNMPOUTPKTS);
+    }
+    return 1;
+}
+
+/*
+ * Sends a notification to each trap sink, in the format it wants, and
+ * passes it to the trap callbacks.
+ */
+static void
+_send_to_sinks(netsnmp_pdu *template_v1pdu, netsnmp_pdu *template_v2pdu)
+{
+    struct trap_encoding encodings[TRAP_ENCODINGS_MAX];
+    struct trap_sink *sink;
+    netsnmp_pdu    *pdu;
+    int             i, nencodings = 0;
+
+    for (sink = sinks; sink; sink = sink->next) {
+#ifndef NETSNMP_DISABLE_SNMPV1
+        if (sink->version == SNMP_VERSION_1)
+            pdu = template_v1pdu;
+        else
+#endif
+        {
+            pdu = template_v2pdu;
+            if (pdu)
+                pdu->command = sink->pdutype;
+        }
+        if (pdu && !_send_encoded_trap(sink->sesp, pdu, encodings,
+                                       &nencodings))
+            send_trap_to_sess(sink->sesp, pdu);
+    }
+    for (i = 0; i < nencodings; i++)
+        SNMP_FREE(encodings[i].pktbuf);
+
+    if (template_v1pdu)
+        snmp_call_callbacks(SNMP_CALLBACK_APPLICATION,
+                        SNMPD_CALLBACK_SEND_TRAP1, template_v1pdu);
+    if (template_v2pdu)
+        snmp_call_callbacks(SNMP_CALLBACK_APPLICATION,
+                        SNMPD_CALLBACK_SEND_TRAP2, template_v2pdu);
+}
+
+/*
+ * With notificationQueueSize set, notifications are queued and sent from
+ * an alarm, a batch at a time, rather than from the code that raised
+ * them, so that a burst of notifications does not hold up requests.
+ * When the queue is full, notificationQueuePolicy decides whether the
+ * newest or the oldest notification is dropped; with "coalesce", a
+ * notification that is the same as one already queued (but for
+ * sysUpTime) is not queued again.
+ */
+#define TRAP_QUEUE_DROP_NEWEST  0
+#define TRAP_QUEUE_DROP_OLDEST  1
+#define TRAP_QUEUE_COALESCE     2
+
+#define TRAP_QUEUE_BATCH        32
+
+struct trap_queue_entry {
+    netsnmp_pdu    *v1pdu;
+    netsnmp_pdu    *v2pdu;
+    u_int           hash;
+    struct trap_queue_entry *next;
+};
+
+static struct trap_queue_entry *trap_queue_head = NULL;
+static struct trap_queue_entry *trap_queue_tail = NULL;
+static int      trap_queue_length = 0;
+static int      trap_queue_policy = TRAP_QUEUE_DROP_NEWEST;
+static unsigned int trap_queue_alarm = 0;
+
+/*
+ * The varbinds that make a notification what it is: those of the v2
+ * form without sysUpTime.0, or failing that those of the v1 form.
+ */
+static netsnmp_variable_list *
+_trap_queue_vars(struct trap_queue_entry *e)
+{
+    netsnmp_variable_list *vars;
+
+    if (e->v2pdu == NULL)
+        return e->v1pdu->variables;
+    vars = e->v2pdu->variables;
+    if (vars && snmp_oid_compare(vars->name, vars->name_length,
+                                 sysuptime_oid, sysuptime_oid_len) == 0)
+        vars = vars->next_variable;
+    return vars;
+}
+
+static u_int
+_trap_queue_hash(struct trap_queue_entry *e)
+{
+    netsnmp_variable_list *var;
+    const u_char   *cp, *end;
+    u_int           hash = 2166136261U;
+
+    for (var = _trap_queue_vars(e); var; var = var->next_variable) {
+        cp = (const u_char *) var->name;
+        for (end = cp + var->name_length * sizeof(oid); cp < end; cp++)
+            hash = (hash ^ *cp) * 16777619U;
+        hash = (hash ^ var->type) * 16777619U;
+        cp = var->val.string;
+        for (end = cp + var->val_len; cp && cp < end; cp++)
+            hash = (hash ^ *cp) * 16777619U;
+    }
+    if (e->v1pdu)
+        hash = (hash ^ (e->v1pdu->trap_type << 16) ^
+                e->v1pdu->specific_type) * 16777619U;
+    return hash;
+}
+
+static int
+_trap_queue_same(struct trap_queue_entry *a, struct trap_queue_entry *b)
+{
+    netsnmp_variable_list *va, *vb;
+
+    if (a->hash != b->hash || !a->v1pdu != !b->v1pdu ||
+        !a->v2pdu != !b->v2pdu)
+        return 0;
+    if (a->v1pdu &&
+        (a->v1pdu->trap_type != b->v1pdu->trap_type ||
+         a->v1pdu->specific_type != b->v1pdu->specific_type ||
+         snmp_oid_compare(a->v1pdu->enterprise, a->v1pdu->enterprise_length,
+                          b->v1pdu->enterprise,
+                          b->v1pdu->enterprise_length) != 0))
+        return 0;
+    if (a->v2pdu &&
+        (a->v2pdu->contextNameLen != b->v2pdu->contextNameLen ||
+         (a->v2pdu->contextNameLen &&
+          memcmp(a->v2pdu->contextName, b->v2pdu->contextName,
+                 a->v2pdu->contextNameLen) != 0)))
+        return 0;
+    for (va = _trap_queue_vars(a), vb = _trap_queue_vars(b); va && vb;
+         va = va->next_variable, vb = vb->next_variable)
+        if (va->type != vb->type || va->val_len != vb->val_len ||
+            snmp_oid_compare(va->name, va->name_length,
+                             vb->name, vb->name_length) != 0 ||
+            (va->val_len &&
+             memcmp(va->val.string, vb->val.string, va->val_len) != 0))
+            return 0;
+    return va == vb;
+}
+
+static void
+_trap_queue_free(struct trap_queue_entry *e)
+{
+    snmp_free_pdu(e->v1pdu);
+    snmp_free_pdu(e->v2pdu);
+    free(e);
+}
+
+static struct trap_queue_entry *
+_trap_queue_pop(void)
+{
+    struct trap_queue_entry *e = trap_queue_head;
+
+    if (e) {
+        trap_queue_head = e->next;
+        if (trap_queue_head == NULL)
+            trap_queue_tail = NULL;
+        trap_queue_length--;
+    }
+    return e;
+}
+
+static void
+_trap_queue_run(unsigned int clientreg, void *clientarg)
+{
+    struct trap_queue_entry *e;
+    int             i;
+
+    trap_queue_alarm = 0;
+    for (i = 0; i < TRAP_QUEUE_BATCH && (e = _trap_queue_pop()); i++) {
+        _send_to_sinks(e->v1pdu, e->v2pdu);
+        _trap_queue_free(e);
+    }
+    DEBUGMSGTL(("trap:queue", "sent %d notifications, %d still queued\n",
+                i, trap_queue_length));
+    if (trap_queue_head)
+        trap_queue_alarm = snmp_alarm_register(0, 0, _trap_queue_run, NULL);
+}
+
+/*
+ * Queues a notification, taking over its PDUs, if queueing is on.
+ * Returns 0 if it is off and the caller should send the notification.
+ */
+static int
+_trap_queue_add(netsnmp_pdu *template_v1pdu, netsnmp_pdu *template_v2pdu)
+{
+    struct trap_queue_entry *e, *old;
+    int             size;
+
+    size = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                              NETSNMP_DS_AGENT_NOTIFICATION_QUEUE_SIZE);
+    if (size <= 0)
+        return 0;
+
+    e = (struct trap_queue_entry *) calloc(1, sizeof(*e));
+    if (e == NULL)
+        return 0;
+    e->v1pdu = template_v1pdu;
+    e->v2pdu = template_v2pdu;
+
+    if (trap_queue_policy == TRAP_QUEUE_COALESCE) {
+        e->hash = _trap_queue_hash(e);
+        for (old = trap_queue_head; old; old = old->next)
+            if (_trap_queue_same(old, e)) {
+                DEBUGMSGTL(("trap:queue", "coalesced a notification\n"));
+                snmp_increment_statistic(STAT_NOTIFY_COALESCED);
+                _trap_queue_free(e);
+                return 1;
+            }
+    }
+    if (trap_queue_length >= size) {
+        DEBUGMSGTL(("trap:queue", "queue full, dropping the %s "
+                    "notification\n", trap_queue_policy ==
+                    TRAP_QUEUE_DROP_OLDEST ? "oldest" : "newest"));
+        snmp_increment_statistic(STAT_NOTIFY_DROPPED);
+        if (trap_queue_policy != TRAP_QUEUE_DROP_OLDEST) {
+            _trap_queue_free(e);
+            return 1;
+        }
+        _trap_queue_free(_trap_queue_pop());
+    }
+
+    if (trap_queue_tail)
+        trap_queue_tail->next = e;
+    else
+        trap_queue_head = e;
+    trap_queue_tail = e;
+    trap_queue_length++;
+    snmp_increment_statistic(STAT_NOTIFY_QUEUED);
+    if (trap_queue_alarm == 0)
+        trap_queue_alarm = snmp_alarm_register(0, 0, _trap_queue_run, NULL);
+    return 1;
+}
+
+/**
+ * Sends any notifications still queued, as is done before the trap sinks
+ * are reconfigured and when the agent shuts down.
+ */
+void
+netsnmp_trap_queue_flush(void)
+{
+    struct trap_queue_entry *e;
+
+    if (trap_queue_alarm) {
+        snmp_alarm_unregister(trap_queue_alarm);
+        trap_queue_alarm = 0;
+    }
+    while ((e = _trap_queue_pop()) != NULL) {
+        _send_to_sinks(e->v1pdu, e->v2pdu);
+        _trap_queue_free(e);
+    }
+}
+
 /**
  * This function allows you to make a distinction between generic 
  * traps from different classes of equipment. For example, you may want 
@@ -631,7 +980,6 @@ netsnmp_send_traps(int trap, int specific,
     netsnmp_variable_list *var;
     in_addr_t             *pdu_in_addr_t;
     u_long                 uptime;
-    struct trap_sink *sink;
     const char            *v1trapaddress;
     int                    res = 0;
 
@@ -812,32 +1160,13 @@ netsnmp_send_traps(int trap, int specific,
     }
 
     /*
-     *  Now loop through the list of trap sinks
-     *   and call the trap callback routines,
+     *  Now either queue the notification, or loop through the list of
+     *   trap sinks and call the trap callback routines,
      *   providing an appropriately formatted PDU in each case
      */
-    for (sink = sinks; sink; sink = sink->next) {
-#ifndef NETSNMP_DISABLE_SNMPV1
-        if (sink->version == SNMP_VERSION_1) {
-          if (template_v1pdu) {
-            send_trap_to_sess(sink->sesp, template_v1pdu);
-          }
-        } else {
-#endif
-          if (template_v2pdu) {
-            template_v2pdu->command = sink->pdutype;
-            send_trap_to_sess(sink->sesp, template_v2pdu);
-          }
-#ifndef NETSNMP_DISABLE_SNMPV1
-        }
-#endif
-    }
-    if (template_v1pdu)
-        snmp_call_callbacks(SNMP_CALLBACK_APPLICATION,
-                        SNMPD_CALLBACK_SEND_TRAP1, template_v1pdu);
-    if (template_v2pdu)
-        snmp_call_callbacks(SNMP_CALLBACK_APPLICATION,
-                        SNMPD_CALLBACK_SEND_TRAP2, template_v2pdu);
+    if (_trap_queue_add(template_v1pdu, template_v2pdu))
+        return 0;
+    _send_to_sinks(template_v1pdu, template_v2pdu);
     snmp_free_pdu(template_v1pdu);
     snmp_free_pdu(template_v2pdu);
     return 0;
@@ -1311,4 +1640,23 @@ snmpd_free_trapcommunity(void)
     }
 }
 #endif
+
+void
+snmpd_parse_config_notification_queue_policy(const char *word, char *cptr)
+{
+    if (strcasecmp(cptr, "dropNewest") == 0)
+        trap_queue_policy = TRAP_QUEUE_DROP_NEWEST;
+    else if (strcasecmp(cptr, "dropOldest") == 0)
+        trap_queue_policy = TRAP_QUEUE_DROP_OLDEST;
+    else if (strcasecmp(cptr, "coalesce") == 0)
+        trap_queue_policy = TRAP_QUEUE_COALESCE;
+    else
+        config_perror("expected dropNewest, dropOldest or coalesce");
+}
+
+void
+snmpd_free_notification_queue_policy(void)
+{
+    trap_queue_policy = TRAP_QUEUE_DROP_NEWEST;
+}
 /** @} */
@@ -0,0 +1,472 @@
+/*
+ * agent_workers.c
+ *
+ * Pool of threads processing read-only requests for thread safe
+ * handlers, so that a slow handler on the main thread no longer holds
+ * up every other manager.
+ *
+ * The main thread still receives and parses every packet, checks access
+ * and sends every response; only handle_pdu() runs on the workers.
+ * Completed requests are handed back through a pipe watched by the main
+ * loop.  A read/write lock keeps the workers out while the main thread
+ * changes the registry, the configuration or processes a SET.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <errno.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/agent/agent_registry.h>
+#include <net-snmp/agent/agent_workers.h>
+
+/**
+ * Hands a request back to the main thread.  Called by a handler running
+ * on a worker thread which finds that it has to do something only the
+ * main thread may do, like reloading a cache; the request is then
+ * processed again from scratch on the main thread.
+ *
+ * @return 1 if the request was handed back, in which case the handler
+ *         returns SNMP_ERR_GENERR, or 0 if the handler is running on the
+ *         main thread.
+ */
+int
+netsnmp_agent_workers_hand_back(netsnmp_agent_request_info *reqinfo)
+{
+    if (!reqinfo->asp || !(reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER))
+        return 0;
+    reqinfo->asp->flags |= SNMP_AGENT_FLAGS_NOT_THREAD_SAFE;
+    return 1;
+}
+
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+
+#include <pthread.h>
+
+extern netsnmp_agent_session *netsnmp_processing_set;
+
+typedef struct agent_worker_job_s {
+    netsnmp_agent_session *asp;
+    int             status;
+    int             cancelled;  /* the request is freed, not answered */
+    struct agent_worker_job_s *next;
+    /* jobs not completed yet; only used on the main thread */
+    struct agent_worker_job_s *prev_outstanding, *next_outstanding;
+} agent_worker_job;
+
+typedef struct agent_worker_queue_s {
+    agent_worker_job *head;
+    agent_worker_job *tail;
+} agent_worker_queue;
+
+static pthread_t *workers;
+static int      worker_count;
+static int      workers_stopping;
+static int      lock_depth;
+static int      done_pipe[2] = { -1, -1 };
+
+/* protects both queues and workers_stopping */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static agent_worker_queue pending_jobs, done_jobs;
+
+static agent_worker_job *outstanding_jobs;
+
+/* read locked by the workers, write locked by the main thread */
+static pthread_rwlock_t agent_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void
+_queue_push(agent_worker_queue *queue, agent_worker_job *job)
+{
+    job->next = NULL;
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+}
+
+static agent_worker_job *
+_queue_pop(agent_worker_queue *queue)
+{
+    agent_worker_job *job = queue->head;
+
+    if (job) {
+        queue->head = job->next;
+        if (!queue->head)
+            queue->tail = NULL;
+    }
+    return job;
+}
+
+static void    *
+_worker_run(void *arg)
+{
+    agent_worker_job *job;
+    int             cancelled;
+
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!workers_stopping && !pending_jobs.head)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        job = _queue_pop(&pending_jobs);
+        cancelled = job ? job->cancelled : 0;
+        pthread_mutex_unlock(&queue_lock);
+        if (!job)
+            break;
+
+        if (!cancelled) {
+            pthread_rwlock_rdlock(&agent_lock);
+            job->status = handle_pdu(job->asp);
+            pthread_rwlock_unlock(&agent_lock);
+        }
+
+        pthread_mutex_lock(&queue_lock);
+        _queue_push(&done_jobs, job);
+        pthread_mutex_unlock(&queue_lock);
+        /*
+         * a full pipe already guarantees a wakeup of the main loop
+         */
+        if (write(done_pipe[1], "", 1) < 0 && errno != EAGAIN)
+            snmp_log_perror("agent worker");
+    }
+    return NULL;
+}
+
+/*
+ * Main thread: finish off the requests the workers are done with.
+ */
+static void
+_workers_complete(int fd, void *data)
+{
+    agent_worker_job *job, *next;
+    char            buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pthread_mutex_lock(&queue_lock);
+    job = done_jobs.head;
+    done_jobs.head = done_jobs.tail = NULL;
+    pthread_mutex_unlock(&queue_lock);
+
+    for (; job; job = next) {
+        next = job->next;
+        if (job->prev_outstanding)
+            job->prev_outstanding->next_outstanding = job->next_outstanding;
+        else
+            outstanding_jobs = job->next_outstanding;
+        if (job->next_outstanding)
+            job->next_outstanding->prev_outstanding = job->prev_outstanding;
+        job->asp->worker_job = NULL;
+        job->asp->flags &= ~SNMP_AGENT_FLAGS_IN_WORKER;
+        if (job->cancelled)
+            free_agent_snmp_session(job->asp);
+        else
+            netsnmp_complete_request(job->asp, job->status);
+        free(job);
+    }
+}
+
+/**
+ * Starts the worker threads.
+ *
+ * @param count the number of threads to start
+ *
+ * @return the number of threads running, or -1 on failure.
+ */
+int
+netsnmp_agent_workers_start(int count)
+{
+    sigset_t        all, old;
+    int             i, rc;
+
+    if (worker_count || count <= 0)
+        return worker_count;
+
+    if (pipe(done_pipe) < 0) {
+        snmp_log_perror("agent workers: pipe");
+        return -1;
+    }
+    for (i = 0; i < 2; i++)
+        fcntl(done_pipe[i], F_SETFL,
+              fcntl(done_pipe[i], F_GETFL) | O_NONBLOCK);
+
+    workers = (pthread_t *) calloc(count, sizeof(pthread_t));
+    if (!workers) {
+        close(done_pipe[0]);
+        close(done_pipe[1]);
+        return -1;
+    }
+
+    /*
+     * signals (SIGHUP in particular) are left to the main thread
+     */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    workers_stopping = 0;
+    for (i = 0; i < count; i++) {
+        rc = pthread_create(&workers[i], NULL, _worker_run, NULL);
+        if (rc != 0) {
+            snmp_log(LOG_ERR, "agent workers: started %d of %d threads: %s\n",
+                     i, count, strerror(rc));
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    worker_count = i;
+    if (!worker_count) {
+        SNMP_FREE(workers);
+        close(done_pipe[0]);
+        close(done_pipe[1]);
+        return -1;
+    }
+    register_readfd(done_pipe[0], _workers_complete, NULL);
+    snmp_log(LOG_INFO, "Processing requests on %d worker threads\n",
+             worker_count);
+    return worker_count;
+}
+
+/**
+ * Stops the worker threads, after they finished the requests already
+ * dispatched to them.
+ */
+void
+netsnmp_agent_workers_stop(void)
+{
+    int             i, count = worker_count;
+
+    if (!worker_count)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    workers_stopping = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (i = 0; i < count; i++)
+        pthread_join(workers[i], NULL);
+    SNMP_FREE(workers);
+    worker_count = 0;
+
+    unregister_readfd(done_pipe[0]);
+    _workers_complete(done_pipe[0], NULL);
+    close(done_pipe[0]);
+    close(done_pipe[1]);
+    done_pipe[0] = done_pipe[1] = -1;
+    DEBUGMSGTL(("agent_workers", "stopped %d threads\n", count));
+}
+
+/**
+ * Hands a request to the worker threads, if it is a read-only request
+ * whose varbinds all fall into thread safe registrations.
+ *
+ * @return 1 if the request was dispatched, 0 if the caller has to
+ *         process it.
+ */
+int
+netsnmp_agent_workers_dispatch(netsnmp_agent_session *asp)
+{
+    netsnmp_variable_list *var;
+    netsnmp_subtree *tp;
+    agent_worker_job *job;
+
+    if (!worker_count || netsnmp_processing_set)
+        return 0;
+
+    switch (asp->pdu->command) {
+    case SNMP_MSG_GET:
+    case SNMP_MSG_GETNEXT:
+    case SNMP_MSG_GETBULK:
+        break;
+    default:
+        return 0;
+    }
+
+    /*
+     * Varbinds outside of any registration are handled by the workers
+     * as well; a GETNEXT that walks into a handler which is not thread
+     * safe is handed back by netsnmp_call_handlers().
+     */
+    for (var = asp->pdu->variables; var; var = var->next_variable) {
+        tp = netsnmp_subtree_find(var->name, var->name_length, NULL,
+                                  asp->pdu->contextName);
+        if (tp && tp->reginfo &&
+            !(tp->reginfo->modes & HANDLER_CAN_THREAD_SAFE))
+            return 0;
+    }
+
+    job = SNMP_MALLOC_TYPEDEF(agent_worker_job);
+    if (!job)
+        return 0;
+    job->asp = asp;
+    asp->flags |= SNMP_AGENT_FLAGS_IN_WORKER;
+    asp->worker_job = job;
+    job->next_outstanding = outstanding_jobs;
+    if (outstanding_jobs)
+        outstanding_jobs->prev_outstanding = job;
+    outstanding_jobs = job;
+
+    pthread_mutex_lock(&queue_lock);
+    _queue_push(&pending_jobs, job);
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return 1;
+}
+
+/**
+ * Cancels a request handed to the worker threads, which is then freed
+ * instead of answered once the workers are done with it.
+ *
+ * @return 1 if the request is still owned by the workers and must not
+ *         be freed by the caller, 0 otherwise.
+ */
+int
+netsnmp_agent_workers_cancel(netsnmp_agent_session *asp)
+{
+    agent_worker_job *job = (agent_worker_job *) asp->worker_job;
+
+    if (!job)
+        return 0;
+    DEBUGMSGTL(("agent_workers", "cancelled request %8p\n", asp));
+    pthread_mutex_lock(&queue_lock);
+    job->cancelled = 1;
+    pthread_mutex_unlock(&queue_lock);
+    return 1;
+}
+
+/**
+ * Cancels every request from a session which is being closed.
+ */
+void
+netsnmp_agent_workers_cancel_session(netsnmp_session *sess)
+{
+    agent_worker_job *job;
+
+    for (job = outstanding_jobs; job; job = job->next_outstanding)
+        if (job->asp->session == sess)
+            netsnmp_agent_workers_cancel(job->asp);
+}
+
+/**
+ * Called before the handlers of a registration process a request.  On
+ * the main thread this waits for all the workers, which are kept out
+ * until netsnmp_agent_workers_leave() is called.  Workers run the
+ * handlers of a registration concurrently: thread safe handlers keep the
+ * state of a request in the request, never in the registration.
+ */
+void
+netsnmp_agent_workers_enter(netsnmp_handler_registration *reginfo,
+                            netsnmp_agent_request_info *reqinfo)
+{
+    if (!(reqinfo->asp && (reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER))
+        && worker_count)
+        netsnmp_agent_workers_lock();
+}
+
+void
+netsnmp_agent_workers_leave(netsnmp_handler_registration *reginfo,
+                            netsnmp_agent_request_info *reqinfo)
+{
+    if (!(reqinfo->asp && (reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER))
+        && worker_count)
+        netsnmp_agent_workers_unlock();
+}
+
+void
+netsnmp_agent_workers_lock(void)
+{
+    if (worker_count && lock_depth++ == 0)
+        pthread_rwlock_wrlock(&agent_lock);
+}
+
+void
+netsnmp_agent_workers_unlock(void)
+{
+    /*
+     * lookups on the workers only read the VACM view index, so it is
+     * brought up to date before they run again
+     */
+    if (lock_depth) {
+        if (--lock_depth == 0) {
+            vacm_buildIndexes();
+            pthread_rwlock_unlock(&agent_lock);
+        }
+    } else if (!worker_count)
+        vacm_buildIndexes();
+}
+
+#else /* NETSNMP_REENTRANT && HAVE_PTHREAD_H */
+
+int
+netsnmp_agent_workers_start(int count)
+{
+    if (count > 0)
+        snmp_log(LOG_WARNING, "agent workers need a build configured with "
+                 "--enable-reentrant; processing requests on the main "
+                 "thread\n");
+    return 0;
+}
+
+void
+netsnmp_agent_workers_stop(void)
+{
+}
+
+int
+netsnmp_agent_workers_dispatch(netsnmp_agent_session *asp)
+{
+    return 0;
+}
+
+int
+netsnmp_agent_workers_cancel(netsnmp_agent_session *asp)
+{
+    return 0;
+}
+
+void
+netsnmp_agent_workers_cancel_session(netsnmp_session *sess)
+{
+}
+
+void
+netsnmp_agent_workers_enter(netsnmp_handler_registration *reginfo,
+                            netsnmp_agent_request_info *reqinfo)
+{
+}
+
+void
+netsnmp_agent_workers_leave(netsnmp_handler_registration *reginfo,
+                            netsnmp_agent_request_info *reqinfo)
+{
+}
+
+void
+netsnmp_agent_workers_lock(void)
+{
+}
+
+void
+netsnmp_agent_workers_unlock(void)
+{
+    vacm_buildIndexes();
+}
+
+#endif /* NETSNMP_REENTRANT && HAVE_PTHREAD_H */
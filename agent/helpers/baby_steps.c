@@ -123,6 +123,7 @@ _baby_steps_helper(netsnmp_mib_handler *handler,
 {
     netsnmp_baby_steps_modes *bs_modes;
     int save_mode, i, rc = SNMP_ERR_NOERROR;
+    int is_set = 0;
     u_short *mode_map_ptr;
     
     DEBUGMSGTL(("baby_steps", "Got request, mode %s\n",
@@ -150,15 +151,16 @@ _baby_steps_helper(netsnmp_mib_handler *handler,
     case MODE_SET_FREE:
     case MODE_SET_UNDO:
         mode_map_ptr = set_mode_map[reqinfo->mode];
+        is_set = 1;
         break;
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
             
     default:
         /*
-         * clear completed modes
+         * completed modes are only looked at by SETs, so they are left
+         * alone here: agent worker threads may be processing several
+         * read requests with this handler at once.
          */
-        bs_modes->completed = 0;
-
         mode_map_ptr = get_mode_map;
     }
 
@@ -276,8 +278,10 @@ _baby_steps_helper(netsnmp_mib_handler *handler,
 
             reqinfo->mode = mode_map_ptr[i];
             mode_flag = netsnmp_baby_step_mode2flag( mode_map_ptr[i] );
-            if((mode_flag & bs_modes->registered))
-                bs_modes->completed |= mode_flag;
+            if((mode_flag & bs_modes->registered)) {
+                if (is_set)
+                    bs_modes->completed |= mode_flag;
+            }
             else {
                 DEBUGMSGTL(("baby_steps",
                             "   skipping mode (not registered)\n"));
@@ -495,7 +499,18 @@ _baby_steps_access_multiplexer(netsnmp_mib_handler *handler,
     /*
      * if method exists, set up handler void and call method.
      */
-    if(NULL != method) {
+    if(NULL != method && reqinfo->asp &&
+       (reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER)) {
+        /*
+         * other worker threads may be using the handler at the same
+         * time, so hand the method a copy of it
+         */
+        netsnmp_mib_handler access_handler = *handler;
+
+        access_handler.myvoid = access_methods->my_access_void;
+        rc = (*method)(&access_handler, reginfo, reqinfo, requests);
+    }
+    else if(NULL != method) {
         temp_void = handler->myvoid;
         handler->myvoid = access_methods->my_access_void;
         rc = (*method)(handler, reginfo, reqinfo, requests);
@@ -36,12 +36,13 @@ void
 netsnmp_bulk_to_next_fix_requests(netsnmp_request_info *requests)
 {
     netsnmp_request_info *request;
+    netsnmp_variable_list *next;
     /*
      * Make sure that:
      *    - repeats remain
      *    - last handler provided an answer
      *    - answer didn't exceed range end (ala check_getnext_results)
-     *    - there is a next variable
+     *    - there is a next repetition
      * then
      * update the varbinds for the next request series 
      */
@@ -53,12 +54,12 @@ netsnmp_bulk_to_next_fix_requests(netsnmp_request_info *requests)
                               request->requestvb->name_length,
                               request->range_end,
                               request->range_end_len) < 0) &&
-            request->requestvb->next_variable ) {
+            (next = netsnmp_request_next_repetition(request,
+                                                    request->requestvb))) {
             request->repeat--;
-            snmp_set_var_objid(request->requestvb->next_variable,
-                               request->requestvb->name,
+            snmp_set_var_objid(next, request->requestvb->name,
                                request->requestvb->name_length);
-            request->requestvb = request->requestvb->next_variable;
+            request->requestvb = next;
             request->requestvb->type = ASN_PRIV_RETRY;
             /*
              * if inclusive == 2, it was set in check_getnext_results for
@@ -119,7 +120,7 @@ netsnmp_bulk_to_next_helper(netsnmp_mib_handler *handler,
         /*
          * let agent handler know that we've already called next handler
          */
-        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+        netsnmp_handler_skip_auto_next(handler, reqinfo);
     }
 
     return ret;
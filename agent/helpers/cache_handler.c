@@ -16,12 +16,25 @@
 #else
 #include <strings.h>
 #endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <errno.h>
+#include <signal.h>
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
 
 #include <net-snmp/agent/cache_handler.h>
 
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define CACHE_RELOAD_THREAD 1
+#endif
+
 netsnmp_feature_child_of(cache_handler, mib_helpers)
 
 netsnmp_feature_child_of(cache_find_by_oid, cache_handler)
@@ -30,6 +43,7 @@ netsnmp_feature_child_of(cache_get_head, cache_handler)
 static netsnmp_cache  *cache_head = NULL;
 static int             cache_outstanding_valid = 0;
 static int             _cache_load( netsnmp_cache *cache );
+static void            _cache_reload_wait( netsnmp_cache *cache );
 
 #define CACHE_RELEASE_FREQUENCY 60      /* Check for expired caches every 60s */
 
@@ -93,6 +107,26 @@ void            release_cached_resources(unsigned int regNo,
  *  not be used if cache is not synchronized automatically as it would
  *  result in stale cache information when if polling happens too fast.
  *
+ *  If NETSNMP_CACHE_BACKGROUND_RELOAD is set and spare_magic is not NULL,
+ *  an expired cache is reloaded by a background thread, while requests
+ *  keep being answered from the previous data.  The load_cache routine
+ *  is called with spare_magic instead of magic and must not touch
+ *  anything else the agent uses (nor call snmp_log).  Once it is done,
+ *  the main thread calls swap_cache (or exchanges magic and spare_magic
+ *  when there is none) to make the new data current; free_cache is
+ *  called with spare_magic before the next reload.  If stale_limit is
+ *  set, data older than that many seconds is no longer served: the
+ *  request waits for the reload instead.  The first load, and every
+ *  load in builds without --enable-reentrant, happens inline.
+ *
+ *  The number of loads, failed loads and the time they took are kept in
+ *  the load_* members of the cache, together with the number of requests
+ *  served from the cached data (hits) and of times it was found expired.
+ *  Load routines that know how many rows and bytes they loaded may set
+ *  the rows and bytes members.  The nsCacheStatsTable reports these, and
+ *  netsnmp_cache_stats_dump() writes them out under the "cache_stats"
+ *  debug token.
+ *
  *
  *  Here are some suggestions for some common situations.
  *
@@ -131,6 +165,17 @@ void            release_cached_resources(unsigned int regNo,
  *
  *          NETSNMP_CACHE_RESET_TIMER_ON_USE
  *
+ *  Expensive loads:
+ *      If loading the cache takes long enough to hold up requests (e.g.
+ *      scanning every process or socket), let a background thread do it
+ *      and keep serving the previous data meanwhile.  Allocate a second,
+ *      empty, data set as spare_magic (and a swap_cache routine if the
+ *      table handler does not look the data up through magic), set
+ *      stale_limit to bound the age of the data served, and set:
+ *
+ *          NETSNMP_CACHE_BACKGROUND_RELOAD
+ *          NETSNMP_CACHE_DONT_FREE_EXPIRED
+ *
  *  @{
  */
 
@@ -186,6 +231,8 @@ netsnmp_cache_create(int timeout, NetsnmpCacheLoad * load_hook,
     cache->load_cache = load_hook;
     cache->free_cache = free_hook;
     cache->enabled = 1;
+    cache->rows = -1;
+    cache->bytes = -1;
 
     if(0 == cache->timeout)
         cache->timeout = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
@@ -256,9 +303,21 @@ netsnmp_cache_free(netsnmp_cache *cache)
     if(0 != cache->timer_id)
         netsnmp_cache_timer_stop(cache);
 
+    if (cache->reloading)
+        _cache_reload_wait(cache);
+
     if (cache->valid)
         _cache_free(cache);
 
+#ifdef CACHE_RELOAD_THREAD
+    /*
+     * the spare holds the data replaced by the last background reload
+     */
+    if ((cache->flags & NETSNMP_CACHE_BACKGROUND_RELOAD) &&
+        cache->spare_magic && cache->free_cache)
+        cache->free_cache(cache, cache->spare_magic);
+#endif
+
     if (cache->timestampM)
 	free(cache->timestampM);
 
@@ -308,9 +367,10 @@ _timer_reload(unsigned int regNo, void *clientargs)
 
     DEBUGMSGT(("cache_timer:start", "loading cache %p\n", cache));
 
+    netsnmp_agent_workers_lock();
     cache->expired = 1;
-
     _cache_load(cache);
+    netsnmp_agent_workers_unlock();
 }
 
 /** starts the recurring cache_load callback */
@@ -513,6 +573,18 @@ netsnmp_extract_cache_info(netsnmp_agent_request_info * reqinfo)
 #endif /* NETSNMP_FEATURE_REMOVE_NETSNMP_EXTRACT_CACHE_INFO */
 
 
+/*
+ * Has the cache timeout passed?  Unlike netsnmp_cache_check_expired(),
+ * this does not change the cache.
+ */
+static int
+_cache_timed_out(netsnmp_cache *cache)
+{
+    return !cache->valid || (NULL == cache->timestampM) ||
+        (-1 == cache->timeout) ||
+        netsnmp_ready_monotonic(cache->timestampM, 1000 * cache->timeout);
+}
+
 /** Check if the cache timeout has passed. Sets and return the expired flag. */
 int
 netsnmp_cache_check_expired(netsnmp_cache *cache)
@@ -521,11 +593,16 @@ netsnmp_cache_check_expired(netsnmp_cache *cache)
         return 0;
     if (cache->expired)
         return 1;
-    if(!cache->valid || (NULL == cache->timestampM) || (-1 == cache->timeout))
+    if (_cache_timed_out(cache)) {
+        if (cache->valid && cache->timestampM && -1 != cache->timeout)
+            cache->expirations++;
+        /*
+         * the worker threads check the flag
+         */
+        netsnmp_agent_workers_lock();
         cache->expired = 1;
-    else
-        cache->expired = netsnmp_ready_monotonic(cache->timestampM,
-                                                 1000 * cache->timeout);
+        netsnmp_agent_workers_unlock();
+    }
     
     return cache->expired;
 }
@@ -538,11 +615,20 @@ netsnmp_cache_check_and_reload(netsnmp_cache * cache)
         DEBUGMSGT(("helper:cache_handler", " no cache\n"));
         return 0;	/* ?? or -1 */
     }
-    if (!cache->valid || netsnmp_cache_check_expired(cache))
-        return _cache_load( cache );
-    else {
+    if (!cache->valid || netsnmp_cache_check_expired(cache)) {
+        u_long          loads = cache->load_count;
+        int             ret = _cache_load( cache );
+
+        /*
+         * served from the previous data while it is reloaded
+         */
+        if (cache->load_count == loads && cache->valid)
+            cache->hits++;
+        return ret;
+    } else {
         DEBUGMSGT(("helper:cache_handler", " cached (%d)\n",
                    cache->timeout));
+        cache->hits++;
         return 0;
     }
 }
@@ -579,6 +665,8 @@ netsnmp_cache_helper_handler(netsnmp_mib_handler * handler,
 
     netsnmp_cache  *cache = NULL;
     netsnmp_handler_args cache_hint;
+    int             in_worker = reqinfo->asp &&
+        (reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER);
 
     DEBUGMSGTL(("helper:cache_handler", "Got request (%d) for %s: ",
                 reqinfo->mode, reginfo->handlerName));
@@ -603,13 +691,15 @@ netsnmp_cache_helper_handler(netsnmp_mib_handler * handler,
 
     /*
      * Make the handler-chain parameters available to
-     * the cache_load hook routine.
+     * the cache_load hook routine, which only runs on the main thread.
      */
-    cache_hint.handler = handler;
-    cache_hint.reginfo = reginfo;
-    cache_hint.reqinfo = reqinfo;
-    cache_hint.requests = requests;
-    cache->cache_hint = &cache_hint;
+    if (!in_worker) {
+        cache_hint.handler = handler;
+        cache_hint.reginfo = reginfo;
+        cache_hint.reqinfo = reqinfo;
+        cache_hint.requests = requests;
+        cache->cache_hint = &cache_hint;
+    }
 
     switch (reqinfo->mode) {
 
@@ -631,6 +721,21 @@ netsnmp_cache_helper_handler(netsnmp_mib_handler * handler,
         if (netsnmp_cache_is_valid(reqinfo, addrstr))
             break;
 
+        /*
+         * On a worker thread the cache is only read: the main thread
+         * loads and frees it while the workers are locked out.
+         */
+        if (in_worker) {
+            if ((cache->flags & NETSNMP_CACHE_RESET_TIMER_ON_USE) ||
+                cache->expired || _cache_timed_out(cache)) {
+                DEBUGMSGT(("helper:cache_handler", " needs the main thread\n"));
+                netsnmp_agent_workers_hand_back(reqinfo);
+                return SNMP_ERR_GENERR;
+            }
+            netsnmp_cache_reqinfo_insert(cache, reqinfo, addrstr);
+            return SNMP_ERR_NOERROR;
+        }
+
         /*
          * call the load hook, and update the cache timestamp.
          * If it's not already there, add to reqinfo
@@ -655,6 +760,11 @@ netsnmp_cache_helper_handler(netsnmp_mib_handler * handler,
          * Only do this on the last pass through.
          */
     case MODE_SET_COMMIT:
+        /*
+         * a reload under way may have read the data before the SET
+         */
+        if (cache->reloading)
+            _cache_reload_wait(cache);
         if (cache->valid && 
             ! (cache->flags & NETSNMP_CACHE_DONT_INVALIDATE_ON_SET) ) {
             cache->free_cache(cache, cache->magic);
@@ -679,30 +789,67 @@ static void
 _cache_free( netsnmp_cache *cache )
 {
     if (NULL != cache->free_cache) {
+        netsnmp_agent_workers_lock();
         cache->free_cache(cache, cache->magic);
         cache->valid = 0;
+        netsnmp_agent_workers_unlock();
     }
 }
 
-static int
-_cache_load( netsnmp_cache *cache )
+static u_long
+_cache_elapsed(const struct timeval *start)
 {
-    int ret = -1;
+    struct timeval  now, diff;
 
-    /*
-     * If we've got a valid cache, then release it before reloading
-     */
-    if (cache->valid &&
-        (! (cache->flags & NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD)))
-        _cache_free(cache);
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, start, &diff);
+    return diff.tv_sec * 1000000 + diff.tv_usec;
+}
 
-    if ( cache->load_cache)
-        ret = cache->load_cache(cache, cache->magic);
-    if (ret < 0) {
-        DEBUGMSGT(("helper:cache_handler", " load failed (%d)\n", ret));
-        cache->valid = 0;
-        return ret;
+static void
+_cache_stats_print(netsnmp_cache *cache)
+{
+    DEBUGMSGTL(("cache_stats", "%p ", cache));
+    DEBUGMSGOID(("cache_stats", cache->rootoid, cache->rootoid_len));
+    DEBUGMSG(("cache_stats", ": %lu loads (%lu failed), last %lu us, "
+              "max %lu us, total %lu ms, up to 1ms/10ms/100ms/1s/more "
+              "%lu/%lu/%lu/%lu/%lu, %lu hits, %lu expirations, "
+              "%ld rows, %ld bytes\n", cache->load_count,
+              cache->load_failures, cache->load_time_last,
+              cache->load_time_max,
+              (u_long) (cache->load_time_total / 1000),
+              cache->load_time_hist[0], cache->load_time_hist[1],
+              cache->load_time_hist[2], cache->load_time_hist[3],
+              cache->load_time_hist[4], cache->hits, cache->expirations,
+              cache->rows, cache->bytes));
+}
+
+static void
+_cache_count_load(netsnmp_cache *cache, int ret, u_long usec)
+{
+    u_long          limit;
+    int             i;
+
+    cache->load_count++;
+    if (ret < 0)
+        cache->load_failures++;
+    cache->load_time_last = usec;
+    if (usec > cache->load_time_max)
+        cache->load_time_max = usec;
+    cache->load_time_total += usec;
+    for (i = 0, limit = 1000; i < NETSNMP_CACHE_LOAD_TIME_BUCKETS - 1 &&
+         usec > limit; i++, limit *= 10)
+        ;
+    cache->load_time_hist[i]++;
+
+    DEBUGIF("cache_stats") {
+        _cache_stats_print(cache);
     }
+}
+
+static void
+_cache_loaded( netsnmp_cache *cache )
+{
     cache->valid = 1;
     cache->expired = 0;
 
@@ -718,12 +865,280 @@ _cache_load( netsnmp_cache *cache )
     }
     netsnmp_set_monotonic_marker(&cache->timestampM);
     DEBUGMSGT(("helper:cache_handler", " loaded (%d)\n", cache->timeout));
+}
+
+#define CACHE_RELOAD_IDLE       0
+#define CACHE_RELOAD_RUNNING    1
+#define CACHE_RELOAD_DONE       2
 
+#ifdef CACHE_RELOAD_THREAD
+
+static int      reload_thread_started;
+static int      reload_pipe[2] = { -1, -1 };
+
+/* protects both lists and the reloading member of the caches on them */
+static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reload_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t reload_done_cond = PTHREAD_COND_INITIALIZER;
+static netsnmp_cache *reload_queue, *reload_done;
+
+static void    *
+_cache_reload_run(void *arg)
+{
+    netsnmp_cache  *cache;
+    struct timeval  start;
+    int             ret;
+
+    for (;;) {
+        pthread_mutex_lock(&reload_lock);
+        while (!reload_queue)
+            pthread_cond_wait(&reload_cond, &reload_lock);
+        cache = reload_queue;
+        reload_queue = cache->reload_next;
+        pthread_mutex_unlock(&reload_lock);
+
+        netsnmp_get_monotonic_clock(&start);
+        if (cache->free_cache &&
+            !(cache->flags & NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD))
+            cache->free_cache(cache, cache->spare_magic);
+        ret = cache->load_cache(cache, cache->spare_magic);
+
+        pthread_mutex_lock(&reload_lock);
+        cache->reload_rc = ret;
+        cache->reload_time = _cache_elapsed(&start);
+        cache->reloading = CACHE_RELOAD_DONE;
+        cache->reload_next = reload_done;
+        reload_done = cache;
+        pthread_cond_broadcast(&reload_done_cond);
+        pthread_mutex_unlock(&reload_lock);
+        /*
+         * a full pipe already guarantees a wakeup of the main loop
+         */
+        while (write(reload_pipe[1], "", 1) < 0 && errno == EINTR)
+            ;
+    }
+    return NULL;
+}
+
+/*
+ * Main thread: make the data of a finished reload current.
+ */
+static void
+_cache_reload_finish(netsnmp_cache *cache)
+{
+    void           *data;
+
+    cache->reloading = CACHE_RELOAD_IDLE;
+    _cache_count_load(cache, cache->reload_rc, cache->reload_time);
+    if (cache->reload_rc < 0) {
+        DEBUGMSGT(("helper:cache_handler", " background load of %p failed "
+                   "(%d)\n", cache, cache->reload_rc));
+        return;
+    }
+
+    netsnmp_agent_workers_lock();
+    if (cache->swap_cache)
+        cache->swap_cache(cache, cache->spare_magic);
+    else {
+        data = cache->magic;
+        cache->magic = cache->spare_magic;
+        cache->spare_magic = data;
+    }
+    _cache_loaded(cache);
+    netsnmp_agent_workers_unlock();
+
+    DEBUGMSGT(("helper:cache_handler", " %p reloaded in the background "
+               "(%lu us)\n", cache, cache->reload_time));
+}
+
+static void
+_cache_reload_complete(int fd, void *data)
+{
+    netsnmp_cache  *cache, *next;
+    char            buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pthread_mutex_lock(&reload_lock);
+    cache = reload_done;
+    reload_done = NULL;
+    pthread_mutex_unlock(&reload_lock);
+
+    for (; cache; cache = next) {
+        next = cache->reload_next;
+        _cache_reload_finish(cache);
+    }
+}
+
+/*
+ * Hands a cache to the reload thread, starting it if need be.
+ * Returns 0 if the cache is being reloaded in the background.
+ */
+static int
+_cache_reload_start(netsnmp_cache *cache)
+{
+    netsnmp_cache **pos;
+    sigset_t        all, old;
+    int             i, rc;
+
+    if (cache->reloading)
+        return 0;
+
+    if (!reload_thread_started) {
+        pthread_t       thread;
+
+        if (pipe(reload_pipe) < 0) {
+            snmp_log_perror("cache reload: pipe");
+            return -1;
+        }
+        for (i = 0; i < 2; i++)
+            fcntl(reload_pipe[i], F_SETFL,
+                  fcntl(reload_pipe[i], F_GETFL) | O_NONBLOCK);
+
+        /*
+         * signals are left to the main thread
+         */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        rc = pthread_create(&thread, NULL, _cache_reload_run, NULL);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (rc != 0) {
+            snmp_log(LOG_ERR, "cache reload: cannot start thread: %s\n",
+                     strerror(rc));
+            close(reload_pipe[0]);
+            close(reload_pipe[1]);
+            return -1;
+        }
+        pthread_detach(thread);
+        register_readfd(reload_pipe[0], _cache_reload_complete, NULL);
+        reload_thread_started = 1;
+    }
+
+    pthread_mutex_lock(&reload_lock);
+    cache->reloading = CACHE_RELOAD_RUNNING;
+    cache->reload_next = NULL;
+    for (pos = &reload_queue; *pos; pos = &(*pos)->reload_next)
+        ;
+    *pos = cache;
+    pthread_cond_signal(&reload_cond);
+    pthread_mutex_unlock(&reload_lock);
+
+    DEBUGMSGT(("helper:cache_handler", " reloading %p in the background\n",
+               cache));
+    return 0;
+}
+
+/*
+ * Main thread: wait for the reload of a cache and finish it.
+ */
+static void
+_cache_reload_wait(netsnmp_cache *cache)
+{
+    netsnmp_cache **pos;
+
+    pthread_mutex_lock(&reload_lock);
+    while (cache->reloading != CACHE_RELOAD_DONE)
+        pthread_cond_wait(&reload_done_cond, &reload_lock);
+    for (pos = &reload_done; *pos != cache; pos = &(*pos)->reload_next)
+        ;
+    *pos = cache->reload_next;
+    pthread_mutex_unlock(&reload_lock);
+
+    _cache_reload_finish(cache);
+}
+
+/*
+ * Is the data too old to be served while a reload runs?
+ */
+static int
+_cache_too_stale(netsnmp_cache *cache)
+{
+    return cache->stale_limit > 0 && cache->timestampM &&
+        netsnmp_ready_monotonic(cache->timestampM,
+                                1000 * cache->stale_limit);
+}
+
+#else /* CACHE_RELOAD_THREAD */
+
+static void
+_cache_reload_wait(netsnmp_cache *cache)
+{
+}
+
+#endif /* CACHE_RELOAD_THREAD */
+
+static int
+_cache_load( netsnmp_cache *cache )
+{
+    struct timeval  start;
+    int ret = -1;
+
+#ifdef CACHE_RELOAD_THREAD
+    /*
+     * Keep serving the data we have while it is reloaded in the
+     * background, unless it has become too old.
+     */
+    if (cache->valid && !_cache_too_stale(cache) &&
+        (cache->reloading ||
+         ((cache->flags & NETSNMP_CACHE_BACKGROUND_RELOAD) &&
+          cache->spare_magic && cache->load_cache &&
+          _cache_reload_start(cache) == 0)))
+        return 0;
+
+    if (cache->reloading) {
+        DEBUGMSGT(("helper:cache_handler", " waiting for reload of %p\n",
+                   cache));
+        _cache_reload_wait(cache);
+        if (cache->reload_rc < 0 && cache->valid)
+            _cache_free(cache);
+        return cache->reload_rc;
+    }
+#endif
+
+    /*
+     * the worker threads may be reading the data
+     */
+    netsnmp_agent_workers_lock();
+
+    /*
+     * If we've got a valid cache, then release it before reloading
+     */
+    if (cache->valid &&
+        (! (cache->flags & NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD)))
+        _cache_free(cache);
+
+    if ( cache->load_cache) {
+        netsnmp_get_monotonic_clock(&start);
+        ret = cache->load_cache(cache, cache->magic);
+        _cache_count_load(cache, ret, _cache_elapsed(&start));
+    }
+    if (ret < 0) {
+        DEBUGMSGT(("helper:cache_handler", " load failed (%d)\n", ret));
+        cache->valid = 0;
+    } else
+        _cache_loaded(cache);
+
+    netsnmp_agent_workers_unlock();
     return ret;
 }
 
 
 
+/** writes the statistics of every cache out under the "cache_stats"
+ *  debug token.
+ */
+void
+netsnmp_cache_stats_dump(void)
+{
+    netsnmp_cache  *cache;
+
+    DEBUGIF("cache_stats") {
+        for (cache = cache_head; cache; cache = cache->next)
+            _cache_stats_print(cache);
+    }
+}
+
 /** run regularly to automatically release cached resources.
  * xxx - method to prevent cache from expiring while a request
  *     is being processed (e.g. delegated request). proposal:
@@ -31,7 +31,8 @@ netsnmp_register_null_context(oid * loc, size_t loc_len,
             netsnmp_create_handler("null", netsnmp_null_handler);
         if (contextName)
             reginfo->contextName = strdup(contextName);
-        reginfo->modes = HANDLER_CAN_DEFAULT | HANDLER_CAN_GETBULK;
+        reginfo->modes = HANDLER_CAN_DEFAULT | HANDLER_CAN_GETBULK |
+                         HANDLER_CAN_THREAD_SAFE;
     }
     return netsnmp_register_handler(reginfo);
 }
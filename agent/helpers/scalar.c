@@ -125,6 +125,41 @@ netsnmp_register_read_only_scalar(netsnmp_handler_registration *reginfo)
 
 
 
+/*
+ * Calls the instance handler below with the instance subid appended to
+ * the registered OID.  Agent worker threads may process several requests
+ * for the registration at once, so they extend the OID in a copy of the
+ * registration rather than in the shared one (which the main thread
+ * keeps using, as delegated requests may hold on to it).
+ */
+static int
+_scalar_call_instance(netsnmp_mib_handler *handler,
+                      netsnmp_handler_registration *reginfo,
+                      netsnmp_agent_request_info *reqinfo,
+                      netsnmp_request_info *requests)
+{
+    netsnmp_handler_registration instance_reginfo;
+    oid             instance_oid[MAX_OID_LEN];
+    int             ret;
+
+    if (!reqinfo->asp || !(reqinfo->asp->flags & SNMP_AGENT_FLAGS_IN_WORKER)) {
+        reginfo->rootoid[reginfo->rootoid_len++] = 0;
+        ret = netsnmp_call_next_handler(handler, reginfo, reqinfo, requests);
+        reginfo->rootoid_len--;
+        return ret;
+    }
+
+    if (reginfo->rootoid_len >= MAX_OID_LEN)
+        return SNMP_ERR_GENERR;
+    instance_reginfo = *reginfo;
+    memcpy(instance_oid, reginfo->rootoid,
+           reginfo->rootoid_len * sizeof(oid));
+    instance_oid[instance_reginfo.rootoid_len++] = 0;
+    instance_reginfo.rootoid = instance_oid;
+    return netsnmp_call_next_handler(handler, &instance_reginfo, reqinfo,
+                                     requests);
+}
+
 int
 netsnmp_scalar_helper_handler(netsnmp_mib_handler *handler,
                                 netsnmp_handler_registration *reginfo,
@@ -134,7 +169,7 @@ netsnmp_scalar_helper_handler(netsnmp_mib_handler *handler,
 
     netsnmp_variable_list *var = requests->requestvb;
 
-    int             ret, cmp;
+    int             cmp;
     int             namelen;
 
     DEBUGMSGTL(("helper:scalar", "Got request:\n"));
@@ -154,11 +189,8 @@ netsnmp_scalar_helper_handler(netsnmp_mib_handler *handler,
                                       SNMP_NOSUCHOBJECT);
             return SNMP_ERR_NOERROR;
         } else {
-            reginfo->rootoid[reginfo->rootoid_len++] = 0;
-            ret = netsnmp_call_next_handler(handler, reginfo, reqinfo,
-                                             requests);
-            reginfo->rootoid_len--;
-            return ret;
+            return _scalar_call_instance(handler, reginfo, reqinfo,
+                                         requests);
         }
         break;
 
@@ -174,20 +206,14 @@ netsnmp_scalar_helper_handler(netsnmp_mib_handler *handler,
                                       SNMP_ERR_NOCREATION);
             return SNMP_ERR_NOERROR;
         } else {
-            reginfo->rootoid[reginfo->rootoid_len++] = 0;
-            ret = netsnmp_call_next_handler(handler, reginfo, reqinfo,
-                                             requests);
-            reginfo->rootoid_len--;
-            return ret;
+            return _scalar_call_instance(handler, reginfo, reqinfo,
+                                         requests);
         }
         break;
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
 
     case MODE_GETNEXT:
-        reginfo->rootoid[reginfo->rootoid_len++] = 0;
-        ret = netsnmp_call_next_handler(handler, reginfo, reqinfo, requests);
-        reginfo->rootoid_len--;
-        return ret;
+        return _scalar_call_instance(handler, reginfo, reqinfo, requests);
     }
     /*
      * got here only if illegal mode found 
@@ -117,7 +117,7 @@ netsnmp_stash_to_next_helper(netsnmp_mib_handler *handler,
          * let the handler chain processing know that we've already
          * called the next handler
          */
-        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+        netsnmp_handler_skip_auto_next(handler, reqinfo);
     }
 
     return ret;
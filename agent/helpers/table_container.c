@@ -28,6 +28,7 @@ netsnmp_feature_child_of(table_container_extract, table_container_all)
 netsnmp_feature_child_of(table_container_management, table_container_all)
 netsnmp_feature_child_of(table_container_row_remove, table_container_all)
 netsnmp_feature_child_of(table_container_row_insert, table_container_all)
+netsnmp_feature_child_of(table_container_merge, table_container_all)
 netsnmp_feature_child_of(table_container_all, mib_helpers)
 
 #ifndef NETSNMP_FEATURE_REMOVE_TABLE_CONTAINER
@@ -760,11 +761,6 @@ _container_table_handler(netsnmp_mib_handler *handler,
      * xxx-rks: again, this should be handled further up.
      */
     if ((oldmode == MODE_GETNEXT) && (handler->next)) {
-        /*
-         * tell agent handlder not to auto call next handler
-         */
-        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
-
         /*
          * if we found rows to process, pretend to be a get request
          * and call handler below us.
@@ -780,6 +776,12 @@ _container_table_handler(netsnmp_mib_handler *handler,
 
             agtreq_info->mode = oldmode; /* restore saved mode */
         }
+
+        /*
+         * tell agent handlder not to auto call next handler.  This is
+         * done afterwards, as the handlers below may do the same.
+         */
+        netsnmp_handler_skip_auto_next(handler, agtreq_info);
     }
 
     return rc;
@@ -862,6 +864,201 @@ netsnmp_table_index_find_next_row(netsnmp_container *c,
     return (netsnmp_index*)_find_next_row(c, tblreq, NULL );
 }
 
+/* ==================================
+ *
+ * Container Table API: Merge loading
+ *
+ * ================================== */
+
+#ifndef NETSNMP_FEATURE_REMOVE_TABLE_CONTAINER_MERGE
+/*
+ * The table is rebuilt from the merged rows, rather than having rows
+ * removed and inserted one at a time, once at least 1/MERGE_REBUILD_RATIO
+ * of its rows came or went.  Each removal or insertion costs O(n) in a
+ * binary_array, while inserting all the rows in order costs O(log n)
+ * each.
+ */
+#define MERGE_REBUILD_RATIO 16
+
+/**
+ * merge freshly loaded rows into a table's container
+ *
+ * Instead of releasing every row of a table and loading them all
+ * again, a cache load routine can load the rows into an empty
+ * container and have them merged into the table's one:
+ *   - rows of the table which were not loaded again are removed and
+ *     released;
+ *   - loaded rows whose index is not in the table are moved into it;
+ *   - for rows in both, update copies the data of the loaded row into
+ *     the table's row, and the loaded row is released.
+ *
+ * Rows which are in both stay where they are, so the table only
+ * allocates and frees the rows which came or went, and update can tell
+ * when the data of a row really changed (e.g. to keep a last changed
+ * time).  Both containers are walked in order, so they must be sorted
+ * by the same compare routine, and the fresh one must provide an
+ * iterator.  The table is only changed once the walk is done: if many
+ * rows came or went it is cleared and refilled in order, otherwise
+ * just those rows are removed and inserted.  The fresh container is
+ * left empty.
+ *
+ * @param table   the table's container
+ * @param fresh   container holding the rows just loaded
+ * @param update  copies the data of a loaded row (second parameter)
+ *                into the table's row with the same index (first
+ *                parameter).  Returns 1 if the data changed, 0 if it did
+ *                not, or -1 if the row couldn't be updated, in which case
+ *                it is replaced by the loaded row.
+ * @param release releases a row which is no longer needed
+ * @param context passed to update and release
+ * @param stats   if not NULL, set to the number of rows added, deleted,
+ *                changed and left unchanged
+ *
+ * @return 0 on success, -1 if a parameter was invalid or memory ran
+ *         out, in which case the table is left as it was and the loaded
+ *         rows are released
+ */
+int
+netsnmp_container_table_merge(netsnmp_container *table,
+                              netsnmp_container *fresh,
+                              netsnmp_container_table_update_f *update,
+                              netsnmp_container_obj_func *release,
+                              void *context,
+                              netsnmp_container_table_merge_stats *stats)
+{
+    netsnmp_container_table_merge_stats counts;
+    netsnmp_iterator *it;
+    void          **merged, **dropped, **added, **replaced;
+    size_t          table_size, fresh_size, nmerged, ndropped, nadded;
+    size_t          nreplaced, i;
+    void           *row, *new_row;
+    int             rc;
+
+    if (!table || !fresh || !update || !release || !table->compare) {
+        snmp_log(LOG_ERR, "netsnmp_container_table_merge param error\n");
+        return -1;
+    }
+
+    /*
+     * merged: the rows the table ends up with, in order
+     * dropped: rows of the table to be removed and released
+     * added, replaced: loaded rows which go into the table
+     */
+    table_size = CONTAINER_SIZE(table);
+    fresh_size = CONTAINER_SIZE(fresh);
+    merged = (void **) malloc((2 * table_size + 3 * fresh_size + 1) *
+                              sizeof(void *));
+    /*
+     * the loaded rows are released as the walk goes, so walk them with
+     * an iterator rather than by looking up each next row
+     */
+    it = merged ? CONTAINER_ITERATOR(fresh) : NULL;
+    if (NULL == it) {
+        snmp_log(LOG_ERR, "netsnmp_container_table_merge: %s\n",
+                 merged ? "no iterator" : "out of memory");
+        free(merged);
+        CONTAINER_CLEAR(fresh, release, context);
+        return -1;
+    }
+    dropped = merged + table_size + fresh_size;
+    added = dropped + table_size;
+    replaced = added + fresh_size;
+    nmerged = ndropped = nadded = nreplaced = 0;
+
+    memset(&counts, 0x00, sizeof(counts));
+    row = CONTAINER_FIRST(table);
+    new_row = ITERATOR_FIRST(it);
+    while (row || new_row) {
+        if (NULL == row)
+            rc = 1;
+        else if (NULL == new_row)
+            rc = -1;
+        else
+            rc = table->compare(row, new_row);
+
+        if (rc < 0) {
+            /*
+             * the row wasn't loaded again
+             */
+            dropped[ndropped++] = row;
+            ++counts.deleted;
+            row = CONTAINER_NEXT(table, row);
+            continue;
+        }
+
+        if (rc > 0) {
+            added[nadded++] = new_row;
+            merged[nmerged++] = new_row;
+        } else {
+            rc = (*update) (row, new_row, context);
+            if (rc < 0) {
+                DEBUGMSGTL(("table_container:merge",
+                            "replacing row which couldn't be updated\n"));
+                dropped[ndropped++] = row;
+                replaced[nreplaced++] = new_row;
+                merged[nmerged++] = new_row;
+            } else {
+                (*release) (new_row, context);
+                merged[nmerged++] = row;
+                if (rc > 0)
+                    ++counts.changed;
+                else
+                    ++counts.unchanged;
+            }
+            row = CONTAINER_NEXT(table, row);
+        }
+        new_row = ITERATOR_NEXT(it);
+    }
+    ITERATOR_RELEASE(it);
+    CONTAINER_CLEAR(fresh, NULL, NULL);
+
+    if ((ndropped + nadded) * MERGE_REBUILD_RATIO > table_size) {
+        DEBUGMSGTL(("table_container:merge", "rebuilding %s\n",
+                    table->container_name ? table->container_name :
+                    "table"));
+        CONTAINER_CLEAR(table, NULL, NULL);
+        for (i = 0; i < nmerged; ++i) {
+            if (CONTAINER_INSERT(table, merged[i]) == 0)
+                continue;
+            snmp_log(LOG_ERR, "netsnmp_container_table_merge: "
+                     "couldn't insert row\n");
+            (*release) (merged[i], context);
+        }
+        counts.added = nadded;
+        counts.changed += nreplaced;
+    } else {
+        for (i = 0; i < ndropped; ++i)
+            CONTAINER_REMOVE(table, dropped[i]);
+        for (i = 0; i < nadded; ++i) {
+            if (CONTAINER_INSERT(table, added[i]) == 0)
+                ++counts.added;
+            else
+                (*release) (added[i], context);
+        }
+        for (i = 0; i < nreplaced; ++i) {
+            if (CONTAINER_INSERT(table, replaced[i]) == 0)
+                ++counts.changed;
+            else {
+                (*release) (replaced[i], context);
+                ++counts.deleted;
+            }
+        }
+    }
+    for (i = 0; i < ndropped; ++i)
+        (*release) (dropped[i], context);
+    free(merged);
+
+    DEBUGMSGTL(("table_container:merge",
+                "%s: %u added, %u deleted, %u changed, %u unchanged\n",
+                table->container_name ? table->container_name : "table",
+                counts.added, counts.deleted, counts.changed,
+                counts.unchanged));
+    if (stats)
+        *stats = counts;
+    return 0;
+}
+#endif /* NETSNMP_FEATURE_REMOVE_TABLE_CONTAINER_MERGE */
+
 /* ==================================
  *
  * Container Table API: Index operations
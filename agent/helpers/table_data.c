@@ -685,7 +685,7 @@ netsnmp_table_data_helper_handler(netsnmp_mib_handler *handler,
         result = netsnmp_call_next_handler(handler, reginfo, reqinfo,
                                          requests);
         reqinfo->mode = oldmode;
-        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+        netsnmp_handler_skip_auto_next(handler, reqinfo);
         return result;
     }
     else
@@ -78,6 +78,17 @@
         then the free_loop_context_at_end pointer should be set, which
         is more efficient since a malloc/free will only be performed
         once for every iteration.
+
+   Since every request loops over the whole table, walking a large
+   table this way takes time quadratic in its size.  Tables whose data
+   is loaded by a cache helper injected into the same registration can
+   set the NETSNMP_ITERATOR_FLAG_SNAPSHOT flag instead: the hooks are
+   then called once after each load of the cache to collect the
+   indexes into a sorted snapshot, and GET and GETNEXT requests are
+   answered by a binary search of it until the cache is reloaded or a
+   SET is committed.  The data contexts are kept with the snapshot,
+   so they must stay usable until the cache is next loaded.  Without
+   a valid cache the flag is ignored.
  *
  *  @{
  */
@@ -153,6 +164,8 @@ netsnmp_iterator_create_table( Netsnmp_First_Data_Point *firstDP,
 }
 #endif /* NETSNMP_FEATURE_REMOVE_TABLE_ITERATOR_CREATE_TABLE */
 
+static void _ti_snapshot_free(netsnmp_iterator_info *iinfo);
+
 /** Free the memory that was allocated for a table iterator. */
 void
 netsnmp_iterator_delete_table( netsnmp_iterator_info *iinfo )
@@ -160,6 +173,8 @@ netsnmp_iterator_delete_table( netsnmp_iterator_info *iinfo )
     if (!iinfo)
         return;
 
+    _ti_snapshot_free(iinfo);
+
     if (iinfo->indexes) {
         snmp_free_varbind( iinfo->indexes );
         iinfo->indexes = NULL;
@@ -435,6 +450,317 @@ netsnmp_iterator_remember(netsnmp_request_info *request,
 }    
 
 #define TABLE_ITERATOR_NOTAGAIN 255
+
+/*
+ * The rows of an iterator table sorted by their index, for tables with
+ * NETSNMP_ITERATOR_FLAG_SNAPSHOT set.  A snapshot is valid for as long
+ * as the cache it was built from has not been loaded again.
+ */
+typedef struct ti_snapshot_row_s {
+    oid            *index;
+    size_t          index_len;
+    size_t          index_offset;
+    void           *data_context;
+} ti_snapshot_row;
+
+typedef struct ti_snapshot_s {
+    netsnmp_cache  *cache;
+    u_long          load_count;
+    ti_snapshot_row *rows;
+    size_t          row_count;
+    oid            *indexes;    /* the indexes of all rows, back to back */
+} ti_snapshot;
+
+static void
+_ti_snapshot_release(ti_snapshot *snap, netsnmp_iterator_info *iinfo)
+{
+    size_t          i;
+
+    if (iinfo->free_data_context)
+        for (i = 0; i < snap->row_count; i++)
+            if (snap->rows[i].data_context)
+                (iinfo->free_data_context)(snap->rows[i].data_context,
+                                           iinfo);
+    free(snap->rows);
+    free(snap->indexes);
+    free(snap);
+}
+
+static void
+_ti_snapshot_free(netsnmp_iterator_info *iinfo)
+{
+    if (!iinfo->snapshot)
+        return;
+    _ti_snapshot_release((ti_snapshot *) iinfo->snapshot, iinfo);
+    iinfo->snapshot = NULL;
+}
+
+static int
+_ti_snapshot_row_compare(const void *a, const void *b)
+{
+    const ti_snapshot_row *ra = (const ti_snapshot_row *) a;
+    const ti_snapshot_row *rb = (const ti_snapshot_row *) b;
+
+    return snmp_oid_compare(ra->index, ra->index_len,
+                            rb->index, rb->index_len);
+}
+
+/*
+ * loops over the table once, collecting the index and data context of
+ * each row, and sorts them.  max_index_len leaves room for the table
+ * and column prefix of the OIDs built from the indexes.
+ */
+static ti_snapshot *
+_ti_snapshot_build(netsnmp_iterator_info *iinfo, netsnmp_cache *cache,
+                   size_t max_index_len)
+{
+    ti_snapshot    *snap;
+    ti_snapshot_row *row;
+    netsnmp_variable_list *index_search, *free_this_index_search;
+    void           *loop_context = NULL, *last_loop_context;
+    void           *data_context = NULL;
+    oid             index[MAX_OID_LEN];
+    size_t          index_len, i;
+    size_t          rows_size = 0, indexes_used = 0, indexes_size = 0;
+    int             failed = 0;
+
+    snap = SNMP_MALLOC_TYPEDEF(ti_snapshot);
+    if (!snap)
+        return NULL;
+    snap->cache = cache;
+    snap->load_count = cache->load_count;
+
+    index_search = snmp_clone_varbind(iinfo->indexes);
+    free_this_index_search = index_search;
+    if (index_search)
+        index_search =
+            (iinfo->get_first_data_point) (&loop_context, &data_context,
+                                           index_search, iinfo);
+    while (index_search) {
+        free_this_index_search = index_search;
+
+        if (iinfo->make_data_context && !data_context)
+            data_context = (iinfo->make_data_context)(loop_context, iinfo);
+
+        if (build_oid_noalloc(index, max_index_len, &index_len, NULL, 0,
+                              index_search) != SNMPERR_SUCCESS) {
+            failed = 1;
+        } else if (snap->row_count == rows_size) {
+            rows_size = rows_size ? rows_size * 2 : 64;
+            row = (ti_snapshot_row *) realloc(snap->rows,
+                                      rows_size * sizeof(ti_snapshot_row));
+            if (row)
+                snap->rows = row;
+            else
+                failed = 1;
+        }
+        if (!failed && indexes_used + index_len > indexes_size) {
+            oid            *indexes;
+
+            while (indexes_used + index_len > indexes_size)
+                indexes_size = indexes_size ? indexes_size * 2 : 256;
+            indexes = (oid *) realloc(snap->indexes,
+                                      indexes_size * sizeof(oid));
+            if (indexes)
+                snap->indexes = indexes;
+            else
+                failed = 1;
+        }
+        if (failed) {
+            if (iinfo->free_data_context && data_context)
+                (iinfo->free_data_context)(data_context, iinfo);
+            break;
+        }
+
+        row = &snap->rows[snap->row_count++];
+        memcpy(&snap->indexes[indexes_used], index, index_len * sizeof(oid));
+        row->index_offset = indexes_used;
+        row->index_len = index_len;
+        row->data_context = data_context;
+        indexes_used += index_len;
+
+        /*
+         * the data context now belongs to the snapshot: make sure the
+         * next row does not share it, unless the hook sets it again
+         */
+        data_context = NULL;
+        last_loop_context = loop_context;
+        index_search =
+            (iinfo->get_next_data_point) (&loop_context, &data_context,
+                                          index_search, iinfo);
+        if (iinfo->free_loop_context && last_loop_context &&
+            row->data_context != last_loop_context)
+            (iinfo->free_loop_context) (last_loop_context, iinfo);
+    }
+
+    if (loop_context && iinfo->free_loop_context_at_end)
+        (iinfo->free_loop_context_at_end) (loop_context, iinfo);
+    if (free_this_index_search)
+        snmp_free_varbind(free_this_index_search);
+
+    if (failed) {
+        snmp_log(LOG_ERR, "table_iterator: failed to build a snapshot of "
+                 "the table rows\n");
+        _ti_snapshot_release(snap, iinfo);
+        return NULL;
+    }
+
+    for (i = 0; i < snap->row_count; i++)
+        snap->rows[i].index = &snap->indexes[snap->rows[i].index_offset];
+    if (snap->row_count > 1)
+        qsort(snap->rows, snap->row_count, sizeof(ti_snapshot_row),
+              _ti_snapshot_row_compare);
+
+    DEBUGMSGTL(("table_iterator", "built a snapshot of %lu rows\n",
+                (unsigned long) snap->row_count));
+    return snap;
+}
+
+/*
+ * returns the snapshot of the table, building it again if the cache
+ * has been loaded since, or NULL if the table has no usable cache
+ */
+static ti_snapshot *
+_ti_snapshot_get(netsnmp_iterator_info *iinfo,
+                 netsnmp_handler_registration *reginfo)
+{
+    ti_snapshot    *snap = (ti_snapshot *) iinfo->snapshot;
+    netsnmp_mib_handler *cache_handler;
+    netsnmp_cache  *cache;
+
+    cache_handler = netsnmp_find_handler_by_name(reginfo, "cache_handler");
+    cache = cache_handler ? (netsnmp_cache *) cache_handler->myvoid : NULL;
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_CACHING) ||
+        !cache || !cache->enabled || !cache->valid) {
+        _ti_snapshot_free(iinfo);
+        return NULL;
+    }
+
+    if (snap && snap->cache == cache && snap->load_count == cache->load_count)
+        return snap;
+
+    _ti_snapshot_free(iinfo);
+    if (reginfo->rootoid_len + 2 >= MAX_OID_LEN)
+        return NULL;
+    iinfo->snapshot = _ti_snapshot_build(iinfo, cache,
+                                         MAX_OID_LEN - reginfo->rootoid_len - 2);
+    return (ti_snapshot *) iinfo->snapshot;
+}
+
+/*
+ * returns the row with the given index or, if next is set, the first
+ * row whose index is greater than it
+ */
+static ti_snapshot_row *
+_ti_snapshot_find(ti_snapshot *snap, const oid *index, size_t index_len,
+                  int next)
+{
+    size_t          lo = 0, hi = snap->row_count, mid;
+    int             cmp;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        cmp = snmp_oid_compare(snap->rows[mid].index,
+                               snap->rows[mid].index_len, index, index_len);
+        if (cmp < 0 || (cmp == 0 && next))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == snap->row_count)
+        return NULL;
+    if (!next && snmp_oid_compare(snap->rows[lo].index,
+                                  snap->rows[lo].index_len,
+                                  index, index_len) != 0)
+        return NULL;
+    return &snap->rows[lo];
+}
+
+/*
+ * answers GET and GETNEXT requests from the snapshot, and passes them
+ * on as GET requests like the iterating code below does
+ */
+static int
+_ti_snapshot_handler(netsnmp_mib_handler *handler,
+                     netsnmp_handler_registration *reginfo,
+                     netsnmp_agent_request_info *reqinfo,
+                     netsnmp_request_info *requests,
+                     netsnmp_iterator_info *iinfo, ti_snapshot *snap)
+{
+    netsnmp_table_registration_info *tbl_info = iinfo->table_reginfo;
+    netsnmp_table_request_info *table_info;
+    netsnmp_request_info *request;
+    ti_snapshot_row *row;
+    oid             coloid[MAX_OID_LEN];
+    size_t          coloid_len = reginfo->rootoid_len + 2;
+    unsigned int    nc;
+    int             oldmode, ret;
+
+    memcpy(coloid, reginfo->rootoid, reginfo->rootoid_len * sizeof(oid));
+    coloid[reginfo->rootoid_len] = 1;   /* table.entry node */
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        table_info = netsnmp_extract_table_info(request);
+        if (table_info == NULL)
+            return SNMP_ERR_GENERR;
+
+        if (reqinfo->mode == MODE_GET) {
+            row = _ti_snapshot_find(snap, table_info->index_oid,
+                                    table_info->index_oid_len, 0);
+        } else if (table_info->colnum > tbl_info->max_column) {
+            request->processed = TABLE_ITERATOR_NOTAGAIN;
+            continue;
+        } else {
+            row = _ti_snapshot_find(snap, table_info->index_oid,
+                                    table_info->index_oid_len, 1);
+            while (!row) {
+                /* past the last row: on to the next column */
+                nc = netsnmp_table_next_column(table_info);
+                if (0 == nc) {
+                    coloid[reginfo->rootoid_len + 1] = table_info->colnum + 1;
+                    snmp_set_var_objid(request->requestvb,
+                                       coloid, coloid_len);
+                    request->processed = TABLE_ITERATOR_NOTAGAIN;
+                    break;
+                }
+                table_info->colnum = nc;
+                if (snap->row_count)
+                    row = snap->rows;
+            }
+            if (!row)
+                continue;
+
+            coloid[reginfo->rootoid_len + 1] = table_info->colnum;
+            memcpy(&coloid[coloid_len], row->index,
+                   row->index_len * sizeof(oid));
+            snmp_set_var_objid(request->requestvb, coloid,
+                               coloid_len + row->index_len);
+            memcpy(table_info->index_oid, row->index,
+                   row->index_len * sizeof(oid));
+            table_info->index_oid_len = row->index_len;
+            netsnmp_update_variable_list_from_index(table_info);
+        }
+
+        if (row && row->data_context)
+            /* no free pointer: the context belongs to the snapshot */
+            netsnmp_request_add_list_data(request,
+                                          netsnmp_create_data_list
+                                          (TABLE_ITERATOR_NAME,
+                                           row->data_context, NULL));
+    }
+
+    oldmode = reqinfo->mode;
+    reqinfo->mode = MODE_GET;
+    DEBUGMSGTL(("table_iterator", "call subhandler for mode: %s\n",
+                se_find_label_in_slist("agent_mode", oldmode)));
+    ret = netsnmp_call_next_handler(handler, reginfo, reqinfo, requests);
+    reqinfo->mode = oldmode;
+    return ret;
+}
+
 /* implements the table_iterator helper */
 int
 netsnmp_table_iterator_helper_handler(netsnmp_mib_handler *handler,
@@ -491,6 +817,26 @@ netsnmp_table_iterator_helper_handler(netsnmp_mib_handler *handler,
         return SNMP_ERR_GENERR;
     }
 
+    if (iinfo->flags & NETSNMP_ITERATOR_FLAG_SNAPSHOT) {
+        ti_snapshot    *snap;
+
+        switch (reqinfo->mode) {
+        case MODE_GET:
+        case MODE_GETNEXT:
+            snap = _ti_snapshot_get(iinfo, reginfo);
+            if (snap)
+                return _ti_snapshot_handler(handler, reginfo, reqinfo,
+                                            requests, iinfo, snap);
+            break;
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+        case MODE_SET_COMMIT:
+            /* the rows may have changed without the cache being loaded */
+            _ti_snapshot_free(iinfo);
+            break;
+#endif /* NETSNMP_NO_WRITE_SUPPORT */
+        }
+    }
+
     /* preliminary analysis */
     switch (reqinfo->mode) {
 #ifndef NETSNMP_FEATURE_REMOVE_STASH_CACHE
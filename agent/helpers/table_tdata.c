@@ -391,7 +391,7 @@ _netsnmp_tdata_helper_handler(netsnmp_mib_handler *handler,
         }
         /** skip next handler if processing not needed */
         if (!need_processing)
-            handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+            netsnmp_handler_skip_auto_next(handler, reqinfo);
     }
 
     /* next handler called automatically - 'AUTO_NEXT' */
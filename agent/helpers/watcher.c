@@ -38,6 +38,25 @@ netsnmp_feature_child_of(watcher_spinlock, watcher_all)
  *  @ingroup leaf
  *  @{
  */
+
+/*
+ * A watched variable without a handler of its own is only read when
+ * answering GET requests, and only written by SETs, so it can be served
+ * by the agent's worker threads.
+ */
+static void
+_watcher_thread_safe(netsnmp_handler_registration *reginfo)
+{
+    netsnmp_mib_handler *handler;
+
+    if (!reginfo || !reginfo->handler)
+        return;
+    for (handler = reginfo->handler; handler->next; handler = handler->next)
+        ;
+    if (!handler->access_method)
+        reginfo->modes |= HANDLER_CAN_THREAD_SAFE;
+}
+
 netsnmp_mib_handler *
 netsnmp_get_watcher_handler(void)
 {
@@ -113,6 +132,7 @@ netsnmp_register_watched_instance(netsnmp_handler_registration *reginfo,
     whandler->myvoid = (void *)watchinfo;
 
     netsnmp_inject_handler(reginfo, whandler);
+    _watcher_thread_safe(reginfo);
     return netsnmp_register_instance(reginfo);
 }
 
@@ -132,6 +152,7 @@ netsnmp_register_watched_instance2(netsnmp_handler_registration *reginfo,
     netsnmp_owns_watcher_info(whandler);
 
     netsnmp_inject_handler(reginfo, whandler);
+    _watcher_thread_safe(reginfo);
     return netsnmp_register_instance(reginfo);
 }
 
@@ -150,6 +171,7 @@ netsnmp_register_watched_scalar(netsnmp_handler_registration *reginfo,
     whandler->myvoid = (void *)watchinfo;
 
     netsnmp_inject_handler(reginfo, whandler);
+    _watcher_thread_safe(reginfo);
     return netsnmp_register_scalar(reginfo);
 }
 
@@ -169,6 +191,7 @@ netsnmp_register_watched_scalar2(netsnmp_handler_registration *reginfo,
     netsnmp_owns_watcher_info(whandler);
 
     netsnmp_inject_handler(reginfo, whandler);
+    _watcher_thread_safe(reginfo);
     return netsnmp_register_scalar(reginfo);
 }
 
@@ -268,18 +291,18 @@ netsnmp_watcher_helper_handler(netsnmp_mib_handler *handler,
     case MODE_SET_RESERVE1:
         if (requests->requestvb->type != winfo->type) {
             netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_WRONGTYPE);
-            handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+            netsnmp_handler_skip_auto_next(handler, reqinfo);
         } else if (((winfo->flags & WATCHER_MAX_SIZE) &&
                      requests->requestvb->val_len > winfo->max_size) ||
             ((winfo->flags & WATCHER_FIXED_SIZE) &&
                 requests->requestvb->val_len != get_data_size(winfo))) {
             netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_WRONGLENGTH);
-            handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+            netsnmp_handler_skip_auto_next(handler, reqinfo);
         } else if ((winfo->flags & WATCHER_SIZE_STRLEN) &&
             (memchr(requests->requestvb->val.string, '\0',
                 requests->requestvb->val_len) != NULL)) {
             netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_WRONGVALUE);
-            handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+            netsnmp_handler_skip_auto_next(handler, reqinfo);
         }
         break;
 
@@ -292,7 +315,7 @@ netsnmp_watcher_helper_handler(netsnmp_mib_handler *handler,
         if (old_data == NULL) {
             netsnmp_set_request_error(reqinfo, requests,
                                       SNMP_ERR_RESOURCEUNAVAILABLE);
-            handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+            netsnmp_handler_skip_auto_next(handler, reqinfo);
         } else
             netsnmp_request_add_list_data(requests,
                                           netsnmp_create_data_list
@@ -361,6 +384,7 @@ netsnmp_watched_timestamp_register(netsnmp_mib_handler *whandler,
 {
     whandler->myvoid = (void *)timestamp;
     netsnmp_inject_handler(reginfo, whandler);
+    _watcher_thread_safe(reginfo);
     return netsnmp_register_scalar(reginfo);   /* XXX - or instance? */
 }
 
@@ -417,7 +441,7 @@ netsnmp_watched_timestamp_handler(netsnmp_mib_handler *handler,
     case MODE_SET_RESERVE1:
         netsnmp_set_request_error(reqinfo, requests,
                                   SNMP_ERR_NOTWRITABLE);
-        handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+        netsnmp_handler_skip_auto_next(handler, reqinfo);
         return SNMP_ERR_NOTWRITABLE;
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
     }
@@ -492,7 +516,7 @@ netsnmp_watched_spinlock_handler(netsnmp_mib_handler *handler,
 
             if (*request->requestvb->val.integer != *spinlock) {
                 netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_WRONGVALUE);
-                handler->flags |= MIB_HANDLER_AUTO_NEXT_OVERRIDE_ONCE;
+                netsnmp_handler_skip_auto_next(handler, reqinfo);
                 return SNMP_ERR_WRONGVALUE;
 
             }
@@ -550,6 +574,7 @@ register_scalar_watcher(const char* name,
     }
     if (watchinfo && whandler && reginfo) {
         netsnmp_inject_handler(reginfo, whandler);
+        _watcher_thread_safe(reginfo);
         return netsnmp_register_scalar(reginfo);
     }
     if (whandler)
@@ -46,6 +46,22 @@ extern netsnmp_cache *netsnmp_cache_get_head(void);
 #define NSCACHE_STATUS_ACTIVE   4
 #define NSCACHE_STATUS_EXPIRED  5
 
+/*
+ * ... and for the cache statistics table.
+ */
+
+#define NSCACHE_LOADS                   1
+#define NSCACHE_LOAD_FAILURES           2
+#define NSCACHE_LOAD_TIME_LAST          3
+#define NSCACHE_LOAD_TIME_MAX           4
+#define NSCACHE_LOAD_TIME_TOTAL         5
+#define NSCACHE_LOADS_UP_TO_1MS         6
+#define NSCACHE_LOADS_OVER_1S           10
+#define NSCACHE_HITS                    11
+#define NSCACHE_EXPIRATIONS             12
+#define NSCACHE_ROWS                    13
+#define NSCACHE_BYTES                   14
+
 NETSNMP_IMPORT struct snmp_alarm *
 sa_find_specific(unsigned int clientreg);
 
@@ -56,6 +72,7 @@ init_nsCache(void)
     const oid nsCacheTimeout_oid[]    = { nsCache, 1 };
     const oid nsCacheEnabled_oid[]    = { nsCache, 2 };
     const oid nsCacheTable_oid[]      = { nsCache, 3 };
+    const oid nsCacheStatsTable_oid[] = { nsCache, 4 };
 
     netsnmp_table_registration_info *table_info;
     netsnmp_iterator_info           *iinfo;
@@ -112,6 +129,32 @@ init_nsCache(void)
             nsCacheTable_oid, OID_LENGTH(nsCacheTable_oid),
             HANDLER_CAN_RWRITE),
         iinfo);
+
+    /*
+     * The statistics table shares the indexing of the cache table.
+     */
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    if (!table_info) {
+        return;
+    }
+    netsnmp_table_helper_add_indexes(table_info, ASN_PRIV_IMPLIED_OBJECT_ID, 0);
+    table_info->min_column = NSCACHE_LOADS;
+    table_info->max_column = NSCACHE_BYTES;
+
+    iinfo      = SNMP_MALLOC_TYPEDEF(netsnmp_iterator_info);
+    if (!iinfo) {
+        return;
+    }
+    iinfo->get_first_data_point = get_first_cache_entry;
+    iinfo->get_next_data_point  = get_next_cache_entry;
+    iinfo->table_reginfo        = table_info;
+
+    netsnmp_register_table_iterator2(
+        netsnmp_create_handler_registration(
+            "nsCacheStatsTable", handle_nsCacheStatsTable,
+            nsCacheStatsTable_oid, OID_LENGTH(nsCacheStatsTable_oid),
+            HANDLER_CAN_RONLY),
+        iinfo);
 }
 
 
@@ -427,3 +470,99 @@ handle_nsCacheTable(netsnmp_mib_handler *handler,
 
     return SNMP_ERR_NOERROR;
 }
+
+
+/*
+ * nsCacheStatsTable handling
+ */
+
+int
+handle_nsCacheStatsTable(netsnmp_mib_handler *handler,
+                netsnmp_handler_registration *reginfo,
+                netsnmp_agent_request_info *reqinfo,
+                netsnmp_request_info *requests)
+{
+    u_long value;
+    struct counter64 total;
+    netsnmp_request_info       *request     = NULL;
+    netsnmp_table_request_info *table_info  = NULL;
+    netsnmp_cache              *cache_entry = NULL;
+
+    if (reqinfo->mode != MODE_GET)
+        return SNMP_ERR_NOERROR;
+
+    for (request=requests; request; request=request->next) {
+        if (request->processed != 0)
+            continue;
+
+        cache_entry = (netsnmp_cache*)netsnmp_extract_iterator_context(request);
+        table_info  =                 netsnmp_extract_table_info(request);
+        if (!cache_entry) {
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHINSTANCE);
+            continue;
+        }
+
+        switch (table_info->colnum) {
+        case NSCACHE_LOADS:
+            snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                       cache_entry->load_count);
+            break;
+
+        case NSCACHE_LOAD_FAILURES:
+            snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                       cache_entry->load_failures);
+            break;
+
+        case NSCACHE_LOAD_TIME_LAST:
+            snmp_set_var_typed_integer(request->requestvb, ASN_GAUGE,
+                                       cache_entry->load_time_last);
+            break;
+
+        case NSCACHE_LOAD_TIME_MAX:
+            snmp_set_var_typed_integer(request->requestvb, ASN_GAUGE,
+                                       cache_entry->load_time_max);
+            break;
+
+        case NSCACHE_LOAD_TIME_TOTAL:
+            total.high = (u_long)(cache_entry->load_time_total >> 32);
+            total.low  = (u_long)(cache_entry->load_time_total & 0xffffffff);
+            snmp_set_var_typed_value(request->requestvb, ASN_COUNTER64,
+                                     (u_char*)&total, sizeof(total));
+            break;
+
+        case NSCACHE_HITS:
+            snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                       cache_entry->hits);
+            break;
+
+        case NSCACHE_EXPIRATIONS:
+            snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                       cache_entry->expirations);
+            break;
+
+        case NSCACHE_ROWS:
+            value = (cache_entry->rows < 0 ? 0 : cache_entry->rows);
+            snmp_set_var_typed_integer(request->requestvb, ASN_GAUGE, value);
+            break;
+
+        case NSCACHE_BYTES:
+            value = (cache_entry->bytes < 0 ? 0 : cache_entry->bytes);
+            snmp_set_var_typed_integer(request->requestvb, ASN_GAUGE, value);
+            break;
+
+        default:
+            if (table_info->colnum >= NSCACHE_LOADS_UP_TO_1MS &&
+                table_info->colnum <= NSCACHE_LOADS_OVER_1S) {
+                value = cache_entry->load_time_hist[table_info->colnum -
+                                                    NSCACHE_LOADS_UP_TO_1MS];
+                snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                           value);
+                break;
+            }
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
+            continue;
+        }
+    }
+
+    return SNMP_ERR_NOERROR;
+}
@@ -16,6 +16,7 @@ Netsnmp_Node_Handler handle_nsCacheEnabled;
  * Handler and iterators for the cache table
  */
 Netsnmp_Node_Handler handle_nsCacheTable;
+Netsnmp_Node_Handler handle_nsCacheStatsTable;
 Netsnmp_First_Data_Point  get_first_cache_entry;
 Netsnmp_Next_Data_Point   get_next_cache_entry;
 
@@ -330,6 +330,7 @@ nsVacmAccessTable_handler(netsnmp_mib_handler *handler,
             switch (table_info->colnum) {
             case COLUMN_NSVACMCONTEXTMATCH:
                 entry->contextMatch = *request->requestvb->val.integer;
+                vacm_invalidateCaches();
                 break;
             case COLUMN_NSVACMVIEWNAME:
                 memset( entry->views[viewIdx], 0, VACMSTRINGLEN );
@@ -175,6 +175,8 @@ static int
 _cache_load( netsnmp_cache *cache,  void *magic )
 {
     netsnmp_swrun_container_load( swrun_container, 0 );
+    cache->rows = CONTAINER_SIZE( swrun_container );
+    cache->bytes = cache->rows * sizeof(netsnmp_swrun_entry);
     return 0;
 }
 
@@ -160,7 +160,8 @@ initialize_table_ifTable(void)
                                                 _if_number_handler,
                                                 reg_oid,
                                                 OID_LENGTH(reg_oid),
-                                                HANDLER_CAN_RONLY);
+                                                HANDLER_CAN_RONLY |
+                                                HANDLER_CAN_THREAD_SAFE);
         netsnmp_register_scalar(myreg);
     }
 
@@ -306,10 +306,15 @@ _ifTable_initialize_interface(ifTable_registration * reg_ptr, u_long flags)
                 "Registering ifTable as a mibs-for-dummies table.\n"));
     handler =
         netsnmp_baby_steps_access_multiplexer_get(access_multiplexer);
+    /*
+     * GETs only read the rows, which the cache handler reloads on the
+     * main thread, so they may be processed on worker threads
+     */
     reginfo =
         netsnmp_handler_registration_create("ifTable", handler,
                                             ifTable_oid, ifTable_oid_size,
                                             HANDLER_CAN_BABY_STEP |
+                                            HANDLER_CAN_THREAD_SAFE |
 #if !(defined(NETSNMP_NO_WRITE_SUPPORT) || defined(NETSNMP_DISABLE_SET_SUPPORT))
                                             HANDLER_CAN_RWRITE
 #else
@@ -1859,6 +1864,9 @@ static void     _container_free(netsnmp_container *container);
 static int
 _cache_load(netsnmp_cache * cache, void *vmagic)
 {
+    netsnmp_container *container;
+    int             rc;
+
     DEBUGMSGTL(("internal:ifTable:_cache_load", "called\n"));
 
     if ((NULL == cache) || (NULL == cache->magic)) {
@@ -1872,7 +1880,14 @@ _cache_load(netsnmp_cache * cache, void *vmagic)
     /*
      * call user code
      */
-    return ifTable_container_load((netsnmp_container *) cache->magic);
+    container = (netsnmp_container *) cache->magic;
+    rc = ifTable_container_load(container);
+    if (rc >= 0) {
+        /** for the cache statistics */
+        cache->rows = CONTAINER_SIZE(container);
+        cache->bytes = cache->rows * sizeof(ifTable_rowreq_ctx);
+    }
+    return rc;
 }                               /* _cache_load */
 
 /**
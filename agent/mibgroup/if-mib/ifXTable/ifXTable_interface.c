@@ -275,11 +275,17 @@ _ifXTable_initialize_interface(ifXTable_registration * reg_ptr,
                 "Registering ifXTable as a mibs-for-dummies table.\n"));
     handler =
         netsnmp_baby_steps_access_multiplexer_get(access_multiplexer);
+    /*
+     * GETs only read the rows, which the cache handler of the ifTable
+     * reloads on the main thread, so they may be processed on worker
+     * threads
+     */
     reginfo =
         netsnmp_handler_registration_create("ifXTable", handler,
                                             ifXTable_oid,
                                             ifXTable_oid_size,
                                             HANDLER_CAN_BABY_STEP |
+                                            HANDLER_CAN_THREAD_SAFE |
 #if !(defined(NETSNMP_NO_WRITE_SUPPORT) || defined(NETSNMP_DISABLE_SET_SUPPORT))
                                             HANDLER_CAN_RWRITE
 #else
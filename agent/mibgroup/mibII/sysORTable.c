@@ -91,7 +91,9 @@ register_cb(int major, int minor, void* serv, void* client)
 {
     DEBUGMSGTL(("mibII/sysORTable/register_cb",
                 "register_cb(%d, %d, %p, %p)\n", major, minor, serv, client));
+    netsnmp_agent_workers_lock();
     register_foreach((struct sysORTable*)serv, NULL);
+    netsnmp_agent_workers_unlock();
     return SNMP_ERR_NOERROR;
 }
 
@@ -100,18 +102,21 @@ static int
 unregister_cb(int major, int minor, void* serv, void* client)
 {
     sysORTable_entry *value;
-    netsnmp_iterator* it = CONTAINER_ITERATOR(table);
+    netsnmp_iterator* it;
 
     DEBUGMSGTL(("mibII/sysORTable/unregister_cb",
                 "unregister_cb(%d, %d, %p, %p)\n", major, minor, serv, client));
+    netsnmp_agent_workers_lock();
     sysORLastChange = ((struct sysORTable*)(serv))->OR_uptime;
 
+    it = CONTAINER_ITERATOR(table);
     while ((value = (sysORTable_entry*)ITERATOR_NEXT(it)) && value->data != serv);
     ITERATOR_RELEASE(it);
     if(value) {
 	CONTAINER_REMOVE(table, value);
 	free(value);
     }
+    netsnmp_agent_workers_unlock();
     return SNMP_ERR_NOERROR;
 }
 
@@ -232,7 +237,7 @@ init_sysORTable(void)
         netsnmp_create_handler_registration(
             "mibII/sysORLastChange", NULL,
             sysORLastChange_oid, OID_LENGTH(sysORLastChange_oid),
-            HANDLER_CAN_RONLY);
+            HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE);
     netsnmp_init_watcher_info(
 	    &sysORLastChange_winfo,
             &sysORLastChange, sizeof(u_long),
@@ -243,7 +248,8 @@ init_sysORTable(void)
     sysORTable_reg =
         netsnmp_create_handler_registration(
             "mibII/sysORTable", sysORTable_handler,
-            sysORTable_oid, OID_LENGTH(sysORTable_oid), HANDLER_CAN_RONLY);
+            sysORTable_oid, OID_LENGTH(sysORTable_oid),
+            HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE);
     netsnmp_container_table_register(sysORTable_reg, sysORTable_table_info,
                                      table, TABLE_CONTAINER_KEY_NETSNMP_INDEX);
 
@@ -326,7 +326,7 @@ init_system_mib(void)
         netsnmp_register_watched_scalar(
             netsnmp_create_handler_registration(
                 "mibII/sysDescr", NULL, sysDescr_oid, OID_LENGTH(sysDescr_oid),
-                HANDLER_CAN_RONLY),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE),
             netsnmp_init_watcher_info(&sysDescr_winfo, version_descr, 0,
 				      ASN_OCTET_STR, WATCHER_SIZE_STRLEN));
     }
@@ -337,7 +337,7 @@ init_system_mib(void)
             netsnmp_create_handler_registration(
                 "mibII/sysObjectID", NULL,
                 sysObjectID_oid, OID_LENGTH(sysObjectID_oid),
-                HANDLER_CAN_RONLY),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE),
             netsnmp_init_watcher_info6(
 		&sysObjectID_winfo, sysObjectID, 0, ASN_OBJECT_ID,
                 WATCHER_MAX_SIZE | WATCHER_SIZE_IS_PTR,
@@ -349,7 +349,7 @@ init_system_mib(void)
             netsnmp_create_handler_registration(
                 "mibII/sysUpTime", handle_sysUpTime,
                 sysUpTime_oid, OID_LENGTH(sysUpTime_oid),
-                HANDLER_CAN_RONLY));
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE));
     }
     {
         const oid sysContact_oid[] = { 1, 3, 6, 1, 2, 1, 1, 4 };
@@ -358,7 +358,7 @@ init_system_mib(void)
         netsnmp_register_watched_scalar(
             netsnmp_create_update_handler_registration(
                 "mibII/sysContact", sysContact_oid, OID_LENGTH(sysContact_oid), 
-                HANDLER_CAN_RWRITE, &sysContactSet),
+                HANDLER_CAN_RWRITE | HANDLER_CAN_THREAD_SAFE, &sysContactSet),
             netsnmp_init_watcher_info(
                 &sysContact_winfo, sysContact, SYS_STRING_LEN - 1,
                 ASN_OCTET_STR, WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -366,7 +366,7 @@ init_system_mib(void)
         netsnmp_register_watched_scalar(
             netsnmp_create_update_handler_registration(
                 "mibII/sysContact", sysContact_oid, OID_LENGTH(sysContact_oid),
-                HANDLER_CAN_RONLY, &sysContactSet),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE, &sysContactSet),
             netsnmp_init_watcher_info(
                 &sysContact_winfo, sysContact, SYS_STRING_LEN - 1,
                 ASN_OCTET_STR, WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -379,7 +379,7 @@ init_system_mib(void)
         netsnmp_register_watched_scalar(
             netsnmp_create_update_handler_registration(
                 "mibII/sysName", sysName_oid, OID_LENGTH(sysName_oid),
-                HANDLER_CAN_RWRITE, &sysNameSet),
+                HANDLER_CAN_RWRITE | HANDLER_CAN_THREAD_SAFE, &sysNameSet),
             netsnmp_init_watcher_info(
                 &sysName_winfo, sysName, SYS_STRING_LEN - 1, ASN_OCTET_STR,
                 WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -387,7 +387,7 @@ init_system_mib(void)
         netsnmp_register_watched_scalar(
             netsnmp_create_update_handler_registration(
                 "mibII/sysName", sysName_oid, OID_LENGTH(sysName_oid),
-                HANDLER_CAN_RONLY, &sysNameSet),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE, &sysNameSet),
             netsnmp_init_watcher_info(
                 &sysName_winfo, sysName, SYS_STRING_LEN - 1, ASN_OCTET_STR,
                 WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -401,7 +401,7 @@ init_system_mib(void)
             netsnmp_create_update_handler_registration(
                 "mibII/sysLocation", sysLocation_oid,
                 OID_LENGTH(sysLocation_oid),
-                HANDLER_CAN_RWRITE, &sysLocationSet),
+                HANDLER_CAN_RWRITE | HANDLER_CAN_THREAD_SAFE, &sysLocationSet),
             netsnmp_init_watcher_info(
 		&sysLocation_winfo, sysLocation, SYS_STRING_LEN - 1,
 		ASN_OCTET_STR, WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -410,7 +410,7 @@ init_system_mib(void)
             netsnmp_create_update_handler_registration(
                 "mibII/sysLocation", sysLocation_oid,
                 OID_LENGTH(sysLocation_oid),
-                HANDLER_CAN_RONLY, &sysLocationSet),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE, &sysLocationSet),
             netsnmp_init_watcher_info(
 		&sysLocation_winfo, sysLocation, SYS_STRING_LEN - 1,
 		ASN_OCTET_STR, WATCHER_MAX_SIZE | WATCHER_SIZE_STRLEN));
@@ -418,9 +418,14 @@ init_system_mib(void)
     }
     {
         const oid sysServices_oid[] = { 1, 3, 6, 1, 2, 1, 1, 7 };
-        netsnmp_register_read_only_int_scalar(
-            "mibII/sysServices", sysServices_oid, OID_LENGTH(sysServices_oid),
-            &sysServices, handle_sysServices);
+        netsnmp_register_watched_scalar2(
+            netsnmp_create_handler_registration(
+                "mibII/sysServices", handle_sysServices,
+                sysServices_oid, OID_LENGTH(sysServices_oid),
+                HANDLER_CAN_RONLY | HANDLER_CAN_THREAD_SAFE),
+            netsnmp_create_watcher_info(
+                &sysServices, sizeof(sysServices), ASN_INTEGER,
+                WATCHER_FIXED_SIZE));
     }
     if (++system_module_count == 3)
         REGISTER_SYSOR_ENTRY(system_module_oid,
@@ -179,6 +179,8 @@ init_udpTable(void)
 #if defined (WIN32) || defined (cygwin)
     iinfo->flags               |= NETSNMP_ITERATOR_FLAG_SORTED;
 #endif /* WIN32 || cygwin */
+    /* the rows only change when the cache below is reloaded */
+    iinfo->flags               |= NETSNMP_ITERATOR_FLAG_SNAPSHOT;
 
 
     /*
@@ -484,6 +484,7 @@ vacm_parse_authaccess(const char *token, char *confline)
         }
     }
     ap->contextMatch = prefix;
+    vacm_invalidateCaches();    /* ap may have existed already */
     ap->storageType  = SNMP_STORAGE_PERMANENT;
     ap->status       = SNMP_ROW_ACTIVE;
     if (ap->reserved)
@@ -544,6 +545,7 @@ vacm_parse_setaccess(const char *token, char *param)
 
     strcpy(ap->views[viewnum], viewval);
     ap->contextMatch = iprefix;
+    vacm_invalidateCaches();    /* ap may have existed already */
     ap->storageType = SNMP_STORAGE_PERMANENT;
     ap->status = SNMP_ROW_ACTIVE;
     free(ap->reserved);
@@ -1430,15 +1432,14 @@ vacm_check_view_contents(netsnmp_pdu *pdu, oid * name, size_t namelen,
 
     DEBUGMSGTL(("mibII/vacm_vars", "vacm_in_view: sn=%s", sn));
 
-    gp = vacm_getGroupEntry(pdu->securityModel, sn);
+    ap = vacm_getAccessEntryFor(pdu->securityModel, sn, pdu->securityLevel,
+                                contextNameIndex, &gp);
     if (gp == NULL) {
         DEBUGMSG(("mibII/vacm_vars", "\n"));
         return VACM_NOGROUP;
     }
     DEBUGMSG(("mibII/vacm_vars", ", gn=%s", gp->groupName));
 
-    ap = vacm_getAccessEntry(gp->groupName, contextNameIndex,
-                             pdu->securityModel, pdu->securityLevel);
     if (ap == NULL) {
         DEBUGMSG(("mibII/vacm_vars", "\n"));
         return VACM_NOACCESS;
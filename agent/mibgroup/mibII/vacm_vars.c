@@ -772,6 +772,7 @@ write_vacmGroupName(int action,
             memcpy(string, geptr->groupName, VACMSTRINGLEN);
             memcpy(geptr->groupName, var_val, var_val_len);
             geptr->groupName[var_val_len] = 0;
+            vacm_invalidateCaches();
             if (geptr->status == RS_NOTREADY) {
                 geptr->status = RS_NOTINSERVICE;
             }
@@ -783,6 +784,7 @@ write_vacmGroupName(int action,
         if ((geptr = sec2group_parse_groupEntry(name, name_len)) != NULL &&
             resetOnFail) {
             memcpy(geptr->groupName, string, VACMSTRINGLEN);
+            vacm_invalidateCaches();
         }
     }
     return SNMP_ERR_NOERROR;
@@ -1310,6 +1312,7 @@ write_vacmAccessContextMatch(int action,
         long_ret = *((long *) var_val);
         if (long_ret == CM_EXACT || long_ret == CM_PREFIX) {
             aptr->contextMatch = long_ret;
+            vacm_invalidateCaches();
         } else {
             return SNMP_ERR_WRONGVALUE;
         }
@@ -1760,11 +1763,13 @@ write_vacmViewMask(int action,
             length = vptr->viewMaskLen;
             memcpy(vptr->viewMask, var_val, var_val_len);
             vptr->viewMaskLen = var_val_len;
+            vacm_invalidateCaches();
         }
     } else if (action == FREE) {
         if ((vptr = view_parse_viewEntry(name, name_len)) != NULL) {
             memcpy(vptr->viewMask, string, length);
             vptr->viewMaskLen = length;
+            vacm_invalidateCaches();
         }
     }
     return SNMP_ERR_NOERROR;
@@ -1797,10 +1802,12 @@ write_vacmViewType(int action,
         } else {
             oldValue = vptr->viewType;
             vptr->viewType = newValue;
+            vacm_invalidateCaches();
         }
     } else if (action == UNDO) {
         if ((vptr = view_parse_viewEntry(name, name_len)) != NULL) {
             vptr->viewType = oldValue;
+            vacm_invalidateCaches();
         }
     }
 
@@ -211,8 +211,9 @@ _add_connection(netsnmp_tcpconn_entry *entry, netsnmp_container *container)
  *
  * TODO:350:M: Implement tcpConnectionTable data load
  * This function will also be called by the cache helper to load
- * the container again (after the container free function has been
- * called to free the previous contents).
+ * the container again. The container passed in is then an empty
+ * one, whose rows are merged into the existing ones afterwards
+ * (see tcpConnectionTable_row_update()).
  *
  * @param container container to which items should be inserted
  *
@@ -270,6 +271,42 @@ tcpConnectionTable_container_load(netsnmp_container *container)
     return MFD_SUCCESS;
 }                               /* tcpConnectionTable_container_load */
 
+/**
+ * update an existing row with freshly loaded data
+ *
+ * @param rowreq_ctx the existing row
+ * @param fresh      the row just loaded with the same index
+ *
+ * @retval 1  : the data changed and was copied
+ * @retval 0  : the data did not change
+ * @retval -1 : error; the existing row is replaced by the fresh one
+ *
+ *  When the cache is reloaded, tcpConnectionTable_container_load() loads
+ *  the rows into an empty container, which is then merged into the table:
+ *  connections which are gone are released, new ones are moved into
+ *  the table, and this function is called for connections which are in
+ *  both. The fresh row is released afterwards.
+ */
+int
+tcpConnectionTable_row_update(tcpConnectionTable_rowreq_ctx * rowreq_ctx,
+                              tcpConnectionTable_rowreq_ctx * fresh)
+{
+    int             rc;
+
+    DEBUGMSGTL(("verbose:tcpConnectionTable:tcpConnectionTable_row_update",
+                "called\n"));
+
+    netsnmp_assert((NULL != rowreq_ctx) && (NULL != fresh));
+
+    /*
+     * state and pid are all that can change for a connection
+     */
+    rc = netsnmp_access_tcpconn_entry_update(rowreq_ctx->data, fresh->data);
+    if (rc < 0)
+        return -1;
+    return rc > 0;
+}                               /* tcpConnectionTable_row_update */
+
 /**
  * container clean up
  *
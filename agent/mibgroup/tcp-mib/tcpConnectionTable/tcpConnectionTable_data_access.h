@@ -78,6 +78,11 @@ extern          "C" {
     void            tcpConnectionTable_cache_free(netsnmp_container
                                                   *container);
 
+    int             tcpConnectionTable_row_update(tcpConnectionTable_rowreq_ctx
+                                                  * rowreq_ctx,
+                                                  tcpConnectionTable_rowreq_ctx
+                                                  * fresh);
+
     int
      
         
@@ -52,6 +52,7 @@ netsnmp_feature_child_of(tcpConnectionTable_external_access, libnetsnmpmibs)
 netsnmp_feature_require(row_merge)
 netsnmp_feature_require(baby_steps)
 netsnmp_feature_require(check_all_requests_error)
+netsnmp_feature_require(table_container_merge)
 
 
 netsnmp_feature_child_of(tcpConnectionTable_container_size, tcpConnectionTable_external_access)
@@ -1647,6 +1648,18 @@ _mfd_tcpConnectionTable_irreversible_commit(netsnmp_mib_handler *handler, netsnm
  *
  ***********************************************************************/
 static void     _container_free(netsnmp_container *container);
+static void     _container_item_free(tcpConnectionTable_rowreq_ctx *
+                                     rowreq_ctx, void *context);
+
+/**
+ * @internal
+ */
+static int
+_container_item_update(tcpConnectionTable_rowreq_ctx * rowreq_ctx,
+                       tcpConnectionTable_rowreq_ctx * fresh, void *context)
+{
+    return tcpConnectionTable_row_update(rowreq_ctx, fresh);
+}                               /* _container_item_update */
 
 /**
  * @internal
@@ -1654,6 +1667,10 @@ static void     _container_free(netsnmp_container *container);
 static int
 _cache_load(netsnmp_cache * cache, void *vmagic)
 {
+    netsnmp_container *container;
+    netsnmp_container *fresh;
+    int             rc;
+
     DEBUGMSGTL(("internal:tcpConnectionTable:_cache_load", "called\n"));
 
     if ((NULL == cache) || (NULL == cache->magic)) {
@@ -1668,8 +1685,37 @@ _cache_load(netsnmp_cache * cache, void *vmagic)
     /*
      * call user code
      */
-    return tcpConnectionTable_container_load((netsnmp_container *) cache->
-                                             magic);
+    container = (netsnmp_container *) cache->magic;
+    /*
+     * load into an empty container and merge it into the table, so
+     * that only the rows which changed are touched
+     */
+    fresh =
+        netsnmp_container_find("tcpConnectionTable_load:table_container");
+    if (NULL == fresh) {
+        snmp_log(LOG_ERR,
+                 "error creating load container for tcpConnectionTable\n");
+        return -1;
+    }
+    fresh->compare = container->compare;
+    rc = tcpConnectionTable_container_load(fresh);
+    if (rc >= 0)
+        netsnmp_container_table_merge(container, fresh,
+                                      (netsnmp_container_table_update_f *)
+                                      _container_item_update,
+                                      (netsnmp_container_obj_func *)
+                                      _container_item_free, NULL, NULL);
+    else
+        CONTAINER_CLEAR(fresh,
+                        (netsnmp_container_obj_func *) _container_item_free,
+                        NULL);
+    CONTAINER_FREE(fresh);
+    if (rc >= 0) {
+        /** for the cache statistics */
+        cache->rows = CONTAINER_SIZE(container);
+        cache->bytes = cache->rows * sizeof(tcpConnectionTable_rowreq_ctx);
+    }
+    return rc;
 }                               /* _cache_load */
 
 /**
@@ -1761,6 +1807,11 @@ _tcpConnectionTable_container_init(tcpConnectionTable_interface_ctx *
     }
 
     if_ctx->cache->flags = NETSNMP_CACHE_DONT_INVALIDATE_ON_SET;
+    /*
+     * keep the rows, for the next load to be merged into
+     */
+    if_ctx->cache->flags |= NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD |
+        NETSNMP_CACHE_DONT_FREE_EXPIRED;
 
     tcpConnectionTable_container_init(&if_ctx->container, if_ctx->cache);
     if (NULL == if_ctx->container) {
@@ -50,6 +50,7 @@ SOFTWARE.
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
+#include <stddef.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -109,6 +110,10 @@ int             deny_severity = LOG_WARNING;
 #include "smux/smux.h"
 #endif
 
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+#include <net-snmp/library/snmpUDPIPv6Domain.h>
+#endif
+
 netsnmp_feature_child_of(snmp_agent, libnetsnmpagent)
 netsnmp_feature_child_of(agent_debugging_utilities, libnetsnmpagent)
 
@@ -466,12 +471,14 @@ get_set_cache(netsnmp_agent_session *asp)
     return SNMP_ERR_GENERR;
 }
 
-/* Bulkcache holds the values for the *repeating* varbinds (only),
- *   but ordered "by column" - i.e. the repetitions for each
- *   repeating varbind follow on immediately from one another,
- *   rather than being interleaved, as required by the protocol.
+/* Bulkcache maps the repetitions of each *repeating* varbind to the
+ *   varbinds holding them, ordered "by column" - i.e. the repetitions
+ *   for each repeating varbind follow on immediately from one another.
+ *   The varbinds themselves are already linked "by row", interleaved as
+ *   required by the protocol.
  *
- * So we need to rearrange the varbind list so it's ordered "by row".
+ * So all that is left is to fill in the repetitions that were never
+ * reached, and to drop the rows past the end of the MIB view.
  *
  * In the following code chunk:
  *     n            = # non-repeating varbinds
@@ -482,12 +489,11 @@ get_set_cache(netsnmp_agent_session *asp)
  *     repeats = Desired # of repetitions (of 'r' varbinds)
  */
 NETSNMP_STATIC_INLINE void
-_reorder_getbulk(netsnmp_agent_session *asp)
+_finish_getbulk(netsnmp_agent_session *asp)
 {
     int             i, n = 0, r = 0;
     int             repeats = asp->pdu->errindex;
     int             j, k;
-    int             all_eoMib;
     netsnmp_variable_list *prev = NULL, *curr;
             
     if (asp->vbcount == 0)  /* Nothing to do! */
@@ -535,69 +541,70 @@ _reorder_getbulk(netsnmp_agent_session *asp)
         }
     }
 
-    /*
-     * For each of the original repeating varbinds (except the last),
-     *  go through the block of results for that varbind,
-     *  and link each instance to the corresponding instance
-     *  in the next block.
-     */
-    for (i = 0; i < r - 1; i++) {
-        for (j = 0; j < repeats; j++) {
-            asp->bulkcache[i * repeats + j]->next_variable =
-                asp->bulkcache[(i + 1) * repeats + j];
-        }
-    }
-
-    /*
-     * For the last of the original repeating varbinds,
-     *  go through that block of results, and link each
-     *  instance to the *next* instance in the *first* block.
-     *
-     * The very last instance of this block is left untouched
-     *  since it (correctly) points to the end of the list.
-     */
-    for (j = 0; j < repeats - 1; j++) {
-	asp->bulkcache[(r - 1) * repeats + j]->next_variable = 
-	    asp->bulkcache[j + 1];
-    }
-
     /*
      * If we've got a full row of endOfMibViews, then we
      *  can truncate the result varbind list after that.
      *
-     * Look for endOfMibView exception values in the list of
-     *  repetitions for the first varbind, and check the 
-     *  corresponding instances for the other varbinds
-     *  (following the next_variable links).
-     *
-     * If they're all endOfMibView too, then we can terminate
-     *  the linked list there, and free any redundant varbinds.
+     * Look for the first row whose repetitions are all endOfMibView
+     *  exception values.  If there is one, terminate the linked list
+     *  after its last varbind, and free any redundant varbinds.
      */
-    all_eoMib = 0;
-    for (i = 0; i < repeats; i++) {
-        if (asp->bulkcache[i]->type == SNMP_ENDOFMIBVIEW) {
-            all_eoMib = 1;
-            for (j = 1, prev=asp->bulkcache[i];
-                 j < r;
-                 j++, prev=prev->next_variable) {
-                if (prev->type != SNMP_ENDOFMIBVIEW) {
-                    all_eoMib = 0;
-                    break;	/* Found a real value */
-                }
-            }
-            if (all_eoMib) {
-                /*
-                 * This is indeed a full endOfMibView row.
-                 * Terminate the list here & free the rest.
-                 */
-                snmp_free_varbind( prev->next_variable );
-                prev->next_variable = NULL;
-                break;
-            }
+    for (j = 0; j < repeats; j++) {
+        for (i = 0; i < r; i++) {
+            if (asp->bulkcache[i * repeats + j]->type != SNMP_ENDOFMIBVIEW)
+                break;	/* Found a real value */
+        }
+        if (i == r) {
+            /*
+             * This is indeed a full endOfMibView row.
+             * Terminate the list here & free the rest.
+             */
+            curr = asp->bulkcache[(r - 1) * repeats + j];
+            snmp_free_varbind(curr->next_variable);
+            curr->next_variable = NULL;
+            break;
         }
     }
 }
 
+/**
+ * Finds the varbind holding the next repetition of a GETBULK request.
+ *
+ * The repetitions of the repeating varbinds are linked in the order in
+ * which they are returned, so the next repetition of a request is not
+ * the next varbind.  Helpers processing the repetitions one after the
+ * other look them up here instead.
+ *
+ * @param request the request of a repeating varbind
+ * @param vb      one of the varbinds of the request
+ *
+ * @return the varbind of the following repetition, or NULL if vb is the
+ *         last one.
+ */
+netsnmp_variable_list *
+netsnmp_request_next_repetition(netsnmp_request_info *request,
+                                netsnmp_variable_list *vb)
+{
+    netsnmp_agent_session *asp;
+    netsnmp_variable_list **column;
+    int             n, i, repeats;
+
+    if (!request || !request->agent_req_info ||
+        !(asp = request->agent_req_info->asp) || !asp->bulkcache)
+        return NULL;
+
+    repeats = asp->pdu->errindex;
+    n = asp->pdu->errstat < asp->vbcount ? asp->pdu->errstat : asp->vbcount;
+    i = request->index - 1 - n;
+    if (i < 0 || i >= asp->vbcount - n)
+        return NULL;
+    column = &asp->bulkcache[i * repeats];
+    for (i = 0; i < repeats - 1; i++)
+        if (column[i] == vb)
+            return column[i + 1];
+    return NULL;
+}
+
 
 /* EndOfMibView replies to a GETNEXT request should according to RFC3416
  *  have the object ID set to that of the request. Our tree search 
@@ -642,6 +649,11 @@ agent_check_and_process(int block)
     struct timeval       timeout = { LONG_MAX, 0 }, *tvp = &timeout;
     int                  count;
     int                  fakeblock = 0;
+    int                  use_poll = 0;
+
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+    use_poll = netsnmp_fd_poll_enabled();
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
     numfds = 0;
     netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
@@ -650,7 +662,7 @@ agent_check_and_process(int block)
     NETSNMP_LARGE_FD_ZERO(&readfds);
     NETSNMP_LARGE_FD_ZERO(&writefds);
     NETSNMP_LARGE_FD_ZERO(&exceptfds);
-    snmp_select_info2(&numfds, &readfds, tvp, &fakeblock);
+    snmp_select_info2(&numfds, use_poll ? NULL : &readfds, tvp, &fakeblock);
     if (block != 0 && fakeblock != 0) {
         /*
          * There are no alarms registered, and the caller asked for blocking, so
@@ -674,9 +686,13 @@ agent_check_and_process(int block)
     }
 
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-    netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
-#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+    if (!use_poll)
+        netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
 
+    if (use_poll)
+        count = netsnmp_fd_poll_wait(tvp);
+    else
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
     count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds, &exceptfds, tvp);
 
     if (count > 0) {
@@ -684,10 +700,15 @@ agent_check_and_process(int block)
          * packets found, process them 
          */
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-        netsnmp_dispatch_external_events2(&count, &readfds, &writefds, &exceptfds);
+        if (use_poll)
+            netsnmp_fd_poll_dispatch();
+        else
+            netsnmp_dispatch_external_events2(&count, &readfds, &writefds,
+                                              &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
-        snmp_read2(&readfds);
+        if (!use_poll)
+            snmp_read2(&readfds);
     } else
         switch (count) {
         case 0:
@@ -1285,6 +1306,56 @@ netsnmp_deregister_agent_nsap(int handle)
  * JBPN 20001117
  */
 
+#ifndef NETSNMP_NO_LISTEN_SUPPORT
+/*
+ * Opens the further sockets requested by udpListenSockets for a UDP or
+ * UDP6 endpoint.  They are bound with SO_REUSEPORT to the same address
+ * as the first one, so that the kernel spreads the managers across them,
+ * and each is registered as an agent NSAP of its own.
+ */
+static void
+_init_master_agent_shared(netsnmp_transport *first, const char *spec)
+{
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+    static const oid udp6_domain[] = { TRANSPORT_DOMAIN_UDP_IPV6 };
+#endif
+    netsnmp_transport *transport;
+    int             count, i;
+
+    count = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_UDP_LISTEN_SOCKETS);
+    if (count <= 1)
+        return;
+    if (netsnmp_oid_equals(first->domain, first->domain_length,
+                           netsnmpUDPDomain, netsnmpUDPDomain_len) != 0
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+        && netsnmp_oid_equals(first->domain, first->domain_length,
+                              udp6_domain, OID_LENGTH(udp6_domain)) != 0
+#endif
+        )
+        return;
+
+    for (i = 1; i < count; i++) {
+        transport = netsnmp_transport_open_server("snmp", spec);
+        if (transport == NULL)
+            break;
+        if (transport->sock == first->sock) {
+            /* a socket handed over by systemd can't be shared */
+            netsnmp_transport_free(transport);
+            break;
+        }
+        if (netsnmp_register_agent_nsap(transport) <= 0)
+            break;
+    }
+    if (i < count)
+        snmp_log(LOG_WARNING, "Opened only %d of %d sockets for \"%s\"\n",
+                 i, count, spec);
+    else
+        snmp_log(LOG_INFO, "Listening on %d sockets for \"%s\"\n", count,
+                 spec);
+}
+#endif /* NETSNMP_NO_LISTEN_SUPPORT */
+
 int
 init_master_agent(void)
 {
@@ -1374,6 +1445,7 @@ init_master_agent(void)
                         "init_master_agent; \"%s\" registered as an agent "
 			"NSAP\n", cptr));
         }
+        _init_master_agent_shared(transport, cptr);
     } while(st && *st != '\0');
     SNMP_FREE(buf);
 #endif /* NETSNMP_NO_LISTEN_SUPPORT */
@@ -1438,12 +1510,24 @@ init_agent_snmp_session(netsnmp_session * session, netsnmp_pdu *pdu)
     return asp;
 }
 
+typedef struct agent_vbpool_s {
+    struct agent_vbpool_s *next;
+    netsnmp_variable_list vars[1];
+} agent_vbpool;
+
 void
 free_agent_snmp_session(netsnmp_agent_session *asp)
 {
     if (!asp)
         return;
 
+    /*
+     * a worker thread still processes the request; it is freed once the
+     * worker is done with it
+     */
+    if (netsnmp_agent_workers_cancel(asp))
+        return;
+
     DEBUGMSGTL(("snmp_agent","agent_session %8p released\n", asp));
 
     netsnmp_remove_from_delegated(asp);
@@ -1469,9 +1553,64 @@ free_agent_snmp_session(netsnmp_agent_session *asp)
         netsnmp_free_cachemap(asp->cache_store);
         asp->cache_store = NULL;
     }
+    /*
+     * after the PDUs, which may still link to the pooled varbinds
+     */
+    while (asp->vbpool) {
+        agent_vbpool   *pool = (agent_vbpool *) asp->vbpool;
+
+        asp->vbpool = pool->next;
+        free(pool);
+    }
     SNMP_FREE(asp);
 }
 
+/**
+ * Allocates varbinds that live as long as an agent session.
+ *
+ * The varbinds come as one cleared array and are flagged with
+ * NETSNMP_VAR_FLAG_POOLED, so that they can be linked into the PDUs of
+ * the session and freed with them as usual: snmp_free_var() then only
+ * releases their name and value buffers, while the array itself is
+ * released by free_agent_snmp_session().
+ *
+ * @param asp   the agent session
+ * @param count the number of varbinds
+ *
+ * @return the first varbind, or NULL on failure.
+ */
+netsnmp_variable_list *
+netsnmp_agent_alloc_varbinds(netsnmp_agent_session *asp, int count)
+{
+    agent_vbpool   *pool;
+    int             i;
+
+    if (!asp || count <= 0 ||
+        count > (int)(INT_MAX / sizeof(netsnmp_variable_list)))
+        return NULL;
+
+    pool = (agent_vbpool *) malloc(sizeof(agent_vbpool) +
+                                   (count - 1) *
+                                   sizeof(netsnmp_variable_list));
+    if (!pool)
+        return NULL;
+    for (i = 0; i < count; i++) {
+        netsnmp_variable_list *var = &pool->vars[i];
+
+        /*
+         * name_loc and buf make up most of a varbind and are only read
+         * once written, so leave them be
+         */
+        memset(var, 0, offsetof(netsnmp_variable_list, name_loc));
+        memset(&var->data, 0,
+               sizeof(*var) - offsetof(netsnmp_variable_list, data));
+        var->flags = NETSNMP_VAR_FLAG_POOLED;
+    }
+    pool->next = (agent_vbpool *) asp->vbpool;
+    asp->vbpool = pool;
+    return pool->vars;
+}
+
 int
 netsnmp_check_for_delegated(netsnmp_agent_session *asp)
 {
@@ -1691,9 +1830,10 @@ netsnmp_wrap_up_request(netsnmp_agent_session *asp, int status)
 
             case SNMP_MSG_GETBULK:
                 /*
-                 * for a GETBULK response we need to rearrange the varbinds 
+                 * for a GETBULK response we need to fill in the
+                 * repetitions past the end of the MIB view
                  */
-                _reorder_getbulk(asp);
+                _finish_getbulk(asp);
                 break;
         }
 
@@ -1906,6 +2046,7 @@ netsnmp_free_agent_snmp_session_by_session(netsnmp_session * sess,
 
     DEBUGMSGTL(("snmp_agent", "REMOVE session == %8p\n", sess));
 
+    netsnmp_agent_workers_cancel_session(sess);
     for (a = agent_session_list; a != NULL; a = next) {
         if (a->session == sess) {
             *prevNext = a->next;
@@ -1927,6 +2068,15 @@ handle_snmp_packet(int op, netsnmp_session * session, int reqid,
     netsnmp_agent_session *asp;
     int             status, access_ret, rc;
 
+    /*
+     * the requests a worker thread is processing for a session that is
+     * going away can no longer be answered
+     */
+    if (op == NETSNMP_CALLBACK_OP_DISCONNECT) {
+        netsnmp_agent_workers_cancel_session(session);
+        return 1;
+    }
+
     /*
      * We only support receiving here.  
      */
@@ -2019,6 +2169,15 @@ handle_snmp_packet(int op, netsnmp_session * session, int reqid,
         }
     }
 
+    /*
+     * read-only requests may be handed to the agent worker threads 
+     */
+    if (magic == NULL && netsnmp_agent_workers_dispatch(asp)) {
+        DEBUGMSGTL(("snmp_agent", "request dispatched to worker, asp = %8p\n",
+                    asp));
+        return 1;
+    }
+
     rc = netsnmp_handle_request(asp, status);
 
     /*
@@ -2168,6 +2327,18 @@ netsnmp_add_varbind_to_cache(netsnmp_agent_session *asp, int vbcount,
                                                 cacheid);
                 goto mallocslot;        /* XXX: ick */
             }
+        } else if (asp->flags & SNMP_AGENT_FLAGS_IN_WORKER) {
+            /*
+             * the cacheid of the subtree is shared by all requests, so
+             * worker threads look for the slot of the subtree instead
+             */
+            for (cacheid = asp->treecache_num; cacheid >= 0; cacheid--)
+                if (asp->treecache[cacheid].subtree == tp)
+                    break;
+            if (cacheid < 0) {
+                cacheid = ++(asp->treecache_num);
+                goto mallocslot;
+            }
         } else if (tp->cacheid > -1 && tp->cacheid <= asp->treecache_num &&
                    asp->treecache[tp->cacheid].subtree == tp) {
             /*
@@ -2202,7 +2373,8 @@ netsnmp_add_varbind_to_cache(netsnmp_agent_session *asp, int vbcount,
             }
             asp->treecache[cacheid].subtree = tp;
             asp->treecache[cacheid].requests_begin = request;
-            tp->cacheid = cacheid;
+            if (!(asp->flags & SNMP_AGENT_FLAGS_IN_WORKER))
+                tp->cacheid = cacheid;
         }
 
         /*
@@ -2248,7 +2420,7 @@ check_acm(netsnmp_agent_session *asp, u_char type)
     int             i, j, k;
     netsnmp_request_info *request;
     int             ret = 0;
-    netsnmp_variable_list *vb, *vb2, *vbc;
+    netsnmp_variable_list *vb, *vb2, *vbc, *next;
     int             earliest = 0;
 
     for (i = 0; i <= asp->treecache_num; i++) {
@@ -2260,7 +2432,7 @@ check_acm(netsnmp_agent_session *asp, u_char type)
             earliest = 0;
             for(j = request->repeat, vb = request->requestvb_start;
                 vb && j > -1;
-                j--, vb = vb->next_variable) {
+                j--, vb = netsnmp_request_next_repetition(request, vb)) {
                 if (vb->type != ASN_NULL &&
                     vb->type != ASN_PRIV_RETRY) { /* not yet processed */
                     view =
@@ -2284,15 +2456,22 @@ check_acm(netsnmp_agent_session *asp, u_char type)
                                move the contents up the chain and fill
                                in at the end else we won't end up
                                lexographically sorted properly */
-                            if (j > -1 && vb->next_variable &&
-                                vb->next_variable->type != ASN_NULL &&
-                                vb->next_variable->type != ASN_PRIV_RETRY) {
-                                for(k = j, vbc = vb, vb2 = vb->next_variable;
+                            vb2 = netsnmp_request_next_repetition(request, vb);
+                            if (j > -1 && vb2 &&
+                                vb2->type != ASN_NULL &&
+                                vb2->type != ASN_PRIV_RETRY) {
+                                for(k = j, vbc = vb;
                                     k > -2 && vbc && vb2;
-                                    k--, vbc = vb2, vb2 = vb2->next_variable) {
+                                    k--, vbc = vb2,
+                                    vb2 = netsnmp_request_next_repetition(
+                                        request, vb2)) {
+                                    u_char flags = vbc->flags;
+
                                     /* clone next into the current */
+                                    next = vbc->next_variable;
                                     snmp_clone_var(vb2, vbc);
-                                    vbc->next_variable = vb2;
+                                    vbc->next_variable = next;
+                                    vbc->flags = flags;
                                 }
                             }
                         }
@@ -2311,10 +2490,12 @@ netsnmp_create_subtree_cache(netsnmp_agent_session *asp)
 {
     netsnmp_subtree *tp;
     netsnmp_variable_list *varbind_ptr, *vbsave, *vbptr, **prevNext;
+    netsnmp_variable_list *reps = NULL, *reps_head = NULL;
+    netsnmp_variable_list **reps_end = &reps_head;
     int             view;
     int             vbcount = 0;
     int             bulkcount = 0, bulkrep = 0;
-    int             i = 0, n = 0, r = 0;
+    int             i = 0, j, n = 0, r = 0;
     netsnmp_request_info *request;
 
     if (asp->treecache == NULL && asp->treecache_len == 0) {
@@ -2386,6 +2567,27 @@ netsnmp_create_subtree_cache(netsnmp_agent_session *asp)
                 DEBUGMSGTL(("snmp_agent", "Bulkcache malloc failed\n"));
                 return SNMP_ERR_GENERR;
             }
+
+            /*
+             * Each repetition after the first is one block of r varbinds,
+             * linked in the order they are returned and appended to the
+             * request varbinds below.  The handlers fill them in place;
+             * the bulkcache maps the repetitions of each repeating
+             * varbind to them (see netsnmp_request_next_repetition()).
+             */
+            for (i = 1; i < asp->pdu->errindex; i++) {
+                reps = netsnmp_agent_alloc_varbinds(asp, r);
+                if (!reps) {
+                    DEBUGMSGTL(("snmp_agent", "Repetitions malloc failed\n"));
+                    return SNMP_ERR_GENERR;
+                }
+                for (j = 0; j < r; j++) {
+                    asp->bulkcache[j * asp->pdu->errindex + i] = &reps[j];
+                    reps[j].type = ASN_NULL;
+                    *reps_end = &reps[j];
+                    reps_end = &reps[j].next_variable;
+                }
+            }
         }
         DEBUGMSGTL(("snmp_agent", "GETBULK N = %d, M = %ld, R = %d\n",
                     n, asp->pdu->errindex, r));
@@ -2408,36 +2610,13 @@ netsnmp_create_subtree_cache(netsnmp_agent_session *asp)
                 n--;
             } else {
                 /*
-                 * repeate request varbinds on GETBULK.  These will
-                 * have to be properly rearranged later though as
-                 * responses are supposed to actually be interlaced
-                 * with each other.  This is done with the asp->bulkcache. 
+                 * the request varbind is the first repetition, the
+                 * others were put into the bulkcache above
                  */
                 bulkrep = asp->pdu->errindex - 1;
                 if (asp->pdu->errindex > 0) {
-                    vbptr = varbind_ptr;
-                    asp->bulkcache[bulkcount++] = vbptr;
-
-                    for (i = 1; i < asp->pdu->errindex; i++) {
-                        vbptr->next_variable =
-                            SNMP_MALLOC_STRUCT(variable_list);
-                        /*
-                         * don't clone the oid as it's got to be
-                         * overwritten anyway 
-                         */
-                        if (!vbptr->next_variable) {
-                            /*
-                             * XXXWWW: ack!!! 
-                             */
-                            DEBUGMSGTL(("snmp_agent", "NextVar malloc failed\n"));
-                        } else {
-                            vbptr = vbptr->next_variable;
-                            vbptr->name_length = 0;
-                            vbptr->type = ASN_NULL;
-                            asp->bulkcache[bulkcount++] = vbptr;
-                        }
-                    }
-                    vbptr->next_variable = vbsave;
+                    asp->bulkcache[bulkcount] = varbind_ptr;
+                    bulkcount += asp->pdu->errindex;
                 } else {
                     /*
                      * 0 repeats requested for this varbind, so take it off
@@ -2506,6 +2685,12 @@ netsnmp_create_subtree_cache(netsnmp_agent_session *asp)
         prevNext = &(varbind_ptr->next_variable);
     }
 
+    /*
+     * the further repetitions follow the request varbinds
+     */
+    if (reps_head)
+        *prevNext = reps_head;
+
     return SNMPERR_SUCCESS;
 }
 
@@ -3324,9 +3509,50 @@ netsnmp_handle_request(netsnmp_agent_session *asp, int status)
     }
 
     /*
-     * process the request 
+     * process the request.  A set must not run alongside any requests
+     * still being processed by worker threads.
      */
-    status = handle_pdu(asp);
+    if (asp == netsnmp_processing_set) {
+        netsnmp_agent_workers_lock();
+        status = handle_pdu(asp);
+        netsnmp_agent_workers_unlock();
+    } else
+        status = handle_pdu(asp);
+
+    return netsnmp_complete_request(asp, status);
+}
+
+/**
+ * Deals with the result of handle_pdu() for a request: either adds it
+ * to the delegated request chain or wraps it up and sends the response.
+ *
+ * Requests that a worker thread could not finish because they reached a
+ * handler which is not thread safe are processed again from scratch.
+ *
+ * @param asp    the request, as processed by handle_pdu()
+ * @param status the value returned by handle_pdu()
+ */
+int
+netsnmp_complete_request(netsnmp_agent_session *asp, int status)
+{
+    netsnmp_agent_session *retry;
+
+    if (asp->flags & SNMP_AGENT_FLAGS_NOT_THREAD_SAFE) {
+        DEBUGMSGTL(("snmp_agent", "request %8p needs the main thread\n",
+                    asp));
+        /*
+         * handle_pdu() counts the request again 
+         */
+        if (asp->orig_pdu->command == SNMP_MSG_GET)
+            snmp_increment_statistic_by(STAT_SNMPINGETREQUESTS, -1);
+        else if (asp->orig_pdu->command == SNMP_MSG_GETNEXT)
+            snmp_increment_statistic_by(STAT_SNMPINGETNEXTS, -1);
+        retry = init_agent_snmp_session(asp->session, asp->orig_pdu);
+        free_agent_snmp_session(asp);
+        if (retry == NULL)
+            return 0;
+        return netsnmp_handle_request(retry, SNMP_ERR_NOERROR);
+    }
 
     /*
      * print the results in appropriate debugging mode 
@@ -379,6 +379,7 @@ RETSIGTYPE
 SnmpdDump(int a)
 {
     dump_registry();
+    netsnmp_cache_stats_dump();
     signal(SIGUSR1, SnmpdDump);
 }
 #endif
@@ -405,6 +406,7 @@ SnmpTrapNodeDown(void)
     /*
      * XXX  2 - Node Down #define it as NODE_DOWN_TRAP 
      */
+    netsnmp_trap_queue_flush();
 }
 
 /*******************************************************************-o-******
@@ -1129,8 +1131,15 @@ main(int argc, char *argv[])
      */
     DEBUGMSGTL(("snmpd/main", "We're up.  Starting to process data.\n"));
     if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID, 
-				NETSNMP_DS_AGENT_QUIT_IMMEDIATELY))
+				NETSNMP_DS_AGENT_QUIT_IMMEDIATELY)) {
+        /*
+         * started only now, as threads do not survive the fork above 
+         */
+        netsnmp_agent_workers_start(netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                        NETSNMP_DS_AGENT_WORKER_THREADS));
         receive();
+        netsnmp_agent_workers_stop();
+    }
     DEBUGMSGTL(("snmpd/main", "sending shutdown trap\n"));
     SnmpTrapNodeDown();
     DEBUGMSGTL(("snmpd/main", "Bye...\n"));
@@ -1213,7 +1222,7 @@ receive(void)
     int             numfds;
     netsnmp_large_fd_set readfds, writefds, exceptfds;
     struct timeval  timeout, *tvp = &timeout;
-    int             count, block, i;
+    int             count, block, i, use_poll;
 #ifdef	USING_SMUX_MODULE
     int             sd;
 #endif                          /* USING_SMUX_MODULE */
@@ -1246,7 +1255,9 @@ receive(void)
 	    netsnmp_logging_restart();
 	    snmp_log(LOG_INFO, "NET-SNMP version %s restarted\n",
 		     netsnmp_get_version());
+            netsnmp_agent_workers_lock();
             update_config();
+            netsnmp_agent_workers_unlock();
             send_easy_trap(SNMP_TRAP_ENTERPRISESPECIFIC, 3);
 #if HAVE_SIGHOLD
             sigrelse(SIGHUP);
@@ -1262,12 +1273,26 @@ receive(void)
         tvp->tv_sec = INT_MAX;
         tvp->tv_usec = 0;
 
+        /*
+         * The epoll set already holds every session and registered fd,
+         * only SMUX still needs select().
+         */
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+        use_poll = netsnmp_fd_poll_enabled();
+#else
+        use_poll = 0;
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+#ifdef	USING_SMUX_MODULE
+        if (smux_listen_sd >= 0)
+            use_poll = 0;
+#endif                          /* USING_SMUX_MODULE */
+
         numfds = 0;
         NETSNMP_LARGE_FD_ZERO(&readfds);
         NETSNMP_LARGE_FD_ZERO(&writefds);
         NETSNMP_LARGE_FD_ZERO(&exceptfds);
         block = 0;
-        snmp_select_info2(&numfds, &readfds, tvp, &block);
+        snmp_select_info2(&numfds, use_poll ? NULL : &readfds, tvp, &block);
         if (block == 1) {
             tvp = NULL;         /* block without timeout */
 	}
@@ -1290,7 +1315,9 @@ receive(void)
 #endif                          /* USING_SMUX_MODULE */
 
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-        netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
+        if (!use_poll)
+            netsnmp_external_event_info2(&numfds, &readfds, &writefds,
+                                         &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
     reselect:
@@ -1308,11 +1335,23 @@ receive(void)
         if (tvp)
             DEBUGMSGTL(("timer", "tvp %ld.%ld\n", (long) tvp->tv_sec,
                         (long) tvp->tv_usec));
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+        if (use_poll)
+            count = netsnmp_fd_poll_wait(tvp);
+        else
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
         count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds, &exceptfds,
 				     tvp);
         DEBUGMSGTL(("snmpd/select", "returned, count = %d\n", count));
 
         if (count > 0) {
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+            if (use_poll) {
+                /* sessions and registered fds alike */
+                netsnmp_fd_poll_dispatch();
+                count = 0;
+            }
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
 #ifdef USING_SMUX_MODULE
             /*
@@ -101,6 +101,7 @@ SOFTWARE.
 #include "snmptrapd_handlers.h"
 #include "snmptrapd_log.h"
 #include "snmptrapd_auth.h"
+#include "snmptrapd_workers.h"
 #include "notification-log-mib/notification_log.h"
 #include "tlstm-mib/snmpTlstmCertToTSNTable/snmpTlstmCertToTSNTable.h"
 #include "mibII/vacm_conf.h"
@@ -551,7 +552,7 @@ parse_config_outputOption(const char *token, char *cptr)
 static void
 snmptrapd_main_loop(void)
 {
-    int             count, numfds, block;
+    int             count, numfds, block, use_poll = 0;
     fd_set          readfds,writefds,exceptfds;
     struct timeval  timeout, *tvp;
 
@@ -566,6 +567,10 @@ snmptrapd_main_loop(void)
                 netsnmp_logging_restart();
                 snmp_log(LOG_INFO, "NET-SNMP version %s restarted\n",
                          netsnmp_get_version());
+            /*
+             * the handlers are about to be replaced
+             */
+            netsnmp_trapd_workers_drain();
             trapd_update_config();
             if (trap1_fmt_str_remember) {
                 parse_format( NULL, trap1_fmt_str_remember );
@@ -580,17 +585,35 @@ snmptrapd_main_loop(void)
         tvp = &timeout;
         timerclear(tvp);
         tvp->tv_sec = 5;
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+        use_poll = netsnmp_fd_poll_enabled();
+        if (use_poll)
+            snmp_select_info2(&numfds, NULL, tvp, &block);
+        else
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
         snmp_select_info(&numfds, &readfds, tvp, &block);
         if (block == 1)
             tvp = NULL;         /* block without timeout */
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-        netsnmp_external_event_info(&numfds, &readfds, &writefds, &exceptfds);
-#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+        if (use_poll)
+            count = netsnmp_fd_poll_wait(tvp);
+        else {
+            netsnmp_external_event_info(&numfds, &readfds, &writefds,
+                                        &exceptfds);
+            count = select(numfds, &readfds, &writefds, &exceptfds, tvp);
+        }
+#else
         count = select(numfds, &readfds, &writefds, &exceptfds, tvp);
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
         if (count > 0) {
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-            netsnmp_dispatch_external_events(&count, &readfds, &writefds,
-                                             &exceptfds);
+            if (use_poll) {
+                /* sessions and registered fds alike */
+                netsnmp_fd_poll_dispatch();
+                count = 0;
+            } else
+                netsnmp_dispatch_external_events(&count, &readfds, &writefds,
+                                                 &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
             /* If there are any more events after external events, then
              * try SNMP events. */
@@ -718,6 +741,18 @@ main(int argc, char *argv[])
     register_config_handler("snmptrapd", "outputOption",
                             parse_config_outputOption, NULL, "string");
 
+    netsnmp_ds_register_config(ASN_INTEGER, "snmptrapd", "trapdWorkerThreads",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_APP_WORKER_THREADS);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmptrapd",
+                               "trapdWorkerQueueSize",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_APP_WORKER_QUEUE_SIZE);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmptrapd",
+                               "trapdUnorderedOutput",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_APP_UNORDERED_OUTPUT);
+
     /*
      * Add some options if they are available.  
      */
@@ -1017,12 +1052,14 @@ main(int argc, char *argv[])
         traph = netsnmp_add_global_traphandler(NETSNMPTRAPD_PRE_HANDLER,
                                                syslog_handler);
         traph->authtypes = TRAP_AUTH_LOG;
+        traph->flags |= NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE;
         snmp_enable_syslog();
 #else /* NETSNMP_FEATURE_REMOVE_LOGGING_SYSLOG */
 #ifndef NETSNMP_FEATURE_REMOVE_LOGGING_STDIO
         traph = netsnmp_add_global_traphandler(NETSNMPTRAPD_PRE_HANDLER,
                                                print_handler);
         traph->authtypes = TRAP_AUTH_LOG;
+        traph->flags |= NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE;
         snmp_enable_stderr();
 #endif /* NETSNMP_FEATURE_REMOVE_LOGGING_STDIO */
 #endif /* NETSNMP_FEATURE_REMOVE_LOGGING_SYSLOG */
@@ -1030,6 +1067,7 @@ main(int argc, char *argv[])
         traph = netsnmp_add_global_traphandler(NETSNMPTRAPD_PRE_HANDLER,
                                                print_handler);
         traph->authtypes = TRAP_AUTH_LOG;
+        traph->flags |= NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE;
     }
 
 #if defined(USING_AGENTX_SUBAGENT_MODULE) && !defined(NETSNMP_SNMPTRAPD_DISABLE_AGENTX)
@@ -1335,7 +1373,11 @@ main(int argc, char *argv[])
     trapd_status = SNMPTRAPD_RUNNING;
 #endif
 
+    netsnmp_trapd_workers_start(netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                                   NETSNMP_DS_APP_WORKER_THREADS));
+
     snmptrapd_main_loop();
+    netsnmp_trapd_workers_stop();
 
     if (snmp_get_do_logging()) {
         struct tm      *tm;
@@ -13,6 +13,9 @@
 #if HAVE_NETDB_H
 #include <netdb.h>
 #endif
+#if HAVE_STDINT_H
+#include <stdint.h>
+#endif
 
 #include <net-snmp/net-snmp-includes.h>
 #include "snmptrapd_handlers.h"
@@ -52,9 +55,52 @@ init_netsnmp_trapd_auth(void)
                                NETSNMP_DS_APP_NO_AUTHORIZATION);
 }
 
-/* XXX: store somewhere in the PDU instead */
+/*
+ * The result of the last authorization, kept per thread as notifications
+ * may be handled by worker threads (see snmptrapd_workers.c).
+ * XXX: store somewhere in the PDU instead
+ */
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+
+static pthread_key_t lastlookup_key;
+static pthread_once_t lastlookup_once = PTHREAD_ONCE_INIT;
+
+static void
+_lastlookup_key_create(void)
+{
+    pthread_key_create(&lastlookup_key, NULL);
+}
+
+int
+netsnmp_trapd_get_auth(void)
+{
+    pthread_once(&lastlookup_once, _lastlookup_key_create);
+    return (int)(intptr_t) pthread_getspecific(lastlookup_key);
+}
+
+void
+netsnmp_trapd_set_auth(int auth)
+{
+    pthread_once(&lastlookup_once, _lastlookup_key_create);
+    pthread_setspecific(lastlookup_key, (void *)(intptr_t) auth);
+}
+#else
 static int lastlookup;
 
+int
+netsnmp_trapd_get_auth(void)
+{
+    return lastlookup;
+}
+
+void
+netsnmp_trapd_set_auth(int auth)
+{
+    lastlookup = auth;
+}
+#endif
+
 /**
  * Authorizes incoming notifications for further processing
  */
@@ -143,7 +189,7 @@ netsnmp_trapd_auth(netsnmp_pdu           *pdu,
 
     if (ret) {
         /* we have policy to at least do "something".  Remember and continue. */
-        lastlookup = ret;
+        netsnmp_trapd_set_auth(ret);
 #ifndef NETSNMP_DISABLE_SNMPV1
         if (newpdu != pdu)
             snmp_free_pdu(newpdu);
@@ -167,12 +213,15 @@ netsnmp_trapd_auth(netsnmp_pdu           *pdu,
 int
 netsnmp_trapd_check_auth(int authtypes)
 {
+    int lastlookup;
+
     if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
                                NETSNMP_DS_APP_NO_AUTHORIZATION)) {
         DEBUGMSGTL(("snmptrapd:auth", "authorization turned off\n"));
         return 1;
     }
 
+    lastlookup = netsnmp_trapd_get_auth();
     DEBUGMSGTL(("snmptrapd:auth",
                 "Comparing auth types: result=%d, request=%d, result=%d\n",
                 lastlookup, authtypes,
@@ -9,6 +9,7 @@
 
 #define NETSNMP_DS_APP_NUMERIC_IP       16
 #define NETSNMP_DS_APP_NO_AUTHORIZATION 17
+#define NETSNMP_DS_APP_UNORDERED_OUTPUT 21  /* workers log as they finish */
 
 /*
  * NB: The NETSNMP_DS_APP_NO_AUTHORIZATION definition is repeated
@@ -16,4 +17,11 @@
  *     If this definition is changed, it should be updated there too.
  */
 
+/* integers
+ *
+ * WARNING: These must not conflict with the agent's DS integers either */
+
+#define NETSNMP_DS_APP_WORKER_THREADS    17 /* threads running handlers */
+#define NETSNMP_DS_APP_WORKER_QUEUE_SIZE 18 /* notifications in flight */
+
 #endif /* SNMPTRAPD_DS_H */
@@ -36,6 +36,7 @@
 #include "snmptrapd_handlers.h"
 #include "snmptrapd_auth.h"
 #include "snmptrapd_log.h"
+#include "snmptrapd_workers.h"
 #include "notification-log-mib/notification_log.h"
 
 netsnmp_feature_child_of(add_default_traphandler, snmptrapd)
@@ -47,6 +48,22 @@ char *print_format2  = NULL;
 char *exec_format1   = NULL;
 char *exec_format2   = NULL;
 
+/*
+ * The format strings above compiled, and the standard formats used when
+ * they aren't set.
+ */
+static netsnmp_trapd_format *syslog_tmpl1, *syslog_tmpl2;
+static netsnmp_trapd_format *print_tmpl1, *print_tmpl2;
+static netsnmp_trapd_format *exec_tmpl1, *exec_tmpl2;
+static netsnmp_trapd_format *syslog_v1_tmpl, *syslog_v23_tmpl;
+static netsnmp_trapd_format *print_v23_tmpl, *exec_std_tmpl;
+
+#define SYSLOG_V1_STANDARD_FORMAT      "%a: %W Trap (%q) Uptime: %#T%#v\n"
+#define SYSLOG_V1_ENTERPRISE_FORMAT    "%a: %W Trap (%q) Uptime: %#T%#v\n" /* XXX - (%q) become (.N) ??? */
+#define SYSLOG_V23_NOTIFICATION_FORMAT "%B [%b]: Trap %#v\n"	 	   /* XXX - introduces a leading " ," */
+#define PRINT_V23_NOTIFICATION_FORMAT  "%.4y-%.2m-%.2l %.2h:%.2j:%.2k %B [%b]:\n%v\n"
+#define EXECUTE_FORMAT                 "%B\n%b\n%V\n%v\n"
+
 int   SyslogTrap = 0;
 int   dropauth = 0;
 
@@ -142,6 +159,7 @@ snmptrapd_parse_traphandle(const char *token, char *line)
         traph->token = strdup(cptr);
         if (format) {
             traph->format = format;
+            traph->format_tmpl = netsnmp_trapd_format_compile(format);
             format = NULL;
         }
     }
@@ -218,6 +236,23 @@ parse_forward(const char *token, char *line)
 }
 
 
+/*
+ * Replaces one of the configured format strings, along with its compiled
+ * form.
+ */
+static void
+set_format(char **format, netsnmp_trapd_format **tmpl, const char *str)
+{
+    SNMP_FREE(*format);
+    netsnmp_trapd_format_free(*tmpl);
+    *tmpl = NULL;
+    if (str) {
+        *format = strdup(str);
+        if (*format)
+            *tmpl = netsnmp_trapd_format_compile(*format);
+    }
+}
+
 void
 parse_format(const char *token, char *line)
 {
@@ -250,38 +285,26 @@ parse_format(const char *token, char *line)
      * So update the appropriate pointer(s).
      */
     if (!strcmp( line, "print1")) {
-        SNMP_FREE( print_format1 );
-        print_format1 = strdup(cp);
+        set_format( &print_format1, &print_tmpl1, cp );
     } else if (!strcmp( line, "print2")) {
-        SNMP_FREE( print_format2 );
-        print_format2 = strdup(cp);
+        set_format( &print_format2, &print_tmpl2, cp );
     } else if (!strcmp( line, "print")) {
-        SNMP_FREE( print_format1 );
-        SNMP_FREE( print_format2 );
-        print_format1 = strdup(cp);
-        print_format2 = strdup(cp);
+        set_format( &print_format1, &print_tmpl1, cp );
+        set_format( &print_format2, &print_tmpl2, cp );
     } else if (!strcmp( line, "syslog1")) {
-        SNMP_FREE( syslog_format1 );
-        syslog_format1 = strdup(cp);
+        set_format( &syslog_format1, &syslog_tmpl1, cp );
     } else if (!strcmp( line, "syslog2")) {
-        SNMP_FREE( syslog_format2 );
-        syslog_format2 = strdup(cp);
+        set_format( &syslog_format2, &syslog_tmpl2, cp );
     } else if (!strcmp( line, "syslog")) {
-        SNMP_FREE( syslog_format1 );
-        SNMP_FREE( syslog_format2 );
-        syslog_format1 = strdup(cp);
-        syslog_format2 = strdup(cp);
+        set_format( &syslog_format1, &syslog_tmpl1, cp );
+        set_format( &syslog_format2, &syslog_tmpl2, cp );
     } else if (!strcmp( line, "execute1")) {
-        SNMP_FREE( exec_format1 );
-        exec_format1 = strdup(cp);
+        set_format( &exec_format1, &exec_tmpl1, cp );
     } else if (!strcmp( line, "execute2")) {
-        SNMP_FREE( exec_format2 );
-        exec_format2 = strdup(cp);
+        set_format( &exec_format2, &exec_tmpl2, cp );
     } else if (!strcmp( line, "execute")) {
-        SNMP_FREE( exec_format1 );
-        SNMP_FREE( exec_format2 );
-        exec_format1 = strdup(cp);
-        exec_format2 = strdup(cp);
+        set_format( &exec_format1, &exec_tmpl1, cp );
+        set_format( &exec_format2, &exec_tmpl2, cp );
     }
 
     *sep = ' ';
@@ -291,7 +314,7 @@ parse_format(const char *token, char *line)
 static void
 parse_trap1_fmt(const char *token, char *line)
 {
-    print_format1 = strdup(line);
+    set_format(&print_format1, &print_tmpl1, line);
 }
 
 
@@ -299,7 +322,7 @@ void
 free_trap1_fmt(void)
 {
     if (print_format1 && print_format1 != trap1_std_str)
-        free((char *) print_format1);
+        set_format(&print_format1, &print_tmpl1, NULL);
     print_format1 = NULL;
 }
 
@@ -307,7 +330,7 @@ free_trap1_fmt(void)
 static void
 parse_trap2_fmt(const char *token, char *line)
 {
-    print_format2 = strdup(line);
+    set_format(&print_format2, &print_tmpl2, line);
 }
 
 
@@ -315,7 +338,7 @@ void
 free_trap2_fmt(void)
 {
     if (print_format2 && print_format2 != trap2_std_str)
-        free((char *) print_format2);
+        set_format(&print_format2, &print_tmpl2, NULL);
     print_format2 = NULL;
 }
 
@@ -336,6 +359,18 @@ snmptrapd_register_configs( void )
 			    "[print{,1,2}|syslog{,1,2}|execute{,1,2}] format");
     register_config_handler("snmptrapd", "forward",
                             parse_forward, NULL, "OID|\"default\" destination");
+
+    /* the hardwired formats used by the standard handlers below */
+    if (!syslog_v1_tmpl)
+        syslog_v1_tmpl = netsnmp_trapd_format_compile(SYSLOG_V1_STANDARD_FORMAT);
+    if (!syslog_v23_tmpl)
+        syslog_v23_tmpl =
+            netsnmp_trapd_format_compile(SYSLOG_V23_NOTIFICATION_FORMAT);
+    if (!print_v23_tmpl)
+        print_v23_tmpl =
+            netsnmp_trapd_format_compile(PRINT_V23_NOTIFICATION_FORMAT);
+    if (!exec_std_tmpl)
+        exec_std_tmpl = netsnmp_trapd_format_compile(EXECUTE_FORMAT);
 }
 
 
@@ -352,6 +387,23 @@ netsnmp_trapd_handler *netsnmp_post_global_traphandlers   = NULL;
 netsnmp_trapd_handler *netsnmp_default_traphandlers  = NULL;
 netsnmp_trapd_handler *netsnmp_specific_traphandlers = NULL;
 
+/*
+ * Open addressing index of the trap-specific list by trap OID, so that
+ * netsnmp_get_traphandler() doesn't walk the whole list for each
+ * notification.  It holds the first handler registered for each OID,
+ * which is the entry the list walk would have stopped at.  Entries are
+ * only ever added, by netsnmp_add_traphandler(), and the index is
+ * emptied with the list; if the table can't be allocated, lookups walk
+ * the list.  traph_index_lens counts the registered OIDs of each length,
+ * so that a lookup only tries the prefixes that might be registered.
+ */
+#define TRAPH_INDEX_MAX_LEN (MAX_OID_LEN + 2)
+
+static netsnmp_trapd_handler **traph_index = NULL;
+static size_t   traph_index_size = 0, traph_index_count = 0;
+static int      traph_index_failed = 0;
+static u_int    traph_index_lens[TRAPH_INDEX_MAX_LEN + 1];
+
 typedef struct netsnmp_handler_map_t {
    netsnmp_trapd_handler **handler;
    const char             *descr;
@@ -424,6 +476,97 @@ netsnmp_add_default_traphandler(Netsnmp_Trap_Handler *handler) {
 #endif /* NETSNMP_FEATURE_REMOVE_ADD_DEFAULT_TRAPHANDLER */
 
 
+#define TRAPH_HASH_BASIS 2166136261U
+#define TRAPH_HASH_STEP(hash, subid) \
+    (((hash) ^ (u_int) (subid)) * 16777619U)
+
+static u_int
+_traph_index_hash(const oid *name, int len)
+{
+    u_int           hash = TRAPH_HASH_BASIS;
+    int             i;
+
+    for (i = 0; i < len; i++)
+        hash = TRAPH_HASH_STEP(hash, name[i]);
+    return hash;
+}
+
+/*
+ * Returns the slot holding the entry for this OID, or the empty slot
+ * where it would go.
+ */
+static size_t
+_traph_index_slot(const oid *name, int len, u_int hash)
+{
+    size_t          slot = hash & (traph_index_size - 1);
+    netsnmp_trapd_handler *traph;
+
+    while ((traph = traph_index[slot]) != NULL &&
+           snmp_oid_compare(traph->trapoid, traph->trapoid_len,
+                            name, len) != 0)
+        slot = (slot + 1) & (traph_index_size - 1);
+    return slot;
+}
+
+static void
+_traph_index_clear(void)
+{
+    SNMP_FREE(traph_index);
+    traph_index_size = traph_index_count = 0;
+    traph_index_failed = 0;
+    memset(traph_index_lens, 0, sizeof(traph_index_lens));
+}
+
+/*
+ * Adds the first handler for a newly registered trap OID, growing the
+ * table as needed.
+ */
+static void
+_traph_index_add(netsnmp_trapd_handler *traph)
+{
+    netsnmp_trapd_handler **old = traph_index, *entry;
+    size_t          old_size = traph_index_size, i, slot;
+
+    if (traph_index_failed)
+        return;
+    if (traph->trapoid_len > TRAPH_INDEX_MAX_LEN) {
+        DEBUGMSGTL(("snmptrapd:lookup", "OID too long for the index\n"));
+        _traph_index_clear();
+        traph_index_failed = 1;
+        return;
+    }
+
+    if ((traph_index_count + 1) * 2 > traph_index_size) {
+        traph_index_size = old_size ? old_size * 2 : 64;
+        traph_index = (netsnmp_trapd_handler **)
+            calloc(traph_index_size, sizeof(netsnmp_trapd_handler *));
+        if (!traph_index) {
+            traph_index = old;
+            _traph_index_clear();
+            traph_index_failed = 1;
+            return;
+        }
+        for (i = 0; i < old_size; i++) {
+            if ((entry = old[i]) == NULL)
+                continue;
+            slot = _traph_index_slot(entry->trapoid, entry->trapoid_len,
+                                     _traph_index_hash(entry->trapoid,
+                                                       entry->trapoid_len));
+            traph_index[slot] = entry;
+        }
+        free(old);
+    }
+
+    slot = _traph_index_slot(traph->trapoid, traph->trapoid_len,
+                             _traph_index_hash(traph->trapoid,
+                                               traph->trapoid_len));
+    if (traph_index[slot] == NULL) {
+        traph_index[slot] = traph;
+        traph_index_count++;
+        traph_index_lens[traph->trapoid_len]++;
+    }
+}
+
 /*
  * Register a new trap-specific traphandler
  */
@@ -488,6 +631,7 @@ netsnmp_add_traphandler(Netsnmp_Trap_Handler* handler,
 	        netsnmp_specific_traphandlers = traph;
             traph2->prevt = traph;
             traph->nextt  = traph2;
+            _traph_index_add(traph);
         }
     } else {
         /*
@@ -506,6 +650,7 @@ netsnmp_add_traphandler(Netsnmp_Trap_Handler* handler,
              */
             netsnmp_specific_traphandlers = traph;
         }
+        _traph_index_add(traph);
     }
 
     return traph;
@@ -527,6 +672,7 @@ snmptrapd_free_traphandle(void)
        DEBUGMSG(("snmptrapd", "Freeing default trap handler\n"));
 	nexth = traph->nexth;
 	SNMP_FREE(traph->token);
+	netsnmp_trapd_format_free(traph->format_tmpl);
 	SNMP_FREE(traph);
 	traph = nexth;
     }
@@ -545,12 +691,53 @@ snmptrapd_free_traphandle(void)
 	    nexth = traph->nexth;
 	    SNMP_FREE(traph->token);
 	    SNMP_FREE(traph->trapoid);
+	    netsnmp_trapd_format_free(traph->format_tmpl);
 	    SNMP_FREE(traph);
 	    traph = nexth;
 	}
 	traph = nextt;
     }
     netsnmp_specific_traphandlers = NULL;
+    _traph_index_clear();
+}
+
+/*
+ * Finds the entry the walk of the (descending) trap-specific list below
+ * would stop at.  Only an entry registered for the trap OID itself or
+ * for one of its prefixes can match, and the walk reaches those longest
+ * first, so try the OID and then ever shorter prefixes.
+ */
+static netsnmp_trapd_handler *
+_traph_index_lookup(oid *trapOid, int trapOidLen)
+{
+    u_int           hash[TRAPH_INDEX_MAX_LEN + 1];
+    netsnmp_trapd_handler *traph;
+    int             len;
+
+    hash[0] = TRAPH_HASH_BASIS;
+    for (len = 0; len < trapOidLen; len++)
+        hash[len + 1] = TRAPH_HASH_STEP(hash[len], trapOid[len]);
+
+    for (len = trapOidLen; len >= 0; len--) {
+        if (!traph_index_lens[len])
+            continue;
+        traph = traph_index[_traph_index_slot(trapOid, len, hash[len])];
+        if (!traph)
+            continue;
+        if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE)) {
+            if (len == trapOidLen) {
+                DEBUGMSGTL(( "snmptrapd:lookup",
+                             "get_traphandler exact match (%p)\n", traph));
+                return traph;
+            }
+        } else if (len < trapOidLen ||
+                   !(traph->flags & NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE)) {
+            DEBUGMSGTL(( "snmptrapd:lookup",
+                         "get_traphandler subtree match (%p)\n", traph));
+            return traph;
+        }
+    }
+    return NULL;
 }
 
 /*
@@ -569,6 +756,15 @@ netsnmp_get_traphandler( oid *trapOid, int trapOidLen ) {
     DEBUGMSGOID(("snmptrapd:lookup", trapOid, trapOidLen));
     DEBUGMSG(( "snmptrapd:lookup", "\n"));
 
+    if (traph_index && trapOidLen <= TRAPH_INDEX_MAX_LEN) {
+        traph = _traph_index_lookup(trapOid, trapOidLen);
+        if (traph)
+            return traph;
+        DEBUGMSGTL(( "snmptrapd:lookup", "get_traphandler default (%p)\n",
+                     netsnmp_default_traphandlers));
+        return netsnmp_default_traphandlers;
+    }
+
     /*
      * Look for a matching OID, and return that list...
      */
@@ -626,9 +822,21 @@ netsnmp_get_traphandler( oid *trapOid, int trapOidLen ) {
  *
  *-----------------------------*/
 
-#define SYSLOG_V1_STANDARD_FORMAT      "%a: %W Trap (%q) Uptime: %#T%#v\n"
-#define SYSLOG_V1_ENTERPRISE_FORMAT    "%a: %W Trap (%q) Uptime: %#T%#v\n" /* XXX - (%q) become (.N) ??? */
-#define SYSLOG_V23_NOTIFICATION_FORMAT "%B [%b]: Trap %#v\n"	 	   /* XXX - introduces a leading " ," */
+/*
+ * Formats a trap into out, with the compiled form of the format if there
+ * is one.  Returns 0 if the output was truncated.
+ */
+static int
+format_trap(netsnmp_trapd_buffer *out, size_t *out_len, const char *format,
+            const netsnmp_trapd_format *tmpl, netsnmp_pdu *pdu,
+            netsnmp_transport *transport)
+{
+    if (tmpl)
+        return netsnmp_trapd_format_trap(&out->buf, &out->buf_len, out_len,
+                                         1, tmpl, pdu, transport);
+    return realloc_format_trap(&out->buf, &out->buf_len, out_len, 1,
+                               format, pdu, transport);
+}
 
 /*
  *  Trap handler for logging via syslog
@@ -637,8 +845,8 @@ int   syslog_handler(  netsnmp_pdu           *pdu,
                        netsnmp_transport     *transport,
                        netsnmp_trapd_handler *handler)
 {
-    u_char         *rbuf = NULL;
-    size_t          r_len = 64, o_len = 0;
+    netsnmp_trapd_buffer *out;
+    size_t          o_len = 0;
     int             trunc = 0;
 
     DEBUGMSGTL(( "snmptrapd", "syslog_handler\n"));
@@ -646,7 +854,13 @@ int   syslog_handler(  netsnmp_pdu           *pdu,
     if (SyslogTrap)
         return NETSNMPTRAPD_HANDLER_OK;
 
-    if ((rbuf = (u_char *) calloc(r_len, 1)) == NULL) {
+    /*
+     *  A 0-length format string means don't log
+     */
+    if (handler && handler->format && !*handler->format)
+        return NETSNMPTRAPD_HANDLER_OK;
+
+    if ((out = netsnmp_trapd_output_buffer()) == NULL) {
         snmp_log(LOG_ERR, "couldn't display trap -- malloc failed\n");
         return NETSNMPTRAPD_HANDLER_FAIL;	/* Failed but keep going */
     }
@@ -656,13 +870,8 @@ int   syslog_handler(  netsnmp_pdu           *pdu,
      */
     if (handler && handler->format) {
         DEBUGMSGTL(( "snmptrapd", "format = '%s'\n", handler->format));
-        if (*handler->format) {
-            trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                     handler->format, pdu, transport);
-        } else {
-            free(rbuf);
-            return NETSNMPTRAPD_HANDLER_OK;    /* A 0-length format string means don't log */
-        }
+        trunc = !format_trap(out, &o_len, handler->format,
+                             handler->format_tmpl, pdu, transport);
 
     /*
      *  Otherwise (i.e. a NULL handler format string),
@@ -677,41 +886,36 @@ int   syslog_handler(  netsnmp_pdu           *pdu,
 	if ( pdu->command == SNMP_MSG_TRAP ) {
             if (syslog_format1) {
                 DEBUGMSGTL(( "snmptrapd", "syslog_format v1 = '%s'\n", syslog_format1));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             syslog_format1, pdu, transport);
+                trunc = !format_trap(out, &o_len, syslog_format1,
+                                     syslog_tmpl1, pdu, transport);
 
 	    } else if (pdu->trap_type == SNMP_TRAP_ENTERPRISESPECIFIC) {
                 DEBUGMSGTL(( "snmptrapd", "v1 enterprise format\n"));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             SYSLOG_V1_ENTERPRISE_FORMAT,
-                                             pdu, transport);
+                trunc = !format_trap(out, &o_len, SYSLOG_V1_ENTERPRISE_FORMAT,
+                                     syslog_v1_tmpl, pdu, transport);
 	    } else {
                 DEBUGMSGTL(( "snmptrapd", "v1 standard trap format\n"));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             SYSLOG_V1_STANDARD_FORMAT,
-                                             pdu, transport);
+                trunc = !format_trap(out, &o_len, SYSLOG_V1_STANDARD_FORMAT,
+                                     syslog_v1_tmpl, pdu, transport);
 	    }
 	} else {	/* SNMPv2/3 notifications */
             if (syslog_format2) {
                 DEBUGMSGTL(( "snmptrapd", "syslog_format v1 = '%s'\n", syslog_format2));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             syslog_format2, pdu, transport);
+                trunc = !format_trap(out, &o_len, syslog_format2,
+                                     syslog_tmpl2, pdu, transport);
 	    } else {
                 DEBUGMSGTL(( "snmptrapd", "v2/3 format\n"));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             SYSLOG_V23_NOTIFICATION_FORMAT,
-                                             pdu, transport);
+                trunc = !format_trap(out, &o_len,
+                                     SYSLOG_V23_NOTIFICATION_FORMAT,
+                                     syslog_v23_tmpl, pdu, transport);
 	    }
         }
     }
-    snmp_log(LOG_WARNING, "%s%s", rbuf, (trunc?" [TRUNCATED]\n":""));
-    free(rbuf);
+    netsnmp_trapd_log(LOG_WARNING, (char *) out->buf, trunc);
     return NETSNMPTRAPD_HANDLER_OK;
 }
 
 
-#define PRINT_V23_NOTIFICATION_FORMAT "%.4y-%.2m-%.2l %.2h:%.2j:%.2k %B [%b]:\n%v\n"
-
 /*
  *  Trap handler for logging to a file
  */
@@ -719,8 +923,8 @@ int   print_handler(   netsnmp_pdu           *pdu,
                        netsnmp_transport     *transport,
                        netsnmp_trapd_handler *handler)
 {
-    u_char         *rbuf = NULL;
-    size_t          r_len = 64, o_len = 0;
+    netsnmp_trapd_buffer *out;
+    size_t          o_len = 0;
     int             trunc = 0;
 
     DEBUGMSGTL(( "snmptrapd", "print_handler\n"));
@@ -732,7 +936,13 @@ int   print_handler(   netsnmp_pdu           *pdu,
     if (pdu->trap_type == SNMP_TRAP_AUTHFAIL && dropauth)
         return NETSNMPTRAPD_HANDLER_OK;
 
-    if ((rbuf = (u_char *) calloc(r_len, 1)) == NULL) {
+    /*
+     *  A 0-length format string means don't log
+     */
+    if (handler && handler->format && !*handler->format)
+        return NETSNMPTRAPD_HANDLER_OK;
+
+    if ((out = netsnmp_trapd_output_buffer()) == NULL) {
         snmp_log(LOG_ERR, "couldn't display trap -- malloc failed\n");
         return NETSNMPTRAPD_HANDLER_FAIL;	/* Failed but keep going */
     }
@@ -742,13 +952,8 @@ int   print_handler(   netsnmp_pdu           *pdu,
      */
     if (handler && handler->format) {
         DEBUGMSGTL(( "snmptrapd", "format = '%s'\n", handler->format));
-        if (*handler->format) {
-            trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                     handler->format, pdu, transport);
-        } else {
-            free(rbuf);
-            return NETSNMPTRAPD_HANDLER_OK;    /* A 0-length format string means don't log */
-        }
+        trunc = !format_trap(out, &o_len, handler->format,
+                             handler->format_tmpl, pdu, transport);
 
     /*
      *  Otherwise (i.e. a NULL handler format string),
@@ -763,34 +968,31 @@ int   print_handler(   netsnmp_pdu           *pdu,
 	if ( pdu->command == SNMP_MSG_TRAP ) {
             if (print_format1) {
                 DEBUGMSGTL(( "snmptrapd", "print_format v1 = '%s'\n", print_format1));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             print_format1, pdu, transport);
+                trunc = !format_trap(out, &o_len, print_format1,
+                                     print_tmpl1, pdu, transport);
 	    } else {
                 DEBUGMSGTL(( "snmptrapd", "v1 format\n"));
-                trunc = !realloc_format_plain_trap(&rbuf, &r_len, &o_len, 1,
-                                                   pdu, transport);
+                trunc = !realloc_format_plain_trap(&out->buf, &out->buf_len,
+                                                   &o_len, 1, pdu, transport);
 	    }
 	} else {
             if (print_format2) {
                 DEBUGMSGTL(( "snmptrapd", "print_format v2 = '%s'\n", print_format2));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             print_format2, pdu, transport);
+                trunc = !format_trap(out, &o_len, print_format2,
+                                     print_tmpl2, pdu, transport);
 	    } else {
                 DEBUGMSGTL(( "snmptrapd", "v2/3 format\n"));
-                trunc = !realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             PRINT_V23_NOTIFICATION_FORMAT,
-                                             pdu, transport);
+                trunc = !format_trap(out, &o_len,
+                                     PRINT_V23_NOTIFICATION_FORMAT,
+                                     print_v23_tmpl, pdu, transport);
 	    }
         }
     }
-    snmp_log(LOG_INFO, "%s%s", rbuf, (trunc?" [TRUNCATED]\n":""));
-    free(rbuf);
+    netsnmp_trapd_log(LOG_INFO, (char *) out->buf, trunc);
     return NETSNMPTRAPD_HANDLER_OK;
 }
 
 
-#define EXECUTE_FORMAT	"%B\n%b\n%V\n%v\n"
-
 /*
  *  Trap handler for invoking a suitable script
  */
@@ -803,14 +1005,23 @@ int   command_handler( netsnmp_pdu           *pdu,
                      "support for run_shell_command not available\n"));
     return NETSNMPTRAPD_HANDLER_FAIL;
 #else
-    u_char         *rbuf = NULL;
-    size_t          r_len = 64, o_len = 0;
+    netsnmp_trapd_buffer *out;
+    size_t          o_len = 0;
     int             oldquick;
 
     DEBUGMSGTL(( "snmptrapd", "command_handler\n"));
     DEBUGMSGTL(( "snmptrapd", "token = '%s'\n", handler->token));
     if (handler && handler->token && *handler->token) {
 	netsnmp_pdu    *v2_pdu = NULL;
+
+        /*
+	 * Format the trap and pass this string to the external command
+	 */
+        if ((out = netsnmp_trapd_output_buffer()) == NULL) {
+            snmp_log(LOG_ERR, "couldn't display trap -- malloc failed\n");
+            return NETSNMPTRAPD_HANDLER_FAIL;	/* Failed but keep going */
+        }
+
 	if (pdu->command == SNMP_MSG_TRAP)
 	    v2_pdu = convert_v1pdu_to_v2(pdu);
 	else
@@ -820,48 +1031,38 @@ int   command_handler( netsnmp_pdu           *pdu,
         netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID, 
                                NETSNMP_DS_LIB_QUICK_PRINT, 1);
 
-        /*
-	 * Format the trap and pass this string to the external command
-	 */
-        if ((rbuf = (u_char *) calloc(r_len, 1)) == NULL) {
-            snmp_log(LOG_ERR, "couldn't display trap -- malloc failed\n");
-            return NETSNMPTRAPD_HANDLER_FAIL;	/* Failed but keep going */
-        }
-
         /*
          *  If there's a format string registered for this trap, then use it.
          *  Otherwise use the standard execution format setting.
          */
         if (handler && handler->format && *handler->format) {
             DEBUGMSGTL(( "snmptrapd", "format = '%s'\n", handler->format));
-            realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             handler->format,
-                                             v2_pdu, transport);
+            format_trap(out, &o_len, handler->format, handler->format_tmpl,
+                        v2_pdu, transport);
         } else {
 	    if ( pdu->command == SNMP_MSG_TRAP && exec_format1 ) {
                 DEBUGMSGTL(( "snmptrapd", "exec v1 = '%s'\n", exec_format1));
-                realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             exec_format1, pdu, transport);
+                format_trap(out, &o_len, exec_format1, exec_tmpl1,
+                            pdu, transport);
 	    } else if ( pdu->command != SNMP_MSG_TRAP && exec_format2 ) {
                 DEBUGMSGTL(( "snmptrapd", "exec v2/3 = '%s'\n", exec_format2));
-                realloc_format_trap(&rbuf, &r_len, &o_len, 1,
-                                             exec_format2, pdu, transport);
+                format_trap(out, &o_len, exec_format2, exec_tmpl2,
+                            pdu, transport);
 	    } else {
                 DEBUGMSGTL(( "snmptrapd", "execute format\n"));
-                realloc_format_trap(&rbuf, &r_len, &o_len, 1, EXECUTE_FORMAT,
-                                             v2_pdu, transport);
+                format_trap(out, &o_len, EXECUTE_FORMAT, exec_std_tmpl,
+                            v2_pdu, transport);
             }
 	}
 
         /*
          *  and pass this formatted string to the command specified
          */
-        run_shell_command(handler->token, (char*)rbuf, NULL, NULL);   /* Not interested in output */
+        run_shell_command(handler->token, (char*)out->buf, NULL, NULL);   /* Not interested in output */
         netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID, 
                                NETSNMP_DS_LIB_QUICK_PRINT, oldquick);
         if (pdu->command == SNMP_MSG_TRAP)
             snmp_free_pdu(v2_pdu);
-        free(rbuf);
     }
     return NETSNMPTRAPD_HANDLER_OK;
 #endif /* !def USING_UTILITIES_EXECUTE_MODULE */
@@ -949,6 +1150,82 @@ int   notification_handler(netsnmp_pdu           *pdu,
  *
  *-----------------------------*/
 
+/*
+ * Runs the handlers for a notification, from where *pos says up to the
+ * end of the first 'lists' lists of handlers (or of all of them).
+ * With safe_only set, stops at the first handler that isn't thread safe,
+ * leaving *pos pointing at it, and returns 0.
+ *
+ * Returns NETSNMPTRAPD_HANDLER_FINISH if a handler ended the processing,
+ * NETSNMPTRAPD_HANDLER_OK otherwise.
+ */
+int
+netsnmp_trapd_run_handlers(netsnmp_pdu *pdu, netsnmp_transport *transport,
+                           oid *trapOid, int trapOidLen,
+                           netsnmp_trapd_position *pos, int lists,
+                           int safe_only)
+{
+    netsnmp_trapd_handler *traph;
+    int ret;
+
+    for( ; handlers[pos->list].descr &&
+             (lists == NETSNMPTRAPD_ALL_LISTS || pos->list < lists);
+         ++pos->list, pos->next = NULL ) {
+        if (pos->next) {
+            traph = pos->next;	/* carry on where we left off */
+        } else {
+            DEBUGMSGTL(("snmptrapd", "Running %s handlers\n",
+                        handlers[pos->list].descr));
+            if (NULL == handlers[pos->list].handler) /* specific */
+                traph = netsnmp_get_traphandler(trapOid, trapOidLen);
+            else
+                traph = *handlers[pos->list].handler;
+        }
+
+        for( ; traph; traph = traph->nexth) {
+            if (!netsnmp_trapd_check_auth(traph->authtypes))
+                continue; /* we continue on and skip this one */
+
+            if (safe_only &&
+                !(traph->flags & NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE)) {
+                pos->next = traph;
+                return 0;
+            }
+            ret = (*(traph->handler))(pdu, transport, traph);
+            if(NETSNMPTRAPD_HANDLER_FINISH == ret)
+                return NETSNMPTRAPD_HANDLER_FINISH;
+            if (ret == NETSNMPTRAPD_HANDLER_BREAK)
+                break; /* move on to next type */
+        } /* traph */
+    } /* handlers */
+    return NETSNMPTRAPD_HANDLER_OK;
+}
+
+/*
+ * Acknowledges an INFORM, once all its handlers have run.
+ */
+void
+netsnmp_trapd_respond(netsnmp_session *session, netsnmp_pdu *pdu)
+{
+    netsnmp_pdu *reply;
+
+    if (pdu->command != SNMP_MSG_INFORM)
+        return;
+    reply = snmp_clone_pdu(pdu);
+    if (!reply) {
+        snmp_log(LOG_ERR, "couldn't clone PDU for INFORM response\n");
+    } else {
+        reply->command = SNMP_MSG_RESPONSE;
+        reply->errstat = 0;
+        reply->errindex = 0;
+        if (!snmp_send(session, reply)) {
+            snmp_sess_perror("snmptrapd: Couldn't respond to inform pdu",
+                             session);
+            snmp_free_pdu(reply);
+        }
+    }
+}
+
 
 
 int
@@ -960,9 +1237,8 @@ snmp_input(int op, netsnmp_session *session,
     oid trapOid[MAX_OID_LEN+2] = {0};
     int trapOidLen;
     netsnmp_variable_list *vars;
-    netsnmp_trapd_handler *traph;
+    netsnmp_trapd_position pos;
     netsnmp_transport *transport = (netsnmp_transport *) magic;
-    int ret, idx;
 
     switch (op) {
     case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
@@ -1056,46 +1332,29 @@ t        *     d) any other global handlers
 	 *  This is particularly designed for authentication-related
 	 *     handlers, but can also be used elsewhere.
          *
+         *  With worker threads, the authorization is done here and
+         *     the rest is handed over to the workers.
+         *
          *  OK - Enough waffling, let's get to work.....
 	 */
 
-        for( idx = 0; handlers[idx].descr; ++idx ) {
-            DEBUGMSGTL(("snmptrapd", "Running %s handlers\n",
-                        handlers[idx].descr));
-            if (NULL == handlers[idx].handler) /* specific */
-                traph = netsnmp_get_traphandler(trapOid, trapOidLen);
-            else
-                traph = *handlers[idx].handler;
-
-            for( ; traph; traph = traph->nexth) {
-                if (!netsnmp_trapd_check_auth(traph->authtypes))
-                    continue; /* we continue on and skip this one */
-
-                ret = (*(traph->handler))(pdu, transport, traph);
-                if(NETSNMPTRAPD_HANDLER_FINISH == ret)
-                    return 1;
-                if (ret == NETSNMPTRAPD_HANDLER_BREAK)
-                    break; /* move on to next type */
-            } /* traph */
-        } /* handlers */
-
-
-	if (pdu->command == SNMP_MSG_INFORM) {
-	    netsnmp_pdu *reply = snmp_clone_pdu(pdu);
-	    if (!reply) {
-		snmp_log(LOG_ERR, "couldn't clone PDU for INFORM response\n");
-	    } else {
-		reply->command = SNMP_MSG_RESPONSE;
-		reply->errstat = 0;
-		reply->errindex = 0;
-		if (!snmp_send(session, reply)) {
-		    snmp_sess_perror("snmptrapd: Couldn't respond to inform pdu",
-                                    session);
-		    snmp_free_pdu(reply);
-		}
-	    }
-	}
+        pos.list = 0;
+        pos.next = NULL;
+        if (netsnmp_trapd_workers_running()) {
+            if (netsnmp_trapd_run_handlers(pdu, transport, trapOid,
+                                           trapOidLen, &pos, 1, 0) ==
+                NETSNMPTRAPD_HANDLER_FINISH)
+                return 1;
+            if (netsnmp_trapd_workers_dispatch(session, pdu, transport,
+                                               trapOid, trapOidLen, &pos))
+                return 1;
+        }
+        if (netsnmp_trapd_run_handlers(pdu, transport, trapOid, trapOidLen,
+                                       &pos, NETSNMPTRAPD_ALL_LISTS, 0) ==
+            NETSNMPTRAPD_HANDLER_FINISH)
+            return 1;
 
+        netsnmp_trapd_respond(session, pdu);
         break;
 
     case NETSNMP_CALLBACK_OP_TIMED_OUT:
@@ -1106,8 +1365,15 @@ t        *     d) any other global handlers
         snmp_log(LOG_ERR, "Send Failed: This shouldn't happen either!\n");
         break;
 
-    case NETSNMP_CALLBACK_OP_CONNECT:
     case NETSNMP_CALLBACK_OP_DISCONNECT:
+        /*
+         * the notifications still with the workers can no longer be
+         * answered over this connection
+         */
+        netsnmp_trapd_workers_cancel_session(session);
+        break;
+
+    case NETSNMP_CALLBACK_OP_CONNECT:
         /* Ignore silently */
         break;
 
@@ -10,6 +10,7 @@ typedef int (Netsnmp_Trap_Handler)(netsnmp_pdu           *pdu,
 
 #define NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE     0x1
 #define NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE 0x2
+#define NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE    0x4  /* may run on a worker */
 
 struct netsnmp_trapd_handler_s {
      oid  *trapoid;
@@ -26,6 +27,8 @@ struct netsnmp_trapd_handler_s {
              /* Doubly-linked list of traps with registered handlers */
      netsnmp_trapd_handler *prevt;
      netsnmp_trapd_handler *nextt;
+
+     struct netsnmp_trapd_format_s *format_tmpl;	/* format, compiled */
 };
 
 Netsnmp_Trap_Handler   syslog_handler;
@@ -52,6 +55,17 @@ extern char *print_format2;
 #define NETSNMPTRAPD_HANDLER_BREAK   3	/* Move to the next list */
 #define NETSNMPTRAPD_HANDLER_FINISH  4	/* No further processing */
 
+/*
+ * How far a notification has got through the lists of handlers, so that
+ * it can be handed from one thread to another part of the way through.
+ */
+typedef struct netsnmp_trapd_position_s {
+    int                    list;	/* the list being run */
+    netsnmp_trapd_handler *next;	/* next handler in it, or NULL */
+} netsnmp_trapd_position;
+
+#define NETSNMPTRAPD_ALL_LISTS       -1
+
 void snmptrapd_register_configs( void );
 netsnmp_trapd_handler *netsnmp_add_global_traphandler(int list, Netsnmp_Trap_Handler* handler);
 netsnmp_trapd_handler *netsnmp_add_default_traphandler(Netsnmp_Trap_Handler* handler);
@@ -64,5 +78,10 @@ void do_external(char *cmd, struct hostent *host,
             netsnmp_pdu *pdu, netsnmp_transport *transport);
 int snmp_input(int op, netsnmp_session *session,
            int reqid, netsnmp_pdu *pdu, void *magic);
+int netsnmp_trapd_run_handlers(netsnmp_pdu *pdu, netsnmp_transport *transport,
+                               oid *trapOid, int trapOidLen,
+                               netsnmp_trapd_position *pos, int lists,
+                               int safe_only);
+void netsnmp_trapd_respond(netsnmp_session *session, netsnmp_pdu *pdu);
 
 #endif                          /* SNMPTRAPD_HANDLERS_H */
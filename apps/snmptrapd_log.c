@@ -85,13 +85,40 @@ SOFTWARE.
 #endif
 
 #include <net-snmp/net-snmp-includes.h>
+#include "snmptrapd_handlers.h"
 #include "snmptrapd_log.h"
+#include "snmptrapd_workers.h"
 
 
 #ifndef BSD4_3
 #define BSD4_2
 #endif
 
+/*
+ * Looks up the name of the agent that sent a v1 trap, unless numeric
+ * addresses were asked for.  The lookup returns static data, so it is
+ * done under a lock and the name copied out for the worker threads.
+ */
+static const char *
+agent_host_name(netsnmp_pdu *pdu, char *name, size_t name_len)
+{
+    struct hostent *host;
+    const char     *found = NULL;
+
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_APP_NUMERIC_IP))
+        return NULL;
+
+    snmp_res_lock(MT_APPLICATION_ID, MT_APP_TRAPD_FORMAT);
+    host = netsnmp_gethostbyaddr((char *) pdu->agent_addr, 4, AF_INET);
+    if (host != NULL && host->h_name != NULL) {
+        strlcpy(name, host->h_name, name_len);
+        found = name;
+    }
+    snmp_res_unlock(MT_APPLICATION_ID, MT_APP_TRAPD_FORMAT);
+    return found;
+}
+
 /*
  * These flags mark undefined values in the options structure 
  */
@@ -108,10 +135,9 @@ typedef struct {
     int             left_justify;       /* if true, left justify this field */
     int             alt_format; /* if true, display in alternate format */
     int             leading_zeroes;     /* if true, display with leading zeroes */
+    const char     *separator;  /* between variables, if set by %V */
 } options_type;
 
-char            separator[32];
-
 /*
  * These symbols define the characters that the parser recognizes.
  * The rather odd choice of symbols comes from an attempt to avoid
@@ -328,6 +354,7 @@ init_options(options_type * options)
     options->left_justify = FALSE;
     options->alt_format = FALSE;
     options->leading_zeroes = FALSE;
+    options->separator = NULL;
     return;
 }
 
@@ -458,6 +485,9 @@ realloc_handle_time_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
     time_t          time_val;   /* the time value to output */
     unsigned long   time_ul;    /* u_long time/timeticks */
     struct tm      *parsed_time;        /* parsed version of current time */
+#ifdef HAVE_LOCALTIME_R
+    struct tm       parsed_buf;
+#endif
     char           *safe_bfr = NULL;
     char            fmt_cmd = options->cmd;     /* the format command to use */
 
@@ -517,11 +547,19 @@ realloc_handle_time_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
          * Handle other time fields.  
          */
 
+#ifdef HAVE_LOCALTIME_R
+        if (options->alt_format) {
+            parsed_time = gmtime_r(&time_val, &parsed_buf);
+        } else {
+            parsed_time = localtime_r(&time_val, &parsed_buf);
+        }
+#else
         if (options->alt_format) {
             parsed_time = gmtime(&time_val);
         } else {
             parsed_time = localtime(&time_val);
         }
+#endif
 
         switch (fmt_cmd) {
 
@@ -613,12 +651,13 @@ realloc_handle_ip_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
       */
 {
     struct in_addr *agent_inaddr = (struct in_addr *) pdu->agent_addr;
-    struct hostent *host = NULL;       /* corresponding host name */
+    const char     *host;              /* corresponding host name */
+    char            host_buf[256];
     char            fmt_cmd = options->cmd;     /* what we're formatting */
     u_char         *temp_buf = NULL;
     size_t          temp_buf_len = 64, temp_out_len = 0;
     char           *tstr;
-    unsigned int    oflags;
+    netsnmp_transport fmt_transport;    /* with the flags we format by */
 
     if ((temp_buf = (u_char*)calloc(temp_buf_len, 1)) == NULL) {
         return 0;
@@ -646,13 +685,10 @@ realloc_handle_ip_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
          * Try to resolve the agent_addr field as a hostname; fall back
          * to numerical address.  
          */
-        if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID, 
-                                    NETSNMP_DS_APP_NUMERIC_IP)) {
-            host = netsnmp_gethostbyaddr((char *) pdu->agent_addr, 4, AF_INET);
-        }
+        host = agent_host_name(pdu, host_buf, sizeof(host_buf));
         if (host != NULL) {
             if (!snmp_strcat(&temp_buf, &temp_buf_len, &temp_out_len, 1,
-                             (const u_char *)host->h_name)) {
+                             (const u_char *)host)) {
                 if (temp_buf != NULL) {
                     free(temp_buf);
                 }
@@ -674,11 +710,14 @@ realloc_handle_ip_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
          * Write the numerical transport information.  
          */
         if (transport != NULL && transport->f_fmtaddr != NULL) {
-            oflags = transport->flags;
-            transport->flags &= ~NETSNMP_TRANSPORT_FLAG_HOSTNAME;
-            tstr = transport->f_fmtaddr(transport, pdu->transport_data,
+            /*
+             * a copy, as other threads may be formatting with the same
+             * transport
+             */
+            fmt_transport = *transport;
+            fmt_transport.flags &= ~NETSNMP_TRANSPORT_FLAG_HOSTNAME;
+            tstr = transport->f_fmtaddr(&fmt_transport, pdu->transport_data,
                                         pdu->transport_data_length);
-            transport->flags = oflags;
           
             if (!tstr) goto noip;
             if (!snmp_strcat(&temp_buf, &temp_buf_len, &temp_out_len,
@@ -704,15 +743,18 @@ noip:
          *  into a hostname.  Or rather, have the transport-specific
          *  address formatting routine do this.
          * Otherwise falls back to the numeric address format.
+         * The host name lookup returns static data, so as for %A it is
+         * done under a lock; the formatted address is a copy.
          */
         if (transport != NULL && transport->f_fmtaddr != NULL) {
-            oflags = transport->flags;
+            fmt_transport = *transport;
             if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID, 
                                         NETSNMP_DS_APP_NUMERIC_IP))
-                transport->flags |= NETSNMP_TRANSPORT_FLAG_HOSTNAME;
-            tstr = transport->f_fmtaddr(transport, pdu->transport_data,
+                fmt_transport.flags |= NETSNMP_TRANSPORT_FLAG_HOSTNAME;
+            snmp_res_lock(MT_APPLICATION_ID, MT_APP_TRAPD_FORMAT);
+            tstr = transport->f_fmtaddr(&fmt_transport, pdu->transport_data,
                                         pdu->transport_data_length);
-            transport->flags = oflags;
+            snmp_res_unlock(MT_APPLICATION_ID, MT_APP_TRAPD_FORMAT);
           
             if (!tstr) goto nohost;
             if (!snmp_strcat(&temp_buf, &temp_buf_len, &temp_out_len,
@@ -838,7 +880,7 @@ realloc_handle_trap_fmt(u_char ** buf, size_t * buf_len, size_t * out_len,
     char            fmt_cmd = options->cmd;     /* what we're outputting */
     u_char         *temp_buf = NULL;
     size_t          tbuf_len = 64, tout_len = 0;
-    const char           *sep = separator;
+    const char           *sep = options->separator;
     const char           *default_sep = "\t";
     const char           *default_alt_sep = ", ";
 
@@ -1337,9 +1379,13 @@ realloc_format_plain_trap(u_char ** buf, size_t * buf_len,
 {
     time_t          now;        /* the current time */
     struct tm      *now_parsed; /* time in struct format */
+#ifdef HAVE_LOCALTIME_R
+    struct tm       now_buf;
+#endif
     char            safe_bfr[200];      /* holds other strings */
     struct in_addr *agent_inaddr = (struct in_addr *) pdu->agent_addr;
-    struct hostent *host = NULL;       /* host name */
+    const char     *host;              /* host name */
+    char            host_buf[256];
     netsnmp_variable_list *vars;        /* variables assoc with trap */
 
     if (buf == NULL) {
@@ -1352,7 +1398,11 @@ realloc_format_plain_trap(u_char ** buf, size_t * buf_len,
      * buffer of guaranteed length and then copy it to the output buffer.
      */
     time(&now);
+#ifdef HAVE_LOCALTIME_R
+    now_parsed = localtime_r(&now, &now_buf);
+#else
     now_parsed = localtime(&now);
+#endif
     sprintf(safe_bfr, "%.4d-%.2d-%.2d %.2d:%.2d:%.2d ",
             now_parsed->tm_year + 1900, now_parsed->tm_mon + 1,
             now_parsed->tm_mday, now_parsed->tm_hour,
@@ -1366,14 +1416,11 @@ realloc_format_plain_trap(u_char ** buf, size_t * buf_len,
     /*
      * Get info about the sender.  
      */
-    if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID, 
-                                NETSNMP_DS_APP_NUMERIC_IP)) {
-        host = netsnmp_gethostbyaddr((char *) pdu->agent_addr, 4, AF_INET);
-    }
-    if (host != (struct hostent *) NULL) {
+    host = agent_host_name(pdu, host_buf, sizeof(host_buf));
+    if (host != NULL) {
         if (!snmp_strcat
             (buf, buf_len, out_len, allow_realloc,
-             (const u_char *) host->h_name)) {
+             (const u_char *) host)) {
             return 0;
         }
         if (!snmp_strcat
@@ -1572,38 +1619,142 @@ realloc_format_plain_trap(u_char ** buf, size_t * buf_len,
 }
 
 
-int
-realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
-                    int allow_realloc, const char *format_str,
-                    netsnmp_pdu *pdu, netsnmp_transport *transport)
+/*
+ * A format string compiled by netsnmp_trapd_format_compile(): runs of
+ * literal text (with backslash escapes already interpreted) and format
+ * commands with their options, so that formatting a trap doesn't parse
+ * the format string again.
+ */
+typedef struct trapd_format_op_s {
+    options_type    options;    /* options.cmd is UNDEF_CMD for text */
+    char           *text;       /* the text, or the %V separator */
+    size_t          text_len;
+} trapd_format_op;
+
+struct netsnmp_trapd_format_s {
+    trapd_format_op *ops;
+    int             nops;
+    int             max_ops;
+};
+
+static trapd_format_op *
+format_add_op(netsnmp_trapd_format *fmt)
+{
+    trapd_format_op *ops;
+
+    if (fmt->nops == fmt->max_ops) {
+        ops = (trapd_format_op *) realloc(fmt->ops, (fmt->max_ops + 8) *
+                                          sizeof(trapd_format_op));
+        if (ops == NULL)
+            return NULL;
+        fmt->ops = ops;
+        fmt->max_ops += 8;
+    }
+    memset(&fmt->ops[fmt->nops], 0, sizeof(trapd_format_op));
+    return &fmt->ops[fmt->nops++];
+}
 
-     /*
-      * Function:
-      *    Format the trap information for display in a log. Place the results
-      *    in the specified buffer (truncating to the length of the buffer).
-      *    Returns the number of characters it put in the buffer.
-      *
-      * Input Parameters:
-      *    buf, buf_len, out_len, allow_realloc - standard relocatable
-      *                                           buffer parameters
-      *    format_str - specifies how to format the trap info
-      *    pdu        - the pdu information
-      *    transport  - the transport descriptor
-      */
+/*
+ * Moves the literal text collected so far into an op of its own.
+ */
+static int
+format_add_text(netsnmp_trapd_format *fmt, u_char ** text, size_t *text_len,
+                size_t *text_out_len)
 {
+    trapd_format_op *op;
+
+    if (*text_out_len == 0)
+        return 1;
+    if ((op = format_add_op(fmt)) == NULL)
+        return 0;
+    init_options(&op->options);
+    op->text = (char *) *text;
+    op->text_len = *text_out_len;
+    *text = NULL;
+    *text_len = *text_out_len = 0;
+    return 1;
+}
+
+static int
+format_add_cmd(netsnmp_trapd_format *fmt, u_char ** text, size_t *text_len,
+               size_t *text_out_len, options_type * options,
+               const char *sep)
+{
+    trapd_format_op *op;
+
+    if (!format_add_text(fmt, text, text_len, text_out_len) ||
+        (op = format_add_op(fmt)) == NULL)
+        return 0;
+    op->options = *options;
+    if (options->cmd == CHR_TRAP_VARS && *sep) {
+        if ((op->text = strdup(sep)) == NULL)
+            return 0;
+        op->text_len = strlen(sep);
+        op->options.separator = op->text;
+    }
+    return 1;
+}
+
+static int
+format_add_chr(u_char ** text, size_t *text_len, size_t *text_out_len,
+               char chr)
+{
+    if (*text == NULL || (*text_out_len + 1) >= *text_len) {
+        if (!snmp_realloc(text, text_len))
+            return 0;
+    }
+    *(*text + *text_out_len) = chr;
+    (*text_out_len)++;
+    *(*text + *text_out_len) = '\0';
+    return 1;
+}
+
+void
+netsnmp_trapd_format_free(netsnmp_trapd_format *fmt)
+{
+    int             i;
+
+    if (fmt == NULL)
+        return;
+    for (i = 0; i < fmt->nops; i++)
+        free(fmt->ops[i].text);
+    free(fmt->ops);
+    free(fmt);
+}
+
+/**
+ * Compiles a trap format string, as used by the format1/format2 and
+ * "format" directives and traphandle -F, for netsnmp_trapd_format_trap().
+ *
+ * @param format_str the format string
+ *
+ * @return the compiled format, to be released with
+ *         netsnmp_trapd_format_free(), or NULL if out of memory.
+ */
+netsnmp_trapd_format *
+netsnmp_trapd_format_compile(const char *format_str)
+{
+    netsnmp_trapd_format *fmt;
     unsigned long   fmt_idx = 0;        /* index into the format string */
     options_type    options;    /* formatting options */
     parse_state_type state = PARSE_NORMAL;      /* state of the parser */
     char            next_chr;   /* for speed */
     int             reset_options = TRUE;       /* reset opts on next NORMAL state */
-
-    if (buf == NULL) {
-        return 0;
-    }
-
-    memset(separator, 0, sizeof(separator));
+    char            sep[32];    /* the separator set by %V */
+    u_char         *text = NULL;        /* literal text not yet added */
+    size_t          text_len = 0, text_out_len = 0;
+
+    if (format_str == NULL)
+        return NULL;
+    fmt = SNMP_MALLOC_TYPEDEF(netsnmp_trapd_format);
+    if (fmt == NULL)
+        return NULL;
+
+    memset(sep, 0, sizeof(sep));
+    init_options(&options);
     /*
-     * Go until we reach the end of the format string:  
+     * The same state machine as ever, but adding text and commands to
+     * the compiled format rather than formatting a trap.
      */
     for (fmt_idx = 0; format_str[fmt_idx] != '\0'; fmt_idx++) {
         next_chr = format_str[fmt_idx];
@@ -1620,45 +1771,40 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
                 state = PARSE_BACKSLASH;
             } else if (next_chr == CHR_FMT_DELIM) {
                 state = PARSE_IN_FORMAT;
-            } else {
-                if ((*out_len + 1) >= *buf_len) {
-                    if (!(allow_realloc && snmp_realloc(buf, buf_len))) {
-                        return 0;
-                    }
-                }
-                *(*buf + *out_len) = next_chr;
-                (*out_len)++;
+            } else if (!format_add_chr(&text, &text_len, &text_out_len,
+                                       next_chr)) {
+                goto fail;
             }
             break;
 
         case PARSE_GET_SEPARATOR:
             /*
-             * Parse the separator character
+             * Parse the separator character, up to the next '%'
              * XXX - Possibly need to handle quoted strings ??
              */
-	    {   char *sep = separator;
+	    {   char *sepp = sep;
 		size_t i, j;
-		i = sizeof(separator);
+		i = sizeof(sep);
 		j = 0;
-		memset(separator, 0, i);
-		while (j < i && next_chr && next_chr != CHR_FMT_DELIM) {
+		memset(sep, 0, i);
+		while (j < i - 1 && next_chr && next_chr != CHR_FMT_DELIM) {
 		    if (next_chr == '\\') {
+			next_chr = format_str[++fmt_idx];
+			if (!next_chr)
+			    break;
 			/*
-			 * Handle backslash interpretation
-			 * Print to "separator" string rather than the output buffer
-			 *    (a bit of a hack, but it should work!)
+			 * a separator too long for the buffer is cut short
 			 */
-			next_chr = format_str[++fmt_idx];
-			if (!realloc_handle_backslash
-			    ((u_char **)&sep, &i, &j, 0, next_chr)) {
-			    return 0;
-			}
+			realloc_handle_backslash((u_char **)&sepp, &i, &j, 0,
+                                                 next_chr);
 		    } else {
-			separator[j++] = next_chr;
+			sep[j++] = next_chr;
 		    }
 		    next_chr = format_str[++fmt_idx];
 		}
 	    }
+            if (!format_str[fmt_idx])
+                goto done;
             state = PARSE_IN_FORMAT;
             break;
 
@@ -1666,10 +1812,11 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
             /*
              * Found a backslash.  
              */
-            if (!realloc_handle_backslash
-                (buf, buf_len, out_len, allow_realloc, next_chr)) {
-                return 0;
-            }
+            if (text == NULL && !snmp_realloc(&text, &text_len))
+                goto fail;
+            if (!realloc_handle_backslash(&text, &text_len, &text_out_len, 1,
+                                          next_chr))
+                goto fail;
             state = PARSE_NORMAL;
             break;
 
@@ -1694,20 +1841,14 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
                 state = PARSE_GET_WIDTH;
             } else if (is_fmt_cmd(next_chr)) {
                 options.cmd = next_chr;
-                if (!realloc_dispatch_format_cmd
-                    (buf, buf_len, out_len, allow_realloc, &options, pdu,
-                     transport)) {
-                    return 0;
-                }
+                if (!format_add_cmd(fmt, &text, &text_len, &text_out_len,
+                                    &options, sep))
+                    goto fail;
                 state = PARSE_NORMAL;
             } else {
-                if ((*out_len + 1) >= *buf_len) {
-                    if (!(allow_realloc && snmp_realloc(buf, buf_len))) {
-                        return 0;
-                    }
-                }
-                *(*buf + *out_len) = next_chr;
-                (*out_len)++;
+                if (!format_add_chr(&text, &text_len, &text_out_len,
+                                    next_chr))
+                    goto fail;
                 state = PARSE_NORMAL;
             }
             break;
@@ -1725,20 +1866,14 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
                 state = PARSE_GET_PRECISION;
             } else if (is_fmt_cmd(next_chr)) {
                 options.cmd = next_chr;
-                if (!realloc_dispatch_format_cmd
-                    (buf, buf_len, out_len, allow_realloc, &options, pdu,
-                     transport)) {
-                    return 0;
-                }
+                if (!format_add_cmd(fmt, &text, &text_len, &text_out_len,
+                                    &options, sep))
+                    goto fail;
                 state = PARSE_NORMAL;
             } else {
-                if ((*out_len + 1) >= *buf_len) {
-                    if (!(allow_realloc && snmp_realloc(buf, buf_len))) {
-                        return 0;
-                    }
-                }
-                *(*buf + *out_len) = next_chr;
-                (*out_len)++;
+                if (!format_add_chr(&text, &text_len, &text_out_len,
+                                    next_chr))
+                    goto fail;
                 state = PARSE_NORMAL;
             }
             break;
@@ -1763,20 +1898,14 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
                     (options.width < (size_t)options.precision)) {
                     options.width = (size_t)options.precision;
                 }
-                if (!realloc_dispatch_format_cmd
-                    (buf, buf_len, out_len, allow_realloc, &options, pdu,
-                     transport)) {
-                    return 0;
-                }
+                if (!format_add_cmd(fmt, &text, &text_len, &text_out_len,
+                                    &options, sep))
+                    goto fail;
                 state = PARSE_NORMAL;
             } else {
-                if ((*out_len + 1) >= *buf_len) {
-                    if (!(allow_realloc && snmp_realloc(buf, buf_len))) {
-                        return 0;
-                    }
-                }
-                *(*buf + *out_len) = next_chr;
-                (*out_len)++;
+                if (!format_add_chr(&text, &text_len, &text_out_len,
+                                    next_chr))
+                    goto fail;
                 state = PARSE_NORMAL;
             }
             break;
@@ -1786,17 +1915,195 @@ realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
              * Unknown state.  
              */
             reset_options = TRUE;
-            if ((*out_len + 1) >= *buf_len) {
+            if (!format_add_chr(&text, &text_len, &text_out_len, next_chr))
+                goto fail;
+            state = PARSE_NORMAL;
+        }
+    }
+
+  done:
+    if (!format_add_text(fmt, &text, &text_len, &text_out_len))
+        goto fail;
+    return fmt;
+
+  fail:
+    free(text);
+    netsnmp_trapd_format_free(fmt);
+    return NULL;
+}
+
+
+int
+netsnmp_trapd_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
+                          int allow_realloc, const netsnmp_trapd_format *fmt,
+                          netsnmp_pdu *pdu, netsnmp_transport *transport)
+
+     /*
+      * Function:
+      *    Format the trap information for display in a log, following a
+      *    compiled format string.  Place the results in the specified
+      *    buffer (truncating to the length of the buffer).
+      *    Returns 1 if the output was completed, 0 if it was truncated.
+      *
+      * Input Parameters:
+      *    buf, buf_len, out_len, allow_realloc - standard relocatable
+      *                                           buffer parameters
+      *    fmt        - the format, from netsnmp_trapd_format_compile()
+      *    pdu        - the pdu information
+      *    transport  - the transport descriptor
+      */
+{
+    const trapd_format_op *op, *end;
+    options_type    options;
+
+    if (buf == NULL || fmt == NULL) {
+        return 0;
+    }
+
+    for (op = fmt->ops, end = fmt->ops + fmt->nops; op < end; op++) {
+        if (op->options.cmd == UNDEF_CMD) {
+            while ((*out_len + op->text_len) >= *buf_len) {
                 if (!(allow_realloc && snmp_realloc(buf, buf_len))) {
                     return 0;
                 }
             }
-            *(*buf + *out_len) = next_chr;
-            (*out_len)++;
-            state = PARSE_NORMAL;
+            memcpy(*buf + *out_len, op->text, op->text_len);
+            *out_len += op->text_len;
+        } else {
+            /*
+             * the handlers may change the options they are given
+             */
+            options = op->options;
+            if (!realloc_dispatch_format_cmd(buf, buf_len, out_len,
+                                             allow_realloc, &options, pdu,
+                                             transport)) {
+                return 0;
+            }
         }
     }
 
+    if (*out_len >= *buf_len &&
+        !(allow_realloc && snmp_realloc(buf, buf_len))) {
+        return 0;
+    }
     *(*buf + *out_len) = '\0';
     return 1;
 }
+
+
+int
+realloc_format_trap(u_char ** buf, size_t * buf_len, size_t * out_len,
+                    int allow_realloc, const char *format_str,
+                    netsnmp_pdu *pdu, netsnmp_transport *transport)
+
+     /*
+      * Function:
+      *    Format the trap information for display in a log. Place the results
+      *    in the specified buffer (truncating to the length of the buffer).
+      *    Returns the number of characters it put in the buffer.
+      *    Format strings that are used more than once are best compiled
+      *    with netsnmp_trapd_format_compile() instead.
+      *
+      * Input Parameters:
+      *    buf, buf_len, out_len, allow_realloc - standard relocatable
+      *                                           buffer parameters
+      *    format_str - specifies how to format the trap info
+      *    pdu        - the pdu information
+      *    transport  - the transport descriptor
+      */
+{
+    netsnmp_trapd_format *fmt;
+    int             rc;
+
+    if (buf == NULL) {
+        return 0;
+    }
+    if ((fmt = netsnmp_trapd_format_compile(format_str)) == NULL) {
+        return 0;
+    }
+    rc = netsnmp_trapd_format_trap(buf, buf_len, out_len, allow_realloc,
+                                   fmt, pdu, transport);
+    netsnmp_trapd_format_free(fmt);
+    return rc;
+}
+
+
+/*
+ * The buffer trap handlers format into, one per thread.  It is kept from
+ * one trap to the next, so it usually starts out large enough already;
+ * one grown beyond TRAPD_OUTPUT_KEEP is released after use.
+ */
+#define TRAPD_OUTPUT_INITIAL 256
+#define TRAPD_OUTPUT_KEEP    65536
+
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+
+static pthread_key_t output_key;
+static pthread_once_t output_once = PTHREAD_ONCE_INIT;
+
+static void
+free_output_buffer(void *data)
+{
+    netsnmp_trapd_buffer *out = (netsnmp_trapd_buffer *) data;
+
+    if (out) {
+        free(out->buf);
+        free(out);
+    }
+}
+
+static void
+_output_key_create(void)
+{
+    pthread_key_create(&output_key, free_output_buffer);
+}
+
+static netsnmp_trapd_buffer *
+get_output_buffer(void)
+{
+    netsnmp_trapd_buffer *out;
+
+    pthread_once(&output_once, _output_key_create);
+    out = (netsnmp_trapd_buffer *) pthread_getspecific(output_key);
+    if (out == NULL) {
+        out = SNMP_MALLOC_TYPEDEF(netsnmp_trapd_buffer);
+        if (out != NULL)
+            pthread_setspecific(output_key, out);
+    }
+    return out;
+}
+#else
+static netsnmp_trapd_buffer output_buffer;
+
+static netsnmp_trapd_buffer *
+get_output_buffer(void)
+{
+    return &output_buffer;
+}
+#endif
+
+/**
+ * Returns the calling thread's buffer for formatting a trap into, empty
+ * (but not necessarily NUL terminated), or NULL if out of memory.
+ */
+netsnmp_trapd_buffer *
+netsnmp_trapd_output_buffer(void)
+{
+    netsnmp_trapd_buffer *out = get_output_buffer();
+
+    if (out == NULL)
+        return NULL;
+    if (out->buf_len > TRAPD_OUTPUT_KEEP) {
+        SNMP_FREE(out->buf);
+        out->buf_len = 0;
+    }
+    if (out->buf == NULL) {
+        out->buf = (u_char *) malloc(TRAPD_OUTPUT_INITIAL);
+        if (out->buf == NULL)
+            return NULL;
+        out->buf_len = TRAPD_OUTPUT_INITIAL;
+    }
+    out->buf[0] = '\0';
+    return out;
+}
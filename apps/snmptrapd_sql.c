@@ -9,6 +9,10 @@
  * This file implements a handler for snmptrapd which will cache incoming
  * traps and then write them to a MySQL database.
  *
+ * Queued traps are written together, in one transaction, with INSERTs of
+ * up to sqlBatchSize rows each.  In builds configured with
+ * --enable-reentrant, sqlWriterThread moves the writing to a background
+ * thread, so that a slow database doesn't hold up receiving traps.
  */
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-features.h>
@@ -49,6 +53,12 @@
 #if HAVE_NETDB_H
 #include <netdb.h>
 #endif
+#include <stdarg.h>
+#include <errno.h>
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <signal.h>
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
@@ -58,6 +68,21 @@
 
 netsnmp_feature_require(container_fifo)
 
+/*
+ * prepared statements are kept for INSERTs of 1, 2, 4, ... rows, up to
+ * 1 << (SQL_BATCH_LEVELS - 1)
+ */
+#define SQL_BATCH_LEVELS   10
+#define SQL_BATCH_MAX_ROWS (1 << (SQL_BATCH_LEVELS - 1))
+
+struct sql_buf_t;
+
+/** list of traps, in order of arrival */
+typedef struct sql_buf_list_t {
+    struct sql_buf_t *head, *tail;
+    u_int        count;
+} sql_buf_list;
+
 /*
  * define a structure to hold all the file globals
  */
@@ -72,11 +97,21 @@ typedef struct netsnmp_sql_globals_t {
     MYSQL       *conn;            /* connection */
     u_char       connected;       /* connected flag */
     const char  *groups[3];
-    MYSQL_STMT  *trap_stmt, *vb_stmt; /* prepared statements */
+    MYSQL_STMT  *trap_stmt[SQL_BATCH_LEVELS]; /* prepared statements, */
+    MYSQL_STMT  *vb_stmt[SQL_BATCH_LEVELS];   /* by log2 of rows */
     u_int        alarm_id;        /* id of periodic save alarm */
-    netsnmp_container *queue;     /* container; traps pending database write */
+    sql_buf_list queue;           /* traps pending database write */
     u_int        queue_max;       /* auto save queue when it gets this big */
     int          queue_interval;  /* auto save every N seconds */
+    u_int        batch_max;       /* most rows in one INSERT */
+    u_int        trap_batch_max;  /* most notification rows in one INSERT */
+    int          max_delay;       /* auto save every N ms instead */
+    u_int        backlog_max;     /* traps kept while the database is down */
+    u_char       use_writer;      /* write from a background thread */
+    u_char       failing;         /* keeping traps until the database is back */
+    u_char       exiting;         /* last save; don't keep anything */
+    u_int        id_step;         /* auto_increment_increment of the server */
+    MYSQL_BIND  *tbinds, *vbinds; /* bind structures for batch_max rows */
 } netsnmp_sql_globals;
 
 static netsnmp_sql_globals _sql = {
@@ -90,12 +125,22 @@ static netsnmp_sql_globals _sql = {
     NULL,                  /* connection */
     0,                     /* connected */
     { "client", "snmptrapd", NULL },  /* groups to read from .my.cnf */
-    NULL,                  /* trap_stmt */
-    NULL,                  /* vb_stmt */
+    { NULL },              /* trap_stmt */
+    { NULL },              /* vb_stmt */
     0,                     /* alarm_id */
-    NULL,                  /* queue */
+    { NULL, NULL, 0 },     /* queue */
     1,                     /* queue_max */
-    -1                     /* queue_interval */
+    -1,                    /* queue_interval */
+    1,                     /* batch_max */
+    1,                     /* trap_batch_max */
+    0,                     /* max_delay */
+    0,                     /* backlog_max */
+    0,                     /* use_writer */
+    0,                     /* failing */
+    0,                     /* exiting */
+    1,                     /* id_step */
+    NULL,                  /* tbinds */
+    NULL                   /* vbinds */
 };
 
 /*
@@ -106,10 +151,9 @@ static netsnmp_sql_globals _sql = {
 /*
  * We will be using prepared statements for performance reasons. This
  * requires a sql bind structure for each cell to be inserted in the
- * database. We will be using 2 global static structures to bind to,
- * and a netsnmp container to store the necessary data until it is
- * written to the database. Fixed size buffers are also used to
- * simplify memory management.
+ * database. We will be using 2 global static structures as templates,
+ * copied for each row of an INSERT, and a list of buffers to store the
+ * necessary data until it is written to the database.
  */
 /** enums for the trap fields to be bound */
 enum{
@@ -189,14 +233,27 @@ typedef struct sql_buf_t {
     netsnmp_container *varbinds;
 
     char       logged;
+    my_bool    no_v3;
+
+    uint32_t   trap_id;               /* once the trap row is inserted */
+    struct sql_buf_t *next;           /* in the queue */
 } sql_buf;
 
 /*
- * static bind structures, plus 2 static buffers to bind to.
+ * static bind structures used as templates; _no_v3 marks the nullable
+ * columns, which are bound to the no_v3 field of each buffer.
  */
 static MYSQL_BIND _tbind[TBIND_MAX], _vbind[VBIND_MAX];
 static my_bool    _no_v3;
 
+static const char _trap_insert[] = "INSERT INTO notifications "
+    "(date_time, host, auth, type, version, request_id, snmpTrapOID, transport, security_model, v3msgid, v3security_level, v3context_name, v3context_engine, v3security_name, v3security_engine) "
+    "VALUES";
+static const char _trap_row[] = "(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)";
+static const char _vb_insert[] = "INSERT INTO varbinds "
+    "(trap_id, oid, type, value) VALUES";
+static const char _vb_row[] = "(?,?,?,?)";
+
 static void _sql_process_queue(u_int dontcare, void *meeither);
 
 /*
@@ -220,6 +277,55 @@ _parse_interval_fmt(const char *token, char *cptr)
                 _sql.queue_interval));
 }
 
+/*
+ * parse the sqlBatchSize configuration token
+ */
+static void
+_parse_batch_fmt(const char *token, char *cptr)
+{
+    int batch = atoi(cptr);
+
+    if (batch < 1 || batch > SQL_BATCH_MAX_ROWS) {
+        netsnmp_config_error("%s must be between 1 and %d", token,
+                             SQL_BATCH_MAX_ROWS);
+        return;
+    }
+    _sql.batch_max = batch;
+    DEBUGMSGTL(("sql:queue","batch size now %d rows\n", _sql.batch_max));
+}
+
+/*
+ * parse the sqlMaxDelay configuration token
+ */
+static void
+_parse_delay_fmt(const char *token, char *cptr)
+{
+    _sql.max_delay = atoi(cptr);
+    DEBUGMSGTL(("sql:queue","max delay now %d ms\n", _sql.max_delay));
+}
+
+/*
+ * parse the sqlMaxBacklog configuration token
+ */
+static void
+_parse_backlog_fmt(const char *token, char *cptr)
+{
+    _sql.backlog_max = atoi(cptr);
+    DEBUGMSGTL(("sql:queue","backlog max now %d\n", _sql.backlog_max));
+}
+
+/*
+ * parse the sqlWriterThread configuration token
+ */
+static void
+_parse_writer_fmt(const char *token, char *cptr)
+{
+    int writer = netsnmp_ds_parse_boolean(cptr);
+
+    if (writer >= 0)
+        _sql.use_writer = writer;
+}
+
 /*
  * register sql related configuration tokens
  */
@@ -230,26 +336,71 @@ snmptrapd_register_sql_configs( void )
                             _parse_queue_fmt, NULL, "integer");
     register_config_handler("snmptrapd", "sqlSaveInterval",
                             _parse_interval_fmt, NULL, "seconds");
+    register_config_handler("snmptrapd", "sqlBatchSize",
+                            _parse_batch_fmt, NULL, "rows");
+    register_config_handler("snmptrapd", "sqlMaxDelay",
+                            _parse_delay_fmt, NULL, "milliseconds");
+    register_config_handler("snmptrapd", "sqlMaxBacklog",
+                            _parse_backlog_fmt, NULL, "integer");
+    register_config_handler("snmptrapd", "sqlWriterThread",
+                            _parse_writer_fmt, NULL, "(1|yes|true|0|no|false)");
+}
+
+/*
+ * Errors met by the writer thread are kept, to be logged by the main
+ * thread along with the traps that were being written.
+ */
+static int     _sql_writer_running;
+static u_char *_sql_reports;
+static size_t  _sql_reports_size, _sql_reports_len;
+
+static void
+_sql_report(const char *format, ...)
+{
+    char    msg[512];
+    va_list ap;
+
+    va_start(ap, format);
+    vsnprintf(msg, sizeof(msg), format, ap);
+    va_end(ap);
+    msg[sizeof(msg) - 1] = '\0';
+
+    if (!_sql_writer_running) {
+        snmp_log(LOG_ERR, "%s", msg);
+        return;
+    }
+    (void) snmp_strcat(&_sql_reports, &_sql_reports_size, &_sql_reports_len,
+                       1, (const u_char *) msg);
 }
 
 static void
 netsnmp_sql_disconnected(void)
 {
+    int i;
+
     DEBUGMSGTL(("sql:connection","disconnected\n"));
 
     _sql.connected = 0;
 
     /** release prepared statements */
-    if (_sql.trap_stmt) {
-        mysql_stmt_close(_sql.trap_stmt);
-        _sql.trap_stmt = NULL;
-    }
-    if (_sql.vb_stmt) {
-        mysql_stmt_close(_sql.vb_stmt);
-        _sql.vb_stmt = NULL;
+    for (i = 0; i < SQL_BATCH_LEVELS; i++) {
+        if (_sql.trap_stmt[i]) {
+            mysql_stmt_close(_sql.trap_stmt[i]);
+            _sql.trap_stmt[i] = NULL;
+        }
+        if (_sql.vb_stmt[i]) {
+            mysql_stmt_close(_sql.vb_stmt[i]);
+            _sql.vb_stmt[i] = NULL;
+        }
     }
 }
 
+/*
+ * errors after which the connection has to be set up again
+ */
+#define SQL_CONNECTION_LOST(err) \
+    (CR_SERVER_GONE_ERROR == (err) || CR_SERVER_LOST == (err))
+
 /*
  * convenience function to log mysql errors
  */
@@ -257,17 +408,17 @@ static void
 netsnmp_sql_error(const char *message)
 {
     u_int err = mysql_errno(_sql.conn);
-    snmp_log(LOG_ERR, "%s\n", message);
+    _sql_report("%s\n", message);
     if (_sql.conn != NULL) {
 #if MYSQL_VERSION_ID >= 40101
-        snmp_log(LOG_ERR, "Error %u (%s): %s\n",
-                 err, mysql_sqlstate(_sql.conn), mysql_error(_sql.conn));
+        _sql_report("Error %u (%s): %s\n",
+                    err, mysql_sqlstate(_sql.conn), mysql_error(_sql.conn));
 #else
-        snmp(LOG_ERR, "Error %u: %s\n",
-             mysql_errno(_sql.conn), mysql_error(_sql.conn));
+        _sql_report("Error %u: %s\n",
+                    mysql_errno(_sql.conn), mysql_error(_sql.conn));
 #endif
     }
-    if (CR_SERVER_GONE_ERROR == err)
+    if (SQL_CONNECTION_LOST(err))
         netsnmp_sql_disconnected();
 }
 
@@ -279,17 +430,20 @@ netsnmp_sql_stmt_error (MYSQL_STMT *stmt, const char *message)
 {
     u_int err = mysql_errno(_sql.conn);
 
-    snmp_log(LOG_ERR, "%s\n", message);
+    _sql_report("%s\n", message);
     if (stmt) {
-        snmp_log(LOG_ERR, "SQL Error %u (%s): %s\n",
-                 mysql_stmt_errno(stmt), mysql_stmt_sqlstate(stmt),
-                 mysql_stmt_error(stmt));
+        err = mysql_stmt_errno(stmt);
+        _sql_report("SQL Error %u (%s): %s\n",
+                    mysql_stmt_errno(stmt), mysql_stmt_sqlstate(stmt),
+                    mysql_stmt_error(stmt));
     }
     
-    if (CR_SERVER_GONE_ERROR == err)
+    if (SQL_CONNECTION_LOST(err))
         netsnmp_sql_disconnected();
 }
 
+static void _sql_writer_stop(void);
+
 /*
  * sql cleanup function, called at exit
  */
@@ -303,20 +457,13 @@ netsnmp_mysql_cleanup(void)
         snmp_alarm_unregister(_sql.alarm_id);
 
     /** save any queued traps */
-    if (CONTAINER_SIZE(_sql.queue))
+    _sql.exiting = 1;
+    if (_sql.queue.count)
         _sql_process_queue(0,NULL);
+    _sql_writer_stop();
 
-    CONTAINER_FREE(_sql.queue);
-    _sql.queue = NULL;
-
-    if (_sql.trap_stmt) {
-        mysql_stmt_close(_sql.trap_stmt);
-        _sql.trap_stmt = NULL;
-    }
-    if (_sql.vb_stmt) {
-        mysql_stmt_close(_sql.vb_stmt);
-        _sql.vb_stmt = NULL;
-    }
+    SNMP_FREE(_sql.tbinds);
+    SNMP_FREE(_sql.vbinds);
     
     /** disconnect from server */
     netsnmp_sql_disconnected();
@@ -357,17 +504,77 @@ netsnmp_mysql_bind(const char *text, size_t text_size, MYSQL_STMT **stmt,
     return 0;
 }
 
+/*
+ * get the prepared statement inserting 1 << level rows, preparing it
+ * the first time it is needed
+ */
+static MYSQL_STMT *
+_sql_stmt(MYSQL_STMT **cache, const char *insert, const char *row,
+          int level)
+{
+    size_t insert_len = strlen(insert), row_len = strlen(row);
+    size_t rows = 1 << level, i;
+    char  *text, *cp;
+
+    if (cache[level])
+        return cache[level];
+
+    text = (char *) malloc(insert_len + rows * (row_len + 1));
+    if (NULL == text) {
+        _sql_report("malloc failed for a %d row INSERT\n", (int) rows);
+        return NULL;
+    }
+    memcpy(text, insert, insert_len);
+    cp = text + insert_len;
+    for (i = 0; i < rows; i++) {
+        if (i)
+            *cp++ = ',';
+        memcpy(cp, row, row_len);
+        cp += row_len;
+    }
+    *cp = '\0';
+
+    DEBUGMSGTL(("sql:connection","preparing %d row insert\n", (int) rows));
+    (void) netsnmp_mysql_bind(text, cp - text, &cache[level], _tbind);
+    free(text);
+    return cache[level];
+}
+
+/*
+ * run a query returning a single number, e.g. the value of a server
+ * variable
+ *
+ * return 0 on success, anything else is an error
+ */
+static int
+_sql_server_var(const char *query, int *value)
+{
+    MYSQL_RES *res;
+    MYSQL_ROW  row;
+    int        rc = -1;
+
+    if (mysql_query(_sql.conn, query) != 0)
+        return -1;
+    res = mysql_store_result(_sql.conn);
+    if (NULL == res)
+        return -1;
+    row = mysql_fetch_row(res);
+    if (row && row[0]) {
+        *value = atoi(row[0]);
+        rc = 0;
+    }
+    mysql_free_result(res);
+    return rc;
+}
+
 /*
  * connect to the database and do initial setup
  */
 static int
 netsnmp_mysql_connect(void)
 {
-    char trap_stmt[] = "INSERT INTO notifications "
-        "(date_time, host, auth, type, version, request_id, snmpTrapOID, transport, security_model, v3msgid, v3security_level, v3context_name, v3context_engine, v3security_name, v3security_engine) "
-        "VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)";
-    char vb_stmt[] = "INSERT INTO varbinds "
-        "(trap_id, oid, type, value) VALUES (?,?,?,?)";
+    static int warned;
+    int        value;
 
     /** initialize connection handler */
     if (_sql.connected)
@@ -390,20 +597,46 @@ netsnmp_mysql_connect(void)
         goto err;
     }
 
-    netsnmp_assert((_sql.trap_stmt == NULL) && (_sql.vb_stmt == NULL));
+    netsnmp_assert((_sql.trap_stmt[0] == NULL) && (_sql.vb_stmt[0] == NULL));
 
-    /** prepared statement for inserts */
-    if (0 != netsnmp_mysql_bind(trap_stmt,sizeof(trap_stmt), &_sql.trap_stmt,
-                                _tbind))
+    /** prepared statements for single row inserts; the others on demand */
+    if (NULL == _sql_stmt(_sql.trap_stmt, _trap_insert, _trap_row, 0))
         goto err;
 
-    if (0 != netsnmp_mysql_bind(vb_stmt,sizeof(vb_stmt),&_sql.vb_stmt,
-                                _vbind)) {
-        mysql_stmt_close(_sql.trap_stmt);
-        _sql.trap_stmt = NULL;
+    if (NULL == _sql_stmt(_sql.vb_stmt, _vb_insert, _vb_row, 0)) {
+        mysql_stmt_close(_sql.trap_stmt[0]);
+        _sql.trap_stmt[0] = NULL;
         goto err;
     }
 
+    /*
+     * the ids of the rows of a multi-row insert are this far apart
+     */
+    _sql.id_step = 1;
+    if (_sql_server_var("SELECT @@auto_increment_increment", &value) == 0 &&
+        value > 0)
+        _sql.id_step = value;
+
+    /*
+     * unless InnoDB hands out the ids of a multi-row insert in one go
+     * (innodb_autoinc_lock_mode 0 or 1), they need not be consecutive
+     * and those of the notifications could not be told, so those are
+     * inserted one row at a time.  Without InnoDB there is no such
+     * variable, and the table is locked for the insert.
+     */
+    _sql.trap_batch_max = _sql.batch_max;
+    if (_sql.batch_max > 1 &&
+        _sql_server_var("SELECT @@innodb_autoinc_lock_mode", &value) == 0 &&
+        value != 0 && value != 1) {
+        _sql.trap_batch_max = 1;
+        if (!warned) {
+            _sql_report("innodb_autoinc_lock_mode is %d: "
+                        "notifications are inserted one row at a time\n",
+                        value);
+            warned = 1;
+        }
+    }
+
     return 0;
 
   err:
@@ -431,13 +664,26 @@ netsnmp_mysql_init(void)
         return 0;
     }
 
-    /** create queue for storing traps til they are written to the db */
-    _sql.queue = netsnmp_container_find("fifo");
-    if (NULL == _sql.queue) {
-        snmp_log(LOG_ERR, "Could not allocate sql buf container\n");
+    /** bind structures for the rows of a batch */
+    _sql.tbinds = (MYSQL_BIND *) calloc(_sql.batch_max * TBIND_MAX,
+                                        sizeof(MYSQL_BIND));
+    _sql.vbinds = (MYSQL_BIND *) calloc(_sql.batch_max * VBIND_MAX,
+                                        sizeof(MYSQL_BIND));
+    if ((NULL == _sql.tbinds) || (NULL == _sql.vbinds)) {
+        snmp_log(LOG_ERR, "Could not allocate sql bind structures\n");
+        SNMP_FREE(_sql.tbinds);
+        SNMP_FREE(_sql.vbinds);
         return -1;
     }
 
+#if !defined(NETSNMP_REENTRANT) || !defined(HAVE_PTHREAD_H)
+    if (_sql.use_writer) {
+        snmp_log(LOG_WARNING, "sqlWriterThread requires a build configured "
+                 "with --enable-reentrant; ignored\n");
+        _sql.use_writer = 0;
+    }
+#endif
+
 #ifdef HAVE_BROKEN_LIBMYSQLCLIENT
     my_init();
 #else
@@ -547,10 +793,19 @@ netsnmp_mysql_init(void)
     (void) netsnmp_mysql_connect();
 
     /** register periodic queue save */
-    _sql.alarm_id = snmp_alarm_register(_sql.queue_interval, /* seconds */
-                                        1,                   /* repeat */
-                                        _sql_process_queue,  /* function */
-                                        NULL);               /* client args */
+    if (_sql.max_delay > 0) {
+        struct timeval delay;
+
+        delay.tv_sec = _sql.max_delay / 1000;
+        delay.tv_usec = (_sql.max_delay % 1000) * 1000;
+        _sql.alarm_id = snmp_alarm_register_hr(delay, SA_REPEAT,
+                                               _sql_process_queue, NULL);
+    } else {
+        _sql.alarm_id = snmp_alarm_register(_sql.queue_interval, /* seconds */
+                                            1,                   /* repeat */
+                                            _sql_process_queue,  /* function */
+                                            NULL);               /* client args */
+    }
 
     /** add handler */
     traph = netsnmp_add_global_traphandler(NETSNMPTRAPD_PRE_HANDLER,
@@ -696,6 +951,39 @@ _sql_buf_get(void)
     return sqlb;
 }
 
+/*
+ * add a buffer to the end of a list
+ */
+static void
+_sql_queue_append(sql_buf_list *list, sql_buf *sqlb)
+{
+    sqlb->next = NULL;
+    if (list->tail)
+        list->tail->next = sqlb;
+    else
+        list->head = sqlb;
+    list->tail = sqlb;
+    list->count++;
+}
+
+/*
+ * take the buffer at the front of a list
+ */
+static sql_buf *
+_sql_queue_pop(sql_buf_list *list)
+{
+    sql_buf *sqlb = list->head;
+
+    if (sqlb) {
+        list->head = sqlb->next;
+        if (NULL == list->head)
+            list->tail = NULL;
+        list->count--;
+        sqlb->next = NULL;
+    }
+    return sqlb;
+}
+
 /*
  * save info from incoming trap
  *
@@ -907,7 +1195,7 @@ mysql_handler(netsnmp_pdu           *pdu,
               netsnmp_trapd_handler *handler)
 {
     sql_buf     *sqlb;
-    int          old_format, rc;
+    int          old_format;
 
     DEBUGMSGTL(("sql:handler", "called\n"));
 
@@ -925,153 +1213,540 @@ mysql_handler(netsnmp_pdu           *pdu,
                        NETSNMP_OID_OUTPUT_NUMERIC);
 
 
-    rc = _sql_save_trap_info(sqlb, pdu, transport);
-    rc = _sql_save_varbind_info(sqlb, pdu);
+    (void) _sql_save_trap_info(sqlb, pdu, transport);
+    (void) _sql_save_varbind_info(sqlb, pdu);
 
     /** restore previous OID output format */
     netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_OID_OUTPUT_FORMAT,
                        old_format);
 
     /** insert into queue */
-    rc = CONTAINER_INSERT(_sql.queue, sqlb);
-    if(rc) {
-        snmp_log(LOG_ERR, "Could not log queue sql trap buffer\n");
-        _sql_log(sqlb, NULL);
-        _sql_buf_free(sqlb, 0);
-        return -1;
-    }
+    _sql_queue_append(&_sql.queue, sqlb);
 
-    /** save queue if size is > max */
-    if (CONTAINER_SIZE(_sql.queue) >= _sql.queue_max)
+    /*
+     * save queue if size is > max; while the database is down, leave
+     * retrying to the periodic save
+     */
+    if ((_sql.queue.count >= _sql.queue_max) && !_sql.failing)
         _sql_process_queue(0,NULL);
 
     return 0;
 }
 
 /*
- * save a buffered trap to sql database
+ * bind a buffered trap to the row of an INSERT starting at bind
  */
 static void
-_sql_save(sql_buf *sqlb, void *dontcare)
+_sql_bind_trap(MYSQL_BIND *bind, sql_buf *sqlb)
 {
-    netsnmp_iterator     *it;
-    sql_vb_buf           *sqlvb;
-    u_long                trap_id;
-
-    /*
-     * don't even try if we don't have a database connection
-     */
-    if (0 == _sql.connected) {
-        _sql_log(sqlb, NULL);
-        return;
+    int i;
+
+    memcpy(bind, _tbind, sizeof(_tbind));
+    for (i = 0; i < TBIND_MAX; i++) {
+        if (_tbind[i].length)
+            bind[i].length = &bind[i].buffer_length;
+        if (_tbind[i].is_null)
+            bind[i].is_null = &sqlb->no_v3;
     }
 
-    /*
-     * the prepared statements are bound to the static buffer objects,
-     * so copy the queued data to the static version.
-     */
-    _tbind[TBIND_HOST].buffer = sqlb->host;
-    _tbind[TBIND_HOST].buffer_length = sqlb->host_len;
+    bind[TBIND_HOST].buffer = sqlb->host;
+    bind[TBIND_HOST].buffer_length = sqlb->host_len;
 
-    _tbind[TBIND_OID].buffer = sqlb->oid;
-    _tbind[TBIND_OID].buffer_length = sqlb->oid_len;
+    bind[TBIND_OID].buffer = sqlb->oid;
+    bind[TBIND_OID].buffer_length = sqlb->oid_len;
 
-    _tbind[TBIND_REQID].buffer = (void *)&sqlb->reqid;
-    _tbind[TBIND_VER].buffer = (void *)&sqlb->version;
-    _tbind[TBIND_TYPE].buffer = (void *)&sqlb->type;
-    _tbind[TBIND_SECURITY_MODEL].buffer = (void *)&sqlb->security_model;
+    bind[TBIND_REQID].buffer = (void *)&sqlb->reqid;
+    bind[TBIND_VER].buffer = (void *)&sqlb->version;
+    bind[TBIND_TYPE].buffer = (void *)&sqlb->type;
+    bind[TBIND_SECURITY_MODEL].buffer = (void *)&sqlb->security_model;
 
-    _tbind[TBIND_DATE].buffer = (void *)&sqlb->time;
+    bind[TBIND_DATE].buffer = (void *)&sqlb->time;
 
-    _tbind[TBIND_USER].buffer = sqlb->user;
-    _tbind[TBIND_USER].buffer_length = sqlb->user_len;
+    bind[TBIND_USER].buffer = sqlb->user;
+    bind[TBIND_USER].buffer_length = sqlb->user_len;
 
-    _tbind[TBIND_TRANSPORT].buffer = sqlb->transport;
+    bind[TBIND_TRANSPORT].buffer = sqlb->transport;
     if (sqlb->transport)
-        _tbind[TBIND_TRANSPORT].buffer_length = strlen(sqlb->transport);
+        bind[TBIND_TRANSPORT].buffer_length = strlen(sqlb->transport);
     else
-        _tbind[TBIND_TRANSPORT].buffer_length = 0;
+        bind[TBIND_TRANSPORT].buffer_length = 0;
 
 
     if ((SNMP_MP_MODEL_SNMPv3+1) == sqlb->version) {
-        _no_v3 = 0;
+        sqlb->no_v3 = 0;
 
-        _tbind[TBIND_v3_MSGID].buffer = &sqlb->msgid;
+        bind[TBIND_v3_MSGID].buffer = &sqlb->msgid;
         
-        _tbind[TBIND_v3_SECURITY_LEVEL].buffer = &sqlb->security_level;
+        bind[TBIND_v3_SECURITY_LEVEL].buffer = &sqlb->security_level;
         
-        _tbind[TBIND_v3_CONTEXT_NAME].buffer = sqlb->context;
-        _tbind[TBIND_v3_CONTEXT_NAME].buffer_length = sqlb->context_len;
+        bind[TBIND_v3_CONTEXT_NAME].buffer = sqlb->context;
+        bind[TBIND_v3_CONTEXT_NAME].buffer_length = sqlb->context_len;
 
-        _tbind[TBIND_v3_CONTEXT_ENGINE].buffer = sqlb->context_engine;
-        _tbind[TBIND_v3_CONTEXT_ENGINE].buffer_length =
+        bind[TBIND_v3_CONTEXT_ENGINE].buffer = sqlb->context_engine;
+        bind[TBIND_v3_CONTEXT_ENGINE].buffer_length =
             sqlb->context_engine_len;
 
-        _tbind[TBIND_v3_SECURITY_NAME].buffer = sqlb->security_name;
-        _tbind[TBIND_v3_SECURITY_NAME].buffer_length = sqlb->security_name_len;
+        bind[TBIND_v3_SECURITY_NAME].buffer = sqlb->security_name;
+        bind[TBIND_v3_SECURITY_NAME].buffer_length = sqlb->security_name_len;
 
-        _tbind[TBIND_v3_SECURITY_ENGINE].buffer = sqlb->security_engine;
-        _tbind[TBIND_v3_SECURITY_ENGINE].buffer_length =
+        bind[TBIND_v3_SECURITY_ENGINE].buffer = sqlb->security_engine;
+        bind[TBIND_v3_SECURITY_ENGINE].buffer_length =
             sqlb->security_engine_len;
     }
     else {
-        _no_v3 = 1;
+        sqlb->no_v3 = 1;
     }
+}
 
-    if (mysql_stmt_bind_param(_sql.trap_stmt, _tbind) != 0) {
-        netsnmp_sql_stmt_error(_sql.trap_stmt,
-                               "Could not bind parameters for INSERT");
-        _sql_log(sqlb, NULL);
-        return;
+/*
+ * bind a buffered varbind to the row of an INSERT starting at bind
+ */
+static void
+_sql_bind_varbind(MYSQL_BIND *bind, sql_vb_buf *sqlvb, uint32_t *trap_id)
+{
+    int i;
+
+    memcpy(bind, _vbind, sizeof(_vbind));
+    for (i = 0; i < VBIND_MAX; i++)
+        if (_vbind[i].length)
+            bind[i].length = &bind[i].buffer_length;
+
+    bind[VBIND_ID].buffer = (void *)trap_id;
+    bind[VBIND_TYPE].buffer = (void *)&sqlvb->type;
+
+    bind[VBIND_OID].buffer = sqlvb->oid;
+    bind[VBIND_OID].buffer_length = sqlvb->oid_len;
+
+    bind[VBIND_VAL].buffer = sqlvb->val;
+    bind[VBIND_VAL].buffer_length = sqlvb->val_len;
+}
+
+/*
+ * the largest INSERT (as log2 of its rows, at most max) to use for
+ * count rows
+ */
+static int
+_sql_batch_level(u_int count, u_int max)
+{
+    int level = 0;
+
+    while ((level + 1 < SQL_BATCH_LEVELS) &&
+           ((2U << level) <= count) && ((2U << level) <= max))
+        level++;
+    return level;
+}
+
+/*
+ * run the INSERT of 1 << level rows, bound to bind
+ *
+ * return 0 on success, anything else is an error
+ */
+static int
+_sql_insert(MYSQL_STMT **cache, const char *insert, const char *row,
+            int level, MYSQL_BIND *bind, const char *what)
+{
+    MYSQL_STMT *stmt;
+
+    stmt = _sql_stmt(cache, insert, row, level);
+    if (NULL == stmt)
+        return -1;
+
+    if (mysql_stmt_bind_param(stmt, bind) != 0) {
+        netsnmp_sql_stmt_error(stmt, "Could not bind parameters for INSERT");
+        return -1;
     }
 
     /** execute the prepared statement */
-    if (mysql_stmt_execute(_sql.trap_stmt) != 0) {
-        netsnmp_sql_stmt_error(_sql.trap_stmt,
-                               "Could not execute insert statement for trap");
-        _sql_log(sqlb, NULL);
-        return;
+    if (mysql_stmt_execute(stmt) != 0) {
+        _sql_report("Could not execute insert statement for %s\n", what);
+        netsnmp_sql_stmt_error(stmt, "INSERT failed");
+        return -1;
+    }
+    if ((u_long) mysql_stmt_affected_rows(stmt) != (u_long)(1 << level)) {
+        _sql_report("insert statement for %s added %d of %d rows\n", what,
+                    (int) mysql_stmt_affected_rows(stmt), 1 << level);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * save count buffered traps, starting with sqlb, to the notifications
+ * table, and note the id of each.
+ *
+ * return 0 on success, anything else is an error
+ */
+static int
+_sql_save_traps(sql_buf *sqlb, u_int count)
+{
+    sql_buf  *row;
+    uint32_t  trap_id;
+    u_int     rows, i;
+    int       level;
+
+    while (count) {
+        level = _sql_batch_level(count, _sql.trap_batch_max);
+        rows = 1 << level;
+        for (i = 0, row = sqlb; i < rows; i++, row = row->next)
+            _sql_bind_trap(&_sql.tbinds[i * TBIND_MAX], row);
+
+        if (_sql_insert(_sql.trap_stmt, _trap_insert, _trap_row, level,
+                        _sql.tbinds, "trap") != 0)
+            return -1;
+
+        /*
+         * a multi-row insert reports the id of its first row; the ids of
+         * a single statement are consecutive, or trap_batch_max is 1
+         */
+        trap_id = mysql_insert_id(_sql.conn);
+        for (i = 0; i < rows; i++, sqlb = sqlb->next) {
+            sqlb->trap_id = trap_id;
+            trap_id += _sql.id_step;
+        }
+        count -= rows;
     }
-    trap_id = mysql_insert_id(_sql.conn);
+    return 0;
+}
 
+/*
+ * save the varbinds of count buffered traps, starting with sqlb, to the
+ * varbinds table.
+ *
+ * return 0 on success, anything else is an error
+ */
+static int
+_sql_save_varbinds(sql_buf *sqlb, u_int count)
+{
+    netsnmp_iterator     *it;
+    sql_vb_buf           *sqlvb;
+    sql_buf              *trap;
+    u_int                 total = 0, rows = 0, bound = 0, i;
+    int                   level = 0, rc = 0;
+
+    for (i = 0, trap = sqlb; i < count; i++, trap = trap->next)
+        total += CONTAINER_SIZE(trap->varbinds);
+
+    for (i = 0; (i < count) && (0 == rc); i++, sqlb = sqlb->next) {
+        it = CONTAINER_ITERATOR(sqlb->varbinds);
+        if (NULL == it) {
+            _sql_report("Could not allocate iterator\n");
+            return -1;
+        }
+
+        for( sqlvb = ITERATOR_FIRST(it); sqlvb; sqlvb = ITERATOR_NEXT(it)) {
+            if (0 == rows) {
+                level = _sql_batch_level(total, _sql.batch_max);
+                rows = 1 << level;
+            }
+            _sql_bind_varbind(&_sql.vbinds[bound * VBIND_MAX], sqlvb,
+                              &sqlb->trap_id);
+            if (++bound < rows)
+                continue;
+
+            rc = _sql_insert(_sql.vb_stmt, _vb_insert, _vb_row, level,
+                             _sql.vbinds, "varbind");
+            if (rc)
+                break;
+            total -= rows;
+            bound = rows = 0;
+        }
+        ITERATOR_RELEASE(it);
+    }
+    return rc;
+}
+
+/*
+ * write a list of buffered traps to the sql database, in one
+ * transaction: either all of them are saved, or none.
+ *
+ * return 0 on success, anything else is an error
+ */
+static int
+_sql_write(sql_buf_list *list)
+{
     /*
-     * iterate over the varbinds, copy data and insert
+     * if we don't have a database connection, try to reconnect.
      */
-    it = CONTAINER_ITERATOR(sqlb->varbinds);
-    if (NULL == it) {
-        snmp_log(LOG_ERR,"Could not allocate iterator\n");
-        _sql_log(sqlb, NULL);
-        return;
+    if (0 == _sql.connected) {
+        DEBUGMSGT(("sql:process", "no sql connection; reconnecting\n"));
+        if (netsnmp_mysql_connect() != 0)
+            return -1;
     }
 
-    for( sqlvb = ITERATOR_FIRST(it); sqlvb; sqlvb = ITERATOR_NEXT(it)) {
-
-        _vbind[VBIND_ID].buffer = (void *)&trap_id;
-        _vbind[VBIND_TYPE].buffer = (void *)&sqlvb->type;
+    if ((_sql_save_traps(list->head, list->count) == 0) &&
+        (_sql_save_varbinds(list->head, list->count) == 0)) {
+        if (mysql_commit(_sql.conn) == 0)
+            return 0;
+        netsnmp_sql_error("commit failed");
+    }
 
-        _vbind[VBIND_OID].buffer = sqlvb->oid;
-        _vbind[VBIND_OID].buffer_length = sqlvb->oid_len;
+    if (_sql.connected && (mysql_rollback(_sql.conn) != 0))
+        netsnmp_sql_error("rollback failed");
+    return -1;
+}
 
-        _vbind[VBIND_VAL].buffer = sqlvb->val;
-        _vbind[VBIND_VAL].buffer_length = sqlvb->val_len;
+/*
+ * dispose of a list of traps once written.  If the write failed because
+ * the database couldn't be reached, up to sqlMaxBacklog traps are kept
+ * in the queue to try again; those that aren't are logged instead.
+ */
+static void
+_sql_written(sql_buf_list *list, int rc, int unreachable)
+{
+    sql_buf *sqlb;
 
-        if (mysql_stmt_bind_param(_sql.vb_stmt, _vbind) != 0) {
-            netsnmp_sql_stmt_error(_sql.vb_stmt,
-                                   "Could not bind parameters for INSERT");
+    if (rc && unreachable && _sql.backlog_max && !_sql.exiting) {
+        if (!_sql.failing)
+            snmp_log(LOG_WARNING, "MySQL logging failed; keeping up to %u "
+                     "traps until the database is back\n", _sql.backlog_max);
+        _sql.failing = 1;
+
+        /** back to the front of the queue, which holds newer traps */
+        if (list->head) {
+            list->tail->next = _sql.queue.head;
+            if (NULL == _sql.queue.tail)
+                _sql.queue.tail = list->tail;
+            _sql.queue.head = list->head;
+            _sql.queue.count += list->count;
+            list->head = list->tail = NULL;
+            list->count = 0;
+        }
+        while (_sql.queue.count > _sql.backlog_max) {
+            sqlb = _sql_queue_pop(&_sql.queue);
             _sql_log(sqlb, NULL);
-            break;
+            _sql_buf_free(sqlb, NULL);
         }
+        return;
+    }
 
-        if (mysql_stmt_execute(_sql.vb_stmt) != 0) {
-            netsnmp_sql_stmt_error(_sql.vb_stmt,
-                                   "Could not execute insert statement for varbind");
+    if ((0 == rc) && _sql.failing) {
+        snmp_log(LOG_INFO, "MySQL logging resumed\n");
+        _sql.failing = 0;
+    }
+    while ((sqlb = _sql_queue_pop(list)) != NULL) {
+        if (rc)
             _sql_log(sqlb, NULL);
+        _sql_buf_free(sqlb, NULL);
+    }
+}
+
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+
+#include <pthread.h>
+
+/*
+ * The writer thread.  The main thread hands it the queue as a batch
+ * whenever the queue would have been written, and gets the batch back,
+ * through a pipe watched by the main loop, once it is written.  The
+ * connection is only used by the writer while it is running.
+ */
+typedef struct sql_batch_t {
+    sql_buf_list traps;
+    int          rc;
+    int          unreachable;     /* the database couldn't be reached */
+    u_char      *reports;         /* errors to log */
+    struct sql_batch_t *next;
+} sql_batch;
+
+typedef struct sql_batch_list_t {
+    sql_batch   *head, *tail;
+} sql_batch_list;
+
+static pthread_t       _sql_writer;
+static int             _sql_writer_stopping;
+static pthread_mutex_t _sql_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  _sql_writer_cond = PTHREAD_COND_INITIALIZER;
+static sql_batch_list  _sql_to_write, _sql_done;
+static int             _sql_done_pipe[2] = { -1, -1 };
+
+static void
+_sql_batch_append(sql_batch_list *list, sql_batch *batch)
+{
+    batch->next = NULL;
+    if (list->tail)
+        list->tail->next = batch;
+    else
+        list->head = batch;
+    list->tail = batch;
+}
+
+static void *
+_sql_writer_run(void *arg)
+{
+    sql_batch *batch;
+
+    mysql_thread_init();
+    for (;;) {
+        pthread_mutex_lock(&_sql_writer_lock);
+        while (!_sql_to_write.head && !_sql_writer_stopping)
+            pthread_cond_wait(&_sql_writer_cond, &_sql_writer_lock);
+        batch = _sql_to_write.head;
+        if (batch) {
+            _sql_to_write.head = batch->next;
+            if (NULL == _sql_to_write.head)
+                _sql_to_write.tail = NULL;
+        }
+        pthread_mutex_unlock(&_sql_writer_lock);
+        if (NULL == batch)
             break;
+
+        batch->rc = _sql_write(&batch->traps);
+        batch->unreachable = !_sql.connected;
+        batch->reports = _sql_reports;
+        _sql_reports = NULL;
+        _sql_reports_size = _sql_reports_len = 0;
+
+        pthread_mutex_lock(&_sql_writer_lock);
+        _sql_batch_append(&_sql_done, batch);
+        pthread_mutex_unlock(&_sql_writer_lock);
+        /*
+         * a full pipe already guarantees a wakeup of the main loop
+         */
+        while (write(_sql_done_pipe[1], "", 1) < 0 && errno == EINTR)
+            ;
+    }
+    mysql_thread_end();
+    return NULL;
+}
+
+/*
+ * main thread: log what the writer met and dispose of its batches
+ */
+static void
+_sql_writer_done(int fd, void *data)
+{
+    sql_batch *batch, *next;
+    char       buf[64];
+
+    while (fd >= 0 && read(fd, buf, sizeof(buf)) > 0)
+        ;
+    pthread_mutex_lock(&_sql_writer_lock);
+    batch = _sql_done.head;
+    _sql_done.head = _sql_done.tail = NULL;
+    pthread_mutex_unlock(&_sql_writer_lock);
+
+    for (; batch; batch = next) {
+        next = batch->next;
+        if (batch->reports) {
+            snmp_log(LOG_ERR, "%s", (char *) batch->reports);
+            free(batch->reports);
         }
+        _sql_written(&batch->traps, batch->rc, batch->unreachable);
+        free(batch);
     }
-    ITERATOR_RELEASE(it);
 }
 
+/*
+ * main thread: start the writer, after snmptrapd has gone into the
+ * background
+ */
+static int
+_sql_writer_start(void)
+{
+    sigset_t all, old;
+    int      i, rc;
+
+    if (pipe(_sql_done_pipe) < 0) {
+        snmp_log_perror("sql writer: pipe");
+        return -1;
+    }
+    for (i = 0; i < 2; i++)
+        fcntl(_sql_done_pipe[i], F_SETFL,
+              fcntl(_sql_done_pipe[i], F_GETFL) | O_NONBLOCK);
+
+    /*
+     * signals are left to the main thread
+     */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    _sql_writer_stopping = 0;
+    _sql_writer_running = 1;
+    rc = pthread_create(&_sql_writer, NULL, _sql_writer_run, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0) {
+        snmp_log(LOG_ERR, "sql writer: could not start thread: %s\n",
+                 strerror(rc));
+        _sql_writer_running = 0;
+        close(_sql_done_pipe[0]);
+        close(_sql_done_pipe[1]);
+        return -1;
+    }
+    register_readfd(_sql_done_pipe[0], _sql_writer_done, NULL);
+    DEBUGMSGTL(("sql:writer", "started\n"));
+    return 0;
+}
+
+/*
+ * main thread: wait for the writer to finish the batches handed to it
+ */
+static void
+_sql_writer_stop(void)
+{
+    if (!_sql_writer_running)
+        return;
+
+    pthread_mutex_lock(&_sql_writer_lock);
+    _sql_writer_stopping = 1;
+    pthread_cond_signal(&_sql_writer_cond);
+    pthread_mutex_unlock(&_sql_writer_lock);
+    pthread_join(_sql_writer, NULL);
+    _sql_writer_running = 0;
+
+    unregister_readfd(_sql_done_pipe[0]);
+    _sql_writer_done(-1, NULL);
+    close(_sql_done_pipe[0]);
+    close(_sql_done_pipe[1]);
+    _sql_done_pipe[0] = _sql_done_pipe[1] = -1;
+    DEBUGMSGTL(("sql:writer", "stopped\n"));
+}
+
+/*
+ * main thread: hand the queue to the writer (or leave it queued, if out
+ * of memory)
+ *
+ * return 0 on success, anything else if it has to be written here
+ */
+static int
+_sql_writer_queue(void)
+{
+    sql_batch *batch;
+
+    if (!_sql_writer_running && _sql_writer_start() != 0) {
+        _sql.use_writer = 0;
+        return -1;
+    }
+
+    batch = SNMP_MALLOC_TYPEDEF(sql_batch);
+    if (NULL == batch) {
+        snmp_log(LOG_ERR, "Could not allocate sql batch\n");
+        return 0;
+    }
+    batch->traps = _sql.queue;
+    _sql.queue.head = _sql.queue.tail = NULL;
+    _sql.queue.count = 0;
+
+    pthread_mutex_lock(&_sql_writer_lock);
+    _sql_batch_append(&_sql_to_write, batch);
+    pthread_cond_signal(&_sql_writer_cond);
+    pthread_mutex_unlock(&_sql_writer_lock);
+    return 0;
+}
+
+#else /* !(NETSNMP_REENTRANT && HAVE_PTHREAD_H) */
+
+static void
+_sql_writer_stop(void)
+{
+}
+
+static int
+_sql_writer_queue(void)
+{
+    return -1;
+}
+
+#endif /* NETSNMP_REENTRANT && HAVE_PTHREAD_H */
+
 /*
  * process (save) queued items to sql database.
  *
@@ -1081,39 +1756,29 @@ _sql_save(sql_buf *sqlb, void *dontcare)
 static void
 _sql_process_queue(u_int dontcare, void *meeither)
 {
-    int        rc;
+    sql_buf_list list;
+    int          rc;
 
     /** bail if the queue is empty */
-    if( 0 == CONTAINER_SIZE(_sql.queue))
+    if( 0 == _sql.queue.count)
         return;
 
     DEBUGMSGT(("sql:process", "processing %d queued traps\n",
-               (int)CONTAINER_SIZE(_sql.queue)));
-
-    /*
-     * if we don't have a database connection, try to reconnect. We
-     * don't care if we fail - traps will be logged in that case.
-     */
-    if (0 == _sql.connected) {
-        DEBUGMSGT(("sql:process", "no sql connection; reconnecting\n"));
-        (void) netsnmp_mysql_connect();
-    }
+               (int)_sql.queue.count));
 
-    CONTAINER_FOR_EACH(_sql.queue, (netsnmp_container_obj_func*)_sql_save,
-                       NULL);
+    if (_sql.use_writer && (_sql_writer_queue() == 0))
+        return;
 
-    if (_sql.connected) {
-        rc = mysql_commit(_sql.conn);
-        if (rc) { /* nuts... now what? */
-            netsnmp_sql_error("commit failed");
-            CONTAINER_FOR_EACH(_sql.queue,
-                               (netsnmp_container_obj_func*)_sql_log,
-                               NULL);
-        }
-    }
+    list = _sql.queue;
+    _sql.queue.head = _sql.queue.tail = NULL;
+    _sql.queue.count = 0;
 
-    CONTAINER_CLEAR(_sql.queue, (netsnmp_container_obj_func*)_sql_buf_free,
-                    NULL);
+    /*
+     * if we don't have a database connection, this tries to reconnect.
+     * We don't care if we fail - traps will be kept or logged in that case.
+     */
+    rc = _sql_write(&list);
+    _sql_written(&list, rc, !_sql.connected);
 }
 
 #else
@@ -0,0 +1,594 @@
+/*
+ * snmptrapd_workers.c
+ *
+ * Pool of threads running the handlers of received notifications, so
+ * that formatting and logging them (which may mean looking up host
+ * names) no longer holds up the receiving of the next ones.
+ *
+ * The main thread receives and parses every notification and runs the
+ * authorization handlers, then queues a copy for the workers.  Finished
+ * notifications come back through a pipe watched by the main loop, which
+ * writes out their log output, runs any handlers that are not thread
+ * safe and answers INFORMs.  By default this is done in the order the
+ * notifications arrived.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <errno.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include "snmptrapd_handlers.h"
+#include "snmptrapd_auth.h"
+#include "snmptrapd_ds.h"
+#include "snmptrapd_workers.h"
+
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H)
+
+#include <pthread.h>
+
+#define TRAPD_WORKER_QUEUE_DEFAULT 1024
+
+typedef struct trapd_output_s {
+    int             priority;
+    char           *text;
+    struct trapd_output_s *next;
+} trapd_output;
+
+typedef struct trapd_job_s {
+    netsnmp_pdu    *pdu;            /* a copy of the notification */
+    netsnmp_session *session;       /* NULL once disconnected */
+    netsnmp_transport *transport;   /* a copy, for the formatters */
+    oid             trapOid[MAX_OID_LEN + 2];
+    int             trapOidLen;
+    int             auth;           /* from the authorization handlers */
+    netsnmp_trapd_position pos;
+    int             status;         /* from netsnmp_trapd_run_handlers() */
+    int             ordered;        /* on the list in order of arrival */
+    int             done;
+    trapd_output   *output;
+    trapd_output   *output_tail;
+    struct trapd_job_s *next;       /* in the pending or done queue */
+    struct trapd_job_s *next_arrived;
+    struct trapd_job_s *next_flight;    /* main thread only */
+    struct trapd_job_s **prev_flight;
+} trapd_job;
+
+typedef struct trapd_job_queue_s {
+    trapd_job      *head;
+    trapd_job      *tail;
+    int             depth;
+    int             max_depth;
+} trapd_job_queue;
+
+static pthread_t *workers;
+static int      worker_count;
+static int      workers_stopping;
+static int      workers_paused;
+static int      workers_active;
+static int      done_pipe[2] = { -1, -1 };
+
+/* protects both queues and the worker state above */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static trapd_job_queue pending_jobs, done_jobs;
+
+/* the job a worker is running, for netsnmp_trapd_log() */
+static pthread_key_t current_job_key;
+
+/*
+ * Main thread only: the notifications whose output is still to be
+ * written, in order of arrival, all notifications in flight, and the
+ * counters that are logged when the workers stop.
+ */
+static trapd_job *arrived_head, *arrived_tail;
+static trapd_job *flight_head;
+static int      in_flight, max_in_flight, waiting, max_waiting;
+static u_long   stat_dispatched, stat_on_main, stat_stalls;
+
+static void
+_queue_push(trapd_job_queue *queue, trapd_job *job)
+{
+    job->next = NULL;
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+    if (++queue->depth > queue->max_depth)
+        queue->max_depth = queue->depth;
+}
+
+static trapd_job *
+_queue_pop(trapd_job_queue *queue)
+{
+    trapd_job      *job = queue->head;
+
+    if (job) {
+        queue->head = job->next;
+        if (!queue->head)
+            queue->tail = NULL;
+        queue->depth--;
+    }
+    return job;
+}
+
+static void    *
+_worker_run(void *arg)
+{
+    trapd_job      *job;
+
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!workers_stopping && (workers_paused || !pending_jobs.head))
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        job = _queue_pop(&pending_jobs);
+        if (job)
+            workers_active++;
+        pthread_mutex_unlock(&queue_lock);
+        if (!job)
+            break;
+
+        pthread_setspecific(current_job_key, job);
+        netsnmp_trapd_set_auth(job->auth);
+        job->status = netsnmp_trapd_run_handlers(job->pdu, job->transport,
+                                                 job->trapOid,
+                                                 job->trapOidLen, &job->pos,
+                                                 NETSNMPTRAPD_ALL_LISTS, 1);
+        pthread_setspecific(current_job_key, NULL);
+
+        pthread_mutex_lock(&queue_lock);
+        _queue_push(&done_jobs, job);
+        if (--workers_active == 0 && workers_paused)
+            pthread_cond_broadcast(&idle_cond);
+        pthread_mutex_unlock(&queue_lock);
+        /*
+         * a full pipe already guarantees a wakeup of the main loop
+         */
+        if (write(done_pipe[1], "", 1) < 0 && errno != EAGAIN)
+            snmp_log_perror("snmptrapd worker");
+    }
+    return NULL;
+}
+
+/*
+ * Main thread: keep the workers out while running handlers that are not
+ * thread safe.
+ */
+static void
+_workers_pause(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    workers_paused = 1;
+    while (workers_active)
+        pthread_cond_wait(&idle_cond, &queue_lock);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void
+_workers_resume(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    workers_paused = 0;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void
+_job_free(trapd_job *job)
+{
+    trapd_output   *out, *next;
+
+    for (out = job->output; out; out = next) {
+        next = out->next;
+        free(out->text);
+        free(out);
+    }
+    if (job->transport)
+        netsnmp_transport_free(job->transport);
+    snmp_free_pdu(job->pdu);
+    free(job);
+}
+
+/*
+ * Main thread: write out what the handlers logged, run the rest of the
+ * handlers and answer an INFORM.
+ */
+static void
+_job_finish(trapd_job *job, int *paused)
+{
+    trapd_output   *out;
+
+    for (out = job->output; out; out = out->next)
+        snmp_log(out->priority, "%s", out->text);
+
+    if (job->status == 0) {
+        if (!*paused) {
+            _workers_pause();
+            *paused = 1;
+        }
+        stat_on_main++;
+        netsnmp_trapd_set_auth(job->auth);
+        job->status = netsnmp_trapd_run_handlers(job->pdu, job->transport,
+                                                 job->trapOid,
+                                                 job->trapOidLen, &job->pos,
+                                                 NETSNMPTRAPD_ALL_LISTS, 0);
+    }
+    if (job->status != NETSNMPTRAPD_HANDLER_FINISH && job->session)
+        netsnmp_trapd_respond(job->session, job->pdu);
+    *job->prev_flight = job->next_flight;
+    if (job->next_flight)
+        job->next_flight->prev_flight = job->prev_flight;
+    in_flight--;
+    _job_free(job);
+}
+
+/*
+ * Main thread: finish off the notifications the workers are done with.
+ */
+static void
+_workers_complete(int fd, void *data)
+{
+    trapd_job      *job, *next;
+    char            buf[64];
+    int             paused = 0;
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pthread_mutex_lock(&queue_lock);
+    job = done_jobs.head;
+    done_jobs.head = done_jobs.tail = NULL;
+    done_jobs.depth = 0;
+    pthread_mutex_unlock(&queue_lock);
+
+    for (; job; job = next) {
+        next = job->next;
+        if (job->ordered) {
+            job->done = 1;
+            if (++waiting > max_waiting)
+                max_waiting = waiting;
+        } else {
+            _job_finish(job, &paused);
+        }
+    }
+    while (arrived_head && arrived_head->done) {
+        job = arrived_head;
+        arrived_head = job->next_arrived;
+        if (!arrived_head)
+            arrived_tail = NULL;
+        waiting--;
+        _job_finish(job, &paused);
+    }
+    if (paused)
+        _workers_resume();
+}
+
+/*
+ * Main thread: wait for the workers to finish at least one notification.
+ */
+static void
+_workers_wait(void)
+{
+    fd_set          fds;
+
+    FD_ZERO(&fds);
+    FD_SET(done_pipe[0], &fds);
+    if (select(done_pipe[0] + 1, &fds, NULL, NULL, NULL) < 0 &&
+        errno != EINTR)
+        snmp_log_perror("snmptrapd workers: select");
+    _workers_complete(done_pipe[0], NULL);
+}
+
+/**
+ * Starts the worker threads.
+ *
+ * @param count the number of threads to start
+ *
+ * @return the number of threads running, or -1 on failure.
+ */
+int
+netsnmp_trapd_workers_start(int count)
+{
+    sigset_t        all, old;
+    int             i, rc;
+
+    if (worker_count || count <= 0)
+        return worker_count;
+
+    if (pipe(done_pipe) < 0) {
+        snmp_log_perror("snmptrapd workers: pipe");
+        return -1;
+    }
+    for (i = 0; i < 2; i++)
+        fcntl(done_pipe[i], F_SETFL,
+              fcntl(done_pipe[i], F_GETFL) | O_NONBLOCK);
+
+    workers = (pthread_t *) calloc(count, sizeof(pthread_t));
+    if (!workers) {
+        close(done_pipe[0]);
+        close(done_pipe[1]);
+        return -1;
+    }
+    pthread_key_create(&current_job_key, NULL);
+
+    /*
+     * signals (SIGHUP in particular) are left to the main thread
+     */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    workers_stopping = 0;
+    for (i = 0; i < count; i++) {
+        rc = pthread_create(&workers[i], NULL, _worker_run, NULL);
+        if (rc != 0) {
+            snmp_log(LOG_ERR, "snmptrapd workers: started %d of %d "
+                     "threads: %s\n", i, count, strerror(rc));
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    worker_count = i;
+    if (!worker_count) {
+        SNMP_FREE(workers);
+        pthread_key_delete(current_job_key);
+        close(done_pipe[0]);
+        close(done_pipe[1]);
+        return -1;
+    }
+    register_readfd(done_pipe[0], _workers_complete, NULL);
+    snmp_log(LOG_INFO, "Handling notifications on %d worker threads\n",
+             worker_count);
+    return worker_count;
+}
+
+/**
+ * Stops the worker threads, once the notifications already handed to
+ * them are finished, and logs how full the queues got.
+ */
+void
+netsnmp_trapd_workers_stop(void)
+{
+    int             i, count = worker_count;
+
+    if (!worker_count)
+        return;
+
+    netsnmp_trapd_workers_drain();
+    pthread_mutex_lock(&queue_lock);
+    workers_stopping = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (i = 0; i < count; i++)
+        pthread_join(workers[i], NULL);
+    SNMP_FREE(workers);
+    worker_count = 0;
+    pthread_key_delete(current_job_key);
+
+    unregister_readfd(done_pipe[0]);
+    close(done_pipe[0]);
+    close(done_pipe[1]);
+    done_pipe[0] = done_pipe[1] = -1;
+
+    snmp_log(LOG_INFO, "snmptrapd workers: %lu notifications, %lu finished "
+             "on the main thread, %lu stalls; at most %d in flight, "
+             "%d queued for the workers, %d queued back, %d awaiting "
+             "their turn\n", stat_dispatched, stat_on_main, stat_stalls,
+             max_in_flight, pending_jobs.max_depth, done_jobs.max_depth,
+             max_waiting);
+    DEBUGMSGTL(("trapd:workers", "stopped %d threads\n", count));
+}
+
+int
+netsnmp_trapd_workers_running(void)
+{
+    return worker_count > 0;
+}
+
+/**
+ * Hands the rest of the handling of a notification to the worker
+ * threads.  Waits for the workers first if trapdWorkerQueueSize
+ * notifications are already in flight.
+ *
+ * @return 1 if the notification was dispatched, 0 if the caller has to
+ *         handle it.
+ */
+int
+netsnmp_trapd_workers_dispatch(netsnmp_session *session, netsnmp_pdu *pdu,
+                               netsnmp_transport *transport,
+                               oid *trapOid, int trapOidLen,
+                               netsnmp_trapd_position *pos)
+{
+    trapd_job      *job;
+    int             limit;
+
+    if (!worker_count)
+        return 0;
+
+    limit = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_APP_WORKER_QUEUE_SIZE);
+    if (limit <= 0)
+        limit = TRAPD_WORKER_QUEUE_DEFAULT;
+    if (in_flight >= limit) {
+        stat_stalls++;
+        while (in_flight >= limit)
+            _workers_wait();
+    }
+
+    job = SNMP_MALLOC_TYPEDEF(trapd_job);
+    if (!job)
+        return 0;
+    job->pdu = snmp_clone_pdu(pdu);
+    if (!job->pdu) {
+        free(job);
+        return 0;
+    }
+    if (transport) {
+        job->transport = netsnmp_transport_copy(transport);
+        if (!job->transport) {
+            snmp_free_pdu(job->pdu);
+            free(job);
+            return 0;
+        }
+    }
+    job->session = session;
+    memcpy(job->trapOid, trapOid, trapOidLen * sizeof(oid));
+    job->trapOidLen = trapOidLen;
+    job->auth = netsnmp_trapd_get_auth();
+    job->pos = *pos;
+
+    job->ordered = !netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                           NETSNMP_DS_APP_UNORDERED_OUTPUT);
+    if (job->ordered) {
+        if (arrived_tail)
+            arrived_tail->next_arrived = job;
+        else
+            arrived_head = job;
+        arrived_tail = job;
+    }
+    job->next_flight = flight_head;
+    job->prev_flight = &flight_head;
+    if (flight_head)
+        flight_head->prev_flight = &job->next_flight;
+    flight_head = job;
+    if (++in_flight > max_in_flight)
+        max_in_flight = in_flight;
+    stat_dispatched++;
+
+    pthread_mutex_lock(&queue_lock);
+    _queue_push(&pending_jobs, job);
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return 1;
+}
+
+/**
+ * Forgets the session of the notifications in flight that came in over
+ * a connection which is closing; INFORMs among them are not answered.
+ */
+void
+netsnmp_trapd_workers_cancel_session(netsnmp_session *session)
+{
+    trapd_job      *job;
+
+    for (job = flight_head; job; job = job->next_flight)
+        if (job->session == session)
+            job->session = NULL;
+}
+
+/**
+ * Finishes every notification in flight, as is needed before the
+ * handlers are reconfigured.
+ */
+void
+netsnmp_trapd_workers_drain(void)
+{
+    while (worker_count && in_flight)
+        _workers_wait();
+}
+
+/**
+ * Logs the output of a handler, or keeps it to be logged from the main
+ * thread if called from a worker.
+ */
+void
+netsnmp_trapd_log(int priority, const char *text, int truncated)
+{
+    trapd_job      *job = NULL;
+    trapd_output   *out;
+    size_t          len;
+
+    if (worker_count)
+        job = (trapd_job *) pthread_getspecific(current_job_key);
+    if (!job) {
+        snmp_log(priority, "%s%s", text, truncated ? " [TRUNCATED]\n" : "");
+        return;
+    }
+
+    out = SNMP_MALLOC_TYPEDEF(trapd_output);
+    len = strlen(text);
+    if (out)
+        out->text = (char *) malloc(len + sizeof(" [TRUNCATED]\n"));
+    if (!out || !out->text) {
+        free(out);
+        snmp_log(LOG_ERR, "couldn't keep trap output -- malloc failed\n");
+        return;
+    }
+    memcpy(out->text, text, len);
+    strcpy(out->text + len, truncated ? " [TRUNCATED]\n" : "");
+    out->priority = priority;
+    if (job->output_tail)
+        job->output_tail->next = out;
+    else
+        job->output = out;
+    job->output_tail = out;
+}
+
+#else /* NETSNMP_REENTRANT && HAVE_PTHREAD_H */
+
+int
+netsnmp_trapd_workers_start(int count)
+{
+    if (count > 0)
+        snmp_log(LOG_WARNING, "snmptrapd workers need a build configured "
+                 "with --enable-reentrant; handling notifications on the "
+                 "main thread\n");
+    return 0;
+}
+
+void
+netsnmp_trapd_workers_stop(void)
+{
+}
+
+int
+netsnmp_trapd_workers_running(void)
+{
+    return 0;
+}
+
+int
+netsnmp_trapd_workers_dispatch(netsnmp_session *session, netsnmp_pdu *pdu,
+                               netsnmp_transport *transport,
+                               oid *trapOid, int trapOidLen,
+                               netsnmp_trapd_position *pos)
+{
+    return 0;
+}
+
+void
+netsnmp_trapd_workers_cancel_session(netsnmp_session *session)
+{
+}
+
+void
+netsnmp_trapd_workers_drain(void)
+{
+}
+
+void
+netsnmp_trapd_log(int priority, const char *text, int truncated)
+{
+    snmp_log(priority, "%s%s", text, truncated ? " [TRUNCATED]\n" : "");
+}
+
+#endif /* NETSNMP_REENTRANT && HAVE_PTHREAD_H */
@@ -0,0 +1,38 @@
+#ifndef SNMPTRAPD_WORKERS_H
+#define SNMPTRAPD_WORKERS_H
+
+/*
+ * Optional pool of threads running the handlers of received
+ * notifications on behalf of the main snmptrapd loop.
+ *
+ * The main thread still receives, parses and authorizes every
+ * notification.  The handlers flagged NETSNMP_TRAPHANDLER_FLAG_THREAD_SAFE
+ * run on the workers; whatever follows the first handler without that
+ * flag, and the response to an INFORM, is run on the main thread once
+ * the workers are done, with the workers paused.  Output logged by the
+ * print and syslog handlers on a worker is kept with the notification
+ * and written from the main thread, in the order the notifications
+ * arrived unless trapdUnorderedOutput is set.
+ *
+ * The pool is only available in builds configured with
+ * --enable-reentrant; otherwise these functions do nothing.
+ */
+
+/* lock for the lookups in snmptrapd_log.c that aren't reentrant */
+#define MT_APP_TRAPD_FORMAT  1
+
+int             netsnmp_trapd_workers_start(int count);
+void            netsnmp_trapd_workers_stop(void);
+int             netsnmp_trapd_workers_running(void);
+int             netsnmp_trapd_workers_dispatch(netsnmp_session *session,
+                                               netsnmp_pdu *pdu,
+                                               netsnmp_transport *transport,
+                                               oid *trapOid, int trapOidLen,
+                                               netsnmp_trapd_position *pos);
+void            netsnmp_trapd_workers_cancel_session(netsnmp_session
+                                                     *session);
+void            netsnmp_trapd_workers_drain(void);
+void            netsnmp_trapd_log(int priority, const char *text,
+                                  int truncated);
+
+#endif /* SNMPTRAPD_WORKERS_H */
@@ -87,6 +87,7 @@ typedef struct netsnmp_mib_handler_s {
 #define HANDLER_CAN_NOT_CREATE        0x08         /* auto set if ! CAN_SET */
 #define HANDLER_CAN_BABY_STEP         0x10
 #define HANDLER_CAN_STASH             0x20
+#define HANDLER_CAN_THREAD_SAFE       0x40   /* may run on a worker thread */
 
 
 #define HANDLER_CAN_RONLY   (HANDLER_CAN_GETANDGETNEXT)
@@ -211,6 +212,10 @@ typedef int (Netsnmp_Node_Handler) (netsnmp_mib_handler *handler,
                                                           netsnmp_handler_registration *reginfo,
                                                           netsnmp_agent_request_info *reqinfo,
                                                           netsnmp_request_info *requests);
+    void            netsnmp_handler_skip_auto_next(netsnmp_mib_handler
+                                                   *handler,
+                                                   netsnmp_agent_request_info
+                                                   *reqinfo);
     
     netsnmp_mib_handler *netsnmp_create_handler(const char *name,
                                                 Netsnmp_Node_Handler *
@@ -51,6 +51,7 @@ typedef struct subtree_context_cache_s {
     const char				*context_name;
     struct netsnmp_subtree_s		*first_subtree;
     struct subtree_context_cache_s	*next;
+    struct subtree_index_node_s		*subtree_index;
 } subtree_context_cache;
 
 
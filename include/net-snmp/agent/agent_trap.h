@@ -36,6 +36,10 @@ void            snmpd_parse_config_trapsess(const char *, char *);
 void            snmpd_free_trapsinks(void);
 void            snmpd_parse_config_trapcommunity(const char *, char *);
 void            snmpd_free_trapcommunity(void);
+void            snmpd_parse_config_notification_queue_policy(const char *,
+                                                             char *);
+void            snmpd_free_notification_queue_policy(void);
+void            netsnmp_trap_queue_flush(void);
 void            send_trap_to_sess(netsnmp_session * sess,
                                   netsnmp_pdu *template_pdu);
 
@@ -0,0 +1,70 @@
+#ifndef AGENT_WORKERS_H
+#define AGENT_WORKERS_H
+
+#ifdef __cplusplus
+extern          "C" {
+#endif
+
+    /*
+     * Optional pool of threads processing read-only requests
+     * (GET, GETNEXT and GETBULK) on behalf of the main agent loop.
+     *
+     * Only requests for subtrees whose registrations carry
+     * HANDLER_CAN_THREAD_SAFE are dispatched; everything else, and any
+     * request that walks into a handler without that flag, is processed
+     * on the main thread as before.  Handlers running on a worker thread
+     * must not register or unregister MIB regions or delegate requests,
+     * and may run for several requests at once, so they keep the state
+     * of a request in the request rather than in their registration or
+     * handler (see netsnmp_handler_skip_auto_next()).
+     *
+     * The pool is only available in builds configured with
+     * --enable-reentrant; otherwise these functions do nothing.
+     */
+
+    int             netsnmp_agent_workers_start(int count);
+    void            netsnmp_agent_workers_stop(void);
+    int             netsnmp_agent_workers_dispatch(netsnmp_agent_session
+                                                   *asp);
+
+    /*
+     * Requests which are freed, or whose session is closed, while a
+     * worker owns them are cancelled: they are freed without a response
+     * once the worker is done with them.
+     */
+    int             netsnmp_agent_workers_cancel(netsnmp_agent_session
+                                                 *asp);
+    void            netsnmp_agent_workers_cancel_session(netsnmp_session
+                                                         *sess);
+
+    int             netsnmp_agent_workers_hand_back(netsnmp_agent_request_info
+                                                    *reqinfo);
+
+    /*
+     * Called around the handlers of a registration.  The main thread
+     * keeps the workers out meanwhile; workers may run the same
+     * registration at once.
+     */
+    void            netsnmp_agent_workers_enter(netsnmp_handler_registration
+                                                *reginfo,
+                                                netsnmp_agent_request_info
+                                                *reqinfo);
+    void            netsnmp_agent_workers_leave(netsnmp_handler_registration
+                                                *reginfo,
+                                                netsnmp_agent_request_info
+                                                *reqinfo);
+
+    /*
+     * Called on the main thread around changes to anything the worker
+     * threads might be reading (the registry, the configuration, SETs).
+     * Waits for the requests in progress to finish; may be nested.  The
+     * outermost unlock rebuilds the VACM view index if the tables changed.
+     */
+    void            netsnmp_agent_workers_lock(void);
+    void            netsnmp_agent_workers_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGENT_WORKERS_H */
@@ -28,8 +28,15 @@ extern          "C" {
 
     typedef struct netsnmp_cache_s netsnmp_cache;
 
+    /*
+     * Loads counted in load_time_hist took up to 1ms, 10ms, 100ms, 1s
+     * or longer.
+     */
+#define NETSNMP_CACHE_LOAD_TIME_BUCKETS 5
+
     typedef int  (NetsnmpCacheLoad)(netsnmp_cache *, void*);
     typedef void (NetsnmpCacheFree)(netsnmp_cache *, void*);
+    typedef void (NetsnmpCacheSwap)(netsnmp_cache *, void*);
 
     struct netsnmp_cache_s {
 	/** Number of handlers whose myvoid member points at this structure. */
@@ -67,6 +74,39 @@ extern          "C" {
         oid *rootoid;
         int  rootoid_len;
 
+        /*
+         * For reloads in the background (NETSNMP_CACHE_BACKGROUND_RELOAD).
+         * load_cache fills spare_magic while requests keep using the
+         * previous data; swap_cache then makes it current on the main
+         * thread.  Without a swap_cache hook, magic and spare_magic are
+         * exchanged.
+         */
+        void             *spare_magic;
+        NetsnmpCacheSwap *swap_cache;
+        int      stale_limit;   /* Age (in s) beyond which stale data is
+                                 * no longer served; 0 for no limit */
+        int      reloading;     /* Background reload state */
+        int      reload_rc;
+        u_long   reload_time;
+        netsnmp_cache *reload_next;
+
+        /*
+         * Load statistics (durations in microseconds)
+         */
+        u_long   load_count;
+        u_long   load_failures;
+        u_long   load_time_last;
+        u_long   load_time_max;
+        uint64_t load_time_total;
+        u_long   load_time_hist[NETSNMP_CACHE_LOAD_TIME_BUCKETS];
+
+        /*
+         * Usage statistics
+         */
+        u_long   hits;          /* Requests served without a load */
+        u_long   expirations;   /* Times the data was found expired */
+        long     rows;          /* Set by load_cache, if it knows; */
+        long     bytes;         /* -1 otherwise */
     };
 
 
@@ -110,6 +150,8 @@ extern          "C" {
     unsigned int netsnmp_cache_timer_start(netsnmp_cache *cache);
     void netsnmp_cache_timer_stop(netsnmp_cache *cache);
 
+    void netsnmp_cache_stats_dump(void);
+
 /*
  * Flags affecting cache handler operation
  */
@@ -120,6 +162,7 @@ extern          "C" {
 #define NETSNMP_CACHE_PRELOAD                               0x0010
 #define NETSNMP_CACHE_AUTO_RELOAD                           0x0020
 #define NETSNMP_CACHE_RESET_TIMER_ON_USE                    0x0040
+#define NETSNMP_CACHE_BACKGROUND_RELOAD                     0x0080
 
 #define NETSNMP_CACHE_HINT_HANDLER_ARGS                     0x1000
 
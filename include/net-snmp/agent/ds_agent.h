@@ -37,6 +37,9 @@
 #define NETSNMP_DS_AGENT_DISKIO_NO_LOOP 19      /* 1 = don't report /dev/loop* entries in diskIOTable */
 #define NETSNMP_DS_AGENT_DISKIO_NO_RAM  20      /* 1 = don't report /dev/ram*  entries in diskIOTable */
 
+   /* Repeated from "apps/snmptrapd_ds.h" */
+#define NETSNMP_DS_APP_UNORDERED_OUTPUT 21
+
 /* WARNING: The trap receiver also uses DS flags and must not conflict with these!
  * If you define additional boolean entries, check in "apps/snmptrapd_ds.h" first */
 
@@ -70,5 +73,11 @@
 #define NETSNMP_DS_AGENT_INTERNAL_SECLEVEL 12   /* used by internal queries */
 #define NETSNMP_DS_AGENT_MAX_GETBULKREPEATS 13 /* max getbulk repeats */
 #define NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES 14   /* max getbulk respones */
+#define NETSNMP_DS_AGENT_WORKER_THREADS 15      /* request worker threads */
+#define NETSNMP_DS_AGENT_NOTIFICATION_QUEUE_SIZE 16 /* queued notifications */
+
+   /* Repeated from "apps/snmptrapd_ds.h" */
+#define NETSNMP_DS_APP_WORKER_THREADS    17
+#define NETSNMP_DS_APP_WORKER_QUEUE_SIZE 18
 
 #endif
@@ -34,6 +34,8 @@ extern          "C" {
 
 #define SNMP_AGENT_FLAGS_NONE                   0x0
 #define SNMP_AGENT_FLAGS_CANCEL_IN_PROGRESS     0x1
+#define SNMP_AGENT_FLAGS_IN_WORKER              0x2
+#define SNMP_AGENT_FLAGS_NOT_THREAD_SAFE        0x4
 
     /*
      * If non-zero, causes the addresses of peers to be logged when receptions
@@ -209,6 +211,10 @@ extern          "C" {
         netsnmp_cachemap *cache_store;
         int             vbcount;
         int             flags;
+        void           *vbpool;         /* see netsnmp_agent_alloc_varbinds */
+        void           *worker_job;     /* set while on a worker thread */
+        struct netsnmp_mib_handler_s *skip_auto_next; /* see
+                                        netsnmp_handler_skip_auto_next */
     } netsnmp_agent_session;
 
     /*
@@ -229,6 +235,12 @@ extern          "C" {
     netsnmp_agent_session *init_agent_snmp_session(netsnmp_session *,
                                                    netsnmp_pdu *);
     void            free_agent_snmp_session(netsnmp_agent_session *);
+    netsnmp_variable_list *netsnmp_agent_alloc_varbinds(netsnmp_agent_session
+                                                        *asp, int count);
+    netsnmp_variable_list *netsnmp_request_next_repetition(netsnmp_request_info
+                                                           *request,
+                                                           netsnmp_variable_list
+                                                           *vb);
     void           
         netsnmp_remove_and_free_agent_snmp_session(netsnmp_agent_session
                                                    *asp);
@@ -239,6 +251,9 @@ extern          "C" {
                                                    (netsnmp_request_list
                                                     *));
 #endif
+    int             handle_pdu(netsnmp_agent_session *asp);
+    int             netsnmp_complete_request(netsnmp_agent_session *asp,
+                                             int status);
     int             getNextSessID(void);
     void            dump_sess_list(void);
     int             init_master_agent(void);
@@ -101,6 +101,33 @@ extern          "C" {
                                           netsnmp_table_request_info *tblreq,
                                           netsnmp_container *container,
                                           char key_type );
+
+/* ===================================
+ * Container Table API: Merge loading
+ * =================================== */
+
+    /** rows touched by netsnmp_container_table_merge */
+    typedef struct netsnmp_container_table_merge_stats_s {
+        u_int           added;
+        u_int           deleted;
+        u_int           changed;
+        u_int           unchanged;
+    } netsnmp_container_table_merge_stats;
+
+    /*
+     * copy the data of a loaded row (fresh) into the table's row with
+     * the same index. returns 1 if it changed, 0 if not, -1 on error.
+     */
+    typedef int (netsnmp_container_table_update_f) (void *row, void *fresh,
+                                                    void *context);
+
+    int
+    netsnmp_container_table_merge(netsnmp_container *table,
+                                  netsnmp_container *fresh,
+                                  netsnmp_container_table_update_f *update,
+                                  netsnmp_container_obj_func *release,
+                                  void *context,
+                                  netsnmp_container_table_merge_stats *stats);
 #ifdef __cplusplus
 }
 #endif
@@ -469,6 +469,53 @@ SOFTWARE.
                                               int allow_realloc,
                                               u_char type, const double *data,
                                               size_t data_size);
+
+    /*
+     * Presized forward encoding: the *_len functions return the length of
+     * an object's contents, the build functions write the whole object
+     * front to back into space the caller has already reserved.
+     */
+    NETSNMP_IMPORT
+    int             asn_presized_reserve(u_char ** pkt, size_t * pkt_len,
+                                         size_t offset, size_t need);
+    NETSNMP_IMPORT
+    size_t          asn_presized_header_len(size_t length);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_header(u_char * data, u_char type,
+                                              size_t length);
+    NETSNMP_IMPORT
+    size_t          asn_presized_int_len(long integer);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_int(u_char * data, u_char type,
+                                           long integer, size_t len);
+    NETSNMP_IMPORT
+    size_t          asn_presized_unsigned_int_len(u_long integer);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_unsigned_int(u_char * data,
+                                                    u_char type,
+                                                    u_long integer,
+                                                    size_t len);
+    NETSNMP_IMPORT
+    size_t          asn_presized_unsigned_int64_len(const struct counter64
+                                                    *cp);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_unsigned_int64(u_char * data,
+                                                      u_char type,
+                                                      const struct
+                                                      counter64 *cp,
+                                                      size_t len);
+    NETSNMP_IMPORT
+    size_t          asn_presized_objid_len(const oid * objid,
+                                           size_t objidlength);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_objid(u_char * data, u_char type,
+                                             const oid * objid,
+                                             size_t objidlength,
+                                             size_t len);
+    NETSNMP_IMPORT
+    u_char         *asn_presized_build_string(u_char * data, u_char type,
+                                              const u_char * str,
+                                              size_t len);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,37 @@
+/*
+ * container_btree.h
+ * $Id$
+ *
+ */
+#ifndef NETSNMP_CONTAINER_BTREE_H
+#define NETSNMP_CONTAINER_BTREE_H
+
+
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/factory.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    /*
+     * get a container which uses a B+-tree for storage
+     */
+    netsnmp_container *netsnmp_container_get_btree(void);
+
+    /*
+     * get a factory for producing B+-tree containers
+     */
+    netsnmp_factory   *netsnmp_container_get_btree_factory(void);
+
+    /*
+     * initialize B+-tree container. call at startup.
+     */
+    void netsnmp_container_btree_init(void);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /** NETSNMP_CONTAINER_BTREE_H */
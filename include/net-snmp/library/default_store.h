@@ -95,6 +95,10 @@ extern          "C" {
 #define NETSNMP_DS_LIB_DONT_LOAD_HOST_FILES 40 /* don't read host.conf files */
 #define NETSNMP_DS_LIB_DNSSEC_WARN_ONLY     41 /* tread DNSSEC errors as warnings */
 #define NETSNMP_DS_LIB_CLIENT_ADDR_USES_PORT 42 /* NETSNMP_DS_LIB_CLIENT_ADDR includes address and also port */
+#define NETSNMP_DS_LIB_NO_EPOLL            43 /* wait for events with select() rather than epoll */
+#define NETSNMP_DS_LIB_PDU_ARENA           44 /* parse incoming PDUs into an arena */
+#define NETSNMP_DS_LIB_NO_PRESIZED_ENCODE  45 /* reverse encode PDUs without sizing them first */
+#define NETSNMP_DS_LIB_NO_KEY_CACHE        46 /* don't cache keys derived from passphrases */
 #define NETSNMP_DS_LIB_MAX_BOOL_ID          48 /* match NETSNMP_DS_MAX_SUBIDS */
 
     /*
@@ -118,6 +122,10 @@ extern          "C" {
 #define NETSNMP_DS_SSHDOMAIN_SOCK_GROUP    13
 #define NETSNMP_DS_LIB_TIMEOUT             14
 #define NETSNMP_DS_LIB_RETRIES             15
+#define NETSNMP_DS_LIB_UDP_BATCH_SIZE      16 /* datagrams per recvmmsg() */
+#define NETSNMP_DS_LIB_UDP_LISTEN_SOCKETS  17 /* SO_REUSEPORT sockets */
+#define NETSNMP_DS_LIB_ENGINETIME_CACHE_SIZE 18 /* max engine time entries */
+#define NETSNMP_DS_LIB_UDP_BATCH_BUFFER    19 /* bytes received per UDP batch */
 #define NETSNMP_DS_LIB_MAX_INT_ID          48 /* match NETSNMP_DS_MAX_SUBIDS */
     
     /*
@@ -171,6 +179,7 @@ extern          "C" {
 #define NETSNMP_DS_LIB_SSH_PUBKEY        33
 #define NETSNMP_DS_LIB_SSH_PRIVKEY       34
 #define NETSNMP_DS_LIB_OUTPUT_PRECISION  35
+#define NETSNMP_DS_LIB_KEY_CACHE_FILE    36
 #define NETSNMP_DS_LIB_MAX_STR_ID        48 /* match NETSNMP_DS_MAX_SUBIDS */
 
     /*
@@ -128,6 +128,40 @@ void netsnmp_dispatch_external_events2(int *count,
                                        netsnmp_large_fd_set *readfds,
                                        netsnmp_large_fd_set *writefds,
                                        netsnmp_large_fd_set *exceptfds);
+
+/*
+ * epoll Backend
+ *
+ * Description:
+ *   On systems with epoll(), the sessions in the session list and the FDs
+ *   registered above are also kept in a persistent epoll set, so that the
+ *   cost of a wakeup no longer grows with the number of open sessions.
+ *   An event loop that wants to use it checks netsnmp_fd_poll_enabled()
+ *   and, if that returns true, passes a NULL fdset to snmp_select_info2()
+ *   (which then only computes the timeout), calls netsnmp_fd_poll_wait()
+ *   instead of select() and netsnmp_fd_poll_dispatch() instead of
+ *   netsnmp_dispatch_external_events2() and snmp_read2().  Otherwise it
+ *   uses select() as before.  See snmpd.c and snmptrapd.c for examples.
+ *
+ *   The epoll set is only created by the first call to
+ *   netsnmp_fd_poll_enabled(), and not at all if the "noEpoll" snmp.conf
+ *   token is set, so applications with their own select() loop are not
+ *   affected.
+ */
+#define NETSNMP_FD_POLL_READ     0x01
+#define NETSNMP_FD_POLL_WRITE    0x02
+#define NETSNMP_FD_POLL_EXCEPT   0x04
+#define NETSNMP_FD_POLL_SESSION  0x08
+
+NETSNMP_IMPORT
+int  netsnmp_fd_poll_enabled(void);
+void netsnmp_fd_poll_watch(int fd, int what, void *session);
+void netsnmp_fd_poll_unwatch(int fd, int what, void *session);
+NETSNMP_IMPORT
+int  netsnmp_fd_poll_wait(struct timeval *timeout);
+NETSNMP_IMPORT
+void netsnmp_fd_poll_dispatch(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,9 @@ extern          "C" {
                                  const u_char * Ku, size_t ku_len,
                                  u_char * Kul, size_t * kul_len);
 
+    NETSNMP_IMPORT
+    void            netsnmp_key_cache_clear(void);
+
     NETSNMP_IMPORT
     int             encode_keychange(const oid * hashtype,
                                      u_int hashtype_len, u_char * oldkey,
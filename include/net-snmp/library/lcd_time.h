@@ -18,7 +18,7 @@ extern          "C" {
     /*
      * Macros and definitions.
      */
-#define ETIMELIST_SIZE	23
+#define ETIMELIST_SIZE	23      /* initial number of hash buckets */
 
 
 
@@ -43,6 +43,14 @@ extern          "C" {
         u_int           authenticatedFlag;
 #endif
         struct enginetime_struct *next;
+
+        u_int           hash;
+        /*
+         * Neighbours in the list from the most to the least recently
+         * *   used entry.
+         */
+        struct enginetime_struct *lru_prev;
+        struct enginetime_struct *lru_next;
     } enginetime   , *Enginetime;
 
 
@@ -54,6 +54,28 @@ extern          "C" {
                                         u_int msglen, const u_char * MAC,
                                         u_int maclen);
 
+    typedef struct netsnmp_keyed_hash_s netsnmp_keyed_hash;
+
+    netsnmp_keyed_hash *sc_keyed_hash_create(const oid * authtype,
+                                             size_t authtypelen,
+                                             const u_char * key,
+                                             u_int keylen);
+    int             sc_keyed_hash_matches(const netsnmp_keyed_hash * kh,
+                                          const oid * authtype,
+                                          size_t authtypelen,
+                                          const u_char * key, u_int keylen);
+    void            sc_keyed_hash_free(netsnmp_keyed_hash * kh);
+    int             sc_generate_prepared_keyed_hash(netsnmp_keyed_hash * kh,
+                                                    const u_char * message,
+                                                    u_int msglen,
+                                                    u_char * MAC,
+                                                    size_t * maclen);
+    int             sc_check_prepared_keyed_hash(netsnmp_keyed_hash * kh,
+                                                 const u_char * message,
+                                                 u_int msglen,
+                                                 const u_char * MAC,
+                                                 u_int maclen);
+
     int             sc_encrypt(const oid * privtype, size_t privtypelen,
                                u_char * key, u_int keylen,
                                u_char * iv, u_int ivlen,
@@ -66,6 +88,28 @@ extern          "C" {
                                u_char * ciphertext, u_int ctlen,
                                u_char * plaintext, size_t * ptlen);
 
+    typedef struct netsnmp_cipher_key_s netsnmp_cipher_key;
+
+    netsnmp_cipher_key *sc_cipher_key_create(const oid * privtype,
+                                             size_t privtypelen,
+                                             const u_char * key,
+                                             u_int keylen);
+    int             sc_cipher_key_matches(const netsnmp_cipher_key * ck,
+                                          const oid * privtype,
+                                          size_t privtypelen,
+                                          const u_char * key, u_int keylen);
+    void            sc_cipher_key_free(netsnmp_cipher_key * ck);
+    int             sc_encrypt_prepared(netsnmp_cipher_key * ck,
+                                        const u_char * iv, u_int ivlen,
+                                        const u_char * plaintext,
+                                        u_int ptlen, u_char * ciphertext,
+                                        size_t * ctlen);
+    int             sc_decrypt_prepared(netsnmp_cipher_key * ck,
+                                        const u_char * iv, u_int ivlen,
+                                        const u_char * ciphertext,
+                                        u_int ctlen, u_char * plaintext,
+                                        size_t * ptlen);
+
     int             sc_hash(const oid * hashtype, size_t hashtypelen,
                             const u_char * buf, size_t buf_len,
                             u_char * MAC, size_t * MAC_len);
@@ -23,6 +23,12 @@ extern          "C" {
                              void **opaque, int *olength);
     int netsnmp_udpbase_send(netsnmp_transport *t, void *buf, int size,
                              void **opaque, int *olength);
+    int netsnmp_udpbase_close(netsnmp_transport *t);
+    int netsnmp_udpbase_batch_recv(netsnmp_transport *t, void *buf,
+                                   int size, void **opaque, int *olength,
+                                   int *rc);
+    int netsnmp_udpbase_batch_send(netsnmp_transport *t, void *buf,
+                                   int size, void **opaque, int *olength);
 
 #if defined(HAVE_IP_PKTINFO) || defined(HAVE_IP_RECVDSTADDR)
     int netsnmp_udpbase_recvfrom(int s, void *buf, int len,
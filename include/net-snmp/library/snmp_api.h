@@ -291,6 +291,22 @@ typedef struct request_list {
 
     NETSNMP_IMPORT void snmp_free_var_internals(netsnmp_variable_list *);     /* frees contents only */
 
+    NETSNMP_IMPORT
+    int             netsnmp_pdu_arena_init(netsnmp_pdu *pdu, size_t size);
+    NETSNMP_IMPORT
+    netsnmp_variable_list *netsnmp_pdu_arena_var(netsnmp_pdu *pdu,
+                                                 size_t val_len);
+
+    /*
+     * Where an arena varbind keeps a value that doesn't fit in buf.  Like
+     * buf, that storage goes away with the varbind and is never free()d.
+     */
+#define NETSNMP_VAR_ARENA_VAL(var) ((u_char *) ((var) + 1))
+#define NETSNMP_VAR_VAL_IS_LOCAL(var)                                   \
+    ((var)->val.string == (var)->buf ||                                 \
+     (((var)->flags & NETSNMP_VAR_FLAG_ARENA) &&                        \
+      (var)->val.string == NETSNMP_VAR_ARENA_VAL(var)))
+
 
     /*
      * This routine must be supplied by the application:
@@ -453,6 +469,10 @@ typedef struct request_list {
     NETSNMP_IMPORT
     int        snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len,
                                 size_t * offset, netsnmp_pdu *pdu);
+
+    NETSNMP_IMPORT
+    int        snmp_pdu_presized_rbuild(u_char ** pkt, size_t * pkt_len,
+                                 size_t * offset, netsnmp_pdu *pdu);
 #endif
 
 
@@ -715,9 +735,29 @@ struct netsnmp_transport_s;
 #define  STAT_TLSTM_STATS_START                 STAT_TLSTM_SNMPTLSTMSESSIONOPENS
 #define  STAT_TLSTM_STATS_END          STAT_TLSTM_SNMPTLSTMSESSIONINVALIDCACHES
 
+    /*
+     * engine time cache (lcd_time.c) counters
+     */
+#define  STAT_LCD_ENGINETIME_HITS            57
+#define  STAT_LCD_ENGINETIME_MISSES          58
+#define  STAT_LCD_ENGINETIME_EVICTIONS       59
+
+#define  STAT_LCD_STATS_START                STAT_LCD_ENGINETIME_HITS
+#define  STAT_LCD_STATS_END                  STAT_LCD_ENGINETIME_EVICTIONS
+
+    /*
+     * agent notification queue (agent_trap.c) counters
+     */
+#define  STAT_NOTIFY_QUEUED                  60
+#define  STAT_NOTIFY_DROPPED                 61
+#define  STAT_NOTIFY_COALESCED               62
+
+#define  STAT_NOTIFY_STATS_START             STAT_NOTIFY_QUEUED
+#define  STAT_NOTIFY_STATS_END               STAT_NOTIFY_COALESCED
+
     /* this previously was end+1; don't know why the +1 is needed;
        XXX: check the code */
-#define  NETSNMP_STAT_MAX_STATS              (STAT_TLSTM_STATS_END+1)
+#define  NETSNMP_STAT_MAX_STATS              (STAT_NOTIFY_STATS_END+1)
 /** backwards compatability */
 #define MAX_STATS NETSNMP_STAT_MAX_STATS
 
@@ -729,6 +769,9 @@ struct netsnmp_transport_s;
        netsnmp_session *session;
        netsnmp_transport *transport;
        struct snmp_internal_session *internal;
+       int poll_fd;         /* fd watched by the fd event manager's epoll set */
+       int list_flags;      /* SESS_LISTED, SESS_PENDING (snmp_api.c) */
+       struct session_list *next_pending; /* next session with requests */
     };
 
 #ifdef __cplusplus
@@ -81,6 +81,10 @@ extern          "C" {
        /* these are actually DH * pointers but only if openssl is avail. */
         void           *usmDHUserAuthKeyChange;
         void           *usmDHUserPrivKeyChange;
+       /* the keyed hash prepared for authKey, see sc_keyed_hash_create() */
+        struct netsnmp_keyed_hash_s *authKeyHash;
+       /* the key schedule prepared for privKey, see sc_cipher_key_create() */
+        struct netsnmp_cipher_key_s *privKeyCipher;
         struct usmUser *next;
         struct usmUser *prev;
     };
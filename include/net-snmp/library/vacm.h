@@ -214,6 +214,31 @@ extern          "C" {
     NETSNMP_IMPORT
     struct vacm_accessEntry *vacm_getAccessEntry(const char *,
                                                  const char *, int, int);
+    /*
+     * Returns the access entry for a securityModel, securityName,
+     * securityLevel and contextName, and sets the group entry it came
+     * through, as vacm_getGroupEntry() and vacm_getAccessEntry() would.
+     * The answers are remembered until the VACM tables change.
+     */
+    NETSNMP_IMPORT
+    struct vacm_accessEntry *vacm_getAccessEntryFor(int, const char *, int,
+                                                    const char *,
+                                                    struct vacm_groupEntry
+                                                    **);
+    /*
+     * Must be called after changing the groupName of a group entry, the
+     * contextMatch of an access entry or the mask or type of a view entry.
+     */
+    NETSNMP_IMPORT
+    void            vacm_invalidateCaches(void);
+    /*
+     * Rebuilds the view index if the VACM tables changed since it was
+     * built; until then views are looked up by scanning them.  Must not
+     * run alongside lookups: it is called after the configuration is
+     * read, and by snmpd with its worker threads locked out.
+     */
+    NETSNMP_IMPORT
+    void            vacm_buildIndexes(void);
     NETSNMP_IMPORT
     void            vacm_scanAccessInit(void);
     NETSNMP_IMPORT
@@ -258,6 +283,23 @@ extern          "C" {
                                             const char *viewName,
                                             oid * viewSubtree,
                                             size_t viewSubtreeLen, int mode);
+    NETSNMP_IMPORT
+    int             netsnmp_view_subtree_check(struct vacm_viewEntry *head,
+                                               const char *viewName,
+                                               oid * viewSubtree,
+                                               size_t viewSubtreeLen);
+    NETSNMP_IMPORT
+    struct vacm_viewEntry *netsnmp_view_create(struct vacm_viewEntry **head,
+                                               const char *viewName,
+                                               oid * viewSubtree,
+                                               size_t viewSubtreeLen);
+    NETSNMP_IMPORT
+    void            netsnmp_view_destroy(struct vacm_viewEntry **head,
+                                         const char *viewName,
+                                         oid * viewSubtree,
+                                         size_t viewSubtreeLen);
+    NETSNMP_IMPORT
+    void            netsnmp_view_clear(struct vacm_viewEntry **head);
 
 
 #ifdef __cplusplus
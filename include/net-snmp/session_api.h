@@ -102,6 +102,14 @@ extern          "C" {
     NETSNMP_IMPORT
     void            snmp_read2(netsnmp_large_fd_set *);
 
+    /*
+     * snmp_read_ready() reads from one session of the session list that
+     * is known to be readable, e.g. because the epoll backend of the fd
+     * event manager reported it.
+     */
+    NETSNMP_IMPORT
+    void            snmp_read_ready(void *);
+
 
     NETSNMP_IMPORT
     int             snmp_synch_response(netsnmp_session *, netsnmp_pdu *,
@@ -141,7 +149,8 @@ extern          "C" {
     /*
      * snmp_select_info2() is similar to snmp_select_info(), but accepts a
      * pointer to a large file descriptor set instead of a pointer to a
-     * regular file descriptor set.
+     * regular file descriptor set.  The set may be NULL when the caller
+     * only needs the timeout, e.g. because it waits with epoll.
      */
     NETSNMP_IMPORT
     int             snmp_select_info2(int *, netsnmp_large_fd_set *,
@@ -229,6 +238,9 @@ extern          "C" {
     int             snmp_sess_async_send(void *, netsnmp_pdu *,
                                          netsnmp_callback, void *);
     NETSNMP_IMPORT
+    int             snmp_sess_encode(void *, netsnmp_pdu *, u_char **,
+                                     u_char **, size_t *);
+    NETSNMP_IMPORT
     int             snmp_sess_select_info(void *, int *, fd_set *,
                                           struct timeval *, int *);
     NETSNMP_IMPORT
@@ -157,8 +157,15 @@ typedef struct variable_list {
    /** callback to free above */
    void            (*dataFreeHook)(void *);    
    int             index;
+   /** NETSNMP_VAR_FLAG_* bits describing how the varbind is stored */
+   u_char          flags;
 } netsnmp_variable_list;
 
+/** the varbind is part of a larger block and mustn't be freed on its own */
+#define NETSNMP_VAR_FLAG_POOLED     0x01
+/** the varbind was carved from a PDU arena, see netsnmp_pdu_arena_init() */
+#define NETSNMP_VAR_FLAG_ARENA      0x02
+
 
 /** @typedef struct snmp_pdu to netsnmp_pdu
  * Typedefs the snmp_pdu struct into netsnmp_pdu */
@@ -265,6 +272,9 @@ typedef struct snmp_pdu {
     int             range_subid;
     
     void           *securityStateRef;
+
+    /** varbind storage, see netsnmp_pdu_arena_init() */
+    void           *arena;
 } netsnmp_pdu;
 
 
@@ -226,6 +226,11 @@ SOFTWARE.
     } while(0)
 #endif
 
+/*
+ * The continuation bit of every byte in a u_long.
+ */
+#define ASN_SUBID_CONT_BITS ((~0UL / 0xff) * ASN_BIT8)
+
 /**
  * @internal
  * output an error for a wrong size
@@ -458,6 +463,26 @@ _asn_bitstring_check(const char *str, size_t asn_length, u_char datum)
     return 0;
 }
 
+/*
+ * Fast path for the common case of a short form length.  Returns the
+ * length of the object at data if it is encoded in a single byte, is
+ * between 1 and maxlen and fits in the dlen bytes left, otherwise 0, in
+ * which case the caller falls back to asn_parse_length() and the full
+ * checks.
+ */
+static NETSNMP_INLINE u_long
+_asn_parse_short_length(const u_char * data, size_t maxlen, size_t dlen)
+{
+    u_long          length;
+
+    if (dlen < 2)
+        return 0;
+    length = data[1];
+    if (length == 0 || length > maxlen || length + 2 > dlen)
+        return 0;
+    return length;
+}
+
 /**
  * @internal 
  * asn_parse_int - pulls a long out of an int type.
@@ -502,14 +527,19 @@ asn_parse_int(u_char * data,
         return NULL;
     }
 
-    bufp = asn_parse_length(bufp, &asn_length);
-    if (_asn_parse_length_check
-        (errpre, bufp, data, asn_length, *datalength))
-        return NULL;
+    asn_length = _asn_parse_short_length(data, intsize, *datalength);
+    if (asn_length) {
+        bufp++;
+    } else {
+        bufp = asn_parse_length(bufp, &asn_length);
+        if (_asn_parse_length_check
+            (errpre, bufp, data, asn_length, *datalength))
+            return NULL;
 
-    if ((size_t) asn_length > intsize || (int) asn_length == 0) {
-        _asn_length_err(errpre, (size_t) asn_length, intsize);
-        return NULL;
+        if ((size_t) asn_length > intsize || (int) asn_length == 0) {
+            _asn_length_err(errpre, (size_t) asn_length, intsize);
+            return NULL;
+        }
     }
 
     *datalength -= (int) asn_length + (bufp - data);
@@ -574,15 +604,20 @@ asn_parse_unsigned_int(u_char * data,
         _asn_type_err(errpre, *type);
         return NULL;
     }
-    bufp = asn_parse_length(bufp, &asn_length);
-    if (_asn_parse_length_check
-        (errpre, bufp, data, asn_length, *datalength))
-        return NULL;
+    asn_length = _asn_parse_short_length(data, intsize, *datalength);
+    if (asn_length) {
+        bufp++;
+    } else {
+        bufp = asn_parse_length(bufp, &asn_length);
+        if (_asn_parse_length_check
+            (errpre, bufp, data, asn_length, *datalength))
+            return NULL;
 
-    if ((asn_length > (intsize + 1)) || ((int) asn_length == 0) ||
-        ((asn_length == intsize + 1) && *bufp != 0x00)) {
-        _asn_length_err(errpre, (size_t) asn_length, intsize);
-        return NULL;
+        if ((asn_length > (intsize + 1)) || ((int) asn_length == 0) ||
+            ((asn_length == intsize + 1) && *bufp != 0x00)) {
+            _asn_length_err(errpre, (size_t) asn_length, intsize);
+            return NULL;
+        }
     }
     *datalength -= (int) asn_length + (bufp - data);
     if (*bufp & 0x80)
@@ -1330,16 +1365,22 @@ asn_parse_objid(u_char * data,
     register long   length;
     u_long          asn_length;
     size_t          original_length = *objidlength;
+    size_t          i;
 
     *type = *bufp++;
     if (*type != ASN_OBJECT_ID) {
         _asn_type_err(errpre, *type);
         return NULL;
     }
-    bufp = asn_parse_length(bufp, &asn_length);
-    if (_asn_parse_length_check("parse objid", bufp, data,
-                                asn_length, *datalength))
-        return NULL;
+    asn_length = _asn_parse_short_length(data, 0x7f, *datalength);
+    if (asn_length) {
+        bufp++;
+    } else {
+        bufp = asn_parse_length(bufp, &asn_length);
+        if (_asn_parse_length_check("parse objid", bufp, data,
+                                    asn_length, *datalength))
+            return NULL;
+    }
 
     *datalength -= (int) asn_length + (bufp - data);
 
@@ -1354,7 +1395,28 @@ asn_parse_objid(u_char * data,
     length = asn_length;
     (*objidlength)--;           /* account for expansion of first byte */
 
-    while (length > 0 && (*objidlength)-- > 0) {
+    while (length > 0 && *objidlength > 0) {
+        /*
+         * Most sub-identifiers fit in a single byte: copy a word's worth
+         * of them at a time while no continuation bit is set.
+         */
+        if (length >= (long) sizeof(u_long) &&
+            *objidlength >= sizeof(u_long)) {
+            u_long          word;
+
+            memcpy(&word, bufp, sizeof(word));
+            if (!(word & ASN_SUBID_CONT_BITS)) {
+                for (i = 0; i < sizeof(u_long); i++)
+                    oidp[i] = bufp[i];
+                oidp += sizeof(u_long);
+                bufp += sizeof(u_long);
+                length -= sizeof(u_long);
+                *objidlength -= sizeof(u_long);
+                continue;
+            }
+        }
+        (*objidlength)--;
+
         subidentifier = 0;
         do {                    /* shift and add in low order 7 bits */
             subidentifier =
@@ -3729,6 +3791,365 @@ asn_realloc_rbuild_double(u_char ** pkt, size_t * pkt_len,
 }
 
 #endif                          /* NETSNMP_WITH_OPAQUE_SPECIAL_TYPES */
+
+/*
+ * Presized forward encoding.
+ *
+ * These functions encode exactly the same octets as their
+ * asn_realloc_rbuild_* counterparts, but in two steps: the caller first asks
+ * for the length of every item (the *_len functions), so that the lengths
+ * of the enclosing constructions are known before anything is written, and
+ * then writes each item front to back into space it has already reserved.
+ * No bounds checking is done while writing.
+ */
+
+/**
+ * Makes sure there are at least need octets free in front of the data
+ * already reverse encoded at the end of a buffer, growing the buffer by
+ * exactly the missing amount if there are not.
+ *
+ * @param pkt     IN/OUT address of the begining of the buffer.
+ * @param pkt_len IN/OUT address to an integer containing the size of pkt.
+ * @param offset  IN the number of octets used at the end of the buffer.
+ * @param need    IN the number of octets to be written in front of them.
+ *
+ * @return 1 on success, 0 on error (the buffer is left unchanged).
+ */
+int
+asn_presized_reserve(u_char ** pkt, size_t * pkt_len, size_t offset,
+                     size_t need)
+{
+    u_char         *new_pkt;
+    size_t          new_len;
+
+    if (*pkt_len - offset >= need) {
+        return 1;
+    }
+    new_len = offset + need;
+    new_pkt = (u_char *) realloc(*pkt, new_len);
+    if (new_pkt == NULL) {
+        return 0;
+    }
+    memmove(new_pkt + new_len - offset, new_pkt + *pkt_len - offset,
+            offset);
+    *pkt = new_pkt;
+    *pkt_len = new_len;
+    return 1;
+}
+
+/**
+ * Returns the number of octets taken by the type and length of an object.
+ *
+ * @param length  IN length of the object's contents.
+ */
+size_t
+asn_presized_header_len(size_t length)
+{
+    size_t          len = 2;
+
+    if (length > 0x7f) {
+        for (; length; length >>= 8) {
+            len++;
+        }
+    }
+    return len;
+}
+
+/**
+ * Writes the type and length of an object.
+ *
+ * @param data    IN pointer to where to write.
+ * @param type    IN type of the object.
+ * @param length  IN length of the object's contents.
+ *
+ * @return pointer to the first octet after the header.
+ */
+u_char         *
+asn_presized_build_header(u_char * data, u_char type, size_t length)
+{
+    size_t          len, i;
+
+    *data++ = type;
+    if (length <= 0x7f) {
+        *data++ = (u_char) length;
+        return data;
+    }
+    len = asn_presized_header_len(length) - 2;
+    *data++ = (u_char) (0x80 | len);
+    for (i = len; i > 0; i--) {
+        data[i - 1] = (u_char) length;
+        length >>= 8;
+    }
+    return data + len;
+}
+
+/**
+ * Returns the length of the contents of an integer.
+ *
+ * @see asn_realloc_rbuild_int
+ */
+size_t
+asn_presized_int_len(long integer)
+{
+    size_t          len = 1;
+    long            testvalue;
+    u_char          top;
+
+    CHECK_OVERFLOW_S(integer,14);
+    testvalue = (integer < 0) ? -1 : 0;
+
+    top = (u_char) integer;
+    integer >>= 8;
+    while (integer != testvalue) {
+        top = (u_char) integer;
+        integer >>= 8;
+        len++;
+    }
+    if ((top & 0x80) != (testvalue & 0x80)) {
+        len++;
+    }
+    return len;
+}
+
+/**
+ * Writes an integer whose contents are len octets long.
+ *
+ * @return pointer to the first octet after the object.
+ */
+u_char         *
+asn_presized_build_int(u_char * data, u_char type, long integer,
+                       size_t len)
+{
+    size_t          i;
+
+    CHECK_OVERFLOW_S(integer,15);
+
+    data = asn_presized_build_header(data, type, len);
+    for (i = len; i > 0; i--) {
+        data[i - 1] = (u_char) integer;
+        integer >>= 8;
+    }
+    return data + len;
+}
+
+/**
+ * Returns the length of the contents of an unsigned integer.
+ *
+ * @see asn_realloc_rbuild_unsigned_int
+ */
+size_t
+asn_presized_unsigned_int_len(u_long integer)
+{
+    size_t          len = 1;
+    u_char          top;
+
+    CHECK_OVERFLOW_U(integer,16);
+
+    top = (u_char) integer;
+    integer >>= 8;
+    while (integer != 0) {
+        top = (u_char) integer;
+        integer >>= 8;
+        len++;
+    }
+    if (top & 0x80) {
+        len++;
+    }
+    return len;
+}
+
+/**
+ * Writes an unsigned integer whose contents are len octets long.
+ *
+ * @return pointer to the first octet after the object.
+ */
+u_char         *
+asn_presized_build_unsigned_int(u_char * data, u_char type,
+                                u_long integer, size_t len)
+{
+    size_t          i;
+
+    CHECK_OVERFLOW_U(integer,17);
+
+    data = asn_presized_build_header(data, type, len);
+    for (i = len; i > 0; i--) {
+        data[i - 1] = (u_char) integer;
+        integer >>= 8;
+    }
+    return data + len;
+}
+
+/**
+ * Returns the length of the contents of an unsigned 64-bit integer.
+ *
+ * @see asn_realloc_rbuild_unsigned_int64
+ */
+size_t
+asn_presized_unsigned_int64_len(const struct counter64 *cp)
+{
+    u_long          low = cp->low, high = cp->high;
+
+    CHECK_OVERFLOW_U(high,18);
+    CHECK_OVERFLOW_U(low,18);
+
+    if (high) {
+        return 4 + asn_presized_unsigned_int_len(high);
+    }
+    return asn_presized_unsigned_int_len(low);
+}
+
+/**
+ * Writes an unsigned 64-bit integer whose contents are len octets long.
+ *
+ * @return pointer to the first octet after the object.
+ */
+u_char         *
+asn_presized_build_unsigned_int64(u_char * data, u_char type,
+                                  const struct counter64 *cp, size_t len)
+{
+    u_long          low = cp->low, high = cp->high;
+    size_t          i;
+
+    CHECK_OVERFLOW_U(high,19);
+    CHECK_OVERFLOW_U(low,19);
+
+    data = asn_presized_build_header(data, type, len);
+    for (i = len; i > 0; i--) {
+        if (len - i < 4) {
+            data[i - 1] = (u_char) low;
+            low >>= 8;
+        } else {
+            data[i - 1] = (u_char) high;
+            high >>= 8;
+        }
+    }
+    return data + len;
+}
+
+/*
+ * Returns the number of octets a sub-identifier is encoded in.
+ */
+static NETSNMP_INLINE size_t
+_asn_presized_subid_len(oid subid)
+{
+    size_t          len = 5;
+
+    if (subid < 0x10000000) {
+        return 1 + (subid >= 0x80) + (subid >= 0x4000) +
+            (subid >= 0x200000);
+    }
+    for (subid >>= 28; subid >>= 7;) {
+        len++;
+    }
+    return len;
+}
+
+static NETSNMP_INLINE u_char *
+_asn_presized_build_subid(u_char * data, oid subid)
+{
+    size_t          i, len;
+
+    if (subid < 0x80) {
+        *data = (u_char) subid;
+        return data + 1;
+    }
+    len = _asn_presized_subid_len(subid);
+    data[len - 1] = (u_char) subid & 0x7f;
+    for (i = len - 1; i > 0; i--) {
+        subid >>= 7;
+        data[i - 1] = (u_char) ((subid & 0x7f) | 0x80);
+    }
+    return data + len;
+}
+
+/**
+ * Returns the length of the contents of an object identifier, or 0 if it
+ * cannot be encoded.
+ *
+ * @see asn_realloc_rbuild_objid
+ */
+size_t
+asn_presized_objid_len(const oid * objid, size_t objidlength)
+{
+    size_t          i, len;
+    oid             subid;
+
+    if (objidlength == 0) {
+        return 2;
+    }
+    if (objid[0] > 2) {
+        return 0;
+    }
+    if (objidlength == 1) {
+        return 1;
+    }
+    if ((objid[1] > 40) && (objid[0] < 2)) {
+        return 0;
+    }
+    len = _asn_presized_subid_len(objid[0] * 40 + objid[1]);
+    for (i = 2; i < objidlength; i++) {
+        subid = objid[i];
+        if (subid < 0x80) {
+            len++;
+            continue;
+        }
+        CHECK_OVERFLOW_U(subid,20);
+        len += _asn_presized_subid_len(subid);
+    }
+    return len;
+}
+
+/**
+ * Writes an object identifier whose contents are len octets long, as
+ * returned by asn_presized_objid_len().
+ *
+ * @return pointer to the first octet after the object.
+ */
+u_char         *
+asn_presized_build_objid(u_char * data, u_char type,
+                         const oid * objid, size_t objidlength,
+                         size_t len)
+{
+    size_t          i;
+    oid             subid;
+
+    data = asn_presized_build_header(data, type, len);
+    if (objidlength == 0) {
+        *data++ = 0;
+        *data++ = 0;
+    } else if (objidlength == 1) {
+        *data++ = (u_char) objid[0];
+    } else {
+        data = _asn_presized_build_subid(data, objid[0] * 40 + objid[1]);
+        for (i = 2; i < objidlength; i++) {
+            subid = objid[i];
+            if (subid < 0x80) {
+                *data++ = (u_char) subid;
+                continue;
+            }
+            CHECK_OVERFLOW_U(subid,21);
+            data = _asn_presized_build_subid(data, subid);
+        }
+    }
+    return data;
+}
+
+/**
+ * Writes an object whose contents are the len octets at str, such as an
+ * octet string or a bit string.  A null object is written with a len of 0.
+ *
+ * @return pointer to the first octet after the object.
+ */
+u_char         *
+asn_presized_build_string(u_char * data, u_char type,
+                          const u_char * str, size_t len)
+{
+    data = asn_presized_build_header(data, type, len);
+    if (len) {
+        memcpy(data, str, len);
+    }
+    return data + len;
+}
 #endif                          /*  NETSNMP_USE_REVERSE_ASNENCODING  */
 /**
  * @}
@@ -99,6 +99,10 @@ static const char *lib[MAX_CALLBACK_SUBIDS] = {
  * callback list is modified while being traversed. Not intended
  * to do any real protection, or in any way imply that this code
  * has been evaluated for use in a multi-threaded environment.
+ * (Reentrant builds guard the lists with the MT_LIB_CALLBACK mutex, which
+ * is only held while a list is walked or changed, never while a callback
+ * runs.  The counts below then count the walks in progress in any thread,
+ * so that a callback unregistered meanwhile is only marked unused.)
  * In 5.2, it was a single lock. For 5.3, it has been updated to
  * a lock per callback, since a particular callback may trigger
  * registration/unregistration of other callbacks (eg AgentX
@@ -120,8 +124,10 @@ static int _lock;
 NETSNMP_STATIC_INLINE int
 _callback_lock(int major, int minor, const char* warn, int do_assert)
 {
+#ifndef NETSNMP_REENTRANT
     int lock_holded=0;
     struct timeval lock_time = { 0, 1000 };
+#endif
 
 #ifdef NETSNMP_PARANOID_LEVEL_HIGH
     if (major >= MAX_CALLBACK_IDS || minor >= MAX_CALLBACK_SUBIDS) {
@@ -129,12 +135,19 @@ _callback_lock(int major, int minor, const char* warn, int do_assert)
         return 1;
     }
 #endif
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_CALLBACK);
     
 #ifdef CALLBACK_NAME_LOGGING
     DEBUGMSGTL(("9:callback:lock", "locked (%s,%s)\n",
                 types[major], (SNMP_CALLBACK_LIBRARY == major) ?
                 SNMP_STRORNULL(lib[minor]) : "null"));
 #endif
+#ifndef NETSNMP_REENTRANT
+    /*
+     * in reentrant builds a raised count may just be a walk in another
+     * thread, which does not mind the list changing, so don't wait there.
+     */
     while (CALLBACK_LOCK_COUNT(major,minor) >= 1 && ++lock_holded < 100)
 	select(0, NULL, NULL, NULL, &lock_time);
 
@@ -147,6 +160,7 @@ _callback_lock(int major, int minor, const char* warn, int do_assert)
         
         return 1;
     }
+#endif
 
     CALLBACK_LOCK(major,minor);
     return 0;
@@ -163,6 +177,7 @@ _callback_unlock(int major, int minor)
 #endif
     
     CALLBACK_UNLOCK(major,minor);
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_CALLBACK);
 
 #ifdef CALLBACK_NAME_LOGGING
     DEBUGMSGTL(("9:callback:lock", "unlocked (%s,%s)\n",
@@ -188,6 +203,7 @@ init_callbacks(void)
     
     _callback_need_init = 0;
     
+    snmp_res_init();
     memset(thecallbacks, 0, sizeof(thecallbacks)); 
 #ifdef LOCK_PER_CALLBACK_SUBID
     memset(_locks, 0, sizeof(_locks));
@@ -320,6 +336,8 @@ int
 snmp_call_callbacks(int major, int minor, void *caller_arg)
 {
     struct snmp_gen_callback *scp;
+    SNMPCallback   *callback;
+    void           *client_arg;
     unsigned int    count = 0;
     
     if (major >= MAX_CALLBACK_IDS || minor >= MAX_CALLBACK_SUBIDS) {
@@ -351,17 +369,21 @@ snmp_call_callbacks(int major, int minor, void *caller_arg)
         /*
          * skip unregistered callbacks
          */
-        if(NULL == scp->sc_callback)
+        callback = scp->sc_callback;
+        client_arg = scp->sc_client_arg;
+        if(NULL == callback)
             continue;
 
         DEBUGMSGTL(("callback", "calling a callback for maj=%d min=%d\n",
                     major, minor));
 
         /*
-         * call them 
+         * call them.  scp stays in the list while the count is raised,
+         * so other threads may walk and change it in the meantime.
          */
-        (*(scp->sc_callback)) (major, minor, caller_arg,
-                               scp->sc_client_arg);
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_CALLBACK);
+        (*callback) (major, minor, caller_arg, client_arg);
+        snmp_res_lock(MT_LIBRARY_ID, MT_LIB_CALLBACK);
         count++;
     }
 
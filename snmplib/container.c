@@ -15,6 +15,7 @@
 #include <net-snmp/library/container_binary_array.h>
 #include <net-snmp/library/container_list_ssll.h>
 #include <net-snmp/library/container_null.h>
+#include <net-snmp/library/container_btree.h>
 
 netsnmp_feature_child_of(container_all, libnetsnmp)
 
@@ -93,6 +94,9 @@ netsnmp_container_init_list(void)
 #ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_NULL
     netsnmp_container_null_init();
 #endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_NULL */
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_BTREE
+    netsnmp_container_btree_init();
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_BTREE */
 
     /*
      * default aliases for some containers
@@ -203,6 +207,13 @@ netsnmp_container_find_factory(const char *type_list)
     if (NULL==type_list)
         return NULL;
 
+    /*
+     * a type registered under the whole list takes precedence
+     */
+    f = netsnmp_container_get_factory(type_list);
+    if (NULL != f)
+        return f;
+
     list = strdup(type_list);
     if (!list)
         return NULL;
@@ -243,6 +254,14 @@ netsnmp_container_find_ct(const char *type_list)
     if (NULL==type_list)
         return NULL;
 
+    /*
+     * a type registered under the whole list (e.g. "table_container:btree")
+     * takes precedence over its parts
+     */
+    ct = netsnmp_container_get_ct(type_list);
+    if (NULL != ct)
+        return ct;
+
     list = strdup(type_list);
     if (!list)
         return NULL;
@@ -32,12 +32,20 @@
 #include <net-snmp/library/container_binary_array.h>
 #include <net-snmp/library/tools.h>
 #include <net-snmp/library/snmp_assert.h>
+#include <net-snmp/library/mt_support.h>
 
 typedef struct binary_array_table_s {
     size_t                     max_size;   /* Size of the current data table */
     size_t                     count;      /* Index of the next free entry */
     int                        dirty;
     void                     **data;       /* The table itself */
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    /*
+     * readers sort the table when they first need it sorted, and agent
+     * worker threads may be reading it at the same time
+     */
+    pthread_mutex_t            sort_lock;
+#endif
 } binary_array_table;
 
 typedef struct binary_array_iterator_s {
@@ -100,6 +108,9 @@ Sort_Array(netsnmp_container *c)
     if (c->flags & CONTAINER_KEY_UNSORTED)
         return 0;
 
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_mutex_lock(&t->sort_lock);
+#endif
     if (t->dirty) {
         /*
          * Sort the table 
@@ -113,6 +124,9 @@ Sort_Array(netsnmp_container *c)
          */
         ++c->sync;
     }
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_mutex_unlock(&t->sort_lock);
+#endif
 
     return 1;
 }
@@ -165,8 +179,7 @@ binary_search(const void *val, netsnmp_container *c, int exact)
         return linear_search(val, c);
     }
 
-    if (t->dirty)
-        Sort_Array(c);
+    Sort_Array(c);
 
     while (len > 0) {
         half = len >> 1;
@@ -231,6 +244,9 @@ netsnmp_binary_array_initialize(void)
     t->count = 0;
     t->dirty = 0;
     t->data = NULL;
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_mutex_init(&t->sort_lock, NULL);
+#endif
 
     return t;
 }
@@ -239,6 +255,9 @@ void
 netsnmp_binary_array_release(netsnmp_container *c)
 {
     binary_array_table *t = (binary_array_table*)c->container_data;
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_mutex_destroy(&t->sort_lock);
+#endif
     SNMP_FREE(t->data);
     SNMP_FREE(t);
     SNMP_FREE(c);
@@ -285,8 +304,7 @@ netsnmp_binary_array_get(netsnmp_container *c, const void *key, int exact)
     /*
      * if the table is dirty, sort it.
      */
-    if (t->dirty)
-        Sort_Array(c);
+    Sort_Array(c);
 
     /*
      * if there is a key, search. Otherwise default is 0;
@@ -371,8 +389,7 @@ netsnmp_binary_array_remove(netsnmp_container *c, const void *key, void **save)
     /*
      * if the table is dirty, sort it.
      */
-    if (t->dirty)
-        Sort_Array(c);
+    Sort_Array(c);
 
     /*
      * search
@@ -391,7 +408,7 @@ netsnmp_binary_array_for_each(netsnmp_container *c,
     binary_array_table *t = (binary_array_table*)c->container_data;
     size_t             i;
 
-    if (sort && t->dirty)
+    if (sort)
         Sort_Array(c);
 
     for (i = 0; i < t->count; ++i)
@@ -493,8 +510,7 @@ binary_search_for_start(netsnmp_index *val, netsnmp_container *c)
     if (!len)
         return -1;
 
-    if (t->dirty)
-        Sort_Array(c);
+    Sort_Array(c);
 
     while (len > 0) {
         half = len >> 1;
@@ -537,8 +553,7 @@ netsnmp_binary_array_get_subset(netsnmp_container *c, void *key, int *len)
     /*
      * if the table is dirty, sort it.
      */
-    if (t->dirty)
-        Sort_Array(c);
+    Sort_Array(c);
 
     /*
      * find matching items
@@ -861,8 +876,7 @@ _ba_iterator_reset(binary_array_iterator *it)
         return -1;
     }
 
-    if (t->dirty)
-        Sort_Array(it->base.container);
+    Sort_Array(it->base.container);
 
     /*
      * save sync count, to make sure container doesn't change while
@@ -0,0 +1,906 @@
+/*
+ * container_btree.c
+ * $Id$
+ *
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <sys/types.h>
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/types.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/tools.h>
+#include <net-snmp/library/snmp_assert.h>
+
+#include <net-snmp/library/container_btree.h>
+
+netsnmp_feature_child_of(container_btree, container_types)
+
+/** @defgroup btree_container btree_container
+ *  A container which keeps its items in a B+-tree.
+ *  @ingroup container
+ *
+ *  Items are kept in order in leaves of up to BTREE_ORDER items, which
+ *  are linked to each other in key order; the nodes above them hold
+ *  the first item of each of their children.  Inserting or removing an
+ *  item only moves the items of one leaf, instead of up to all of the
+ *  items of a binary_array, which makes this container a better fit
+ *  for large tables whose rows come and go one at a time.
+ *
+ *  Duplicate keys are kept if CONTAINER_KEY_ALLOW_DUPLICATES is set:
+ *  find returns the first of them, find_next the first item after all
+ *  of them, and remove the item passed in if it is one of them.
+ *  CONTAINER_KEY_UNSORTED is not supported.
+ *
+ *  @{
+ */
+
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_BTREE
+
+#define BTREE_ORDER     32      /* items in a leaf, children of a node */
+#define BTREE_MIN       (BTREE_ORDER / 4)
+#define BTREE_MAX_DEPTH 24
+
+typedef struct btree_node_s {
+    int                  leaf;
+    int                  count;
+    struct btree_node_s *prev, *next;   /* neighbouring leaves */
+    /*
+     * the items of a leaf, or the first item of each child of a node
+     */
+    void                *items[BTREE_ORDER];
+    /*
+     * BTREE_ORDER children, allocated after the node; NULL for leaves
+     */
+    struct btree_node_s **children;
+} btree_node;
+
+typedef struct btree_pos_s {
+    btree_node          *node;
+    int                  pos;
+} btree_pos;
+
+typedef struct btree_container_s {
+    netsnmp_container    c;
+
+    size_t               count;
+    int                  depth;         /* levels below the root */
+    btree_node          *root;
+} btree_container;
+
+typedef struct btree_iterator_s {
+    netsnmp_iterator     base;
+
+    btree_node          *leaf;
+    int                  pos;
+} btree_iterator;
+
+static netsnmp_iterator *_btree_iterator_get(netsnmp_container *c);
+
+/**********************************************************************
+ *
+ * nodes
+ *
+ */
+static btree_node *
+_btree_node_new(int leaf)
+{
+    btree_node *n;
+
+    if (leaf)
+        n = (btree_node *) calloc(1, sizeof(btree_node));
+    else
+        n = (btree_node *) calloc(1, sizeof(btree_node) +
+                                  BTREE_ORDER * sizeof(btree_node *));
+    if (NULL == n)
+        return NULL;
+    n->leaf = leaf;
+    if (!leaf)
+        n->children = (btree_node **) (n + 1);
+    return n;
+}
+
+static void
+_btree_node_free(btree_node *n)
+{
+    int i;
+
+    if (!n->leaf)
+        for (i = 0; i < n->count; ++i)
+            _btree_node_free(n->children[i]);
+    free(n);
+}
+
+/*
+ * puts an item (and for nodes, the child it is the first item of) at
+ * position pos of a node that is not full
+ */
+static void
+_btree_node_put(btree_node *n, int pos, void *item, btree_node *child)
+{
+    netsnmp_assert(n->count < BTREE_ORDER);
+
+    memmove(&n->items[pos + 1], &n->items[pos],
+            (n->count - pos) * sizeof(void *));
+    n->items[pos] = item;
+    if (!n->leaf) {
+        memmove(&n->children[pos + 1], &n->children[pos],
+                (n->count - pos) * sizeof(btree_node *));
+        n->children[pos] = child;
+    }
+    ++n->count;
+}
+
+static void
+_btree_node_take(btree_node *n, int pos)
+{
+    --n->count;
+    memmove(&n->items[pos], &n->items[pos + 1],
+            (n->count - pos) * sizeof(void *));
+    if (!n->leaf)
+        memmove(&n->children[pos], &n->children[pos + 1],
+                (n->count - pos) * sizeof(btree_node *));
+}
+
+/*
+ * appends the items of src to dst, and frees src
+ */
+static void
+_btree_node_merge(btree_node *dst, btree_node *src)
+{
+    netsnmp_assert(dst->count + src->count <= BTREE_ORDER);
+
+    memcpy(&dst->items[dst->count], src->items,
+           src->count * sizeof(void *));
+    if (dst->leaf) {
+        dst->next = src->next;
+        if (src->next)
+            src->next->prev = dst;
+    } else
+        memcpy(&dst->children[dst->count], src->children,
+               src->count * sizeof(btree_node *));
+    dst->count += src->count;
+    free(src);
+}
+
+/*
+ * returns the position of the first item of a node which is not less
+ * than key or, if upper is set, greater than key
+ */
+NETSNMP_STATIC_INLINE int
+_btree_node_search(btree_node *n, const void *key, int upper,
+                   netsnmp_container_compare *f)
+{
+    int lo = 0, hi = n->count, mid, rc;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        rc = (*f)(n->items[mid], key);
+        if (rc < 0 || (upper && rc == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**********************************************************************
+ *
+ * paths from the root to a leaf
+ *
+ */
+
+/*
+ * fills in the path to the first item not less than (or, if upper is
+ * set, greater than) key.  The position in the leaf may be past its
+ * last item, in which case the item is the first of the next leaf.
+ */
+static void
+_btree_search(btree_container *bt, const void *key, int upper,
+              netsnmp_container_compare *f, btree_pos *path)
+{
+    btree_node *n = bt->root;
+    int         level, pos;
+
+    for (level = 0; level < bt->depth; ++level) {
+        pos = _btree_node_search(n, key, upper, f);
+        if (pos > 0)
+            --pos;
+        path[level].node = n;
+        path[level].pos = pos;
+        n = n->children[pos];
+    }
+    path[level].node = n;
+    path[level].pos = _btree_node_search(n, key, upper, f);
+}
+
+/*
+ * moves the path on to the first item of the next leaf
+ */
+static int
+_btree_path_next_leaf(btree_container *bt, btree_pos *path)
+{
+    int level;
+
+    for (level = bt->depth - 1; level >= 0; --level)
+        if (path[level].pos + 1 < path[level].node->count)
+            break;
+    if (level < 0)
+        return 0;
+
+    ++path[level].pos;
+    for (++level; level <= bt->depth; ++level) {
+        path[level].node =
+            path[level - 1].node->children[path[level - 1].pos];
+        path[level].pos = 0;
+    }
+    return 1;
+}
+
+/*
+ * the first item of the node at this level of the path has changed:
+ * update the nodes above it
+ */
+static void
+_btree_path_fix_first(btree_pos *path, int level)
+{
+    for (; level > 0; --level) {
+        path[level - 1].node->items[path[level - 1].pos] =
+            path[level].node->items[0];
+        if (path[level - 1].pos != 0)
+            break;
+    }
+}
+
+/**********************************************************************
+ *
+ * container
+ *
+ */
+static btree_node *
+_btree_leftmost(btree_container *bt)
+{
+    btree_node *n = bt->root;
+
+    while (!n->leaf)
+        n = n->children[0];
+    return n;
+}
+
+static btree_node *
+_btree_rightmost(btree_container *bt)
+{
+    btree_node *n = bt->root;
+
+    while (!n->leaf)
+        n = n->children[n->count - 1];
+    return n;
+}
+
+static void *
+_btree_get(netsnmp_container *c, const void *key, int exact)
+{
+    btree_container *bt = (btree_container *)c;
+    btree_pos   path[BTREE_MAX_DEPTH + 1];
+    btree_node *leaf;
+    int         pos;
+    void       *item;
+
+    if (!bt->count)
+        return NULL;
+
+    if (NULL == key)
+        return bt->root->items[0];
+
+    _btree_search(bt, key, !exact, c->compare, path);
+    leaf = path[bt->depth].node;
+    pos = path[bt->depth].pos;
+    if (pos == leaf->count) {
+        leaf = leaf->next;
+        if (NULL == leaf)
+            return NULL;
+        pos = 0;
+    }
+    item = leaf->items[pos];
+
+    if (exact && c->compare(item, key) != 0)
+        return NULL;
+    return item;
+}
+
+static void *
+_btree_find(netsnmp_container *c, const void *data)
+{
+    return _btree_get(c, data, 1);
+}
+
+static void *
+_btree_find_next(netsnmp_container *c, const void *data)
+{
+    return _btree_get(c, data, 0);
+}
+
+static int
+_btree_insert(netsnmp_container *c, const void *data)
+{
+    btree_container *bt = (btree_container *)c;
+    btree_pos   path[BTREE_MAX_DEPTH + 1];
+    btree_node *spare[BTREE_MAX_DEPTH + 2];
+    btree_node *n, *split, *child = NULL;
+    void       *item = NETSNMP_REMOVE_CONST(void *, data);
+    int         level, pos, half = BTREE_ORDER / 2, needed = 0, used = 0;
+
+    _btree_search(bt, data, 1, c->compare, path);
+
+    /*
+     * the position is after any duplicates, so only the item before it
+     * can have the same key
+     */
+    if (!(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES) &&
+        path[bt->depth].pos > 0 &&
+        c->compare(path[bt->depth].node->items[path[bt->depth].pos - 1],
+                   data) == 0) {
+        DEBUGMSGTL(("container", "not inserting duplicate key\n"));
+        return -1;
+    }
+
+    /*
+     * allocate the nodes needed for splitting full nodes up front, so
+     * that running out of memory leaves the tree as it was
+     */
+    for (level = bt->depth;
+         level >= 0 && path[level].node->count == BTREE_ORDER; --level) {
+        spare[needed] = _btree_node_new(level == bt->depth);
+        if (NULL == spare[needed++])
+            break;
+    }
+    if (level < 0 && needed > 0 && spare[needed - 1] != NULL) {
+        if (bt->depth == BTREE_MAX_DEPTH)
+            spare[needed++] = NULL;
+        else
+            spare[needed++] = _btree_node_new(0);
+    }
+    if (needed > 0 && NULL == spare[needed - 1]) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        while (--needed > 0)
+            free(spare[needed - 1]);
+        return -1;
+    }
+
+    for (level = bt->depth; ; --level) {
+        n = path[level].node;
+        pos = path[level].pos;
+
+        if (n->count < BTREE_ORDER) {
+            _btree_node_put(n, pos, item, child);
+            if (pos == 0)
+                _btree_path_fix_first(path, level);
+            break;
+        }
+
+        /*
+         * split the node in two, and add the new one to its parent
+         */
+        split = spare[used++];
+        memcpy(split->items, &n->items[half],
+               (BTREE_ORDER - half) * sizeof(void *));
+        if (n->leaf) {
+            split->next = n->next;
+            if (n->next)
+                n->next->prev = split;
+            n->next = split;
+            split->prev = n;
+        } else
+            memcpy(split->children, &n->children[half],
+                   (BTREE_ORDER - half) * sizeof(btree_node *));
+        split->count = BTREE_ORDER - half;
+        n->count = half;
+
+        if (pos <= half) {
+            _btree_node_put(n, pos, item, child);
+            if (pos == 0)
+                _btree_path_fix_first(path, level);
+        } else
+            _btree_node_put(split, pos - half, item, child);
+
+        if (level == 0) {
+            n = spare[used++];
+            n->items[0] = bt->root->items[0];
+            n->children[0] = bt->root;
+            n->items[1] = split->items[0];
+            n->children[1] = split;
+            n->count = 2;
+            bt->root = n;
+            ++bt->depth;
+            break;
+        }
+        item = split->items[0];
+        child = split;
+        ++path[level - 1].pos;
+    }
+    netsnmp_assert(used == needed);
+
+    ++bt->count;
+    ++c->sync;
+    return 0;
+}
+
+/*
+ * removes the item at the end of the path, and merges or rebalances
+ * the nodes left less than a quarter full
+ */
+static void
+_btree_remove_at(btree_container *bt, btree_pos *path)
+{
+    btree_node *n, *parent, *left, *right;
+    int         level = bt->depth, pos;
+
+    n = path[level].node;
+    pos = path[level].pos;
+    _btree_node_take(n, pos);
+    --bt->count;
+    ++bt->c.sync;
+
+    for (;;) {
+        if (level == 0) {
+            if (!n->leaf && n->count == 1) {
+                bt->root = n->children[0];
+                --bt->depth;
+                free(n);
+            }
+            return;
+        }
+        if (pos == 0 && n->count > 0)
+            _btree_path_fix_first(path, level);
+        if (n->count >= BTREE_MIN)
+            return;
+
+        parent = path[level - 1].node;
+        pos = path[level - 1].pos;
+        left = pos > 0 ? parent->children[pos - 1] : NULL;
+        right = pos + 1 < parent->count ? parent->children[pos + 1] : NULL;
+
+        if (left && left->count + n->count <= BTREE_ORDER) {
+            _btree_node_merge(left, n);
+        } else if (right && n->count + right->count <= BTREE_ORDER) {
+            _btree_node_merge(n, right);
+            if (pos == 0)
+                _btree_path_fix_first(path, level);
+            ++pos;
+        } else if (left) {
+            _btree_node_put(n, 0, left->items[left->count - 1],
+                            left->leaf ? NULL :
+                            left->children[left->count - 1]);
+            --left->count;
+            _btree_path_fix_first(path, level);
+            return;
+        } else if (right) {
+            _btree_node_put(n, n->count, right->items[0],
+                            right->leaf ? NULL : right->children[0]);
+            _btree_node_take(right, 0);
+            parent->items[pos + 1] = right->items[0];
+            if (n->count == 1)
+                _btree_path_fix_first(path, level);
+            return;
+        } else
+            return;
+
+        /*
+         * a child was merged into its neighbour: remove it from the
+         * parent, which may leave that short of children in turn
+         */
+        n = parent;
+        --level;
+        _btree_node_take(n, pos);
+    }
+}
+
+static int
+_btree_remove(netsnmp_container *c, const void *data)
+{
+    btree_container *bt = (btree_container *)c;
+    btree_pos   path[BTREE_MAX_DEPTH + 1], first[BTREE_MAX_DEPTH + 1];
+    btree_node *leaf;
+    void       *item;
+    int         found = 0;
+
+    if (!bt->count)
+        return -1;
+
+    _btree_search(bt, data, 0, c->compare, path);
+
+    /*
+     * among duplicates, remove the item passed in if it is there, or
+     * else the first of them
+     */
+    for (;;) {
+        leaf = path[bt->depth].node;
+        if (path[bt->depth].pos == leaf->count) {
+            if (!_btree_path_next_leaf(bt, path))
+                break;
+            continue;
+        }
+        item = leaf->items[path[bt->depth].pos];
+        if (c->compare(item, data) != 0)
+            break;
+        if (!found) {
+            memcpy(first, path, (bt->depth + 1) * sizeof(btree_pos));
+            found = 1;
+        }
+        if (item == data || !(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES)) {
+            _btree_remove_at(bt, path);
+            return 0;
+        }
+        ++path[bt->depth].pos;
+    }
+
+    if (!found)
+        return -1;
+    _btree_remove_at(bt, first);
+    return 0;
+}
+
+static size_t
+_btree_size(netsnmp_container *c)
+{
+    return ((btree_container *)c)->count;
+}
+
+static void
+_btree_for_each(netsnmp_container *c, netsnmp_container_obj_func *f,
+                void *context)
+{
+    btree_node *leaf;
+    int         i;
+
+    for (leaf = _btree_leftmost((btree_container *)c); leaf;
+         leaf = leaf->next)
+        for (i = 0; i < leaf->count; ++i)
+            (*f) (leaf->items[i], context);
+}
+
+static void
+_btree_clear(netsnmp_container *c, netsnmp_container_obj_func *f,
+             void *context)
+{
+    btree_container *bt = (btree_container *)c;
+    btree_node *root = bt->root;
+    int         i;
+
+    if (NULL != f)
+        _btree_for_each(c, f, context);
+
+    /*
+     * keep the root as an empty leaf
+     */
+    if (!root->leaf)
+        for (i = 0; i < root->count; ++i)
+            _btree_node_free(root->children[i]);
+    root->leaf = 1;
+    root->children = NULL;
+    root->count = 0;
+    root->prev = root->next = NULL;
+    bt->depth = 0;
+    bt->count = 0;
+    ++c->sync;
+}
+
+static int
+_btree_free(netsnmp_container *c)
+{
+    btree_container *bt = (btree_container *)c;
+
+    _btree_node_free(bt->root);
+    free(bt);
+    return 0;
+}
+
+static netsnmp_void_array *
+_btree_get_subset(netsnmp_container *c, void *key)
+{
+    btree_container *bt = (btree_container *)c;
+    btree_pos   path[BTREE_MAX_DEPTH + 1];
+    netsnmp_void_array *va;
+    btree_node *leaf;
+    void      **array = NULL, **tmp;
+    size_t      len = 0, size = 0;
+    int         pos;
+
+    netsnmp_assert(c->ncompare);
+    if (!bt->count || NULL == key || NULL == c->ncompare)
+        return NULL;
+
+    _btree_search(bt, key, 0, c->ncompare, path);
+    leaf = path[bt->depth].node;
+    for (pos = path[bt->depth].pos; leaf; leaf = leaf->next, pos = 0) {
+        for (; pos < leaf->count; ++pos) {
+            if (c->ncompare(leaf->items[pos], key) != 0)
+                break;
+            if (len == size) {
+                size = size ? size * 2 : 16;
+                tmp = (void **) realloc(array, size * sizeof(void *));
+                if (NULL == tmp) {
+                    free(array);
+                    return NULL;
+                }
+                array = tmp;
+            }
+            array[len++] = leaf->items[pos];
+        }
+        if (pos < leaf->count)
+            break;
+    }
+    if (len == 0)
+        return NULL;
+
+    va = SNMP_MALLOC_TYPEDEF(netsnmp_void_array);
+    if (NULL == va) {
+        free(array);
+        return NULL;
+    }
+    va->size = len;
+    va->array = array;
+    return va;
+}
+
+static int
+_btree_options(netsnmp_container *c, int set, u_int flags)
+{
+    if (set) {
+        if ((flags & CONTAINER_KEY_ALLOW_DUPLICATES) == flags)
+            c->flags = flags;
+        else
+            flags = (u_int)-1; /* unsupported flag */
+    }
+    else
+        return ((c->flags & flags) == flags);
+    return flags;
+}
+
+static netsnmp_container *
+_btree_duplicate(netsnmp_container *c, void *ctx, u_int flags)
+{
+    netsnmp_container *dup;
+    btree_node *leaf;
+    int         i;
+
+    if (flags) {
+        snmp_log(LOG_ERR, "btree duplicate does not support flags yet\n");
+        return NULL;
+    }
+
+    dup = netsnmp_container_get_btree();
+    if (NULL == dup) {
+        snmp_log(LOG_ERR," no memory for btree duplicate\n");
+        return NULL;
+    }
+    if (netsnmp_container_data_dup(dup, c) != 0) {
+        _btree_free(dup);
+        return NULL;
+    }
+
+    /*
+     * shallow copy
+     */
+    for (leaf = _btree_leftmost((btree_container *)c); leaf;
+         leaf = leaf->next)
+        for (i = 0; i < leaf->count; ++i)
+            if (_btree_insert(dup, leaf->items[i]) != 0) {
+                snmp_log(LOG_ERR, "no memory for btree duplicate\n");
+                _btree_free(dup);
+                return NULL;
+            }
+
+    return dup;
+}
+
+netsnmp_container *
+netsnmp_container_get_btree(void)
+{
+    /*
+     * allocate memory
+     */
+    btree_container *bt = SNMP_MALLOC_TYPEDEF(btree_container);
+    if (NULL==bt) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+    bt->root = _btree_node_new(1);
+    if (NULL == bt->root) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        free(bt);
+        return NULL;
+    }
+
+    netsnmp_init_container((netsnmp_container *)bt, NULL, _btree_free,
+                           _btree_size, NULL, _btree_insert, _btree_remove,
+                           _btree_find);
+    bt->c.find_next = _btree_find_next;
+    bt->c.get_subset = _btree_get_subset;
+    bt->c.get_iterator = _btree_iterator_get;
+    bt->c.for_each = _btree_for_each;
+    bt->c.clear = _btree_clear;
+    bt->c.options = _btree_options;
+    bt->c.duplicate = _btree_duplicate;
+
+    return (netsnmp_container *)bt;
+}
+
+netsnmp_factory *
+netsnmp_container_get_btree_factory(void)
+{
+    static netsnmp_factory f = { "btree",
+                                 (netsnmp_factory_produce_f*)
+                                 netsnmp_container_get_btree };
+
+    return &f;
+}
+
+void
+netsnmp_container_btree_init(void)
+{
+    netsnmp_container_register("btree",
+                               netsnmp_container_get_btree_factory());
+    netsnmp_container_register("table_container:btree",
+                               netsnmp_container_get_btree_factory());
+}
+
+/**********************************************************************
+ *
+ * iterator
+ *
+ */
+NETSNMP_STATIC_INLINE btree_container *
+_btree_it2cont(btree_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return NULL;
+    }
+
+    return (btree_container *)it->base.container;
+}
+
+NETSNMP_STATIC_INLINE void *
+_btree_iterator_position(btree_iterator *it)
+{
+    btree_container *bt = _btree_it2cont(it);
+    if (NULL == bt)
+        return NULL; /* msg already logged */
+
+    if(it->base.container->sync != it->base.sync) {
+        DEBUGMSGTL(("container:iterator", "out of sync\n"));
+        return NULL;
+    }
+
+    if(NULL == it->leaf || it->pos < 0 || it->pos >= it->leaf->count) {
+        DEBUGMSGTL(("container:iterator", "end of container\n"));
+        return NULL;
+    }
+
+    return it->leaf->items[it->pos];
+}
+
+static void *
+_btree_iterator_curr(btree_iterator *it)
+{
+    return _btree_iterator_position(it);
+}
+
+static void *
+_btree_iterator_first(btree_iterator *it)
+{
+    btree_container *bt = _btree_it2cont(it);
+    if (NULL == bt)
+        return NULL;
+
+    it->leaf = _btree_leftmost(bt);
+    it->pos = 0;
+
+    return _btree_iterator_position(it);
+}
+
+static void *
+_btree_iterator_next(btree_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    if (it->leaf && ++it->pos >= it->leaf->count && it->leaf->next) {
+        it->leaf = it->leaf->next;
+        it->pos = 0;
+    }
+
+    return _btree_iterator_position(it);
+}
+
+static void *
+_btree_iterator_last(btree_iterator *it)
+{
+    btree_container *bt = _btree_it2cont(it);
+    if (NULL == bt)
+        return NULL;
+
+    it->leaf = _btree_rightmost(bt);
+    it->pos = it->leaf->count - 1;
+
+    return _btree_iterator_position(it);
+}
+
+static int
+_btree_iterator_reset(btree_iterator *it)
+{
+    btree_container *bt = _btree_it2cont(it);
+    if (NULL == bt)
+        return -1;
+
+    it->leaf = _btree_leftmost(bt);
+    it->pos = 0;
+
+    /*
+     * save sync count, to make sure container doesn't change while
+     * iterator is in use.
+     */
+    it->base.sync = it->base.container->sync;
+
+    return 0;
+}
+
+static int
+_btree_iterator_release(netsnmp_iterator *it)
+{
+    free(it);
+
+    return 0;
+}
+
+static netsnmp_iterator *
+_btree_iterator_get(netsnmp_container *c)
+{
+    btree_iterator* it;
+
+    if(NULL == c)
+        return NULL;
+
+    it = SNMP_MALLOC_TYPEDEF(btree_iterator);
+    if(NULL == it)
+        return NULL;
+
+    it->base.container = c;
+
+    it->base.first = (netsnmp_iterator_rtn*)_btree_iterator_first;
+    it->base.next = (netsnmp_iterator_rtn*)_btree_iterator_next;
+    it->base.curr = (netsnmp_iterator_rtn*)_btree_iterator_curr;
+    it->base.last = (netsnmp_iterator_rtn*)_btree_iterator_last;
+    it->base.reset = (netsnmp_iterator_rc*)_btree_iterator_reset;
+    it->base.release = (netsnmp_iterator_rc*)_btree_iterator_release;
+
+    (void)_btree_iterator_reset(it);
+
+    return (netsnmp_iterator *)it;
+}
+#else /* NETSNMP_FEATURE_REMOVE_CONTAINER_BTREE */
+netsnmp_feature_unused(container_btree);
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_BTREE */
+/** @} */
@@ -9,6 +9,13 @@
 #include <net-snmp/library/fd_event_manager.h>
 #include <net-snmp/library/snmp_logging.h>
 #include <net-snmp/library/large_fd_set.h>
+#include <errno.h>
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 netsnmp_feature_child_of(fd_event_manager, libnetsnmp)
 
@@ -37,6 +44,7 @@ register_readfd(int fd, void (*func) (int, void *), void *data)
         external_readfdfunc[external_readfdlen] = func;
         external_readfd_data[external_readfdlen] = data;
         external_readfdlen++;
+        netsnmp_fd_poll_watch(fd, NETSNMP_FD_POLL_READ, NULL);
         DEBUGMSGTL(("fd_event_manager:register_readfd", "registered fd %d\n", fd));
         return FD_REGISTERED_OK;
     } else {
@@ -57,6 +65,7 @@ register_writefd(int fd, void (*func) (int, void *), void *data)
         external_writefdfunc[external_writefdlen] = func;
         external_writefd_data[external_writefdlen] = data;
         external_writefdlen++;
+        netsnmp_fd_poll_watch(fd, NETSNMP_FD_POLL_WRITE, NULL);
         DEBUGMSGTL(("fd_event_manager:register_writefd", "registered fd %d\n", fd));
         return FD_REGISTERED_OK;
     } else {
@@ -78,6 +87,7 @@ register_exceptfd(int fd, void (*func) (int, void *), void *data)
         external_exceptfdfunc[external_exceptfdlen] = func;
         external_exceptfd_data[external_exceptfdlen] = data;
         external_exceptfdlen++;
+        netsnmp_fd_poll_watch(fd, NETSNMP_FD_POLL_EXCEPT, NULL);
         DEBUGMSGTL(("fd_event_manager:register_exceptfd", "registered fd %d\n", fd));
         return FD_REGISTERED_OK;
     } else {
@@ -103,6 +113,7 @@ unregister_readfd(int fd)
                 external_readfdfunc[j] = external_readfdfunc[j + 1];
                 external_readfd_data[j] = external_readfd_data[j + 1];
             }
+            netsnmp_fd_poll_unwatch(fd, NETSNMP_FD_POLL_READ, NULL);
             DEBUGMSGTL(("fd_event_manager:unregister_readfd", "unregistered fd %d\n", fd));
             external_fd_unregistered = 1;
             return FD_UNREGISTERED_OK;
@@ -127,6 +138,7 @@ unregister_writefd(int fd)
                 external_writefdfunc[j] = external_writefdfunc[j + 1];
                 external_writefd_data[j] = external_writefd_data[j + 1];
             }
+            netsnmp_fd_poll_unwatch(fd, NETSNMP_FD_POLL_WRITE, NULL);
             DEBUGMSGTL(("fd_event_manager:unregister_writefd", "unregistered fd %d\n", fd));
             external_fd_unregistered = 1;
             return FD_UNREGISTERED_OK;
@@ -151,6 +163,7 @@ unregister_exceptfd(int fd)
                 external_exceptfdfunc[j] = external_exceptfdfunc[j + 1];
                 external_exceptfd_data[j] = external_exceptfd_data[j + 1];
             }
+            netsnmp_fd_poll_unwatch(fd, NETSNMP_FD_POLL_EXCEPT, NULL);
             DEBUGMSGTL(("fd_event_manager:unregister_exceptfd", "unregistered fd %d\n",
                         fd));
             external_fd_unregistered = 1;
@@ -292,6 +305,307 @@ void netsnmp_dispatch_external_events2(int *count,
       }
   }
 }
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define FD_POLL_MAX_EVENTS 64
+
+/*
+ * What is being watched on each fd, indexed by fd.  The session pointer
+ * is only meaningful while NETSNMP_FD_POLL_SESSION is set.
+ */
+typedef struct fd_poll_watch_s {
+    int             what;
+    void           *session;
+} fd_poll_watch;
+
+static fd_poll_watch *fd_poll_watches;
+static int      fd_poll_watches_len;
+static int      fd_poll_fd = -1;
+static int      fd_poll_failed;
+
+/* the events returned by the last netsnmp_fd_poll_wait() */
+static struct epoll_event fd_poll_ready[FD_POLL_MAX_EVENTS];
+static int      fd_poll_ready_len;
+
+static void
+_fd_poll_update(int fd, int old_what, int what)
+{
+    struct epoll_event ev;
+    int             rc;
+
+    if (fd_poll_fd < 0)
+        return;
+
+    if (!what) {
+        /* the fd may have been closed already, which removed it too */
+        epoll_ctl(fd_poll_fd, EPOLL_CTL_DEL, fd, NULL);
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = fd;
+    if (what & (NETSNMP_FD_POLL_READ | NETSNMP_FD_POLL_SESSION))
+        ev.events |= EPOLLIN;
+    if (what & NETSNMP_FD_POLL_WRITE)
+        ev.events |= EPOLLOUT;
+    if (what & NETSNMP_FD_POLL_EXCEPT)
+        ev.events |= EPOLLPRI;
+
+    /*
+     * Closing an fd silently drops it from the epoll set, and the fd
+     * number may since have been reused, so fall back either way.
+     */
+    rc = epoll_ctl(fd_poll_fd, old_what ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                   fd, &ev);
+    if (rc < 0 && errno == ENOENT)
+        rc = epoll_ctl(fd_poll_fd, EPOLL_CTL_ADD, fd, &ev);
+    else if (rc < 0 && errno == EEXIST)
+        rc = epoll_ctl(fd_poll_fd, EPOLL_CTL_MOD, fd, &ev);
+    if (rc < 0)
+        DEBUGMSGTL(("fd_event_manager:poll", "can't watch fd %d: %s\n",
+                    fd, strerror(errno)));
+}
+
+/**
+ * Returns whether the event loop should use the epoll backend, i.e.
+ * netsnmp_fd_poll_wait() and netsnmp_fd_poll_dispatch(), rather than
+ * select().  The epoll set is created on the first call.
+ */
+int
+netsnmp_fd_poll_enabled(void)
+{
+    int             fd;
+
+    if (fd_poll_fd >= 0)
+        return 1;
+    if (fd_poll_failed ||
+        netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_NO_EPOLL))
+        return 0;
+
+#ifdef EPOLL_CLOEXEC
+    fd_poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    fd_poll_fd = epoll_create(FD_POLL_MAX_EVENTS);
+#endif
+    if (fd_poll_fd < 0) {
+        snmp_log_perror("epoll_create");
+        fd_poll_failed = 1;
+        return 0;
+    }
+    for (fd = 0; fd < fd_poll_watches_len; fd++)
+        if (fd_poll_watches[fd].what)
+            _fd_poll_update(fd, 0, fd_poll_watches[fd].what);
+    DEBUGMSGTL(("fd_event_manager:poll", "created epoll set %d\n",
+                fd_poll_fd));
+    return 1;
+}
+
+/**
+ * Adds an fd to the epoll set.
+ *
+ * @param fd      the fd to watch
+ * @param what    NETSNMP_FD_POLL_READ, _WRITE or _EXCEPT for fds registered
+ *                with register_readfd() and friends, or
+ *                NETSNMP_FD_POLL_SESSION for the socket of a session
+ * @param session the session list entry, for NETSNMP_FD_POLL_SESSION
+ */
+void
+netsnmp_fd_poll_watch(int fd, int what, void *session)
+{
+    int             i, old_what;
+
+    if (fd < 0)
+        return;
+
+    if (fd >= fd_poll_watches_len) {
+        int             len = fd_poll_watches_len ? fd_poll_watches_len : 64;
+        fd_poll_watch  *watches;
+
+        while (len <= fd)
+            len *= 2;
+        watches = (fd_poll_watch *) realloc(fd_poll_watches,
+                                            len * sizeof(*watches));
+        if (!watches) {
+            snmp_log(LOG_ERR, "netsnmp_fd_poll_watch: out of memory\n");
+            return;
+        }
+        memset(watches + fd_poll_watches_len, 0,
+               (len - fd_poll_watches_len) * sizeof(*watches));
+        fd_poll_watches = watches;
+        fd_poll_watches_len = len;
+    }
+
+    /*
+     * Whatever was reported for an earlier user of this fd number no
+     * longer applies.
+     */
+    for (i = 0; i < fd_poll_ready_len; i++)
+        if (fd_poll_ready[i].data.fd == fd)
+            fd_poll_ready[i].events = 0;
+
+    old_what = fd_poll_watches[fd].what;
+    fd_poll_watches[fd].what |= what;
+    if (what & NETSNMP_FD_POLL_SESSION)
+        fd_poll_watches[fd].session = session;
+    _fd_poll_update(fd, old_what, fd_poll_watches[fd].what);
+}
+
+/**
+ * Removes an fd from the epoll set.  For NETSNMP_FD_POLL_SESSION nothing
+ * happens unless the fd still belongs to the given session.
+ */
+void
+netsnmp_fd_poll_unwatch(int fd, int what, void *session)
+{
+    fd_poll_watch  *watch;
+    int             old_what;
+
+    if (fd < 0 || fd >= fd_poll_watches_len)
+        return;
+
+    watch = &fd_poll_watches[fd];
+    if ((what & NETSNMP_FD_POLL_SESSION) && watch->session != session)
+        what &= ~NETSNMP_FD_POLL_SESSION;
+    if (!(watch->what & what))
+        return;
+
+    old_what = watch->what;
+    watch->what &= ~what;
+    if (what & NETSNMP_FD_POLL_SESSION)
+        watch->session = NULL;
+    _fd_poll_update(fd, old_what, watch->what);
+}
+
+/**
+ * Waits for events on the watched fds; the replacement for select().
+ *
+ * @param timeout how long to wait, or NULL to wait forever
+ *
+ * @return the number of fds with events, 0 on timeout or -1 on error
+ *         (with errno set).
+ */
+int
+netsnmp_fd_poll_wait(struct timeval *timeout)
+{
+    int             ms = -1;
+
+    fd_poll_ready_len = 0;
+    if (!netsnmp_fd_poll_enabled()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (timeout) {
+        if (timeout->tv_sec >= INT_MAX / 1000 - 1)
+            ms = INT_MAX;
+        else
+            ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    }
+
+    fd_poll_ready_len = epoll_wait(fd_poll_fd, fd_poll_ready,
+                                   FD_POLL_MAX_EVENTS, ms);
+    if (fd_poll_ready_len < 0) {
+        int             err = errno;
+
+        fd_poll_ready_len = 0;
+        errno = err;
+        return -1;
+    }
+    return fd_poll_ready_len;
+}
+
+/**
+ * Calls the callbacks registered for the fds netsnmp_fd_poll_wait()
+ * returned, and reads from the sessions among them.
+ */
+void
+netsnmp_fd_poll_dispatch(void)
+{
+    int             i, j, fd, events;
+
+    for (i = 0; i < fd_poll_ready_len; i++) {
+        fd = fd_poll_ready[i].data.fd;
+        if (fd < 0 || fd >= fd_poll_watches_len)
+            continue;
+
+        /*
+         * Re-read both after each callback: a callback may unregister
+         * any fd, including those still waiting in fd_poll_ready.
+         */
+        events = fd_poll_ready[i].events;
+        if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            (fd_poll_watches[fd].what & NETSNMP_FD_POLL_READ)) {
+            for (j = 0; j < external_readfdlen; j++)
+                if (external_readfd[j] == fd) {
+                    DEBUGMSGTL(("fd_event_manager:netsnmp_fd_poll_dispatch",
+                                "readfd[%d] = %d\n", j, fd));
+                    external_readfdfunc[j] (fd, external_readfd_data[j]);
+                    break;
+                }
+        }
+        events = fd_poll_ready[i].events;
+        if ((events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) &&
+            (fd_poll_watches[fd].what & NETSNMP_FD_POLL_WRITE)) {
+            for (j = 0; j < external_writefdlen; j++)
+                if (external_writefd[j] == fd) {
+                    DEBUGMSGTL(("fd_event_manager:netsnmp_fd_poll_dispatch",
+                                "writefd[%d] = %d\n", j, fd));
+                    external_writefdfunc[j] (fd, external_writefd_data[j]);
+                    break;
+                }
+        }
+        events = fd_poll_ready[i].events;
+        if ((events & EPOLLPRI) &&
+            (fd_poll_watches[fd].what & NETSNMP_FD_POLL_EXCEPT)) {
+            for (j = 0; j < external_exceptfdlen; j++)
+                if (external_exceptfd[j] == fd) {
+                    DEBUGMSGTL(("fd_event_manager:netsnmp_fd_poll_dispatch",
+                                "exceptfd[%d] = %d\n", j, fd));
+                    external_exceptfdfunc[j] (fd, external_exceptfd_data[j]);
+                    break;
+                }
+        }
+        events = fd_poll_ready[i].events;
+        if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            (fd_poll_watches[fd].what & NETSNMP_FD_POLL_SESSION))
+            snmp_read_ready(fd_poll_watches[fd].session);
+    }
+    fd_poll_ready_len = 0;
+}
+
+#else /* HAVE_SYS_EPOLL_H */
+
+int
+netsnmp_fd_poll_enabled(void)
+{
+    return 0;
+}
+
+void
+netsnmp_fd_poll_watch(int fd, int what, void *session)
+{
+}
+
+void
+netsnmp_fd_poll_unwatch(int fd, int what, void *session)
+{
+}
+
+int
+netsnmp_fd_poll_wait(struct timeval *timeout)
+{
+    errno = EINVAL;
+    return -1;
+}
+
+void
+netsnmp_fd_poll_dispatch(void)
+{
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
 #else  /*  !NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 netsnmp_feature_unused(fd_event_manager);
 #endif /*  !NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
@@ -17,7 +17,15 @@
 #include <net-snmp/net-snmp-features.h>
 
 #include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
 #include <sys/types.h>
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
 #ifdef HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
@@ -42,6 +50,8 @@
 #include <net-snmp/utilities.h>
 
 #include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/default_store.h>
+#include <net-snmp/library/mt_support.h>
 #ifdef NETSNMP_USE_OPENSSL
 #	include <openssl/hmac.h>
 #else
@@ -101,9 +111,9 @@ netsnmp_feature_child_of(usm_keytools, usm_support)
  *	 cause an error to be returned.
  *	 (Punt this check to the cmdline apps?  XXX)
  */
-int
-generate_Ku(const oid * hashtype, u_int hashtype_len,
-            const u_char * P, size_t pplen, u_char * Ku, size_t * kulen)
+static int
+_generate_Ku(const oid * hashtype, u_int hashtype_len,
+             const u_char * P, size_t pplen, u_char * Ku, size_t * kulen)
 #if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
 {
     int             rval = SNMPERR_SUCCESS,
@@ -311,6 +321,408 @@ generate_Ku(const oid * hashtype, u_int hashtype_len,
 #else
 _KEYTOOLS_NOT_AVAILABLE
 #endif                          /* internal or openssl */
+
+/*
+ * Keys derived from passphrases are remembered for the life of the
+ * process, so that a manager talking to many agents that share a few
+ * passphrases only expands each passphrase once.  Ku is looked up by the
+ * hash type and a salted SHA-1 digest of the passphrase, so the
+ * passphrase itself is not kept, and Kul by the hash type, Ku and
+ * engineID.
+ *
+ * If the keyCacheFile token names a file, each Ku computed is also
+ * appended to it, and the file is read back the first time a Ku is
+ * needed, so that the expansion is not repeated across restarts either.
+ * The file holds keys that are as good as the passphrases, so it is
+ * created readable by its owner only and not read if anyone else may.
+ */
+#define KEY_CACHE_IDLEN         96
+#define KEY_CACHE_KEYLEN        64
+#define KEY_CACHE_MAX_ENTRIES   16384
+#define KEY_CACHE_SALTLEN       16
+
+typedef struct key_cache_entry_s {
+    struct key_cache_entry_s *next;
+    u_int           hash;
+    oid             type;       /* last sub-identifier of the hash transform */
+    size_t          idlen;
+    u_char          id[KEY_CACHE_IDLEN];
+    size_t          keylen;
+    u_char          key[KEY_CACHE_KEYLEN];
+} key_cache_entry;
+
+typedef struct key_cache_s {
+    key_cache_entry **buckets;
+    u_int           size;       /* a power of two */
+    u_int           count;
+} key_cache;
+
+static key_cache ku_cache, kul_cache;
+static u_char   key_cache_salt[KEY_CACHE_SALTLEN];
+static int      key_cache_salted = 0;
+static char    *key_cache_file = NULL;  /* file the Ku cache was read from */
+static int      key_cache_file_ok = 0;
+
+static oid
+_key_cache_type(const oid * hashtype, u_int hashtype_len)
+{
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_NO_KEY_CACHE) ||
+        !hashtype || hashtype_len != USM_LENGTH_OID_TRANSFORM)
+        return 0;
+#ifndef NETSNMP_DISABLE_MD5
+    if (ISTRANSFORM(hashtype, HMACMD5Auth))
+        return hashtype[hashtype_len - 1];
+#endif
+    if (ISTRANSFORM(hashtype, HMACSHA1Auth))
+        return hashtype[hashtype_len - 1];
+    return 0;
+}
+
+static u_int
+_key_cache_hash(oid type, const u_char * id, size_t idlen)
+{
+    u_int           hash = 2166136261U ^ (u_int) type;
+
+    while (idlen--)
+        hash = (hash ^ *id++) * 16777619U;
+    return hash;
+}
+
+static key_cache_entry *
+_key_cache_find(key_cache * kc, oid type, const u_char * id, size_t idlen)
+{
+    key_cache_entry *e;
+    u_int           hash;
+
+    if (kc->buckets == NULL)
+        return NULL;
+    hash = _key_cache_hash(type, id, idlen);
+    for (e = kc->buckets[hash & (kc->size - 1)]; e; e = e->next)
+        if (e->hash == hash && e->type == type && e->idlen == idlen &&
+            memcmp(e->id, id, idlen) == 0)
+            return e;
+    return NULL;
+}
+
+static void
+_key_cache_clear(key_cache * kc)
+{
+    key_cache_entry *e, *next;
+    u_int           i;
+
+    if (kc->buckets == NULL)
+        return;
+    for (i = 0; i < kc->size; i++)
+        for (e = kc->buckets[i]; e; e = next) {
+            next = e->next;
+            free_zero(e, sizeof(*e));
+        }
+    free(kc->buckets);
+    kc->buckets = NULL;
+    kc->size = kc->count = 0;
+}
+
+static void
+_key_cache_add(key_cache * kc, oid type, const u_char * id, size_t idlen,
+               const u_char * key, size_t keylen)
+{
+    key_cache_entry *e, *next, **buckets;
+    u_int           i, size;
+
+    if (idlen > KEY_CACHE_IDLEN || keylen > KEY_CACHE_KEYLEN ||
+        _key_cache_find(kc, type, id, idlen))
+        return;
+    if (kc->count >= KEY_CACHE_MAX_ENTRIES) {
+        DEBUGMSGTL(("keytools:cache", "cache full, flushing it\n"));
+        _key_cache_clear(kc);
+    }
+    if (kc->buckets == NULL || kc->count >= kc->size * 2) {
+        size = kc->buckets ? kc->size * 2 : 64;
+        buckets = (key_cache_entry **) calloc(size, sizeof(*buckets));
+        if (buckets == NULL)
+            return;
+        for (i = 0; i < kc->size; i++)
+            for (e = kc->buckets[i]; e; e = next) {
+                next = e->next;
+                e->next = buckets[e->hash & (size - 1)];
+                buckets[e->hash & (size - 1)] = e;
+            }
+        free(kc->buckets);
+        kc->buckets = buckets;
+        kc->size = size;
+    }
+
+    e = SNMP_MALLOC_TYPEDEF(key_cache_entry);
+    if (e == NULL)
+        return;
+    e->hash = _key_cache_hash(type, id, idlen);
+    e->type = type;
+    memcpy(e->id, id, idlen);
+    e->idlen = idlen;
+    memcpy(e->key, key, keylen);
+    e->keylen = keylen;
+    e->next = kc->buckets[e->hash & (kc->size - 1)];
+    kc->buckets[e->hash & (kc->size - 1)] = e;
+    kc->count++;
+}
+
+static char    *
+_key_cache_hex(char *cp, const u_char * data, size_t len)
+{
+    while (len--)
+        cp += sprintf(cp, "%02x", *data++);
+    return cp;
+}
+
+/*
+ * Decodes exactly len octets of hex, returning 0 if the string is of any
+ * other length.
+ */
+static int
+_key_cache_unhex(const char *hex, u_char * data, size_t len)
+{
+    u_int           byte;
+
+    if (strlen(hex) != len * 2)
+        return 0;
+    for (; len--; hex += 2) {
+        if (!isxdigit((u_char) hex[0]) || !isxdigit((u_char) hex[1]) ||
+            sscanf(hex, "%2x", &byte) != 1)
+            return 0;
+        *data++ = (u_char) byte;
+    }
+    return 1;
+}
+
+/*
+ * Checks that an opened cache file is a regular file which only this
+ * user can get at.  Logs and returns 0 if it is not.
+ */
+static int
+_key_cache_file_private(int fd, const char *file)
+{
+#ifndef WIN32
+    struct stat     st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IRWXG | S_IRWXO))) {
+        snmp_log(LOG_ERR, "not using key cache %s: it must be a file owned "
+                 "by this user and not accessible by anyone else\n", file);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+/*
+ * Reads the Ku cache file, taking its salt, or checks that it can be
+ * created.  Called with the cache locked, once for each file name.
+ */
+static void
+_key_cache_load(const char *file)
+{
+    FILE           *fp;
+    char            line[512], token[16], idhex[256], keyhex[256];
+    u_char          salt[KEY_CACHE_SALTLEN], id[KEY_CACHE_IDLEN];
+    u_char          key[KEY_CACHE_KEYLEN];
+    u_long          type;
+    size_t          idlen, keylen;
+    int             have_salt = 0, count = 0;
+
+    SNMP_FREE(key_cache_file);
+    key_cache_file = strdup(file);
+    key_cache_file_ok = 0;
+
+    fp = fopen(file, "r");
+    if (fp == NULL) {
+        /* it will be created when the first key is added */
+        key_cache_file_ok = (errno == ENOENT);
+        return;
+    }
+    if (!_key_cache_file_private(fileno(fp), file)) {
+        fclose(fp);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (!have_salt) {
+            if (sscanf(line, "%15s %255s", token, idhex) != 2 ||
+                strcmp(token, "salt") != 0 ||
+                !_key_cache_unhex(idhex, salt, sizeof(salt)))
+                break;
+            if (memcmp(salt, key_cache_salt, sizeof(salt)) != 0) {
+                /* entries made with another salt can't be looked up */
+                _key_cache_clear(&ku_cache);
+                memcpy(key_cache_salt, salt, sizeof(salt));
+            }
+            key_cache_salted = have_salt = 1;
+            continue;
+        }
+        if (sscanf(line, "%15s %lu %255s %255s", token, &type, idhex,
+                   keyhex) != 4 || strcmp(token, "ku") != 0)
+            break;
+        idlen = strlen(idhex) / 2;
+        keylen = strlen(keyhex) / 2;
+        if (idlen > sizeof(id) || keylen > sizeof(key) ||
+            !_key_cache_unhex(idhex, id, idlen) ||
+            !_key_cache_unhex(keyhex, key, keylen))
+            break;
+        _key_cache_add(&ku_cache, (oid) type, id, idlen, key, keylen);
+        count++;
+    }
+    memset(key, 0, sizeof(key));
+    memset(keyhex, 0, sizeof(keyhex));
+    memset(line, 0, sizeof(line));
+
+    if (!feof(fp) || (!have_salt && ftell(fp) > 0))
+        snmp_log(LOG_ERR, "not using key cache %s: it is not in the "
+                 "expected format\n", file);
+    else
+        key_cache_file_ok = 1;
+    fclose(fp);
+    DEBUGMSGTL(("keytools:cache", "read %d keys from %s\n", count, file));
+}
+
+/*
+ * Appends a Ku to the cache file, starting it with the salt if it is
+ * new.  Each line goes out in a single write so that processes sharing
+ * the file do not interleave them.  Symbolic links are not followed,
+ * and the file that was opened is checked before key material goes
+ * into it.
+ */
+static void
+_key_cache_save(oid type, const u_char * id, size_t idlen,
+                const u_char * key, size_t keylen)
+{
+    char            line[64 + 2 * (KEY_CACHE_IDLEN + KEY_CACHE_KEYLEN)];
+    char           *cp;
+    struct stat     st;
+    int             fd;
+
+    fd = open(key_cache_file, O_WRONLY | O_APPEND | O_CREAT
+#ifdef O_NOFOLLOW
+              | O_NOFOLLOW
+#endif
+              , S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        snmp_log(LOG_ERR, "cannot write key cache %s: %s\n",
+                 key_cache_file, strerror(errno));
+        key_cache_file_ok = 0;
+        return;
+    }
+    if (!_key_cache_file_private(fd, key_cache_file)) {
+        close(fd);
+        key_cache_file_ok = 0;
+        return;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        cp = line + sprintf(line, "salt ");
+        cp = _key_cache_hex(cp, key_cache_salt, sizeof(key_cache_salt));
+        *cp++ = '\n';
+        if (write(fd, line, cp - line) != cp - line)
+            key_cache_file_ok = 0;
+    }
+    cp = line + sprintf(line, "ku %lu ", (u_long) type);
+    cp = _key_cache_hex(cp, id, idlen);
+    *cp++ = ' ';
+    cp = _key_cache_hex(cp, key, keylen);
+    *cp++ = '\n';
+    if (write(fd, line, cp - line) != cp - line)
+        key_cache_file_ok = 0;
+    memset(line, 0, sizeof(line));
+    close(fd);
+}
+
+/*
+ * Computes the name Ku is cached under: a digest of the salt and the
+ * passphrase.  Called with the cache locked.
+ */
+static int
+_key_cache_ku_id(const u_char * P, size_t pplen, u_char * id, size_t * idlen)
+{
+    const char     *file;
+    u_char         *buf;
+    size_t          saltlen = sizeof(key_cache_salt);
+    int             rval;
+
+    file = netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                 NETSNMP_DS_LIB_KEY_CACHE_FILE);
+    if (file && *file) {
+        if (key_cache_file == NULL || strcmp(file, key_cache_file) != 0)
+            _key_cache_load(file);
+    } else if (key_cache_file) {
+        SNMP_FREE(key_cache_file);
+        key_cache_file_ok = 0;
+    }
+    if (!key_cache_salted) {
+        if (sc_random(key_cache_salt, &saltlen) != SNMPERR_SUCCESS)
+            return SNMPERR_GENERR;
+        key_cache_salted = 1;
+    }
+
+    buf = (u_char *) malloc(sizeof(key_cache_salt) + pplen);
+    if (buf == NULL)
+        return SNMPERR_GENERR;
+    memcpy(buf, key_cache_salt, sizeof(key_cache_salt));
+    memcpy(buf + sizeof(key_cache_salt), P, pplen);
+    rval = sc_hash(usmHMACSHA1AuthProtocol, USM_LENGTH_OID_TRANSFORM, buf,
+                   sizeof(key_cache_salt) + pplen, id, idlen);
+    free_zero(buf, sizeof(key_cache_salt) + pplen);
+    return rval;
+}
+
+/*******************************************************************-o-******
+ * generate_Ku
+ *
+ * As above, but returns the key from the cache if the passphrase has been
+ * expanded with the same hash type before, and otherwise adds it.
+ */
+int
+generate_Ku(const oid * hashtype, u_int hashtype_len,
+            const u_char * P, size_t pplen, u_char * Ku, size_t * kulen)
+{
+    key_cache_entry *e;
+    u_char          id[KEY_CACHE_IDLEN];
+    size_t          idlen = sizeof(id);
+    oid             type;
+    int             rval;
+
+    type = _key_cache_type(hashtype, hashtype_len);
+    if (!type || !P || !Ku || !kulen || pplen < USM_LENGTH_P_MIN)
+        return _generate_Ku(hashtype, hashtype_len, P, pplen, Ku, kulen);
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+    if (_key_cache_ku_id(P, pplen, id, &idlen) != SNMPERR_SUCCESS) {
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+        return _generate_Ku(hashtype, hashtype_len, P, pplen, Ku, kulen);
+    }
+    e = _key_cache_find(&ku_cache, type, id, idlen);
+    if (e && e->keylen <= *kulen) {
+        memcpy(Ku, e->key, e->keylen);
+        *kulen = e->keylen;
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+        memset(id, 0, sizeof(id));
+        return SNMPERR_SUCCESS;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+
+    /* don't hold the lock over the expansion */
+    rval = _generate_Ku(hashtype, hashtype_len, P, pplen, Ku, kulen);
+    if (rval == SNMPERR_SUCCESS && *kulen <= KEY_CACHE_KEYLEN) {
+        snmp_res_lock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+        if (!_key_cache_find(&ku_cache, type, id, idlen)) {
+            _key_cache_add(&ku_cache, type, id, idlen, Ku, *kulen);
+            if (key_cache_file && key_cache_file_ok)
+                _key_cache_save(type, id, idlen, Ku, *kulen);
+        }
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+    }
+    memset(id, 0, sizeof(id));
+    return rval;
+}
 /*******************************************************************-o-******
  * generate_kul
  *
@@ -349,11 +761,11 @@ _KEYTOOLS_NOT_AVAILABLE
  * XXX	An engineID of any length is accepted, even if larger than
  *	what is spec'ed for the textual convention.
  */
-int
-generate_kul(const oid * hashtype, u_int hashtype_len,
-             const u_char * engineID, size_t engineID_len,
-             const u_char * Ku, size_t ku_len,
-             u_char * Kul, size_t * kul_len)
+static int
+_generate_kul(const oid * hashtype, u_int hashtype_len,
+              const u_char * engineID, size_t engineID_len,
+              const u_char * Ku, size_t ku_len,
+              u_char * Kul, size_t * kul_len)
 #if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
 {
     int             rval = SNMPERR_SUCCESS;
@@ -419,6 +831,70 @@ generate_kul(const oid * hashtype, u_int hashtype_len,
 #else
 _KEYTOOLS_NOT_AVAILABLE
 #endif                          /* internal or openssl */
+
+/*******************************************************************-o-******
+ * generate_kul
+ *
+ * As above, but returns the key from the cache if Ku has been localized
+ * to engineID with the same hash type before, and otherwise adds it.
+ */
+int
+generate_kul(const oid * hashtype, u_int hashtype_len,
+             const u_char * engineID, size_t engineID_len,
+             const u_char * Ku, size_t ku_len,
+             u_char * Kul, size_t * kul_len)
+{
+    key_cache_entry *e;
+    u_char          id[KEY_CACHE_IDLEN];
+    size_t          idlen;
+    oid             type;
+    int             rval;
+
+    type = _key_cache_type(hashtype, hashtype_len);
+    if (!type || !engineID || !Ku || !Kul || !kul_len ||
+        engineID_len == 0 || ku_len == 0 ||
+        1 + ku_len + engineID_len > sizeof(id))
+        return _generate_kul(hashtype, hashtype_len, engineID, engineID_len,
+                             Ku, ku_len, Kul, kul_len);
+
+    /* the length of Ku first, so that where it ends is unambiguous */
+    id[0] = (u_char) ku_len;
+    memcpy(id + 1, Ku, ku_len);
+    memcpy(id + 1 + ku_len, engineID, engineID_len);
+    idlen = 1 + ku_len + engineID_len;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+    e = _key_cache_find(&kul_cache, type, id, idlen);
+    if (e && e->keylen <= *kul_len) {
+        memcpy(Kul, e->key, e->keylen);
+        *kul_len = e->keylen;
+        rval = SNMPERR_SUCCESS;
+    } else {
+        rval = _generate_kul(hashtype, hashtype_len, engineID, engineID_len,
+                             Ku, ku_len, Kul, kul_len);
+        if (rval == SNMPERR_SUCCESS)
+            _key_cache_add(&kul_cache, type, id, idlen, Kul, *kul_len);
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+    memset(id, 0, sizeof(id));
+    return rval;
+}
+
+/**
+ * Forgets, and wipes, all the keys generate_Ku() and generate_kul() have
+ * cached.  The key cache file, if any, is read again when the next Ku is
+ * needed.
+ */
+void
+netsnmp_key_cache_clear(void)
+{
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+    _key_cache_clear(&ku_cache);
+    _key_cache_clear(&kul_cache);
+    SNMP_FREE(key_cache_file);
+    key_cache_file_ok = 0;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_KEYCACHE);
+}
 /*******************************************************************-o-******
  * encode_keychange
  *
@@ -2,7 +2,6 @@
  * lcd_time.c
  *
  * XXX  Should etimelist entries with <0,0> time tuples be timed out?
- * XXX  Need a routine to free the memory?  (Perhaps at shutdown?)
  */
 
 #include <net-snmp/net-snmp-config.h>
@@ -44,6 +43,7 @@
 #include <net-snmp/utilities.h>
 
 #include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/default_store.h>
 #include <net-snmp/library/callback.h>
 #include <net-snmp/library/snmp_secmod.h>
 #include <net-snmp/library/snmpusm.h>
@@ -62,9 +62,96 @@ netsnmp_feature_child_of(usm_lcd_time, usm_support)
  * Global static hashlist to contain Enginetime entries.
  *
  * New records are prepended to the appropriate list at the hash index.
+ * The number of lists grows with the number of records, which are also
+ * kept in a list from the most to the least recently used, so that the
+ * least recently used one can be dropped when the engineTimeCacheSize
+ * token limits their number.
  */
-static Enginetime etimelist[ETIMELIST_SIZE];
+static Enginetime *etimelist = NULL;
+static u_int    etimelist_size = 0;     /* number of hash lists */
+static u_int    etimelist_count = 0;    /* number of records */
+static Enginetime etime_lru_head = NULL, etime_lru_tail = NULL;
 
+static u_int
+_etime_hash(const u_char * engineID, u_int engineID_len)
+{
+    u_int           hash = 2166136261U;
+
+    while (engineID_len--)
+        hash = (hash ^ *engineID++) * 16777619U;
+    return hash;
+}
+
+static void
+_etime_lru_unlink(Enginetime e)
+{
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        etime_lru_head = e->lru_next;
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        etime_lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void
+_etime_lru_push(Enginetime e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = etime_lru_head;
+    if (etime_lru_head)
+        etime_lru_head->lru_prev = e;
+    else
+        etime_lru_tail = e;
+    etime_lru_head = e;
+}
+
+/*
+ * Takes a record out of its hash list and the LRU list, and frees it.
+ */
+static void
+_etime_remove(Enginetime e)
+{
+    Enginetime     *ep;
+
+    for (ep = &etimelist[e->hash % etimelist_size]; *ep; ep = &(*ep)->next)
+        if (*ep == e) {
+            *ep = e->next;
+            break;
+        }
+    _etime_lru_unlink(e);
+    etimelist_count--;
+    SNMP_FREE(e->engineID);
+    SNMP_FREE(e);
+}
+
+/*
+ * Makes room for more records, keeping the lists short.  Returns 0 if
+ * there is no memory for the first table.
+ */
+static int
+_etimelist_grow(void)
+{
+    Enginetime     *table, e, next;
+    u_int           size, i;
+
+    size = etimelist ? etimelist_size * 2 + 1 : ETIMELIST_SIZE;
+    table = (Enginetime *) calloc(size, sizeof(Enginetime));
+    if (table == NULL)
+        return etimelist != NULL;
+    for (i = 0; i < etimelist_size; i++)
+        for (e = etimelist[i]; e; e = next) {
+            next = e->next;
+            e->next = table[e->hash % size];
+            table[e->hash % size] = e;
+        }
+    free(etimelist);
+    etimelist = table;
+    etimelist_size = size;
+    return 1;
+}
 
 
 
@@ -263,21 +350,17 @@ get_enginetime_ex(u_char * engineID,
 void free_enginetime(unsigned char *engineID, size_t engineID_len)
 {
     Enginetime      e = NULL;
-    int             rval = 0;
 
-    rval = hash_engineID(engineID, engineID_len);
-    if (rval < 0)
-	return;
-
-    e = etimelist[rval];
-
-    while (e != NULL) {
-	etimelist[rval] = e->next;
-	SNMP_FREE(e->engineID);
-	SNMP_FREE(e);
-	e = etimelist[rval];
-    }
+    if (!engineID || !engineID_len || !etimelist)
+        return;
 
+    for (e = etimelist[_etime_hash(engineID, engineID_len) % etimelist_size];
+         e; e = e->next)
+        if (e->engineID_len == engineID_len &&
+            !memcmp(e->engineID, engineID, engineID_len)) {
+            _etime_remove(e);
+            return;
+        }
 }
 
 /*******************************************************************-o-****
@@ -296,24 +379,18 @@ void free_enginetime(unsigned char *engineID, size_t engineID_len)
  */
 void free_etimelist(void)
 {
-     int index = 0;
      Enginetime e = NULL;
      Enginetime nextE = NULL;
 
-     for( ; index < ETIMELIST_SIZE; ++index)
+     for (e = etime_lru_head; e != NULL; e = nextE)
      {
-           e = etimelist[index];
-
-           while(e != NULL)
-           {
-                 nextE = e->next;
-                 SNMP_FREE(e->engineID);
-                 SNMP_FREE(e);
-                 e = nextE;
-           }
-
-           etimelist[index] = NULL;
+           nextE = e->lru_next;
+           SNMP_FREE(e->engineID);
+           SNMP_FREE(e);
      }
+     SNMP_FREE(etimelist);
+     etimelist_size = etimelist_count = 0;
+     etime_lru_head = etime_lru_tail = NULL;
      return;
 }
 
@@ -345,7 +422,7 @@ set_enginetime(const u_char * engineID,
                u_int engineID_len,
                u_int engineboot, u_int engine_time, u_int authenticated)
 {
-    int             rval = SNMPERR_SUCCESS, iindex;
+    int             rval = SNMPERR_SUCCESS, max;
     Enginetime      e = NULL;
 
 
@@ -363,19 +440,39 @@ set_enginetime(const u_char * engineID,
      * for engineID.  Create a new record if necessary.
      */
     if (!(e = search_enginetime_list(engineID, engineID_len))) {
-        if ((iindex = hash_engineID(engineID, engineID_len)) < 0) {
+        if ((!etimelist || etimelist_count >= etimelist_size * 2) &&
+            !_etimelist_grow()) {
             QUITFUN(SNMPERR_GENERR, set_enginetime_quit);
         }
 
         e = (Enginetime) calloc(1, sizeof(*e));
-
-        e->next = etimelist[iindex];
-        etimelist[iindex] = e;
-
-        e->engineID = (u_char *) calloc(1, engineID_len);
+        if (e == NULL ||
+            (e->engineID = (u_char *) malloc(engineID_len)) == NULL) {
+            QUITFUN(SNMPERR_GENERR, set_enginetime_quit);
+        }
         memcpy(e->engineID, engineID, engineID_len);
-
         e->engineID_len = engineID_len;
+        e->hash = _etime_hash(engineID, engineID_len);
+
+        e->next = etimelist[e->hash % etimelist_size];
+        etimelist[e->hash % etimelist_size] = e;
+        _etime_lru_push(e);
+        etimelist_count++;
+
+        /*
+         * Forget the least recently used engines if there are too many.
+         */
+        max = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                 NETSNMP_DS_LIB_ENGINETIME_CACHE_SIZE);
+        while (max > 0 && etimelist_count > (u_int) max &&
+               etime_lru_tail != e) {
+            DEBUGMSGTL(("lcd_set_enginetime", "forgetting engineID "));
+            DEBUGMSGHEX(("lcd_set_enginetime", etime_lru_tail->engineID,
+                         etime_lru_tail->engineID_len));
+            DEBUGMSG(("lcd_set_enginetime", "\n"));
+            _etime_remove(etime_lru_tail);
+            snmp_increment_statistic(STAT_LCD_ENGINETIME_EVICTIONS);
+        }
     }
 #ifdef LCD_TIME_SYNC_OPT
     if (authenticated || !e->authenticatedFlag) {
@@ -396,6 +493,8 @@ set_enginetime(const u_char * engineID,
               engine_time));
 
   set_enginetime_quit:
+    if (e)
+        SNMP_FREE(e->engineID);
     SNMP_FREE(e);
 
     return rval;
@@ -417,43 +516,49 @@ set_enginetime(const u_char * engineID,
  *	NULL if no record exists.
  *
  *
- * Search etimelist for an entry with engineID.
+ * Search etimelist for an entry with engineID, and make it the most
+ * recently used one.
  *
  * ASSUMES that no engineID will have more than one record in the list.
  */
 Enginetime
 search_enginetime_list(const u_char * engineID, u_int engineID_len)
 {
-    int             rval = SNMPERR_SUCCESS;
     Enginetime      e = NULL;
+    u_int           hash;
 
 
     /*
      * Sanity check.
      */
     if (!engineID || (engineID_len <= 0)) {
-        QUITFUN(SNMPERR_GENERR, search_enginetime_list_quit);
+        return NULL;
     }
 
 
     /*
      * Find the entry for engineID if there be one.
      */
-    rval = hash_engineID(engineID, engineID_len);
-    if (rval < 0) {
-        QUITFUN(SNMPERR_GENERR, search_enginetime_list_quit);
+    if (etimelist) {
+        hash = _etime_hash(engineID, engineID_len);
+        for (e = etimelist[hash % etimelist_size]; e; e = e->next) {
+            if (e->hash == hash && engineID_len == e->engineID_len
+                && !memcmp(e->engineID, engineID, engineID_len)) {
+                break;
+            }
+        }
     }
-    e = etimelist[rval];
 
-    for ( /*EMPTY*/; e; e = e->next) {
-        if ((engineID_len == e->engineID_len)
-            && !memcmp(e->engineID, engineID, engineID_len)) {
-            break;
+    if (e) {
+        if (e != etime_lru_head) {
+            _etime_lru_unlink(e);
+            _etime_lru_push(e);
         }
+        snmp_increment_statistic(STAT_LCD_ENGINETIME_HITS);
+    } else {
+        snmp_increment_statistic(STAT_LCD_ENGINETIME_MISSES);
     }
 
-
-  search_enginetime_list_quit:
     return e;
 
 }                               /* end search_enginetime_list() */
@@ -470,63 +575,27 @@ search_enginetime_list(const u_char * engineID, u_int engineID_len)
  *	 engineID_len
  *      
  * Returns:
- *	>0			etimelist index for this engineID.
+ *	>=0			etimelist index for this engineID.
  *	SNMPERR_GENERR		Error.
  *	
  * 
  * Use a cheap hash to build an index into the etimelist.  Method is 
- * to hash the engineID, then split the hash into u_int's and add them up
- * and modulo the size of the list.
+ * an FNV-1a hash of the engineID, modulo the current number of lists.
+ * The index changes as the list grows.
  *
  */
 int
 hash_engineID(const u_char * engineID, u_int engineID_len)
 {
-    int             rval = SNMPERR_GENERR;
-    size_t          buf_len = SNMP_MAXBUF;
-    u_int           additive = 0;
-    u_char         *bufp, buf[SNMP_MAXBUF];
-    void           *context = NULL;
-
-
-
     /*
      * Sanity check.
      */
     if (!engineID || (engineID_len <= 0)) {
-        QUITFUN(SNMPERR_GENERR, hash_engineID_quit);
-    }
-
-
-    /*
-     * Hash engineID into a list index.
-     */
-#ifndef NETSNMP_DISABLE_MD5
-    rval = sc_hash(usmHMACMD5AuthProtocol,
-                   sizeof(usmHMACMD5AuthProtocol) / sizeof(oid),
-                   engineID, engineID_len, buf, &buf_len);
-    if (rval == SNMPERR_SC_NOT_CONFIGURED) {
-        /* fall back to sha1 */
-        rval = sc_hash(usmHMACSHA1AuthProtocol,
-                   sizeof(usmHMACSHA1AuthProtocol) / sizeof(oid),
-                   engineID, engineID_len, buf, &buf_len);
+        return SNMPERR_GENERR;
     }
-#else
-    rval = sc_hash(usmHMACSHA1AuthProtocol,
-                   sizeof(usmHMACSHA1AuthProtocol) / sizeof(oid),
-                   engineID, engineID_len, buf, &buf_len);
-#endif
-    QUITFUN(rval, hash_engineID_quit);
-
-    for (bufp = buf; (bufp - buf) < (int) buf_len; bufp += 4) {
-        additive += (u_int) * bufp;
-    }
-
-  hash_engineID_quit:
-    SNMP_FREE(context);
-    memset(buf, 0, SNMP_MAXBUF);
 
-    return (rval < 0) ? rval : (int)(additive % ETIMELIST_SIZE);
+    return (int) (_etime_hash(engineID, engineID_len) %
+                  (etimelist ? etimelist_size : ETIMELIST_SIZE));
 
 }                               /* end hash_engineID() */
 
@@ -591,7 +660,7 @@ dump_etimelist(void)
 
     DEBUGMSGTL(("dump_etimelist", "\n"));
 
-    while (++iindex < ETIMELIST_SIZE) {
+    while (++iindex < (int) etimelist_size) {
         DEBUGMSG(("dump_etimelist", "[%d]", iindex));
 
         count = 0;
@@ -20,6 +20,7 @@ extern          "C" {
 #ifdef NETSNMP_REENTRANT
 
 static mutex_type s_res[MT_MAX_IDS][MT_LIB_MAXIMUM];  /* locking structures */
+static int      s_res_initialized;
 
 static mutex_type *
 _mt_res(int groupID, int resourceID)
@@ -62,6 +63,14 @@ snmp_res_init(void)
     int ii, jj, rc = 0;
     mutex_type *mutex;
 
+    /*
+     * may be called early (eg by init_callbacks()) as well as from
+     * init_snmp(); only the first call sets up the mutexes.
+     */
+    if (s_res_initialized)
+        return 0;
+    s_res_initialized = 1;
+
     for (jj = 0; (0 == rc) && (jj < MT_MAX_IDS); jj++) {
 	for (ii = 0; (0 == rc) && (ii < MT_LIB_MAXIMUM); ii++) {
 	    mutex = _mt_res(jj, ii);
@@ -660,6 +660,346 @@ sc_check_keyed_hash(const oid * authtype, size_t authtypelen,
 #else
 _SCAPI_NOT_CONFIGURED
 #endif                          /* NETSNMP_USE_INTERNAL_MD5 */
+
+/*
+ * Precomputed keyed hashes.
+ *
+ * HMAC starts by hashing the key xor'ed with an inner pad and finishes by
+ * hashing it xor'ed with an outer pad, which costs a compression round of
+ * the digest each that does not depend on the message.  A keyed hash
+ * context keeps the digest states after those rounds, so that hashing a
+ * message with it only takes a copy of them and the message itself.
+ *
+ * Contexts can only be prepared for the OpenSSL and internal crypto
+ * implementations, and for keys no longer than a digest block;
+ * sc_keyed_hash_create() returns NULL otherwise, and callers use
+ * sc_generate_keyed_hash() and sc_check_keyed_hash() instead.
+ */
+#define SC_HMAC_BLOCKLEN 64
+
+struct netsnmp_keyed_hash_s {
+    oid             authtype[USM_LENGTH_OID_TRANSFORM];
+    u_char          key[SC_HMAC_BLOCKLEN];
+    u_int           keylen;
+    size_t          properlength;
+#ifdef NETSNMP_USE_OPENSSL
+    EVP_MD_CTX     *inner;
+    EVP_MD_CTX     *outer;
+#elif defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    int             is_md5;
+    MD5_CTX         md5_inner;
+    MD5_CTX         md5_outer;
+    SHA_CTX         sha1_inner;
+    SHA_CTX         sha1_outer;
+#endif
+};
+
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+static void
+_sc_keyed_hash_pads(const u_char * key, u_int keylen, u_char * ipad,
+                    u_char * opad)
+{
+    u_int           i;
+
+    memset(ipad, 0x36, SC_HMAC_BLOCKLEN);
+    memset(opad, 0x5c, SC_HMAC_BLOCKLEN);
+    for (i = 0; i < keylen; i++) {
+        ipad[i] ^= key[i];
+        opad[i] ^= key[i];
+    }
+}
+#endif
+
+#ifdef NETSNMP_USE_OPENSSL
+static EVP_MD_CTX *
+_sc_md_ctx_new(void)
+{
+    EVP_MD_CTX     *cptr;
+
+#ifdef HAVE_EVP_MD_CTX_CREATE
+    cptr = EVP_MD_CTX_create();
+#else
+    cptr = malloc(sizeof(*cptr));
+    if (cptr == NULL)
+        return NULL;
+#if defined(OLD_DES)
+    memset(cptr, 0, sizeof(*cptr));
+#else
+    EVP_MD_CTX_init(cptr);
+#endif
+#endif
+    return cptr;
+}
+
+static void
+_sc_md_ctx_free(EVP_MD_CTX * cptr)
+{
+    if (cptr == NULL)
+        return;
+#ifdef HAVE_EVP_MD_CTX_DESTROY
+    EVP_MD_CTX_destroy(cptr);
+#else
+#if !defined(OLD_DES)
+    EVP_MD_CTX_cleanup(cptr);
+#endif
+    free(cptr);
+#endif
+}
+#endif                          /* NETSNMP_USE_OPENSSL */
+
+/*******************************************************************-o-******
+ * sc_keyed_hash_create
+ *
+ * Parameters:
+ *	 authtype	Type of authentication transform.
+ *	 authtypelen
+ *	*key		Pointer to key (Kul) to use in keyed hash.
+ *	 keylen		Length of key in bytes.
+ *      
+ * Returns:
+ *	A context for sc_generate_prepared_keyed_hash() and
+ *	sc_check_prepared_keyed_hash(), or NULL if the keyed hash can not
+ *	be prepared for this transform, key or crypto library.
+ *
+ * The context holds a copy of the key.  Free it with sc_keyed_hash_free().
+ */
+netsnmp_keyed_hash *
+sc_keyed_hash_create(const oid * authtype, size_t authtypelen,
+                     const u_char * key, u_int keylen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    netsnmp_keyed_hash *kh;
+    u_char          ipad[SC_HMAC_BLOCKLEN], opad[SC_HMAC_BLOCKLEN];
+    int             properlength, md5 = 0, ok;
+#ifdef NETSNMP_USE_OPENSSL
+    const EVP_MD   *hashfn;
+#endif
+
+    if (!authtype || !key || keylen <= 0 || keylen > SC_HMAC_BLOCKLEN
+        || authtypelen != USM_LENGTH_OID_TRANSFORM)
+        return NULL;
+    properlength = sc_get_properlength(authtype, authtypelen);
+    if (properlength == SNMPERR_GENERR || keylen < (u_int) properlength)
+        return NULL;
+#ifndef NETSNMP_DISABLE_MD5
+    if (ISTRANSFORM(authtype, HMACMD5Auth))
+        md5 = 1;
+    else
+#endif
+    if (!ISTRANSFORM(authtype, HMACSHA1Auth))
+        return NULL;
+#ifdef NETSNMP_USE_INTERNAL_CRYPTO
+    /*
+     * MD5_hmac() and SHA1_hmac() only take keys of the digest length.
+     */
+    if (keylen != (u_int) properlength)
+        return NULL;
+#endif
+
+    kh = (netsnmp_keyed_hash *) calloc(1, sizeof(*kh));
+    if (kh == NULL)
+        return NULL;
+    memcpy(kh->authtype, authtype, sizeof(kh->authtype));
+    memcpy(kh->key, key, keylen);
+    kh->keylen = keylen;
+    kh->properlength = properlength;
+
+    _sc_keyed_hash_pads(key, keylen, ipad, opad);
+#ifdef NETSNMP_USE_OPENSSL
+    hashfn = md5 ? EVP_md5() : EVP_sha1();
+    kh->inner = _sc_md_ctx_new();
+    kh->outer = _sc_md_ctx_new();
+    ok = kh->inner && kh->outer &&
+        EVP_DigestInit_ex(kh->inner, hashfn, NULL) &&
+        EVP_DigestUpdate(kh->inner, ipad, SC_HMAC_BLOCKLEN) &&
+        EVP_DigestInit_ex(kh->outer, hashfn, NULL) &&
+        EVP_DigestUpdate(kh->outer, opad, SC_HMAC_BLOCKLEN);
+#else
+    kh->is_md5 = md5;
+    if (md5)
+        ok = MD5_Init(&kh->md5_inner) &&
+            MD5_Update(&kh->md5_inner, ipad, SC_HMAC_BLOCKLEN) &&
+            MD5_Init(&kh->md5_outer) &&
+            MD5_Update(&kh->md5_outer, opad, SC_HMAC_BLOCKLEN);
+    else
+        ok = SHA1_Init(&kh->sha1_inner) &&
+            SHA1_Update(&kh->sha1_inner, ipad, SC_HMAC_BLOCKLEN) &&
+            SHA1_Init(&kh->sha1_outer) &&
+            SHA1_Update(&kh->sha1_outer, opad, SC_HMAC_BLOCKLEN);
+#endif
+    memset(ipad, 0, sizeof(ipad));
+    memset(opad, 0, sizeof(opad));
+    if (!ok) {
+        sc_keyed_hash_free(kh);
+        return NULL;
+    }
+    return kh;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * sc_keyed_hash_matches
+ *
+ * Returns 1 if kh was prepared for this transform and key, 0 otherwise.
+ */
+int
+sc_keyed_hash_matches(const netsnmp_keyed_hash * kh, const oid * authtype,
+                      size_t authtypelen, const u_char * key, u_int keylen)
+{
+    return kh != NULL && authtype != NULL && key != NULL &&
+        authtypelen == USM_LENGTH_OID_TRANSFORM && keylen == kh->keylen &&
+        memcmp(kh->authtype, authtype, sizeof(kh->authtype)) == 0 &&
+        memcmp(kh->key, key, keylen) == 0;
+}
+
+void
+sc_keyed_hash_free(netsnmp_keyed_hash * kh)
+{
+    if (kh == NULL)
+        return;
+#ifdef NETSNMP_USE_OPENSSL
+    _sc_md_ctx_free(kh->inner);
+    _sc_md_ctx_free(kh->outer);
+#endif
+    SNMP_ZERO(kh, sizeof(*kh));
+    free(kh);
+}
+
+/*******************************************************************-o-******
+ * sc_generate_prepared_keyed_hash
+ *
+ * Parameters:
+ *	*kh		Context from sc_keyed_hash_create().
+ *	*message	Pointer to the message to hash.
+ *	 msglen		Length of the message.
+ *	*MAC		Will be returned with allocated bytes containg hash.
+ *	*maclen		Length of the hash buffer in bytes; also indicates
+ *				whether the MAC should be truncated.
+ *      
+ * Returns:
+ *	SNMPERR_SUCCESS			Success.
+ *	SNMPERR_SC_GENERAL_FAILURE	All errs
+ *
+ * Like sc_generate_keyed_hash(), with the transform and key of kh.
+ */
+int
+sc_generate_prepared_keyed_hash(netsnmp_keyed_hash * kh,
+                                const u_char * message, u_int msglen,
+                                u_char * MAC, size_t * maclen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    int             rval = SNMPERR_SUCCESS;
+    u_char          buf[SNMP_MAXBUF_SMALL];
+#ifdef NETSNMP_USE_OPENSSL
+    EVP_MD_CTX     *cptr;
+    unsigned int    buf_len = 0;
+#else
+    MD5_CTX         cmd5;
+    SHA_CTX         csha1;
+#endif
+
+    DEBUGTRACE;
+
+    if (!kh || !message || !MAC || !maclen || (msglen <= 0)
+        || (*maclen <= 0))
+        return SNMPERR_SC_GENERAL_FAILURE;
+
+#ifdef NETSNMP_USE_OPENSSL
+    /*
+     * The prepared states are shared, so hash in a context of our own.
+     */
+    cptr = _sc_md_ctx_new();
+    if (cptr == NULL ||
+        !EVP_MD_CTX_copy_ex(cptr, kh->inner) ||
+        !EVP_DigestUpdate(cptr, message, msglen) ||
+        !EVP_DigestFinal_ex(cptr, buf, &buf_len) ||
+        !EVP_MD_CTX_copy_ex(cptr, kh->outer) ||
+        !EVP_DigestUpdate(cptr, buf, buf_len) ||
+        !EVP_DigestFinal_ex(cptr, buf, &buf_len) ||
+        buf_len != kh->properlength) {
+        rval = SNMPERR_SC_GENERAL_FAILURE;
+    } else {
+        if (*maclen > buf_len)
+            *maclen = buf_len;
+        memcpy(MAC, buf, *maclen);
+    }
+    _sc_md_ctx_free(cptr);
+#else
+    if (kh->is_md5) {
+        cmd5 = kh->md5_inner;
+        if (!MD5_Update(&cmd5, message, msglen) || !MD5_Final(buf, &cmd5))
+            rval = SNMPERR_SC_GENERAL_FAILURE;
+        cmd5 = kh->md5_outer;
+        if (!MD5_Update(&cmd5, buf, kh->properlength) ||
+            !MD5_Final(buf, &cmd5))
+            rval = SNMPERR_SC_GENERAL_FAILURE;
+        memset(&cmd5, 0, sizeof(cmd5));
+    } else {
+        csha1 = kh->sha1_inner;
+        if (!SHA1_Update(&csha1, message, msglen) ||
+            !SHA1_Final(buf, &csha1))
+            rval = SNMPERR_SC_GENERAL_FAILURE;
+        csha1 = kh->sha1_outer;
+        if (!SHA1_Update(&csha1, buf, kh->properlength) ||
+            !SHA1_Final(buf, &csha1))
+            rval = SNMPERR_SC_GENERAL_FAILURE;
+        memset(&csha1, 0, sizeof(csha1));
+    }
+    if (rval == SNMPERR_SUCCESS) {
+        if (*maclen > kh->properlength)
+            *maclen = kh->properlength;
+        memcpy(MAC, buf, *maclen);
+    }
+#endif
+    memset(buf, 0, kh->properlength);
+    return rval;
+#else
+    return SNMPERR_SC_GENERAL_FAILURE;
+#endif
+}                               /* end sc_generate_prepared_keyed_hash() */
+
+/*******************************************************************-o-******
+ * sc_check_prepared_keyed_hash
+ *
+ * Parameters:
+ *	*kh		Context from sc_keyed_hash_create().
+ *	*message	Message for which to check the hash.
+ *	 msglen		Length of message.
+ *	*MAC		Given hash.
+ *	 maclen		Length of given hash; indicates truncation if it is
+ *				shorter than the normal size of output for
+ *				given hash transform.
+ * Returns:
+ *	SNMPERR_SUCCESS		Success.
+ *	SNMPERR_SC_GENERAL_FAILURE	Any error
+ *
+ * Like sc_check_keyed_hash(), with the transform and key of kh.
+ */
+int
+sc_check_prepared_keyed_hash(netsnmp_keyed_hash * kh,
+                             const u_char * message, u_int msglen,
+                             const u_char * MAC, u_int maclen)
+{
+    int             rval = SNMPERR_SUCCESS;
+    size_t          buf_len = SNMP_MAXBUF_SMALL;
+    u_char          buf[SNMP_MAXBUF_SMALL];
+
+    DEBUGTRACE;
+
+    if (!kh || !message || !MAC || (msglen <= 0)
+        || maclen != USM_MD5_AND_SHA_AUTH_LEN || maclen > msglen)
+        return SNMPERR_SC_GENERAL_FAILURE;
+
+    rval = sc_generate_prepared_keyed_hash(kh, message, msglen, buf,
+                                           &buf_len);
+    if (rval != SNMPERR_SUCCESS || memcmp(buf, MAC, maclen) != 0)
+        rval = SNMPERR_SC_GENERAL_FAILURE;
+    memset(buf, 0, buf_len);
+    return rval;
+}                               /* end sc_check_prepared_keyed_hash() */
+
 /*******************************************************************-o-******
  * sc_encrypt
  *
@@ -1145,6 +1485,269 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
 }
 #endif                          /* NETSNMP_USE_OPENSSL */
 
+/*
+ * Prepared cipher keys.
+ *
+ * sc_encrypt() and sc_decrypt() expand the key into a DES or AES key
+ * schedule for every message.  A cipher key keeps the expanded schedule,
+ * so that it can be used for all the messages of a user.  As with keyed
+ * hashes, sc_cipher_key_create() returns NULL for transforms or crypto
+ * libraries it can not prepare keys for.
+ */
+#define SC_CIPHER_MAXKEYLEN 64
+
+#ifdef OLD_DES
+#define SC_DES_SCHEDULE(ck) ((ck)->des_sched)
+#else
+#define SC_DES_SCHEDULE(ck) (&(ck)->des_sched)
+#endif
+
+struct netsnmp_cipher_key_s {
+    oid             privtype[USM_LENGTH_OID_TRANSFORM];
+    u_char          key[SC_CIPHER_MAXKEYLEN];
+    u_int           keylen;
+    int             is_aes;
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+#ifndef NETSNMP_DISABLE_DES
+    DES_key_schedule des_sched;
+#endif
+#ifdef HAVE_AES
+    AES_KEY         aes_key;
+#endif
+#endif
+};
+
+/*******************************************************************-o-******
+ * sc_cipher_key_create
+ *
+ * Parameters:
+ *	 privtype	Type of privacy cryptographic transform.
+ *	 privtypelen
+ *	*key		Key bits for crypting.
+ *	 keylen		Length of key (buffer) in bytes.
+ *      
+ * Returns:
+ *	A key for sc_encrypt_prepared() and sc_decrypt_prepared(), or NULL
+ *	if the key can not be prepared for this transform or crypto library.
+ *
+ * The prepared key holds a copy of key.  Free it with sc_cipher_key_free().
+ */
+netsnmp_cipher_key *
+sc_cipher_key_create(const oid * privtype, size_t privtypelen,
+                     const u_char * key, u_int keylen)
+{
+#if (defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)) && defined(NETSNMP_ENABLE_SCAPI_AUTHPRIV)
+    netsnmp_cipher_key *ck;
+#ifndef NETSNMP_DISABLE_DES
+    DES_cblock      key_struct;
+#endif
+
+    if (!privtype || !key || keylen <= 0 || keylen > SC_CIPHER_MAXKEYLEN
+        || privtypelen != USM_LENGTH_OID_TRANSFORM)
+        return NULL;
+
+    ck = (netsnmp_cipher_key *) calloc(1, sizeof(*ck));
+    if (ck == NULL)
+        return NULL;
+    memcpy(ck->privtype, privtype, sizeof(ck->privtype));
+    memcpy(ck->key, key, keylen);
+    ck->keylen = keylen;
+
+#ifndef NETSNMP_DISABLE_DES
+    if (ISTRANSFORM(privtype, DESPriv) &&
+        keylen >= BYTESIZE(SNMP_TRANS_PRIVLEN_1DES)) {
+        memcpy(key_struct, key, sizeof(key_struct));
+        (void) DES_key_sched(&key_struct, SC_DES_SCHEDULE(ck));
+        memset(key_struct, 0, sizeof(key_struct));
+        return ck;
+    }
+#endif
+#ifdef HAVE_AES
+    if (ISTRANSFORM(privtype, AESPriv) &&
+        keylen >= BYTESIZE(SNMP_TRANS_PRIVLEN_AES)) {
+        (void) AES_set_encrypt_key(key, SNMP_TRANS_PRIVLEN_AES,
+                                   &ck->aes_key);
+        ck->is_aes = 1;
+        return ck;
+    }
+#endif
+    sc_cipher_key_free(ck);
+#endif
+    return NULL;
+}
+
+/*
+ * sc_cipher_key_matches
+ *
+ * Returns 1 if ck was prepared for this transform and key, 0 otherwise.
+ */
+int
+sc_cipher_key_matches(const netsnmp_cipher_key * ck, const oid * privtype,
+                      size_t privtypelen, const u_char * key, u_int keylen)
+{
+    return ck != NULL && privtype != NULL && key != NULL &&
+        privtypelen == USM_LENGTH_OID_TRANSFORM && keylen == ck->keylen &&
+        memcmp(ck->privtype, privtype, sizeof(ck->privtype)) == 0 &&
+        memcmp(ck->key, key, keylen) == 0;
+}
+
+void
+sc_cipher_key_free(netsnmp_cipher_key * ck)
+{
+    if (ck == NULL)
+        return;
+    SNMP_ZERO(ck, sizeof(*ck));
+    free(ck);
+}
+
+/*******************************************************************-o-******
+ * sc_encrypt_prepared
+ *
+ * Parameters:
+ *	*ck		Key from sc_cipher_key_create().
+ *	*iv		IV bits for crypting.
+ *	 ivlen		Length of iv (buffer) in bytes.
+ *	*plaintext	Plaintext to crypt.
+ *	 ptlen		Length of plaintext.
+ *	*ciphertext	Ciphertext to crypt.
+ *	*ctlen		Length of ciphertext.
+ *      
+ * Returns:
+ *	SNMPERR_SUCCESS			Success.
+ *	SNMPERR_SC_GENERAL_FAILURE	Any error
+ *
+ * Like sc_encrypt(), with the transform and key of ck.  ciphertext may be
+ * plaintext itself to encrypt in place; for DES, *ctlen must then leave
+ * room for the padding after the plaintext.  AES-CFB does not pad.
+ */
+int
+sc_encrypt_prepared(netsnmp_cipher_key * ck, const u_char * iv,
+                    u_int ivlen, const u_char * plaintext, u_int ptlen,
+                    u_char * ciphertext, size_t * ctlen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    u_char          my_iv[128];
+#ifndef NETSNMP_DISABLE_DES
+    u_char          pad_block[8];
+    int             pad, plast;
+#endif
+#ifdef HAVE_AES
+    int             new_ivlen = 0;
+#endif
+
+    DEBUGTRACE;
+
+    if (!ck || !iv || !plaintext || !ciphertext || !ctlen || (ptlen <= 0)
+        || (ptlen > *ctlen) || (ivlen > sizeof(my_iv)))
+        return SNMPERR_SC_GENERAL_FAILURE;
+
+    memset(my_iv, 0, sizeof(my_iv));
+    memcpy(my_iv, iv, ivlen);
+#ifdef HAVE_AES
+    if (ck->is_aes) {
+        if (ivlen < BYTESIZE(SNMP_TRANS_PRIVLEN_AES_IV))
+            return SNMPERR_SC_GENERAL_FAILURE;
+        AES_cfb128_encrypt(plaintext, ciphertext, ptlen,
+                           &ck->aes_key, my_iv, &new_ivlen, AES_ENCRYPT);
+        *ctlen = ptlen;
+        memset(my_iv, 0, sizeof(my_iv));
+        return SNMPERR_SUCCESS;
+    }
+#endif
+#ifndef NETSNMP_DISABLE_DES
+    if (ivlen < BYTESIZE(SNMP_TRANS_PRIVLEN_1DES_IV))
+        return SNMPERR_SC_GENERAL_FAILURE;
+    pad = sizeof(pad_block) - (ptlen % sizeof(pad_block));
+    plast = (int) ptlen - (sizeof(pad_block) - pad);
+    if (pad == sizeof(pad_block))
+        pad = 0;
+    if (ptlen + pad > *ctlen)
+        return SNMPERR_SC_GENERAL_FAILURE;      /* not enough space */
+    if (pad > 0) {
+        /* copied first, in case ciphertext is plaintext */
+        memcpy(pad_block, plaintext + plast, sizeof(pad_block) - pad);
+        memset(&pad_block[sizeof(pad_block) - pad], pad, pad);
+    }
+    DES_ncbc_encrypt(plaintext, ciphertext, plast, SC_DES_SCHEDULE(ck),
+                     (DES_cblock *) my_iv, DES_ENCRYPT);
+    if (pad > 0) {
+        DES_ncbc_encrypt(pad_block, ciphertext + plast, sizeof(pad_block),
+                         SC_DES_SCHEDULE(ck), (DES_cblock *) my_iv,
+                         DES_ENCRYPT);
+        *ctlen = plast + sizeof(pad_block);
+    } else {
+        *ctlen = plast;
+    }
+    memset(pad_block, 0, sizeof(pad_block));
+    memset(my_iv, 0, sizeof(my_iv));
+    return SNMPERR_SUCCESS;
+#endif
+#endif
+    return SNMPERR_SC_GENERAL_FAILURE;
+}                               /* end sc_encrypt_prepared() */
+
+/*******************************************************************-o-******
+ * sc_decrypt_prepared
+ *
+ * Parameters:
+ *	*ck		Key from sc_cipher_key_create().
+ *	*iv
+ *	 ivlen
+ *	*ciphertext
+ *	 ctlen
+ *	*plaintext
+ *	*ptlen
+ *      
+ * Returns:
+ *	SNMPERR_SUCCESS			Success.
+ *      SNMPERR_SC_GENERAL_FAILURE      Any error
+ *
+ * Like sc_decrypt(), with the transform and key of ck.  plaintext may be
+ * ciphertext itself, to decrypt in place.
+ */
+int
+sc_decrypt_prepared(netsnmp_cipher_key * ck, const u_char * iv,
+                    u_int ivlen, const u_char * ciphertext, u_int ctlen,
+                    u_char * plaintext, size_t * ptlen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    u_char          my_iv[128];
+#ifdef HAVE_AES
+    int             new_ivlen = 0;
+#endif
+
+    DEBUGTRACE;
+
+    if (!ck || !iv || !plaintext || !ciphertext || !ptlen || (ctlen <= 0)
+        || (*ptlen <= 0) || (*ptlen < ctlen) || (ivlen > sizeof(my_iv)))
+        return SNMPERR_SC_GENERAL_FAILURE;
+
+    memset(my_iv, 0, sizeof(my_iv));
+    memcpy(my_iv, iv, ivlen);
+#ifdef HAVE_AES
+    if (ck->is_aes) {
+        if (ivlen < BYTESIZE(SNMP_TRANS_PRIVLEN_AES_IV))
+            return SNMPERR_SC_GENERAL_FAILURE;
+        AES_cfb128_encrypt(ciphertext, plaintext, ctlen,
+                           &ck->aes_key, my_iv, &new_ivlen, AES_DECRYPT);
+        *ptlen = ctlen;
+        memset(my_iv, 0, sizeof(my_iv));
+        return SNMPERR_SUCCESS;
+    }
+#endif
+#ifndef NETSNMP_DISABLE_DES
+    if (ivlen < BYTESIZE(SNMP_TRANS_PRIVLEN_1DES_IV))
+        return SNMPERR_SC_GENERAL_FAILURE;
+    DES_cbc_encrypt(ciphertext, plaintext, ctlen, SC_DES_SCHEDULE(ck),
+                    (DES_cblock *) my_iv, DES_DECRYPT);
+    *ptlen = ctlen;
+    memset(my_iv, 0, sizeof(my_iv));
+    return SNMPERR_SUCCESS;
+#endif
+#endif
+    return SNMPERR_SC_GENERAL_FAILURE;
+}                               /* end sc_decrypt_prepared() */
+
 #ifdef NETSNMP_USE_INTERNAL_CRYPTO
 
 /* These functions are basically copies of the MDSign() routine in
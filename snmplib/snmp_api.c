@@ -42,6 +42,7 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <ctype.h>
+#include <stddef.h>
 #if HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -123,6 +124,7 @@ SOFTWARE.
 #include <net-snmp/library/container.h>
 #include <net-snmp/library/snmp_secmod.h>
 #include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/fd_event_manager.h>
 #ifdef NETSNMP_SECMOD_USM
 #include <net-snmp/library/snmpusm.h>
 #endif
@@ -311,6 +313,21 @@ static const char *secLevelName[] = {
  * use token in comments to individually protect these resources 
  */
 struct session_list *Sessions = NULL;   /* MT_LIB_SESSION */
+/*
+ * The sessions of the list above which had requests outstanding at some
+ * point, chained through next_pending.  Entries whose requests are all
+ * gone are dropped by the next snmp_select_info2() with a NULL fdset.
+ */
+static struct session_list *Sessions_pending = NULL;    /* MT_LIB_SESSION */
+/*
+ * Set when a session of the list lost its socket, so that the next
+ * snmp_select_info2() with a NULL fdset walks the list to close it.
+ */
+static int      Sessions_closed = 0;    /* MT_LIB_SESSION */
+
+#define SESS_LISTED     0x01    /* linked into Sessions */
+#define SESS_PENDING    0x02    /* linked into Sessions_pending */
+
 static long     Reqid = 0;      /* MT_LIB_REQUESTID */
 static long     Msgid = 0;      /* MT_LIB_MESSAGEID */
 static long     Sessid = 0;     /* MT_LIB_SESSIONID */
@@ -346,6 +363,15 @@ static int      snmp_resend_request(struct session_list *slp,
                                     int incr_retries);
 static void     register_default_handlers(void);
 static struct session_list *snmp_sess_copy(netsnmp_session * pss);
+static void     _sess_watch(struct session_list *slp);
+static void     _sess_unpend(struct session_list *slp);
+static int      _sess_read_ready(void *sessp);
+static int      _sess_read_queued(void *sessp);
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+static int      _snmp_pdu_presized_rbuild(u_char ** pkt, size_t * pkt_len,
+                                          size_t * offset, netsnmp_pdu *pdu,
+                                          size_t headroom, int wrapped);
+#endif
 int             snmp_get_errno(void);
 NETSNMP_IMPORT
 void            snmp_synch_reset(netsnmp_session * notused);
@@ -740,6 +766,8 @@ register_default_handlers(void)
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_DUMP_PACKET);
     netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "reverseEncodeBER",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_REVERSE_ENCODE);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "noPresizedEncodeBER",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_NO_PRESIZED_ENCODE);
     netsnmp_ds_register_config(ASN_INTEGER, "snmp", "defaultPort",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_DEFAULT_PORT);
 #if !defined(NETSNMP_DISABLE_SNMPV1) || !defined(NETSNMP_DISABLE_SNMPV2C)
@@ -770,6 +798,17 @@ register_default_handlers(void)
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_CLIENTSENDBUF);
     netsnmp_ds_register_config(ASN_INTEGER, "snmp", "clientRecvBuf",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_CLIENTRECVBUF);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "noEpoll",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_NO_EPOLL);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "pduArena",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_PDU_ARENA);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "noKeyCache",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_NO_KEY_CACHE);
+    netsnmp_ds_register_config(ASN_OCTET_STR, "snmp", "keyCacheFile",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_KEY_CACHE_FILE);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "engineTimeCacheSize",
+		      NETSNMP_DS_LIBRARY_ID,
+		      NETSNMP_DS_LIB_ENGINETIME_CACHE_SIZE);
     netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "noPersistentLoad",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_DISABLE_PERSISTENT_LOAD);
     netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "noPersistentSave",
@@ -946,6 +985,7 @@ snmp_open(netsnmp_session *session)
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
     slp->next = Sessions;
     Sessions = slp;
+    _sess_watch(slp);
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 
     return (slp->session);
@@ -986,6 +1026,7 @@ snmp_open_ex(netsnmp_session *session,
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
     slp->next = Sessions;
     Sessions = slp;
+    _sess_watch(slp);
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 
     return (slp->session);
@@ -1634,6 +1675,7 @@ snmp_add(netsnmp_session * in_session,
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
     slp->next = Sessions;
     Sessions = slp;
+    _sess_watch(slp);
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 
     return (slp->session);
@@ -1670,6 +1712,7 @@ snmp_add_full(netsnmp_session * in_session,
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
     slp->next = Sessions;
     Sessions = slp;
+    _sess_watch(slp);
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 
     return (slp->session);
@@ -1851,6 +1894,15 @@ snmp_sess_close(void *sessp)
         (*sptr->session_close) (slp->session);
     }
 
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+    netsnmp_fd_poll_unwatch(slp->poll_fd, NETSNMP_FD_POLL_SESSION, slp);
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+    if (slp->list_flags & SESS_PENDING) {
+        snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
+        _sess_unpend(slp);
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    }
+
     isp = slp->internal;
     slp->internal = NULL;
 
@@ -1913,6 +1965,41 @@ snmp_sess_close(void *sessp)
     return 1;
 }
 
+/*
+ * Adds the socket of a session that was just linked into the session list
+ * to the epoll set of the fd event manager.
+ */
+static void
+_sess_watch(struct session_list *slp)
+{
+    slp->list_flags |= SESS_LISTED;
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+    if (slp->transport && slp->transport->sock >= 0) {
+        slp->poll_fd = slp->transport->sock;
+        netsnmp_fd_poll_watch(slp->poll_fd, NETSNMP_FD_POLL_SESSION, slp);
+    }
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+}
+
+/*
+ * Removes a session from Sessions_pending.  Called with MT_LIB_SESSION
+ * held.
+ */
+static void
+_sess_unpend(struct session_list *slp)
+{
+    struct session_list **prev;
+
+    for (prev = &Sessions_pending; *prev; prev = &(*prev)->next_pending) {
+        if (*prev == slp) {
+            *prev = slp->next_pending;
+            break;
+        }
+    }
+    slp->next_pending = NULL;
+    slp->list_flags &= ~SESS_PENDING;
+}
+
 int
 snmp_close(netsnmp_session * session)
 {
@@ -2512,11 +2599,25 @@ snmpv3_packet_realloc_rbuild(u_char ** pkt, size_t * pkt_len,
 
         *offset += pdu_data_len;
         memcpy(*pkt + *pkt_len - *offset, pdu_data, pdu_data_len);
-    } else {
+    } else if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                      NETSNMP_DS_LIB_NO_PRESIZED_ENCODE)) {
         rc = snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
         if (rc == 0) {
             return -1;
         }
+    } else {
+        /*
+         * Leave room for the scopedPDU and message headers, and the
+         * security parameters, so that they don't grow the buffer again.
+         */
+        rc = _snmp_pdu_presized_rbuild(pkt, pkt_len, offset, pdu,
+                                       pdu->contextEngineIDLen +
+                                       pdu->contextNameLen +
+                                       SNMP_MAX_MSG_V3_HDRS +
+                                       SNMP_SEC_PARAM_BUF_SIZE, 0);
+        if (rc == 0) {
+            return -1;
+        }
     }
     body_len = *offset - body_end_offset;
 
@@ -2904,7 +3005,23 @@ _snmp_build(u_char ** pkt, size_t * pkt_len, size_t * offset,
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
         if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_REVERSE_ENCODE)) {
             DEBUGPRINTPDUTYPE("send", pdu->command);
-            rc = snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
+            if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                       NETSNMP_DS_LIB_NO_PRESIZED_ENCODE)) {
+                rc = snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
+            } else {
+                /*
+                 * Leave room for the community, the version and the
+                 * message header, so that the buffer is only grown once.
+                 */
+                size_t          headroom;
+
+                headroom = asn_presized_int_len(pdu->version);
+                headroom += asn_presized_header_len(headroom) +
+                    asn_presized_header_len(pdu->community_len) +
+                    pdu->community_len;
+                rc = _snmp_pdu_presized_rbuild(pkt, pkt_len, offset, pdu,
+                                               headroom, 1);
+            }
             if (rc == 0) {
                 return -1;
             }
@@ -3472,6 +3589,256 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
                                      *offset - start_offset);
     return rc;
 }
+
+/*
+ * Sets *len to the length of the contents of a varbind's value.  Returns 0
+ * if the value can't be presized; snmp_realloc_rbuild_var_op() then
+ * encodes it, or reports what is wrong with it.
+ */
+static int
+_snmp_presized_value_len(const netsnmp_variable_list *vp, size_t *len)
+{
+    switch (vp->type) {
+    case ASN_INTEGER:
+        if (vp->val_len != sizeof(long))
+            return 0;
+        *len = asn_presized_int_len(*vp->val.integer);
+        return 1;
+
+    case ASN_GAUGE:
+    case ASN_COUNTER:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        if (vp->val_len != sizeof(u_long))
+            return 0;
+        *len = asn_presized_unsigned_int_len(*(u_long *) vp->val.integer);
+        return 1;
+
+    case ASN_COUNTER64:
+        if (vp->val_len != sizeof(struct counter64))
+            return 0;
+        *len = asn_presized_unsigned_int64_len(vp->val.counter64);
+        return 1;
+
+    case ASN_OCTET_STR:
+    case ASN_IPADDRESS:
+    case ASN_OPAQUE:
+    case ASN_NSAP:
+    case ASN_BIT_STR:
+        *len = vp->val_len;
+        return 1;
+
+    case ASN_OBJECT_ID:
+        *len = asn_presized_objid_len(vp->val.objid,
+                                      vp->val_len / sizeof(oid));
+        return *len != 0;
+
+    case ASN_NULL:
+    case SNMP_NOSUCHOBJECT:
+    case SNMP_NOSUCHINSTANCE:
+    case SNMP_ENDOFMIBVIEW:
+        *len = 0;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static u_char *
+_snmp_presized_build_value(u_char *data, const netsnmp_variable_list *vp,
+                           size_t len)
+{
+    switch (vp->type) {
+    case ASN_INTEGER:
+        return asn_presized_build_int(data, vp->type, *vp->val.integer, len);
+
+    case ASN_GAUGE:
+    case ASN_COUNTER:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        return asn_presized_build_unsigned_int(data, vp->type,
+                                               *(u_long *) vp->val.integer,
+                                               len);
+
+    case ASN_COUNTER64:
+        return asn_presized_build_unsigned_int64(data, vp->type,
+                                                 vp->val.counter64, len);
+
+    case ASN_OBJECT_ID:
+        return asn_presized_build_objid(data, vp->type, vp->val.objid,
+                                        vp->val_len / sizeof(oid), len);
+
+    default:
+        return asn_presized_build_string(data, vp->type, vp->val.string,
+                                         len);
+    }
+}
+
+/*
+ * Sets *len to the length of the contents of a PDU, and *vblen to the length
+ * of the contents of its variable-bindings sequence.  Returns 0 if the PDU
+ * can't be presized.
+ */
+static int
+_snmp_pdu_presized_len(netsnmp_pdu *pdu, size_t *len, size_t *vblen)
+{
+    netsnmp_variable_list *vp;
+    size_t          namelen, vallen, seqlen, l;
+
+    *vblen = 0;
+    for (vp = pdu->variables; vp; vp = vp->next_variable) {
+        namelen = asn_presized_objid_len(vp->name, vp->name_length);
+        if (namelen == 0 || !_snmp_presized_value_len(vp, &vallen))
+            return 0;
+        seqlen = asn_presized_header_len(namelen) + namelen +
+            asn_presized_header_len(vallen) + vallen;
+        *vblen += asn_presized_header_len(seqlen) + seqlen;
+    }
+    *len = asn_presized_header_len(*vblen) + *vblen;
+
+    if (pdu->command != SNMP_MSG_TRAP) {
+        l = asn_presized_int_len(pdu->reqid);
+        *len += asn_presized_header_len(l) + l;
+        l = asn_presized_int_len(pdu->errstat);
+        *len += asn_presized_header_len(l) + l;
+        l = asn_presized_int_len(pdu->errindex);
+        *len += asn_presized_header_len(l) + l;
+    } else {
+        l = asn_presized_objid_len(pdu->enterprise, pdu->enterprise_length);
+        if (l == 0)
+            return 0;
+        *len += asn_presized_header_len(l) + l;
+        *len += asn_presized_header_len(4) + 4;
+        l = asn_presized_int_len(pdu->trap_type);
+        *len += asn_presized_header_len(l) + l;
+        l = asn_presized_int_len(pdu->specific_type);
+        *len += asn_presized_header_len(l) + l;
+        l = asn_presized_unsigned_int_len(pdu->time);
+        *len += asn_presized_header_len(l) + l;
+    }
+
+    return 1;
+}
+
+/*
+ * Writes a PDU whose contents are len octets long, as sized by
+ * _snmp_pdu_presized_len(), front to back.
+ */
+static u_char *
+_snmp_pdu_presized_build(u_char *data, netsnmp_pdu *pdu, size_t len,
+                         size_t vblen)
+{
+    netsnmp_variable_list *vp;
+    size_t          namelen, vallen;
+
+    data = asn_presized_build_header(data, (u_char) pdu->command, len);
+
+    if (pdu->command != SNMP_MSG_TRAP) {
+        data = asn_presized_build_int(data, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_INTEGER),
+                                      pdu->reqid,
+                                      asn_presized_int_len(pdu->reqid));
+        data = asn_presized_build_int(data, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_INTEGER),
+                                      pdu->errstat,
+                                      asn_presized_int_len(pdu->errstat));
+        data = asn_presized_build_int(data, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_INTEGER),
+                                      pdu->errindex,
+                                      asn_presized_int_len(pdu->errindex));
+    } else {
+        data = asn_presized_build_objid(data, (u_char) (ASN_UNIVERSAL |
+                                                        ASN_PRIMITIVE |
+                                                        ASN_OBJECT_ID),
+                                        pdu->enterprise,
+                                        pdu->enterprise_length,
+                                        asn_presized_objid_len(pdu->enterprise,
+                                                               pdu->enterprise_length));
+        data = asn_presized_build_string(data, (u_char) (ASN_IPADDRESS |
+                                                         ASN_PRIMITIVE),
+                                         pdu->agent_addr, 4);
+        data = asn_presized_build_int(data, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_INTEGER),
+                                      pdu->trap_type,
+                                      asn_presized_int_len(pdu->trap_type));
+        data = asn_presized_build_int(data, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_INTEGER),
+                                      pdu->specific_type,
+                                      asn_presized_int_len(pdu->specific_type));
+        data = asn_presized_build_unsigned_int(data, (u_char) (ASN_TIMETICKS |
+                                                               ASN_PRIMITIVE),
+                                               pdu->time,
+                                               asn_presized_unsigned_int_len(pdu->time));
+    }
+
+    data = asn_presized_build_header(data, (u_char) (ASN_SEQUENCE |
+                                                     ASN_CONSTRUCTOR), vblen);
+    for (vp = pdu->variables; vp; vp = vp->next_variable) {
+        namelen = asn_presized_objid_len(vp->name, vp->name_length);
+        _snmp_presized_value_len(vp, &vallen);
+        data = asn_presized_build_header(data, (u_char) (ASN_SEQUENCE |
+                                                         ASN_CONSTRUCTOR),
+                                         asn_presized_header_len(namelen) +
+                                         namelen +
+                                         asn_presized_header_len(vallen) +
+                                         vallen);
+        data = asn_presized_build_objid(data, (u_char) (ASN_UNIVERSAL |
+                                                        ASN_PRIMITIVE |
+                                                        ASN_OBJECT_ID),
+                                        vp->name, vp->name_length, namelen);
+        data = _snmp_presized_build_value(data, vp, vallen);
+    }
+    return data;
+}
+
+/*
+ * Like snmp_pdu_realloc_rbuild(), but computes the length of every part of
+ * the PDU first, grows the buffer at most once and then writes the PDU front
+ * to back into the reserved space, leaving headroom octets free in front of
+ * it for the caller's headers, plus room for a SEQUENCE header around both
+ * if wrapped is set.  PDUs it can't presize (opaque float, double
+ * and 64-bit integer values), and PDUs built while debugging output is on,
+ * so that packet dumps still work, are handed to snmp_pdu_realloc_rbuild().
+ */
+static int
+_snmp_pdu_presized_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
+                          netsnmp_pdu *pdu, size_t headroom, int wrapped)
+{
+    size_t          len, pdulen, vblen;
+
+    if (snmp_get_do_debugging() ||
+        !_snmp_pdu_presized_len(pdu, &pdulen, &vblen)) {
+        return snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
+    }
+    len = asn_presized_header_len(pdulen) + pdulen;
+
+    if (wrapped) {
+        headroom += asn_presized_header_len(len + headroom);
+    }
+    if (!asn_presized_reserve(pkt, pkt_len, *offset, len + headroom)) {
+        return 0;
+    }
+    _snmp_pdu_presized_build(*pkt + *pkt_len - *offset - len, pdu, pdulen,
+                             vblen);
+    *offset += len;
+    return 1;
+}
+
+/*
+ * On error, returns 0.
+ */
+int
+snmp_pdu_presized_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
+                         netsnmp_pdu *pdu)
+{
+    return _snmp_pdu_presized_rbuild(pkt, pkt_len, offset, pdu, 0, 0);
+}
 #endif                          /* NETSNMP_USE_REVERSE_ASNENCODING */
 
 /*
@@ -4355,6 +4722,7 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
     size_t          four;
     netsnmp_variable_list *vp = NULL, *vplast = NULL;
     oid             objid[MAX_OID_LEN];
+    size_t          name_length, val_len, room;
     u_char         *p;
 
     /*
@@ -4499,17 +4867,42 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
      * get each varBind sequence 
      */
     while ((int) *length > 0) {
-        vp = SNMP_MALLOC_TYPEDEF(netsnmp_variable_list);
-        if (NULL == vp)
-            goto fail;
-
-        vp->name_length = MAX_OID_LEN;
+        name_length = MAX_OID_LEN;
         DEBUGDUMPSECTION("recv", "VarBind");
-        data = snmp_parse_var_op(data, objid, &vp->name_length, &vp->type,
-                                 &vp->val_len, &var_val, length);
+        data = snmp_parse_var_op(data, objid, &name_length, &type,
+                                 &val_len, &var_val, length);
         if (data == NULL)
             goto fail;
-        if (snmp_set_var_objid(vp, objid, vp->name_length))
+
+        /*
+         * set aside room for values that won't fit in buf, in case the
+         * varbind comes from an arena 
+         */
+        switch (type) {
+        case ASN_OBJECT_ID:
+            room = (val_len + 1) * sizeof(oid);
+            if (room > MAX_OID_LEN * sizeof(oid))
+                room = MAX_OID_LEN * sizeof(oid);
+            break;
+        case ASN_IPADDRESS:
+        case ASN_OCTET_STR:
+        case ASN_OPAQUE:
+        case ASN_NSAP:
+            room = val_len < sizeof(vp->buf) ? 0 : val_len;
+            break;
+        case ASN_BIT_STR:
+            room = val_len;
+            break;
+        default:
+            room = 0;
+            break;
+        }
+        vp = netsnmp_pdu_arena_var(pdu, room);
+        if (NULL == vp)
+            goto fail;
+        vp->type = type;
+        vp->val_len = val_len;
+        if (snmp_set_var_objid(vp, objid, name_length))
             goto fail;
 
         len = MAX_PACKET_LENGTH;
@@ -4586,6 +4979,8 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
         case ASN_NSAP:
             if (vp->val_len < sizeof(vp->buf)) {
                 vp->val.string = (u_char *) vp->buf;
+            } else if (vp->flags & NETSNMP_VAR_FLAG_ARENA) {
+                vp->val.string = NETSNMP_VAR_ARENA_VAL(vp);
             } else {
                 vp->val.string = (u_char *) malloc(vp->val_len);
             }
@@ -4603,7 +4998,10 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
             if (!p)
                 goto fail;
             vp->val_len *= sizeof(oid);
-            vp->val.objid = (oid *) malloc(vp->val_len);
+            if (vp->flags & NETSNMP_VAR_FLAG_ARENA)
+                vp->val.objid = (oid *) NETSNMP_VAR_ARENA_VAL(vp);
+            else
+                vp->val.objid = (oid *) malloc(vp->val_len);
             if (vp->val.objid == NULL) {
                 goto fail;
             }
@@ -4615,7 +5013,10 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
         case ASN_NULL:
             break;
         case ASN_BIT_STR:
-            vp->val.bitstring = (u_char *) malloc(vp->val_len);
+            if (vp->flags & NETSNMP_VAR_FLAG_ARENA)
+                vp->val.bitstring = NETSNMP_VAR_ARENA_VAL(vp);
+            else
+                vp->val.bitstring = (u_char *) malloc(vp->val_len);
             if (vp->val.bitstring == NULL) {
                 goto fail;
             }
@@ -4768,31 +5169,14 @@ snmp_async_send(netsnmp_session * session,
     return snmp_sess_async_send(sessp, pdu, callback, cb_data);
 }
 
+/*
+ * Checks the version of a PDU against the session's, and notes whether a
+ * response is expected.  Returns 0, with the session's error set, if
+ * the PDU can't be sent on the session.
+ */
 static int
-_sess_async_send(void *sessp,
-                 netsnmp_pdu *pdu, snmp_callback callback, void *cb_data)
+_sess_prepare_pdu(netsnmp_session * session, netsnmp_pdu *pdu)
 {
-    struct session_list *slp = (struct session_list *) sessp;
-    netsnmp_session *session;
-    struct snmp_internal_session *isp;
-    netsnmp_transport *transport = NULL;
-    u_char         *pktbuf = NULL, *packet = NULL;
-    size_t          pktbuf_len = 0, offset = 0, length = 0;
-    int             result;
-    long            reqid;
-
-    if (slp == NULL) {
-        return 0;
-    } else {
-        session = slp->session;
-        isp = slp->internal;
-        transport = slp->transport;
-        if (!session || !isp || !transport) {
-            DEBUGMSGTL(("sess_async_send", "send fail: closing...\n"));
-            return 0;
-        }
-    }
-
     if (pdu == NULL) {
         session->s_snmp_errno = SNMPERR_NULL_PDU;
         return 0;
@@ -4840,22 +5224,25 @@ _sess_async_send(void *sessp,
             pdu->flags |= UCD_MSG_FLAG_EXPECT_RESPONSE;
             break;
     }
+    return 1;
+}
 
-    /*
-     * check to see if we need a v3 engineID probe
-     */
-    if ((pdu->version == SNMP_VERSION_3) &&
-        (pdu->flags & UCD_MSG_FLAG_EXPECT_RESPONSE) &&
-        (session->securityEngineIDLen == 0) &&
-        (0 == (session->flags & SNMP_FLAGS_DONT_PROBE))) {
-        int rc;
-        DEBUGMSGTL(("snmpv3_build", "delayed probe for engineID\n"));
-        rc = snmpv3_engineID_probe(slp, session);
-        if (rc == 0)
-            return 0; /* s_snmp_errno already set */
-    }
+/*
+ * Encodes a PDU for the session, checking that the message is not too
+ * big for it.  On success, returns 1 with the message at *packet, of
+ * *length octets, within the buffer *pktbuf, which the caller frees.
+ */
+static int
+_sess_build_packet(struct session_list *slp, netsnmp_pdu *pdu,
+                   u_char ** pktbuf, u_char ** packet, size_t * length)
+{
+    netsnmp_session *session = slp->session;
+    struct snmp_internal_session *isp = slp->internal;
+    netsnmp_transport *transport = slp->transport;
+    size_t          pktbuf_len = 0, offset = 0;
+    int             result;
 
-    if ((pktbuf = (u_char *)malloc(2048)) == NULL) {
+    if ((*pktbuf = (u_char *)malloc(2048)) == NULL) {
         DEBUGMSGTL(("sess_async_send",
                     "couldn't malloc initial packet buffer\n"));
         session->s_snmp_errno = SNMPERR_MALLOC;
@@ -4899,25 +5286,25 @@ _sess_async_send(void *sessp,
      */
     if (isp->hook_realloc_build) {
         result = isp->hook_realloc_build(session, pdu,
-                                         &pktbuf, &pktbuf_len, &offset);
-        packet = pktbuf;
-        length = offset;
+                                         pktbuf, &pktbuf_len, &offset);
+        *packet = *pktbuf;
+        *length = offset;
     } else if (isp->hook_build) {
-        packet = pktbuf;
-        length = pktbuf_len;
-        result = isp->hook_build(session, pdu, pktbuf, &length);
+        *packet = *pktbuf;
+        *length = pktbuf_len;
+        result = isp->hook_build(session, pdu, *pktbuf, length);
     } else {
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
         if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_REVERSE_ENCODE)) {
             result =
-                snmp_build(&pktbuf, &pktbuf_len, &offset, session, pdu);
-            packet = pktbuf + pktbuf_len - offset;
-            length = offset;
+                snmp_build(pktbuf, &pktbuf_len, &offset, session, pdu);
+            *packet = *pktbuf + pktbuf_len - offset;
+            *length = offset;
         } else {
 #endif
-            packet = pktbuf;
-            length = pktbuf_len;
-            result = snmp_build(&pktbuf, &length, &offset, session, pdu);
+            *packet = *pktbuf;
+            *length = pktbuf_len;
+            result = snmp_build(pktbuf, length, &offset, session, pdu);
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
         }
 #endif
@@ -4925,7 +5312,7 @@ _sess_async_send(void *sessp,
 
     if (result < 0) {
         DEBUGMSGTL(("sess_async_send", "encoding failure\n"));
-        SNMP_FREE(pktbuf);
+        SNMP_FREE(*pktbuf);
         return 0;
     }
 
@@ -4934,12 +5321,12 @@ _sess_async_send(void *sessp,
      * specified in the received PDU.  
      */
 
-    if (pdu->version == SNMP_VERSION_3 && session->sndMsgMaxSize != 0 && length > session->sndMsgMaxSize) {
+    if (pdu->version == SNMP_VERSION_3 && session->sndMsgMaxSize != 0 && *length > session->sndMsgMaxSize) {
         DEBUGMSGTL(("sess_async_send",
                     "length of packet (%lu) exceeds session maximum (%lu)\n",
-                    (unsigned long)length, (unsigned long)session->sndMsgMaxSize));
+                    (unsigned long)*length, (unsigned long)session->sndMsgMaxSize));
         session->s_snmp_errno = SNMPERR_TOO_LONG;
-        SNMP_FREE(pktbuf);
+        SNMP_FREE(*pktbuf);
         return 0;
     }
 
@@ -4948,15 +5335,89 @@ _sess_async_send(void *sessp,
      * large as length.  
      */
 
-    if (transport->msgMaxSize != 0 && length > transport->msgMaxSize) {
+    if (transport->msgMaxSize != 0 && *length > transport->msgMaxSize) {
         DEBUGMSGTL(("sess_async_send",
                     "length of packet (%lu) exceeds transport maximum (%lu)\n",
-                    (unsigned long)length, (unsigned long)transport->msgMaxSize));
+                    (unsigned long)*length, (unsigned long)transport->msgMaxSize));
         session->s_snmp_errno = SNMPERR_TOO_LONG;
-        SNMP_FREE(pktbuf);
+        SNMP_FREE(*pktbuf);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Encodes a PDU into the message snmp_sess_send() would send for it,
+ * without sending it, so that the same message can be sent to several
+ * peers with netsnmp_transport_send().
+ *
+ * @param sessp the session, as returned by snmp_sess_pointer()
+ * @param pdu the PDU to encode; it is not freed
+ * @param pktbuf receives a buffer the caller must free
+ * @param packet receives the start of the message within *pktbuf
+ * @param length receives the length of the message
+ *
+ * @return 1 on success, 0 on failure with the session's error set
+ */
+int
+snmp_sess_encode(void *sessp, netsnmp_pdu *pdu, u_char ** pktbuf,
+                 u_char ** packet, size_t * length)
+{
+    struct session_list *slp = (struct session_list *) sessp;
+
+    *pktbuf = NULL;
+    if (slp == NULL || !slp->session || !slp->internal || !slp->transport)
+        return 0;
+    if (!_sess_prepare_pdu(slp->session, pdu))
+        return 0;
+    return _sess_build_packet(slp, pdu, pktbuf, packet, length);
+}
+
+static int
+_sess_async_send(void *sessp,
+                 netsnmp_pdu *pdu, snmp_callback callback, void *cb_data)
+{
+    struct session_list *slp = (struct session_list *) sessp;
+    netsnmp_session *session;
+    struct snmp_internal_session *isp;
+    netsnmp_transport *transport = NULL;
+    u_char         *pktbuf = NULL, *packet = NULL;
+    size_t          length = 0;
+    int             result;
+    long            reqid;
+
+    if (slp == NULL) {
         return 0;
+    } else {
+        session = slp->session;
+        isp = slp->internal;
+        transport = slp->transport;
+        if (!session || !isp || !transport) {
+            DEBUGMSGTL(("sess_async_send", "send fail: closing...\n"));
+            return 0;
+        }
+    }
+
+    if (!_sess_prepare_pdu(session, pdu))
+        return 0;
+
+    /*
+     * check to see if we need a v3 engineID probe
+     */
+    if ((pdu->version == SNMP_VERSION_3) &&
+        (pdu->flags & UCD_MSG_FLAG_EXPECT_RESPONSE) &&
+        (session->securityEngineIDLen == 0) &&
+        (0 == (session->flags & SNMP_FLAGS_DONT_PROBE))) {
+        int rc;
+        DEBUGMSGTL(("snmpv3_build", "delayed probe for engineID\n"));
+        rc = snmpv3_engineID_probe(slp, session);
+        if (rc == 0)
+            return 0; /* s_snmp_errno already set */
     }
 
+    if (!_sess_build_packet(slp, pdu, &pktbuf, &packet, &length))
+        return 0;
+
     /*
      * Send the message.  
      */
@@ -5022,6 +5483,11 @@ _sess_async_send(void *sessp,
             isp->requests = rp;
             isp->requestsEnd = rp;
         }
+        if ((slp->list_flags & (SESS_LISTED | SESS_PENDING)) == SESS_LISTED) {
+            slp->next_pending = Sessions_pending;
+            Sessions_pending = slp;
+            slp->list_flags |= SESS_PENDING;
+        }
         snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
     } else {
         /*
@@ -5064,6 +5530,161 @@ snmp_sess_async_send(void *sessp,
 }
 
 
+/*
+ * PDU arenas.
+ *
+ * An arena hands out varbinds, along with room for their values, from a
+ * few large blocks instead of a malloc() each.  The PDU and each of the
+ * varbinds hold a reference on the arena, so that varbinds unlinked from
+ * the PDU remain valid until they are freed in turn.
+ */
+#define PDU_ARENA_BLOCK_SIZE    16384
+#define PDU_ARENA_ALIGN(n)      (((n) + 7) & ~(size_t) 7)
+
+typedef struct pdu_arena_block_s {
+    struct pdu_arena_block_s *next;
+    size_t          size;
+    size_t          used;
+} pdu_arena_block;
+
+typedef struct pdu_arena_s {
+    pdu_arena_block *blocks;
+    int             refs;
+} pdu_arena;
+
+typedef struct pdu_arena_var_s {
+    pdu_arena      *arena;
+    netsnmp_variable_list var;
+} pdu_arena_var;
+
+static void    *
+_pdu_arena_alloc(pdu_arena *arena, size_t len)
+{
+    pdu_arena_block *block = arena->blocks;
+    void           *ptr;
+
+    len = PDU_ARENA_ALIGN(len);
+    if (block->size - block->used < len) {
+        size_t          size = PDU_ARENA_BLOCK_SIZE;
+
+        if (size < len)
+            size = len;
+        block = (pdu_arena_block *) malloc(sizeof(pdu_arena_block) + size);
+        if (block == NULL)
+            return NULL;
+        block->size = size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    ptr = (u_char *) (block + 1) + block->used;
+    block->used += len;
+    return ptr;
+}
+
+static void
+_pdu_arena_release(pdu_arena *arena)
+{
+    pdu_arena_block *block, *next;
+
+    if (--arena->refs > 0)
+        return;
+    /*
+     * the arena itself lives in the first block, which is the last one
+     */
+    for (block = arena->blocks; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+}
+
+/**
+ * Makes the varbinds of a PDU come from an arena.
+ *
+ * Once set up, snmp_pdu_parse() and snmp_clone_pdu() take the varbinds
+ * of the PDU, and their values, from a few large blocks.  snmp_free_pdu()
+ * returns the blocks in one go, once the varbinds have been freed.
+ *
+ * The varbinds can be used, replaced and freed with snmp_free_var() like
+ * any other.  What an arena varbind doesn't support is free() on itself,
+ * or on a value it didn't get from the caller: see NETSNMP_VAR_VAL_IS_LOCAL.
+ *
+ * @param pdu  the PDU, which must not have any variables yet
+ * @param size the size of the first block, 0 for the default
+ *
+ * @return SNMPERR_SUCCESS, or SNMPERR_MALLOC if the arena couldn't be set
+ *         up, in which case the PDU keeps on using malloc().
+ */
+int
+netsnmp_pdu_arena_init(netsnmp_pdu *pdu, size_t size)
+{
+    pdu_arena_block *block;
+    pdu_arena      *arena;
+
+    if (pdu == NULL || pdu->variables != NULL)
+        return SNMPERR_GENERR;
+    if (pdu->arena != NULL)
+        return SNMPERR_SUCCESS;
+
+    if (size == 0)
+        size = PDU_ARENA_BLOCK_SIZE;
+    size += PDU_ARENA_ALIGN(sizeof(pdu_arena));
+    block = (pdu_arena_block *) malloc(sizeof(pdu_arena_block) + size);
+    if (block == NULL)
+        return SNMPERR_MALLOC;
+    block->next = NULL;
+    block->size = size;
+    block->used = PDU_ARENA_ALIGN(sizeof(pdu_arena));
+    arena = (pdu_arena *) (block + 1);
+    arena->blocks = block;
+    arena->refs = 1;
+    pdu->arena = arena;
+    return SNMPERR_SUCCESS;
+}
+
+/**
+ * Allocates a cleared varbind for a PDU.
+ *
+ * The varbind comes from the PDU's arena when it has one, and from
+ * malloc() otherwise.  It is not linked into the PDU.
+ *
+ * @param pdu     the PDU
+ * @param val_len room to set aside for the value, which is then found at
+ *                NETSNMP_VAR_ARENA_VAL(var) if the varbind is flagged
+ *                NETSNMP_VAR_FLAG_ARENA
+ *
+ * @return the varbind, or NULL on failure.
+ */
+netsnmp_variable_list *
+netsnmp_pdu_arena_var(netsnmp_pdu *pdu, size_t val_len)
+{
+    pdu_arena      *arena;
+    pdu_arena_var  *slot;
+    netsnmp_variable_list *var;
+
+    if (pdu == NULL || pdu->arena == NULL)
+        return SNMP_MALLOC_TYPEDEF(netsnmp_variable_list);
+
+    arena = (pdu_arena *) pdu->arena;
+    slot = (pdu_arena_var *) _pdu_arena_alloc(arena, sizeof(pdu_arena_var) +
+                                              val_len);
+    if (slot == NULL)
+        return NULL;
+    slot->arena = arena;
+    arena->refs++;
+
+    /*
+     * name_loc and buf are only read once written, leave them be
+     */
+    var = &slot->var;
+    memset(var, 0, offsetof(netsnmp_variable_list, name_loc));
+    memset(&var->data, 0,
+           sizeof(netsnmp_variable_list) -
+           offsetof(netsnmp_variable_list, data));
+    var->flags = NETSNMP_VAR_FLAG_ARENA;
+    return var;
+}
+
 /*
  * Frees the variable and any malloc'd data associated with it.
  */
@@ -5075,7 +5696,7 @@ snmp_free_var_internals(netsnmp_variable_list * var)
 
     if (var->name != var->name_loc)
         SNMP_FREE(var->name);
-    if (var->val.string != var->buf)
+    if (!NETSNMP_VAR_VAL_IS_LOCAL(var))
         SNMP_FREE(var->val.string);
     if (var->data) {
         if (var->dataFreeHook) {
@@ -5090,8 +5711,16 @@ snmp_free_var_internals(netsnmp_variable_list * var)
 void
 snmp_free_var(netsnmp_variable_list * var)
 {
+    if (!var)
+        return;
+
     snmp_free_var_internals(var);
-    free((char *) var);
+    if (var->flags & NETSNMP_VAR_FLAG_ARENA)
+        _pdu_arena_release(((pdu_arena_var *)
+                            ((u_char *) var -
+                             offsetof(pdu_arena_var, var)))->arena);
+    else if (!(var->flags & NETSNMP_VAR_FLAG_POOLED))
+        free((char *) var);
 }
 
 void
@@ -5148,6 +5777,8 @@ snmp_free_pdu(netsnmp_pdu *pdu)
     SNMP_FREE(pdu->contextName);
     SNMP_FREE(pdu->securityName);
     SNMP_FREE(pdu->transport_data);
+    if (pdu->arena)
+        _pdu_arena_release((pdu_arena *) pdu->arena);
     memset(pdu, 0, sizeof(netsnmp_pdu));
     free((char *) pdu);
 }
@@ -5171,6 +5802,9 @@ snmp_create_sess_pdu(netsnmp_transport *transport, void *opaque,
     pdu->transport_data_length = olength;
     pdu->tDomain = transport->domain;
     pdu->tDomainLen = transport->domain_length;
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_PDU_ARENA))
+        netsnmp_pdu_arena_init(pdu, 0);
     return pdu;
 }
 
@@ -5463,6 +6097,21 @@ snmp_read2(netsnmp_large_fd_set * fdset)
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 }
 
+void
+snmp_read_ready(void *sessp)
+{
+    struct session_list *slp = (struct session_list *) sessp;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    if (_sess_read_queued(sessp) && slp->session &&
+        slp->session->s_snmp_errno) {
+        SET_SNMP_ERROR(slp->session->s_snmp_errno);
+    }
+    if (slp->transport && slp->transport->sock < 0)
+        Sessions_closed = 1;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
+}
+
 /*
  * Same as snmp_read, but works just one session. 
  * returns 0 if success, -1 if fail 
@@ -5471,6 +6120,50 @@ snmp_read2(netsnmp_large_fd_set * fdset)
  */
 int
 _sess_read(void *sessp, netsnmp_large_fd_set * fdset)
+{
+    struct session_list *slp = (struct session_list *) sessp;
+    netsnmp_transport *transport = slp ? slp->transport : NULL;
+
+    if (transport && transport->sock >= 0 &&
+        (!fdset || !(NETSNMP_LARGE_FD_ISSET(transport->sock, fdset)))) {
+        DEBUGMSGTL(("sess_read", "not reading %d (fdset %p set %d)\n",
+                    transport->sock, fdset,
+                    fdset ? NETSNMP_LARGE_FD_ISSET(transport->sock, fdset)
+		    : -9));
+        return 0;
+    }
+
+    return _sess_read_queued(sessp);
+}
+
+/*
+ * Reads from a session whose socket is known to be readable, including
+ * any further datagrams its transport received along with the first one
+ * (see NETSNMP_TRANSPORT_FLAG_RECV_QUEUED).
+ * returns 0 if success, -1 if fail 
+ */
+static int
+_sess_read_queued(void *sessp)
+{
+    struct session_list *slp = (struct session_list *) sessp;
+    int             rc, rc2;
+
+    rc = _sess_read_ready(sessp);
+    while (slp && slp->transport && slp->transport->sock >= 0 &&
+           (slp->transport->flags & NETSNMP_TRANSPORT_FLAG_RECV_QUEUED)) {
+        rc2 = _sess_read_ready(sessp);
+        if (rc2)
+            rc = rc2;
+    }
+    return rc;
+}
+
+/*
+ * Reads from a session whose socket is known to be readable.
+ * returns 0 if success, -1 if fail 
+ */
+static int
+_sess_read_ready(void *sessp)
 {
     struct session_list *slp = (struct session_list *) sessp;
     netsnmp_session *sp = slp ? slp->session : NULL;
@@ -5492,14 +6185,6 @@ _sess_read(void *sessp, netsnmp_large_fd_set * fdset)
         return 0; 
     }
 
-    if (!fdset || !(NETSNMP_LARGE_FD_ISSET(transport->sock, fdset))) {
-        DEBUGMSGTL(("sess_read", "not reading %d (fdset %p set %d)\n",
-                    transport->sock, fdset,
-                    fdset ? NETSNMP_LARGE_FD_ISSET(transport->sock, fdset)
-		    : -9));
-        return 0;
-    }
-
     sp->s_snmp_errno = 0;
     sp->s_errno = 0;
 
@@ -5549,6 +6234,7 @@ _sess_read(void *sessp, netsnmp_large_fd_set * fdset)
                 if (nslp != NULL) {
                     nslp->next = Sessions;
                     Sessions = nslp;
+                    _sess_watch(nslp);
                     /*
                      * Tell the new session about its existance if possible.
                      */
@@ -5646,6 +6332,8 @@ _sess_read(void *sessp, netsnmp_large_fd_set * fdset)
         /* reset the flag since it's a per-message flag */
         transport->flags &= (~NETSNMP_TRANSPORT_FLAG_EMPTY_PKT);
 
+        if (!(transport->flags & NETSNMP_TRANSPORT_FLAG_STREAM))
+            SNMP_FREE(rxbuf);
         return 0;
     }
 
@@ -5958,6 +6646,63 @@ snmp_sess_select_info2(void *sessp, int *numfds, netsnmp_large_fd_set *fdset,
                                         NETSNMP_SELECT_NOFLAGS);
 }
 
+/*
+ * Finds the earliest expiry of the outstanding requests for
+ * snmp_sess_select_info2_flags() without walking the whole session list:
+ * only the sessions in Sessions_pending can have requests outstanding.
+ * Closes the sessions among them that lost their socket, and drops those
+ * without requests from Sessions_pending.  Returns the number of sessions
+ * with requests outstanding.
+ */
+static int
+_sess_select_pending(struct timeval *earliest)
+{
+    struct session_list *slp, **prev;
+    netsnmp_request_list *rp;
+    int             requests = 0;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    for (prev = &Sessions_pending; (slp = *prev) != NULL;) {
+        if (slp->transport == NULL) {
+            /*
+             * Close in progress -- skip this one.  
+             */
+            prev = &slp->next_pending;
+            continue;
+        }
+        if (slp->transport->sock == -1) {
+            /*
+             * This session was marked for deletion; closing it also
+             * removes it from Sessions_pending.
+             */
+            DEBUGMSG(("sess_select", "delete "));
+            snmp_close(slp->session);
+            continue;
+        }
+        if (slp->internal == NULL || slp->internal->requests == NULL) {
+            *prev = slp->next_pending;
+            slp->next_pending = NULL;
+            slp->list_flags &= ~SESS_PENDING;
+            continue;
+        }
+
+        DEBUGMSG(("sess_select", "%d ", slp->transport->sock));
+        requests++;
+        for (rp = slp->internal->requests; rp; rp = rp->next_request) {
+            if (!timerisset(earliest)
+                || (timerisset(&rp->expireM)
+                    && timercmp(&rp->expireM, earliest, <))) {
+                *earliest = rp->expireM;
+                DEBUGMSG(("verbose:sess_select","(to in %d.%06d sec) ",
+                           (int)earliest->tv_sec, (int)earliest->tv_usec));
+            }
+        }
+        prev = &slp->next_pending;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    return requests;
+}
+
 /**
  * Compute/update the arguments to be passed to select().
  *
@@ -5968,7 +6713,9 @@ snmp_sess_select_info2(void *sessp, int *numfds, netsnmp_large_fd_set *fdset,
  *   and MSVC), do not use the value written into *numfds.
  * @param[in,out] fdset   A large file descriptor set to which all file
  *   descriptors will be added that are associated with one of the examined
- *   sessions.
+ *   sessions.  May be NULL if the caller waits with netsnmp_fd_poll_wait()
+ *   and only needs the timeout, in which case only the sessions with
+ *   requests outstanding are examined.
  * @param[in,out] timeout On input, if *block = 1, the maximum time the caller
  *   will block while waiting for Net-SNMP activity. On output, if this function
  *   has set *block to 0, the maximum time the caller is allowed to wait before
@@ -6007,7 +6754,22 @@ snmp_sess_select_info2_flags(void *sessp, int *numfds,
     DEBUGMSGTL(("sess_select", "for %s session%s: ",
                 sessp ? "single" : "all", sessp ? "" : "s"));
 
-    for (slp = sessp ? sessp : Sessions; slp; slp = next) {
+    /*
+     * Without an fdset the caller waits with netsnmp_fd_poll_wait(), which
+     * already knows the sockets, so only the sessions with requests
+     * outstanding are looked at, unless one of the sessions lost its
+     * socket and has to be closed.
+     */
+    if (sessp == NULL && fdset == NULL && !Sessions_closed) {
+        active = requests = _sess_select_pending(&earliest);
+        slp = NULL;
+    } else {
+        if (sessp == NULL)
+            Sessions_closed = 0;
+        slp = sessp ? sessp : Sessions;
+    }
+
+    for (; slp; slp = next) {
         next = slp->next;
 
         if (slp->transport == NULL) {
@@ -6038,7 +6800,8 @@ snmp_sess_select_info2_flags(void *sessp, int *numfds,
             *numfds = (slp->transport->sock + 1);
         }
 
-        NETSNMP_LARGE_FD_SET(slp->transport->sock, fdset);
+        if (fdset)
+            NETSNMP_LARGE_FD_SET(slp->transport->sock, fdset);
         if (slp->internal != NULL && slp->internal->requests) {
             /*
              * Found another session with outstanding requests.  
@@ -6127,7 +6890,10 @@ snmp_timeout(void)
 {
     struct session_list *slp;
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
-    for (slp = Sessions; slp; slp = slp->next) {
+    /*
+     * Only the sessions in Sessions_pending can have requests to time out.
+     */
+    for (slp = Sessions_pending; slp; slp = slp->next_pending) {
         snmp_sess_timeout((void *) slp);
     }
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
@@ -7340,21 +8106,27 @@ static u_int    statistics[NETSNMP_STAT_MAX_STATS];
 u_int
 snmp_increment_statistic(int which)
 {
+    u_int           value = 0;
+
     if (which >= 0 && which < NETSNMP_STAT_MAX_STATS) {
-        statistics[which]++;
-        return statistics[which];
+        snmp_res_lock(MT_LIBRARY_ID, MT_LIB_STATISTICS);
+        value = ++statistics[which];
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_STATISTICS);
     }
-    return 0;
+    return value;
 }
 
 u_int
 snmp_increment_statistic_by(int which, int count)
 {
+    u_int           value = 0;
+
     if (which >= 0 && which < NETSNMP_STAT_MAX_STATS) {
-        statistics[which] += count;
-        return statistics[which];
+        snmp_res_lock(MT_LIBRARY_ID, MT_LIB_STATISTICS);
+        value = statistics[which] += count;
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_STATISTICS);
     }
-    return 0;
+    return value;
 }
 
 u_int
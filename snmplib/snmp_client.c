@@ -219,16 +219,12 @@ snmp_synch_input(int op,
 
 
 /*
- * Clone an SNMP variable data structure.
- * Sets pointers to structure private storage, or
- * allocates larger object identifiers and values as needed.
- *
- * Caller must make list association for cloned variable.
- *
- * Returns 0 if successful.
+ * Clones var into newvar, which gets the given flags.  An arena varbind
+ * keeps a large value in the room set aside behind it.
  */
-int
-snmp_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar)
+static int
+_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar,
+           u_char flags)
 {
     if (!newvar || !var)
         return 1;
@@ -240,6 +236,7 @@ snmp_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar)
     newvar->data = NULL;
     newvar->dataFreeHook = NULL;
     newvar->index = 0;
+    newvar->flags = flags;
 
     /*
      * Clone the object identifier and the value.
@@ -255,6 +252,8 @@ snmp_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar)
         if (var->val.string != &var->buf[0]) {
             if (var->val_len <= sizeof(var->buf))
                 newvar->val.string = newvar->buf;
+            else if (flags & NETSNMP_VAR_FLAG_ARENA)
+                newvar->val.string = NETSNMP_VAR_ARENA_VAL(newvar);
             else {
                 newvar->val.string = (u_char *) malloc(var->val_len);
                 if (!newvar->val.string)
@@ -277,6 +276,23 @@ snmp_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar)
 }
 
 
+/*
+ * Clone an SNMP variable data structure.
+ * Sets pointers to structure private storage, or
+ * allocates larger object identifiers and values as needed.
+ *
+ * Caller must make list association for cloned variable.
+ * The clone is flagged as a varbind allocated on its own, whatever the
+ * flags of the original.
+ *
+ * Returns 0 if successful.
+ */
+int
+snmp_clone_var(netsnmp_variable_list * var, netsnmp_variable_list * newvar)
+{
+    return _clone_var(var, newvar, 0);
+}
+
 /*
  * Possibly make a copy of source memory buffer.
  * Will reset destination pointer if source pointer is NULL.
@@ -317,7 +333,7 @@ snmp_reset_var_buffers(netsnmp_variable_list * var)
             var->name_length = 0;
         }
         if (var->val.string != var->buf) {
-            if (NULL != var->val.string)
+            if (NULL != var->val.string && !NETSNMP_VAR_VAL_IS_LOCAL(var))
                 free(var->val.string);
             var->val.string = var->buf;
             var->val_len = 0;
@@ -362,6 +378,7 @@ _clone_pdu_header(netsnmp_pdu *pdu)
     newpdu->contextEngineID = NULL;
     newpdu->contextName = NULL;
     newpdu->transport_data = NULL;
+    newpdu->arena = NULL;
 
     /*
      * copy buffers individually. If any copy fails, all are freed. 
@@ -406,12 +423,19 @@ _clone_pdu_header(netsnmp_pdu *pdu)
         (*sptr->pdu_clone) (pdu, newpdu);
     }
 
+    /*
+     * the clone of an arena PDU gets an arena of its own, if possible 
+     */
+    if (pdu->arena)
+        netsnmp_pdu_arena_init(newpdu, 0);
+
     return newpdu;
 }
 
 static
 netsnmp_variable_list *
 _copy_varlist(netsnmp_variable_list * var,      /* source varList */
+              netsnmp_pdu *newpdu,      /* target PDU (if any) */
               int errindex,     /* index of variable to drop (if any) */
               int copy_count)
 {                               /* !=0 number variables to copy */
@@ -433,11 +457,12 @@ _copy_varlist(netsnmp_variable_list * var,      /* source varList */
         /*
          * clone the next variable. Cleanup if alloc fails 
          */
-        newvar = (netsnmp_variable_list *)
-            malloc(sizeof(netsnmp_variable_list));
-        if (snmp_clone_var(var, newvar)) {
+        newvar = netsnmp_pdu_arena_var(newpdu,
+                                       var->val_len > sizeof(var->buf) ?
+                                       var->val_len : 0);
+        if (!newvar || _clone_var(var, newvar, newvar->flags)) {
             if (newvar)
-                free((char *) newvar);
+                snmp_free_var(newvar);
             snmp_free_varbind(newhead);
             return NULL;
         }
@@ -507,7 +532,7 @@ _copy_pdu_vars(netsnmp_pdu *pdu,        /* source PDU */
         copied = 1;             /* We're interested in 'empty' responses too */
 #endif
 
-    newpdu->variables = _copy_varlist(var, drop_idx, copy_count);
+    newpdu->variables = _copy_varlist(var, newpdu, drop_idx, copy_count);
 #if TEMPORARILY_DISABLED
     if (newpdu->variables)
         copied = 1;
@@ -563,7 +588,7 @@ _clone_pdu(netsnmp_pdu *pdu, int drop_err)
 netsnmp_variable_list *
 snmp_clone_varbind(netsnmp_variable_list * varlist)
 {
-    return _copy_varlist(varlist, 0, 10000);    /* skip none, copy all */
+    return _copy_varlist(varlist, NULL, 0, 10000);      /* skip none, copy all */
 }
 
 /*
@@ -792,7 +817,7 @@ snmp_set_var_value(netsnmp_variable_list * vars,
      * xxx-rks: why the unconditional free? why not use existing
      * memory, if len < vars->val_len ?
      */
-    if (vars->val.string && vars->val.string != vars->buf) {
+    if (vars->val.string && !NETSNMP_VAR_VAL_IS_LOCAL(vars)) {
         free(vars->val.string);
     }
     vars->val.string = NULL;
@@ -120,6 +120,10 @@ static struct usmUser *noNameUser = NULL;
  * Local storage (LCD) of the default user list.
  */
 static struct usmUser *userList = NULL;
+static struct usmUser **userHash = NULL;
+static size_t   userHashSize = 0, userHashCount = 0;
+
+static void     usm_user_hash_clear(void);
 
 /*
  * Prototypes
@@ -233,6 +237,113 @@ usm_get_userList(void)
     return userList;
 }
 
+/*
+ * Returns the precomputed keyed hash for the current authentication key
+ * of a user, preparing it again if the key or the protocol has changed
+ * since, or NULL if there is none.
+ */
+static netsnmp_keyed_hash *
+usm_user_auth_hash(struct usmUser *user)
+{
+    if (user == NULL || user->authKey == NULL || user->authKeyLen == 0)
+        return NULL;
+    if (user->authKeyHash == NULL ||
+        !sc_keyed_hash_matches(user->authKeyHash, user->authProtocol,
+                               user->authProtocolLen, user->authKey,
+                               user->authKeyLen)) {
+        sc_keyed_hash_free(user->authKeyHash);
+        user->authKeyHash = sc_keyed_hash_create(user->authProtocol,
+                                                 user->authProtocolLen,
+                                                 user->authKey,
+                                                 user->authKeyLen);
+    }
+    return user->authKeyHash;
+}
+
+/*
+ * Returns the prepared key schedule for the current privacy key of a
+ * user, preparing it again if the key or the protocol has changed since,
+ * or NULL if there is none.
+ */
+static netsnmp_cipher_key *
+usm_user_priv_cipher(struct usmUser *user)
+{
+    if (user == NULL || user->privKey == NULL || user->privKeyLen == 0)
+        return NULL;
+    if (user->privKeyCipher == NULL ||
+        !sc_cipher_key_matches(user->privKeyCipher, user->privProtocol,
+                               user->privProtocolLen, user->privKey,
+                               user->privKeyLen)) {
+        sc_cipher_key_free(user->privKeyCipher);
+        user->privKeyCipher = sc_cipher_key_create(user->privProtocol,
+                                                   user->privProtocolLen,
+                                                   user->privKey,
+                                                   user->privKeyLen);
+    }
+    return user->privKeyCipher;
+}
+
+/*
+ * Looks up the user of a state reference, whose name is not terminated.
+ */
+static struct usmUser *
+usm_get_user_counted(u_char * engineID, size_t engineIDLen,
+                     const char *name, size_t nameLen)
+{
+    char            nameBuf[SNMP_MAX_SEC_NAME_SIZE];
+
+    if (name == NULL || nameLen >= sizeof(nameBuf))
+        return NULL;
+    memcpy(nameBuf, name, nameLen);
+    nameBuf[nameLen] = '\0';
+    return usm_get_user(engineID, engineIDLen, nameBuf);
+}
+
+/*
+ * Signs an outgoing message, with the precomputed keyed hash of the user
+ * it is for if that was prepared for the same key.
+ */
+static int
+usm_sign_msg(struct usmUser *user,
+             const oid * authProtocol, size_t authProtocolLen,
+             const u_char * authKey, size_t authKeyLen,
+             const u_char * msg, size_t msgLen, u_char * MAC,
+             size_t * MACLen)
+{
+    netsnmp_keyed_hash *kh = usm_user_auth_hash(user);
+
+    if (sc_keyed_hash_matches(kh, authProtocol, authProtocolLen,
+                              authKey, authKeyLen))
+        return sc_generate_prepared_keyed_hash(kh, msg, msgLen, MAC,
+                                               MACLen);
+    return sc_generate_keyed_hash(authProtocol, authProtocolLen,
+                                  authKey, authKeyLen, msg, msgLen,
+                                  MAC, MACLen);
+}
+
+/*
+ * Encrypts an outgoing scopedPdu, with the prepared key schedule of the
+ * user it is for if that was prepared for the same key.  ciphertext may
+ * be plaintext, see sc_encrypt_prepared().
+ */
+static int
+usm_encrypt_msg(struct usmUser *user,
+                const oid * privProtocol, size_t privProtocolLen,
+                u_char * privKey, size_t privKeyLen,
+                u_char * iv, size_t ivLen,
+                const u_char * plaintext, size_t ptLen,
+                u_char * ciphertext, size_t * ctLen)
+{
+    netsnmp_cipher_key *ck = usm_user_priv_cipher(user);
+
+    if (sc_cipher_key_matches(ck, privProtocol, privProtocolLen,
+                              privKey, privKeyLen))
+        return sc_encrypt_prepared(ck, iv, ivLen, plaintext, ptLen,
+                                   ciphertext, ctLen);
+    return sc_encrypt(privProtocol, privProtocolLen, privKey, privKeyLen,
+                      iv, ivLen, plaintext, ptLen, ciphertext, ctLen);
+}
+
 int
 usm_set_usmStateReference_name(struct usmStateReference *ref,
                                char *name, size_t name_len)
@@ -899,6 +1010,7 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
     u_int           thePrivKeyLength = 0;
     const oid      *thePrivProtocol = NULL;
     u_int           thePrivProtocolLength = 0;
+    struct usmUser *theUser = NULL;
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err).
                                          */
@@ -931,6 +1043,9 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        if (theSecLevel != SNMP_SEC_LEVEL_NOAUTH)
+            theUser = usm_get_user_counted(theEngineID, theEngineIDLength,
+                                           theName, theNameLength);
     }
 
     /*
@@ -955,6 +1070,7 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         theEngineID = secEngineID;
         theSecLevel = secLevel;
         theEngineIDLength = secEngineIDLen;
+        theUser = user;
         if (user) {
             theAuthProtocol = user->authProtocol;
             theAuthProtocolLength = user->authProtocolLen;
@@ -1097,11 +1213,11 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       &ptr[dataOffset], &encrypted_length)
+        if (usm_encrypt_msg(theUser, thePrivProtocol, thePrivProtocolLength,
+                            thePrivKey, thePrivKeyLength,
+                            salt, salt_length,
+                            scopedPdu, scopedPduLen,
+                            &ptr[dataOffset], &encrypted_length)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             usm_free_usmStateReference(secStateRef);
@@ -1272,9 +1388,9 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   ptr, ptr_len, temp_sig, &temp_sig_len)
+        if (usm_sign_msg(theUser, theAuthProtocol, theAuthProtocolLength,
+                         theAuthKey, theAuthKeyLength,
+                         ptr, ptr_len, temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             /*
              * FIX temp_sig_len defined?!
@@ -1406,6 +1522,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
     u_int           thePrivKeyLength = 0;
     const oid      *thePrivProtocol = NULL;
     u_int           thePrivProtocolLength = 0;
+    struct usmUser *theUser = NULL;
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err). */
     size_t          salt_length = 0, save_salt_length = 0;
@@ -1443,6 +1560,9 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        if (theSecLevel != SNMP_SEC_LEVEL_NOAUTH)
+            theUser = usm_get_user_counted(theEngineID, theEngineIDLength,
+                                           theName, theNameLength);
     }
 
     /*
@@ -1467,6 +1587,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         theEngineID = secEngineID;
         theSecLevel = secLevel;
         theEngineIDLength = secEngineIDLen;
+        theUser = user;
         if (user) {
             theAuthProtocol = user->authProtocol;
             theAuthProtocolLength = user->authProtocolLen;
@@ -1537,10 +1658,23 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
          * to grow this for us, a la asn_realloc_rbuild_<type> functions, but
          * this will do for now.  
          */
-        u_char         *ciphertext = NULL;
+        u_char         *ciphertext = NULL, *cipherbuf = NULL;
         size_t          ciphertextlen = scopedPduLen + 64;
+        int             in_place = 0;
 
-        if ((ciphertext = (u_char *) malloc(ciphertextlen)) == NULL) {
+#ifdef HAVE_AES
+        /*
+         * AES-CFB does not pad, so a scopedPdu at the end of the packet
+         * buffer, as snmp_build() leaves it, is encrypted where it is.
+         */
+        in_place = ISTRANSFORM(thePrivProtocol, AESPriv) &&
+            scopedPdu == *wholeMsg + *wholeMsgLen - scopedPduLen;
+#endif
+        if (in_place) {
+            ciphertext = scopedPdu;
+            ciphertextlen = scopedPduLen;
+        } else if ((ciphertext = cipherbuf =
+                    (u_char *) malloc(ciphertextlen)) == NULL) {
             DEBUGMSGTL(("usm",
                         "couldn't malloc %d bytes for encrypted PDU\n",
                         (int)ciphertextlen));
@@ -1561,7 +1695,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
                                iv) == -1) {
                 DEBUGMSGTL(("usm", "Can't set AES iv.\n"));
                 usm_free_usmStateReference(secStateRef);
-                SNMP_FREE(ciphertext);
+                SNMP_FREE(cipherbuf);
                 return SNMPERR_USM_GENERICERROR;
             }
         } 
@@ -1576,7 +1710,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
                                              iv) == -1)) {
                 DEBUGMSGTL(("usm", "Can't set DES-CBC salt.\n"));
                 usm_free_usmStateReference(secStateRef);
-                SNMP_FREE(ciphertext);
+                SNMP_FREE(cipherbuf);
                 return SNMPERR_USM_GENERICERROR;
             }
         }
@@ -1588,14 +1722,14 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       ciphertext, &ciphertextlen) != SNMP_ERR_NOERROR) {
+        if (usm_encrypt_msg(theUser, thePrivProtocol, thePrivProtocolLength,
+                            thePrivKey, thePrivKeyLength,
+                            salt, salt_length,
+                            scopedPdu, scopedPduLen,
+                            ciphertext, &ciphertextlen) != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             usm_free_usmStateReference(secStateRef);
-            SNMP_FREE(ciphertext);
+            SNMP_FREE(cipherbuf);
             return SNMPERR_USM_ENCRYPTIONERROR;
         }
 
@@ -1606,16 +1740,25 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
 #ifdef NETSNMP_ENABLE_TESTING_CODE
         theTotalLength = *wholeMsgLen;
 #endif
-        *offset = 0;
-        rc = asn_realloc_rbuild_string(wholeMsg, wholeMsgLen, offset, 1,
-                                       (u_char) (ASN_UNIVERSAL |
-                                                 ASN_PRIMITIVE |
-                                                 ASN_OCTET_STR),
-                                       ciphertext, ciphertextlen);
+        if (in_place) {
+            *offset = ciphertextlen;
+            rc = asn_realloc_rbuild_header(wholeMsg, wholeMsgLen, offset, 1,
+                                           (u_char) (ASN_UNIVERSAL |
+                                                     ASN_PRIMITIVE |
+                                                     ASN_OCTET_STR),
+                                           ciphertextlen);
+        } else {
+            *offset = 0;
+            rc = asn_realloc_rbuild_string(wholeMsg, wholeMsgLen, offset, 1,
+                                           (u_char) (ASN_UNIVERSAL |
+                                                     ASN_PRIMITIVE |
+                                                     ASN_OCTET_STR),
+                                           ciphertext, ciphertextlen);
+        }
         if (rc == 0) {
             DEBUGMSGTL(("usm", "Encryption failed.\n"));
             usm_free_usmStateReference(secStateRef);
-            SNMP_FREE(ciphertext);
+            SNMP_FREE(cipherbuf);
             return SNMPERR_USM_ENCRYPTIONERROR;
         }
 
@@ -1629,7 +1772,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
 #endif
 
         DEBUGMSGTL(("usm", "Encryption successful.\n"));
-        SNMP_FREE(ciphertext);
+        SNMP_FREE(cipherbuf);
     } else {
         /*
          * theSecLevel != SNMP_SEC_LEVEL_AUTHPRIV  
@@ -1817,10 +1960,10 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   proto_msg, proto_msg_len,
-                                   temp_sig, &temp_sig_len)
+        if (usm_sign_msg(theUser, theAuthProtocol, theAuthProtocolLength,
+                         theAuthKey, theAuthKeyLength,
+                         proto_msg, proto_msg_len,
+                         temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             SNMP_FREE(temp_sig);
             DEBUGMSGTL(("usm", "Signing failed.\n"));
@@ -2356,6 +2499,7 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
         (struct usmStateReference **) secStateRf;
 
     struct usmUser *user;
+    netsnmp_cipher_key *ck;
 
 
     DEBUGMSGTL(("usm", "USM processing begun...\n"));
@@ -2503,10 +2647,14 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
      */
     if (secLevel == SNMP_SEC_LEVEL_AUTHNOPRIV
         || secLevel == SNMP_SEC_LEVEL_AUTHPRIV) {
-        if (sc_check_keyed_hash(user->authProtocol, user->authProtocolLen,
-                                user->authKey, user->authKeyLen,
-                                wholeMsg, wholeMsgLen,
-                                signature, signature_length)
+        netsnmp_keyed_hash *kh = usm_user_auth_hash(user);
+
+        if ((kh ? sc_check_prepared_keyed_hash(kh, wholeMsg, wholeMsgLen,
+                                               signature, signature_length)
+             : sc_check_keyed_hash(user->authProtocol, user->authProtocolLen,
+                                   user->authKey, user->authKeyLen,
+                                   wholeMsg, wholeMsgLen,
+                                   signature, signature_length))
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "Verification failed.\n"));
             snmp_increment_statistic(STAT_USMSTATSWRONGDIGESTS);
@@ -2656,11 +2804,22 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
             memcpy(iv+8, salt, salt_length);
         }
 #endif
-        
-        if (sc_decrypt(user->privProtocol, user->privProtocolLen,
-                       user->privKey, user->privKeyLen,
-                       iv, iv_length,
-                       value_ptr, remaining, *scopedPdu, scopedPduLen)
+
+        /*
+         * With a prepared key, decrypt the scopedPdu where it is, in the
+         * message, rather than into the caller's buffer.
+         */
+        ck = usm_user_priv_cipher(user);
+        if (ck) {
+            *scopedPdu = value_ptr;
+            *scopedPduLen = remaining;
+        }
+        if ((ck ? sc_decrypt_prepared(ck, iv, iv_length, value_ptr,
+                                      remaining, *scopedPdu, scopedPduLen)
+             : sc_decrypt(user->privProtocol, user->privProtocolLen,
+                          user->privKey, user->privKeyLen,
+                          iv, iv_length,
+                          value_ptr, remaining, *scopedPdu, scopedPduLen))
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "%s\n", "Failed decryption."));
             snmp_increment_statistic(STAT_USMSTATSDECRYPTIONERRORS);
@@ -3067,6 +3226,8 @@ usm_create_user_from_session(netsnmp_session * session)
         user->userStorageType = ST_READONLY;
         usm_add_user(user);
     }
+    usm_user_auth_hash(user);
+    usm_user_priv_cipher(user);
 
     return SNMPERR_SUCCESS;
 
@@ -3373,6 +3534,7 @@ clear_user_list(void)
 	tmp = next;
     }
     userList = NULL;
+    usm_user_hash_clear();
 
 }
 
@@ -3381,6 +3543,7 @@ shutdown_usm(void)
 {
     free_etimelist();
     clear_user_list();
+    netsnmp_key_cache_clear();
 }
 
 /*******************************************************************-o-******
@@ -3503,6 +3666,153 @@ usm_check_secLevel_vs_protocols(int level,
 
 
 
+/*
+ * Open addressing index of userList by engineID and name, so that
+ * incoming messages don't scan the list.  The list itself stays sorted
+ * for the usmUserTable.  Entries are kept up to date by usm_add_user(),
+ * usm_remove_user() and usm_free_user(); if the table can't be
+ * allocated, lookups walk the list.
+ */
+
+static u_int
+usm_user_hash(const u_char * engineID, size_t engineIDLen, const char *name)
+{
+    u_int           hash = 2166136261U;
+    size_t          i;
+
+    for (i = 0; i < engineIDLen; i++)
+        hash = (hash ^ engineID[i]) * 16777619U;
+    hash = (hash ^ 0xff) * 16777619U;
+    for (; *name; name++)
+        hash = (hash ^ (u_char) *name) * 16777619U;
+    return hash;
+}
+
+/*
+ * The same test usm_get_user_from_list() makes, with name non-NULL.
+ */
+static int
+usm_user_matches(const struct usmUser *user, const u_char * engineID,
+                 size_t engineIDLen, const char *name)
+{
+    return user->engineIDLen == engineIDLen
+        && ((user->engineID == NULL && engineID == NULL)
+            || (user->engineID != NULL && engineID != NULL
+                && memcmp(user->engineID, engineID, engineIDLen) == 0))
+        && strcmp(user->name, name) == 0;
+}
+
+/*
+ * Returns the slot holding the matching user, or the empty slot where it
+ * would go.
+ */
+static size_t
+usm_user_hash_slot(const u_char * engineID, size_t engineIDLen,
+                   const char *name)
+{
+    size_t          slot;
+
+    slot = usm_user_hash(engineID, engineIDLen, name) & (userHashSize - 1);
+    while (userHash[slot] != NULL
+           && !usm_user_matches(userHash[slot], engineID, engineIDLen,
+                                name))
+        slot = (slot + 1) & (userHashSize - 1);
+    return slot;
+}
+
+static void
+usm_user_hash_clear(void)
+{
+    SNMP_FREE(userHash);
+    userHashSize = userHashCount = 0;
+}
+
+/*
+ * (Re)builds the index from userList, in a table of at least size slots.
+ */
+static int
+usm_user_hash_build(size_t size)
+{
+    struct usmUser *uptr;
+    size_t          slot;
+
+    usm_user_hash_clear();
+    userHash = (struct usmUser **) calloc(size, sizeof(struct usmUser *));
+    if (userHash == NULL)
+        return -1;
+    userHashSize = size;
+    for (uptr = userList; uptr != NULL; uptr = uptr->next) {
+        if (uptr->name == NULL)
+            continue;
+        if ((userHashCount + 1) * 2 > userHashSize)
+            return usm_user_hash_build(size * 2);
+        slot = usm_user_hash_slot(uptr->engineID, uptr->engineIDLen,
+                                  uptr->name);
+        if (userHash[slot] == NULL)
+            userHashCount++;
+        userHash[slot] = uptr;
+    }
+    return 0;
+}
+
+static void
+usm_user_hash_add(struct usmUser *user)
+{
+    size_t          slot;
+
+    if (user->name == NULL)
+        return;
+    if (userHash == NULL || (userHashCount + 1) * 2 > userHashSize) {
+        /*
+         * userList already holds the user
+         */
+        if (usm_user_hash_build(userHashSize ? userHashSize * 2 : 64) < 0)
+            usm_user_hash_clear();
+        return;
+    }
+    slot = usm_user_hash_slot(user->engineID, user->engineIDLen,
+                              user->name);
+    if (userHash[slot] == NULL)
+        userHashCount++;
+    userHash[slot] = user;
+}
+
+/*
+ * Returns 1 if the user was in the index, and so in userList.
+ */
+static int
+usm_user_hash_remove(struct usmUser *user)
+{
+    size_t          slot, next, home;
+
+    if (userHash == NULL || user->name == NULL)
+        return 0;
+    slot = usm_user_hash_slot(user->engineID, user->engineIDLen,
+                              user->name);
+    if (userHash[slot] != user)
+        return 0;
+
+    /*
+     * move later members of the probe sequence up, so that no lookup
+     * stops early at the hole
+     */
+    userHash[slot] = NULL;
+    userHashCount--;
+    for (next = (slot + 1) & (userHashSize - 1); userHash[next] != NULL;
+         next = (next + 1) & (userHashSize - 1)) {
+        home = usm_user_hash(userHash[next]->engineID,
+                             userHash[next]->engineIDLen,
+                             userHash[next]->name) & (userHashSize - 1);
+        if (((next - home) & (userHashSize - 1)) >=
+            ((next - slot) & (userHashSize - 1))) {
+            userHash[slot] = userHash[next];
+            userHash[next] = NULL;
+            slot = next;
+        }
+    }
+    return 1;
+}
+
 /*
  * usm_get_user(): Returns a user from userList based on the engineID,
  * engineIDLen and name of the requested user. 
@@ -3525,6 +3835,14 @@ usm_get_user_from_list(u_char * engineID, size_t engineIDLen,
     char            noName[] = "";
     if (name == NULL)
         name = noName;
+    if (puserList == userList && userHash != NULL) {
+        ptr = userHash[usm_user_hash_slot(engineID, engineIDLen, name)];
+        if (ptr != NULL) {
+            DEBUGMSGTL(("usm", "match on user %s\n", ptr->name));
+            return ptr;
+        }
+        puserList = NULL;       /* not there */
+    }
     for (ptr = puserList; ptr != NULL; ptr = ptr->next) {
         if (ptr->name && !strcmp(ptr->name, name)) {
           DEBUGMSGTL(("usm", "match on user %s\n", ptr->name));
@@ -3565,8 +3883,10 @@ usm_add_user(struct usmUser *user)
 {
     struct usmUser *uptr;
     uptr = usm_add_user_to_list(user, userList);
-    if (uptr != NULL)
+    if (uptr != NULL) {
         userList = uptr;
+        usm_user_hash_add(user);
+    }
     return uptr;
 }
 
@@ -3676,6 +3996,18 @@ usm_add_user_to_list(struct usmUser *user, struct usmUser *puserList)
 struct usmUser *
 usm_remove_user(struct usmUser *user)
 {
+    if (user != NULL && usm_user_hash_remove(user)) {
+        /*
+         * it's in userList, so unlink it without looking for it
+         */
+        if (user->prev)
+            user->prev->next = user->next;
+        else
+            userList = user->next;
+        if (user->next)
+            user->next->prev = user->prev;
+        return userList;
+    }
     return usm_remove_user_from_list(user, &userList);
 }
 
@@ -3744,6 +4076,7 @@ usm_free_user(struct usmUser *user)
     if (user == NULL)
         return NULL;
 
+    usm_user_hash_remove(user);
     SNMP_FREE(user->engineID);
     SNMP_FREE(user->name);
     SNMP_FREE(user->secName);
@@ -3762,6 +4095,8 @@ usm_free_user(struct usmUser *user)
         SNMP_FREE(user->privKey);
     }
 
+    sc_keyed_hash_free(user->authKeyHash);
+    sc_cipher_key_free(user->privKeyCipher);
 
     /*
      * FIX  Why not put this check *first?*
@@ -4317,6 +4652,11 @@ usm_set_user_password(struct usmUser *user, const char *token, char *line)
             return;
         }
     }
+
+    if (key == &user->authKey)
+        usm_user_auth_hash(user);
+    else
+        usm_user_priv_cipher(user);
 }                               /* end usm_set_password() */
 
 void
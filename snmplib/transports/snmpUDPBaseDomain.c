@@ -43,6 +43,7 @@
 #include <net-snmp/library/default_store.h>
 #include <net-snmp/library/system.h>
 #include <net-snmp/library/snmp_assert.h>
+#include <net-snmp/library/callback.h>
 
 #ifndef  MSG_DONTWAIT
 #define MSG_DONTWAIT 0
@@ -90,6 +91,21 @@ _netsnmp_udp_sockopt_set(int fd, int local)
 #endif                          /*SO_REUSEADDR */
 #endif
 
+#ifdef SO_REUSEPORT
+    /*
+     * Several sockets of our own sharing a server port (udpListenSockets);
+     * the kernel spreads the incoming datagrams across them by source
+     * address.
+     */
+    if (local && netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                    NETSNMP_DS_LIB_UDP_LISTEN_SOCKETS) > 1) {
+        int             one = 1;
+        DEBUGMSGTL(("socket:option", "setting socket option SO_REUSEPORT\n"));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *) &one,
+                   sizeof(one));
+    }
+#endif                          /*SO_REUSEPORT */
+
     /*
      * Try to set the send and receive buffers to a reasonably large value, so
      * that we can send and receive big PDUs (defaults to 8192 bytes (!) on
@@ -375,6 +391,568 @@ int netsnmp_udpbase_sendto(int fd, struct in_addr *srcip, int if_index,
 }
 #endif /* HAVE_IP_PKTINFO || HAVE_IP_RECVDSTADDR */
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && \
+    defined(HAVE_IP_PKTINFO) && !defined(WIN32)
+/*
+ * Batched I/O.  When the udpBatchSize token asks for more than one
+ * datagram per readable event, netsnmp_udpbase_recv() and, for UDP/IPv6,
+ * netsnmp_udp6_recv() fetch up to that many datagrams with a single
+ * recvmmsg() and hand them out one per call, keeping
+ * NETSNMP_TRANSPORT_FLAG_RECV_QUEUED set while they hold more than one.
+ * Responses sent meanwhile are queued and go out with a single sendmmsg()
+ * from the call after the last datagram was processed.
+ *
+ * The datagrams of a batch share a receive buffer of udpBatchBufferSize
+ * bytes, by default as large as the receive buffer of the socket.  A
+ * datagram which does not fit its share is dropped.
+ */
+#define netsnmp_udpbase_batch_defined
+
+#define UDPBASE_BATCH_MAX       64
+#define UDPBASE_BATCH_MIN_SLOT  2048    /* smallest share of the buffer */
+#define UDPBASE_BATCH_SLOTS     7       /* 1, 2-3, 4-7, ..., 64 */
+#define UDPBASE_BATCH_REPORT    1000    /* batches between debug reports */
+#define UDPBASE_BATCH_ALIGN(n)  (((n) + 15) & ~(size_t)15)
+
+typedef struct udpbase_batch_s {
+    int             size;       /* datagrams per recvmmsg() */
+    int             buffer;     /* udpBatchBufferSize when allocated */
+    int             count;      /* datagrams the last recvmmsg() returned */
+    int             next;       /* next datagram to hand out */
+    int             queued;     /* responses waiting for sendmmsg() */
+    size_t          slot_size;  /* receive buffer per datagram */
+    size_t          rx_cmsg_len;/* control data per datagram (IPv4) */
+    netsnmp_sockaddr_storage local;
+    struct mmsghdr *rx_msg;
+    struct iovec   *rx_iov;
+    netsnmp_sockaddr_storage *rx_from;
+    char           *rx_cmsg;
+    u_char         *rx_buf;
+    struct mmsghdr *tx_msg;
+    struct iovec   *tx_iov;
+    netsnmp_sockaddr_storage *tx_to;
+    struct in_addr *tx_src;
+    int            *tx_if_index;
+    char           *tx_cmsg;
+} udpbase_batch;
+
+/* distribution of the number of datagrams per recvmmsg() and sendmmsg() */
+static unsigned long udpbase_rx_batches[UDPBASE_BATCH_SLOTS];
+static unsigned long udpbase_tx_batches[UDPBASE_BATCH_SLOTS];
+static unsigned long udpbase_rx_dropped;
+static unsigned long udpbase_rx_unreported;
+static int      udpbase_report_registered;
+
+static void
+_udpbase_batch_count(unsigned long *hist, int n)
+{
+    int             slot = 0;
+
+    while (n > 1 && slot < UDPBASE_BATCH_SLOTS - 1) {
+        n >>= 1;
+        slot++;
+    }
+    hist[slot]++;
+}
+
+static void
+_udpbase_batch_format(char *line, size_t size, const unsigned long *hist)
+{
+    size_t          len = 0;
+    int             slot;
+
+    line[0] = '\0';
+    for (slot = 0; slot < UDPBASE_BATCH_SLOTS && len < size; slot++) {
+        if (slot == 0 || slot == UDPBASE_BATCH_SLOTS - 1)
+            len += snprintf(line + len, size - len, " %d:%lu",
+                            1 << slot, hist[slot]);
+        else
+            len += snprintf(line + len, size - len, " %d-%d:%lu",
+                            1 << slot, (2 << slot) - 1, hist[slot]);
+    }
+}
+
+static int
+_udpbase_batch_report(int majorID, int minorID, void *serverarg,
+                      void *clientarg)
+{
+    char            line[256];
+
+    _udpbase_batch_format(line, sizeof(line), udpbase_rx_batches);
+    snmp_log(LOG_INFO, "UDP datagrams per recvmmsg():%s\n", line);
+    _udpbase_batch_format(line, sizeof(line), udpbase_tx_batches);
+    snmp_log(LOG_INFO, "UDP datagrams per sendmmsg():%s\n", line);
+    if (udpbase_rx_dropped)
+        snmp_log(LOG_INFO, "UDP datagrams too large for their batch: %lu\n",
+                 udpbase_rx_dropped);
+    memset(udpbase_rx_batches, 0, sizeof(udpbase_rx_batches));
+    memset(udpbase_tx_batches, 0, sizeof(udpbase_tx_batches));
+    udpbase_rx_dropped = 0;
+    udpbase_report_registered = 0;
+    return SNMPERR_SUCCESS;
+}
+
+/*
+ * With the udpbase:batch:stats debug token, the histograms so far are
+ * also shown every UDPBASE_BATCH_REPORT batches received.
+ */
+static void
+_udpbase_batch_debug_report(void)
+{
+    char            line[256];
+
+    if (++udpbase_rx_unreported < UDPBASE_BATCH_REPORT)
+        return;
+    udpbase_rx_unreported = 0;
+    _udpbase_batch_format(line, sizeof(line), udpbase_rx_batches);
+    DEBUGMSGTL(("udpbase:batch:stats", "datagrams per recvmmsg():%s\n",
+                line));
+    _udpbase_batch_format(line, sizeof(line), udpbase_tx_batches);
+    DEBUGMSGTL(("udpbase:batch:stats", "datagrams per sendmmsg():%s\n",
+                line));
+    DEBUGMSGTL(("udpbase:batch:stats", "datagrams too large: %lu\n",
+                udpbase_rx_dropped));
+}
+
+/*
+ * Returns the batch state of a transport, (re)allocating it when the
+ * configured batch size changed, or NULL if batching is disabled.
+ */
+static udpbase_batch *
+_udpbase_batch_get(netsnmp_transport *t)
+{
+    udpbase_batch  *b = (udpbase_batch *) t->batch;
+    netsnmp_sockaddr_storage local;
+    socklen_t       len;
+    size_t          rx_cmsg_len, slot_size, off[11], total;
+    char           *base;
+    int             size, buffer, bytes, i;
+
+    size = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                              NETSNMP_DS_LIB_UDP_BATCH_SIZE);
+    if (size > UDPBASE_BATCH_MAX)
+        size = UDPBASE_BATCH_MAX;
+    if (size < 1)
+        size = 1;
+    buffer = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                NETSNMP_DS_LIB_UDP_BATCH_BUFFER);
+
+    if (b && ((b->size == size && b->buffer == buffer) ||
+              b->next < b->count || b->queued))
+        return b;
+    if (b) {
+        t->batch = NULL;
+        free(b);
+    }
+    if (size == 1)
+        return NULL;
+
+    len = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    if (getsockname(t->sock, &local.sa, &len) < 0)
+        return NULL;
+    if (local.sa.sa_family == AF_INET)
+        rx_cmsg_len = CMSG_SPACE(cmsg_data_size);
+#ifdef NETSNMP_ENABLE_IPV6
+    else if (local.sa.sa_family == AF_INET6)
+        rx_cmsg_len = 0;
+#endif
+    else
+        return NULL;
+
+    /*
+     * Share the buffer among the datagrams of a batch, but leave room for
+     * a full size request in each.
+     */
+    bytes = buffer;
+    if (bytes <= 0) {
+        len = sizeof(bytes);
+        if (getsockopt(t->sock, SOL_SOCKET, SO_RCVBUF, (void *) &bytes,
+                       &len) < 0)
+            bytes = 0;
+    }
+    slot_size = bytes / size;
+    if (slot_size < UDPBASE_BATCH_MIN_SLOT)
+        slot_size = UDPBASE_BATCH_MIN_SLOT;
+    if (slot_size > t->msgMaxSize)
+        slot_size = t->msgMaxSize;
+
+    /*
+     * Everything lives in a single allocation, so that
+     * netsnmp_transport_free() can release it.
+     */
+    total = UDPBASE_BATCH_ALIGN(sizeof(udpbase_batch));
+    off[0] = total, total += UDPBASE_BATCH_ALIGN(size * sizeof(struct mmsghdr));
+    off[1] = total, total += UDPBASE_BATCH_ALIGN(size * sizeof(struct iovec));
+    off[2] = total, total += UDPBASE_BATCH_ALIGN(size *
+                                        sizeof(netsnmp_sockaddr_storage));
+    off[3] = total, total += UDPBASE_BATCH_ALIGN(size * rx_cmsg_len);
+    off[4] = total, total += UDPBASE_BATCH_ALIGN(size * sizeof(struct mmsghdr));
+    off[5] = total, total += UDPBASE_BATCH_ALIGN(size * sizeof(struct iovec));
+    off[6] = total, total += UDPBASE_BATCH_ALIGN(size *
+                                        sizeof(netsnmp_sockaddr_storage));
+    off[7] = total, total += UDPBASE_BATCH_ALIGN(size *
+                                        sizeof(struct in_addr));
+    off[8] = total, total += UDPBASE_BATCH_ALIGN(size * sizeof(int));
+    off[9] = total, total += UDPBASE_BATCH_ALIGN(size * rx_cmsg_len);
+    off[10] = total, total += size * slot_size;
+
+    base = (char *) calloc(1, total);
+    if (!base) {
+        snmp_log(LOG_ERR, "udp: no memory for a batch of %d datagrams\n",
+                 size);
+        return NULL;
+    }
+    b = (udpbase_batch *) base;
+    b->size = size;
+    b->buffer = buffer;
+    b->slot_size = slot_size;
+    b->rx_cmsg_len = rx_cmsg_len;
+    b->local = local;
+    b->rx_msg = (struct mmsghdr *) (base + off[0]);
+    b->rx_iov = (struct iovec *) (base + off[1]);
+    b->rx_from = (netsnmp_sockaddr_storage *) (base + off[2]);
+    b->rx_cmsg = base + off[3];
+    b->tx_msg = (struct mmsghdr *) (base + off[4]);
+    b->tx_iov = (struct iovec *) (base + off[5]);
+    b->tx_to = (netsnmp_sockaddr_storage *) (base + off[6]);
+    b->tx_src = (struct in_addr *) (base + off[7]);
+    b->tx_if_index = (int *) (base + off[8]);
+    b->tx_cmsg = base + off[9];
+    b->rx_buf = (u_char *) (base + off[10]);
+
+    for (i = 0; i < size; i++) {
+        b->rx_iov[i].iov_base = b->rx_buf + i * b->slot_size;
+        b->rx_iov[i].iov_len = b->slot_size;
+        b->rx_msg[i].msg_hdr.msg_name = &b->rx_from[i];
+        b->rx_msg[i].msg_hdr.msg_iov = &b->rx_iov[i];
+        b->rx_msg[i].msg_hdr.msg_iovlen = 1;
+        if (rx_cmsg_len)
+            b->rx_msg[i].msg_hdr.msg_control = b->rx_cmsg + i * rx_cmsg_len;
+    }
+    t->batch = b;
+
+    if (!udpbase_report_registered) {
+        snmp_register_callback(SNMP_CALLBACK_LIBRARY, SNMP_CALLBACK_SHUTDOWN,
+                               _udpbase_batch_report, NULL);
+        udpbase_report_registered = 1;
+    }
+    DEBUGMSGTL(("udpbase:batch",
+                "fd %d: batches of up to %d datagrams of %d bytes\n",
+                t->sock, size, (int) slot_size));
+    return b;
+}
+
+/*
+ * Sends the queued responses.
+ */
+static void
+_udpbase_batch_flush(netsnmp_transport *t, udpbase_batch *b)
+{
+    int             i = 0, rc;
+
+    if (!b->queued)
+        return;
+
+    _udpbase_batch_count(udpbase_tx_batches, b->queued);
+    DEBUGMSGTL(("udpbase:batch", "fd %d: sending %d datagrams\n", t->sock,
+                b->queued));
+    while (i < b->queued) {
+        rc = sendmmsg(t->sock, &b->tx_msg[i], b->queued - i,
+                      MSG_NOSIGNAL|MSG_DONTWAIT);
+        if (rc > 0) {
+            i += rc;
+            continue;
+        }
+        if (rc < 0 && errno == EINTR)
+            continue;
+        /*
+         * Hand the datagram sendmmsg() stopped at to the single datagram
+         * path, which knows how to respond to broadcast requests.
+         */
+        DEBUGMSGTL(("udpbase:batch", "sendmmsg: %s; resending datagram %d\n",
+                    strerror(errno), i));
+        if (b->tx_to[i].sa.sa_family == AF_INET)
+            netsnmp_udpbase_sendto(t->sock, &b->tx_src[i], b->tx_if_index[i],
+                                   &b->tx_to[i].sa, b->tx_iov[i].iov_base,
+                                   b->tx_iov[i].iov_len);
+        else
+            sendto(t->sock, b->tx_iov[i].iov_base, b->tx_iov[i].iov_len, 0,
+                   &b->tx_to[i].sa, b->tx_msg[i].msg_hdr.msg_namelen);
+        i++;
+    }
+    for (i = 0; i < b->queued; i++)
+        free(b->tx_iov[i].iov_base);
+    b->queued = 0;
+}
+
+/*
+ * Queues a response for the next _udpbase_batch_flush().
+ *
+ * @return 0 if queued, -1 if it has to be sent right away.
+ */
+static int
+_udpbase_batch_queue(netsnmp_transport *t, udpbase_batch *b, void *opaque,
+                     int olength, void *buf, int size)
+{
+    netsnmp_indexed_addr_pair *addr_pair = NULL;
+    struct msghdr  *m;
+    socklen_t       to_len;
+    void           *data;
+    int             i;
+
+    if (b->local.sa.sa_family == AF_INET) {
+        if (olength != sizeof(netsnmp_indexed_addr_pair))
+            return -1;
+        addr_pair = (netsnmp_indexed_addr_pair *) opaque;
+        if (addr_pair->remote_addr.sa.sa_family != AF_INET)
+            return -1;
+        to_len = sizeof(struct sockaddr_in);
+#ifdef NETSNMP_ENABLE_IPV6
+    } else if (olength == sizeof(struct sockaddr_in6)) {
+        to_len = sizeof(struct sockaddr_in6);
+#endif
+    } else
+        return -1;
+
+    if (b->queued == b->size)
+        _udpbase_batch_flush(t, b);
+    data = netsnmp_memdup(buf, size);
+    if (!data)
+        return -1;
+
+    i = b->queued++;
+    if (addr_pair) {
+        b->tx_to[i].sin = addr_pair->remote_addr.sin;
+        b->tx_src[i] = addr_pair->local_addr.sin.sin_addr;
+        b->tx_if_index[i] = addr_pair->if_index;
+    } else {
+        memcpy(&b->tx_to[i], opaque, to_len);
+        b->tx_src[i].s_addr = INADDR_ANY;
+        b->tx_if_index[i] = 0;
+    }
+    b->tx_iov[i].iov_base = data;
+    b->tx_iov[i].iov_len = size;
+
+    m = &b->tx_msg[i].msg_hdr;
+    memset(m, 0, sizeof(*m));
+    m->msg_name = &b->tx_to[i];
+    m->msg_namelen = to_len;
+    m->msg_iov = &b->tx_iov[i];
+    m->msg_iovlen = 1;
+
+    if (b->tx_src[i].s_addr != INADDR_ANY) {
+        struct cmsghdr *cm;
+        struct in_pktinfo ipi;
+
+        m->msg_control = b->tx_cmsg + i * CMSG_SPACE(cmsg_data_size);
+        m->msg_controllen = CMSG_SPACE(cmsg_data_size);
+        memset(m->msg_control, 0, m->msg_controllen);
+        cm = CMSG_FIRSTHDR(m);
+        cm->cmsg_len = CMSG_LEN(cmsg_data_size);
+        cm->cmsg_level = SOL_IP;
+        cm->cmsg_type = IP_PKTINFO;
+        /*
+         * As in netsnmp_udpbase_sendto(), only the source address is set.
+         */
+        memset(&ipi, 0, sizeof(ipi));
+#if defined(cygwin)
+        ipi.ipi_addr.s_addr = b->tx_src[i].s_addr;
+#else
+        ipi.ipi_spec_dst.s_addr = b->tx_src[i].s_addr;
+#endif
+        memcpy(CMSG_DATA(cm), &ipi, sizeof(ipi));
+    }
+    return 0;
+}
+
+/*
+ * Returns the address datagram i of the batch came from, in the form the
+ * send function of the transport expects: a netsnmp_indexed_addr_pair
+ * for UDP/IPv4, a struct sockaddr_in6 for UDP/IPv6.
+ */
+static void *
+_udpbase_batch_from(udpbase_batch *b, int i, int *olength)
+{
+    netsnmp_indexed_addr_pair *addr_pair;
+    struct msghdr  *m = &b->rx_msg[i].msg_hdr;
+    struct cmsghdr *cm;
+
+#ifdef NETSNMP_ENABLE_IPV6
+    if (b->local.sa.sa_family == AF_INET6) {
+        struct sockaddr_in6 *from;
+
+        from = (struct sockaddr_in6 *) malloc(sizeof(*from));
+        if (from == NULL)
+            return NULL;
+        memcpy(from, &b->rx_from[i].sin6, sizeof(*from));
+        *olength = sizeof(*from);
+        return from;
+    }
+#endif
+
+    addr_pair = SNMP_MALLOC_TYPEDEF(netsnmp_indexed_addr_pair);
+    if (addr_pair == NULL)
+        return NULL;
+    memcpy(&addr_pair->remote_addr, &b->rx_from[i], m->msg_namelen);
+    addr_pair->local_addr = b->local;
+    for (cm = CMSG_FIRSTHDR(m); cm != NULL; cm = CMSG_NXTHDR(m, cm)) {
+        if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_PKTINFO) {
+            struct in_pktinfo *src = (struct in_pktinfo *) CMSG_DATA(cm);
+
+            addr_pair->local_addr.sin.sin_addr = src->ipi_addr;
+            addr_pair->if_index = src->ipi_ifindex;
+        }
+    }
+    *olength = sizeof(netsnmp_indexed_addr_pair);
+    return addr_pair;
+}
+
+/*
+ * Drops datagram i of the batch, which did not fit its share of the
+ * receive buffer.
+ */
+static void
+_udpbase_batch_drop(netsnmp_transport *t, udpbase_batch *b, int i)
+{
+    void           *from;
+    char           *str = NULL;
+    int             len = 0;
+
+    udpbase_rx_dropped++;
+    from = _udpbase_batch_from(b, i, &len);
+    if (from && t->f_fmtaddr)
+        str = t->f_fmtaddr(t, from, len);
+    snmp_log(LOG_WARNING, "udp: dropped a datagram of more than %d bytes "
+             "from %s (see udpBatchBufferSize)\n", (int) b->slot_size,
+             str ? str : "?");
+    free(str);
+    free(from);
+}
+
+static int
+_udpbase_batch_recv(netsnmp_transport *t, udpbase_batch *b, void *buf,
+                    int size, void **opaque, int *olength)
+{
+    int             i, rc;
+
+    *opaque = NULL;
+    *olength = 0;
+
+    if (b->next >= b->count &&
+        !(t->flags & NETSNMP_TRANSPORT_FLAG_RECV_QUEUED)) {
+        for (i = 0; i < b->size; i++) {
+            b->rx_msg[i].msg_hdr.msg_namelen = sizeof(b->rx_from[i]);
+            b->rx_msg[i].msg_hdr.msg_controllen = b->rx_cmsg_len;
+            b->rx_msg[i].msg_hdr.msg_flags = 0;
+        }
+        do {
+            rc = recvmmsg(t->sock, b->rx_msg, b->size, MSG_DONTWAIT, NULL);
+        } while (rc < 0 && errno == EINTR);
+        if (rc <= 0) {
+            DEBUGMSGTL(("netsnmp_udp", "recvmmsg fd %d err %d (\"%s\")\n",
+                        t->sock, errno, strerror(errno)));
+            return -1;
+        }
+        b->count = rc;
+        b->next = 0;
+        _udpbase_batch_count(udpbase_rx_batches, rc);
+        DEBUGMSGTL(("udpbase:batch", "fd %d: received %d datagrams\n",
+                    t->sock, rc));
+        DEBUGIF("udpbase:batch:stats") {
+            _udpbase_batch_debug_report();
+        }
+        if (rc > 1)
+            t->flags |= NETSNMP_TRANSPORT_FLAG_RECV_QUEUED;
+    }
+
+    while (b->next < b->count &&
+           (b->rx_msg[b->next].msg_hdr.msg_flags & MSG_TRUNC))
+        _udpbase_batch_drop(t, b, b->next++);
+
+    if (b->next >= b->count) {
+        /*
+         * Every datagram of the batch has been processed.
+         */
+        _udpbase_batch_flush(t, b);
+        t->flags &= ~NETSNMP_TRANSPORT_FLAG_RECV_QUEUED;
+        t->flags |= NETSNMP_TRANSPORT_FLAG_EMPTY_PKT;
+        return 0;
+    }
+
+    i = b->next++;
+    *opaque = _udpbase_batch_from(b, i, olength);
+    if (*opaque == NULL) {
+        *olength = 0;
+        return -1;
+    }
+    rc = b->rx_msg[i].msg_len;
+    if (rc > size)
+        rc = size;
+    memcpy(buf, b->rx_iov[i].iov_base, rc);
+
+    DEBUGIF("udpbase:batch") {
+        char *str = t->f_fmtaddr ? t->f_fmtaddr(t, *opaque, *olength) : NULL;
+        DEBUGMSGTL(("udpbase:batch",
+                    "recvmmsg fd %d got %d bytes (from %s, %d of %d)\n",
+                    t->sock, rc, str ? str : "?", i + 1, b->count));
+        free(str);
+    }
+    return rc;
+}
+
+/**
+ * Receives a datagram as part of a batch if udpBatchSize asks for
+ * batches, for UDP/IPv4 and UDP/IPv6 transports.
+ *
+ * @return 1 if the datagram was received that way, with *rc set to what
+ *   f_recv should return, 0 if batching is off for the transport.
+ */
+int
+netsnmp_udpbase_batch_recv(netsnmp_transport *t, void *buf, int size,
+                           void **opaque, int *olength, int *rc)
+{
+    udpbase_batch  *b;
+
+    if (t == NULL || t->sock < 0 || (b = _udpbase_batch_get(t)) == NULL)
+        return 0;
+    *rc = _udpbase_batch_recv(t, b, buf, size, opaque, olength);
+    return 1;
+}
+
+/**
+ * Queues a response to a datagram received by netsnmp_udpbase_batch_recv()
+ * while the rest of its batch is being processed.
+ *
+ * @return 1 if the response was queued, 0 if it has to be sent right away.
+ */
+int
+netsnmp_udpbase_batch_send(netsnmp_transport *t, void *buf, int size,
+                           void **opaque, int *olength)
+{
+    if (t == NULL || !(t->flags & NETSNMP_TRANSPORT_FLAG_RECV_QUEUED) ||
+        t->batch == NULL || opaque == NULL || *opaque == NULL ||
+        olength == NULL)
+        return 0;
+    return _udpbase_batch_queue(t, (udpbase_batch *) t->batch, *opaque,
+                                *olength, buf, size) == 0;
+}
+#else /* !(HAVE_RECVMMSG && HAVE_SENDMMSG && HAVE_IP_PKTINFO && !WIN32) */
+int
+netsnmp_udpbase_batch_recv(netsnmp_transport *t, void *buf, int size,
+                           void **opaque, int *olength, int *rc)
+{
+    return 0;
+}
+
+int
+netsnmp_udpbase_batch_send(netsnmp_transport *t, void *buf, int size,
+                           void **opaque, int *olength)
+{
+    return 0;
+}
+#endif /* HAVE_RECVMMSG && HAVE_SENDMMSG && HAVE_IP_PKTINFO && !WIN32 */
+
 /*
  * You can write something into opaque that will subsequently get passed back 
  * to your send function if you like.  For instance, you might want to
@@ -390,6 +968,9 @@ netsnmp_udpbase_recv(netsnmp_transport *t, void *buf, int size,
     netsnmp_indexed_addr_pair *addr_pair = NULL;
     struct sockaddr *from;
 
+    if (netsnmp_udpbase_batch_recv(t, buf, size, opaque, olength, &rc))
+        return rc;
+
     if (t != NULL && t->sock >= 0) {
         addr_pair = SNMP_MALLOC_TYPEDEF(netsnmp_indexed_addr_pair);
         if (addr_pair == NULL) {
@@ -461,6 +1042,9 @@ netsnmp_udpbase_send(netsnmp_transport *t, void *buf, int size,
                         size, buf, str, t->sock));
             free(str);
         }
+        if (opaque != NULL && *opaque == addr_pair &&
+            netsnmp_udpbase_batch_send(t, buf, size, opaque, olength))
+            return size;
 	while (rc < 0) {
 #ifdef netsnmp_udpbase_recvfrom_sendto_defined
             rc = netsnmp_udp_sendto(t->sock,
@@ -479,6 +1063,19 @@ netsnmp_udpbase_send(netsnmp_transport *t, void *buf, int size,
     return rc;
 }
 
+int
+netsnmp_udpbase_close(netsnmp_transport *t)
+{
+#ifdef netsnmp_udpbase_batch_defined
+    if (t && t->batch) {
+        _udpbase_batch_flush(t, (udpbase_batch *) t->batch);
+        t->flags &= ~NETSNMP_TRANSPORT_FLAG_RECV_QUEUED;
+        SNMP_FREE(t->batch);
+    }
+#endif
+    return netsnmp_socketbase_close(t);
+}
+
 void
 netsnmp_udp_base_ctor(void)
 {
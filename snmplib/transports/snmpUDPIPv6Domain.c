@@ -65,6 +65,7 @@ static const struct in6_addr in6addr_any = IN6ADDR_ANY_INIT;
 
 #include <net-snmp/library/snmp_transport.h>
 #include <net-snmp/library/snmpSocketBaseDomain.h>
+#include <net-snmp/library/snmpUDPBaseDomain.h>
 #include <net-snmp/library/tools.h>
 
 #ifndef NETSNMP_NO_SYSTEMD
@@ -110,6 +111,9 @@ netsnmp_udp6_recv(netsnmp_transport *t, void *buf, int size,
     socklen_t       fromlen = sizeof(struct sockaddr_in6);
     struct sockaddr *from;
 
+    if (netsnmp_udpbase_batch_recv(t, buf, size, opaque, olength, &rc))
+        return rc;
+
     if (t != NULL && t->sock >= 0) {
         from = (struct sockaddr *) malloc(sizeof(struct sockaddr_in6));
         if (from == NULL) {
@@ -172,6 +176,9 @@ netsnmp_udp6_send(netsnmp_transport *t, void *buf, int size,
                         size, buf, str, t->sock));
             free(str);
         }
+        if (opaque != NULL && to == *opaque &&
+            netsnmp_udpbase_batch_send(t, buf, size, opaque, olength))
+            return size;
 	while (rc < 0) {
 	    rc = sendto(t->sock, buf, size, 0, to,sizeof(struct sockaddr_in6));
 	    if (rc < 0 && errno != EINTR) {
@@ -338,7 +345,7 @@ netsnmp_udp6_transport(struct sockaddr_in6 *addr, int local)
     t->msgMaxSize = 0xffff - 8 - 40;
     t->f_recv     = netsnmp_udp6_recv;
     t->f_send     = netsnmp_udp6_send;
-    t->f_close    = netsnmp_socketbase_close;
+    t->f_close    = netsnmp_udpbase_close;
     t->f_accept   = NULL;
     t->f_fmtaddr  = netsnmp_udp6_fmtaddr;
 
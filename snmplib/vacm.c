@@ -55,6 +55,8 @@
 
 #include <net-snmp/library/snmp_api.h>
 #include <net-snmp/library/tools.h>
+#include <net-snmp/library/callback.h>
+#include <net-snmp/library/mt_support.h>
 #include <net-snmp/library/vacm.h>
 
 static struct vacm_viewEntry *viewList = NULL, *viewScanPtr = NULL;
@@ -69,6 +71,74 @@ static struct vacm_groupEntry *groupList = NULL, *groupScanPtr = NULL;
 #define VIEW_MASK(viewPtr, idx, mask) \
     ((idx >= viewPtr->viewMaskLen) ? mask : (viewPtr->viewMask[idx] & mask))
 
+/*
+ * Lookups in viewList go through a per view name trie of the view
+ * subtrees, and group/access resolution is remembered per requester.
+ * Both become stale whenever vacm_generation changes, which every
+ * create and destroy function does, and vacm_invalidateCaches() does for
+ * changes made to existing entries.
+ *
+ * snmpd may look views up from several threads at once, so lookups never
+ * change the trie: vacm_buildIndexes() rebuilds it once the configuration
+ * has been read and, in snmpd, whenever the worker threads were locked
+ * out to change the tables.  Until then views are looked up in viewList.
+ * The memo is written by lookups, so each thread keeps its own.
+ */
+struct vacm_viewNode {
+    oid             subid;
+    u_char          below;      /* 1 << viewType of every deeper entry */
+    size_t          nchildren, maxchildren;
+    struct vacm_viewNode **children;    /* sorted by subid */
+    struct vacm_viewNode *wild;         /* masked-out sub-identifier */
+    int             nentries;
+    struct vacm_viewEntry **entries;    /* subtrees ending here */
+    int            *order;              /* their positions in viewList */
+};
+
+struct vacm_viewIndex {
+    char            viewName[VACMSTRINGLEN];
+    struct vacm_viewNode *root;
+    struct vacm_viewIndex *next;
+};
+
+struct vacm_accessMemo {
+    u_int           generation;
+    int             securityModel;
+    int             securityLevel;
+    char            securityName[VACMSTRINGLEN];
+    char            contextName[VACMSTRINGLEN];
+    struct vacm_groupEntry *group;
+    struct vacm_accessEntry *access;
+};
+
+#define VACM_ACCESS_MEMO_SIZE 256
+
+struct vacm_accessMemoTable {
+    u_int           wraps;      /* vacm_generationWraps when last cleared */
+    struct vacm_accessMemo entries[VACM_ACCESS_MEMO_SIZE];
+};
+
+static u_int    vacm_generation = 1;
+static u_int    vacm_generationWraps = 0;
+static u_int    viewIndexGeneration = 0;
+static struct vacm_viewIndex *viewIndex = NULL;
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+static pthread_key_t accessMemoKey;
+static pthread_once_t accessMemoKeyOnce = PTHREAD_ONCE_INIT;
+#else
+static struct vacm_accessMemoTable *accessMemo = NULL;
+#endif
+
+static void     vacm_tablesChanged(void);
+
+static int
+_vacm_config_read(int majorID, int minorID, void *serverarg,
+                  void *clientarg)
+{
+    vacm_buildIndexes();
+    return SNMPERR_SUCCESS;
+}
+
 /**
  * Initilizes the VACM code.
  * Specifically:
@@ -92,6 +162,12 @@ init_vacm(void)
                          VACM_VIEW_EXECUTE);
     se_add_pair_to_slist(VACM_VIEW_ENUM_NAME, strdup("net"),
                          VACM_VIEW_NET);
+
+    /* after any other callback that may still add entries */
+    netsnmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                              SNMP_CALLBACK_POST_READ_CONFIG,
+                              _vacm_config_read, NULL,
+                              NETSNMP_CALLBACK_LOWEST_PRIORITY);
 }
 
 void
@@ -711,6 +787,7 @@ netsnmp_view_create(struct vacm_viewEntry **head, const char *viewName,
         op->next = vp;
     else
         *head = vp;
+    vacm_tablesChanged();
     return vp;
 }
 
@@ -742,6 +819,7 @@ netsnmp_view_destroy(struct vacm_viewEntry **head, const char *viewName,
     if (vp->reserved)
         free(vp->reserved);
     free(vp);
+    vacm_tablesChanged();
     return;
 }
 
@@ -755,6 +833,7 @@ netsnmp_view_clear(struct vacm_viewEntry **head)
             free(vp->reserved);
         free(vp);
     }
+    vacm_tablesChanged();
 }
 
 struct vacm_groupEntry *
@@ -839,6 +918,7 @@ vacm_createGroupEntry(int securityModel, const char *securityName)
         groupList = gp;
     else
         og->next = gp;
+    vacm_tablesChanged();
     return gp;
 }
 
@@ -866,6 +946,7 @@ vacm_destroyGroupEntry(int securityModel, const char *securityName)
     if (vp->reserved)
         free(vp->reserved);
     free(vp);
+    vacm_tablesChanged();
     return;
 }
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
@@ -880,6 +961,7 @@ vacm_destroyAllGroupEntries(void)
             free(gp->reserved);
         free(gp);
     }
+    vacm_tablesChanged();
 }
 
 struct vacm_accessEntry *
@@ -960,6 +1042,131 @@ vacm_getAccessEntry(const char *groupName,
     return best;
 }
 
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+static void
+_vacm_accessMemo_key_init(void)
+{
+    pthread_key_create(&accessMemoKey, free);
+}
+#endif
+
+/*
+ * Returns the calling thread's access memo, allocating it on first use.
+ */
+static struct vacm_accessMemoTable *
+_vacm_accessMemo(void)
+{
+    struct vacm_accessMemoTable *memo;
+
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_once(&accessMemoKeyOnce, _vacm_accessMemo_key_init);
+    memo = (struct vacm_accessMemoTable *) pthread_getspecific(accessMemoKey);
+    if (memo == NULL) {
+        memo = (struct vacm_accessMemoTable *) calloc(1, sizeof(*memo));
+        if (memo && pthread_setspecific(accessMemoKey, memo) != 0)
+            SNMP_FREE(memo);
+    }
+#else
+    if (accessMemo == NULL)
+        accessMemo = (struct vacm_accessMemoTable *)
+            calloc(1, sizeof(*accessMemo));
+    memo = accessMemo;
+#endif
+    return memo;
+}
+
+/*
+ * Frees the calling thread's access memo.  Those of other threads are
+ * freed when the threads exit.
+ */
+static void
+_vacm_accessMemo_free(void)
+{
+#if defined(NETSNMP_REENTRANT) && HAVE_PTHREAD_H
+    pthread_once(&accessMemoKeyOnce, _vacm_accessMemo_key_init);
+    free(pthread_getspecific(accessMemoKey));
+    pthread_setspecific(accessMemoKey, NULL);
+#else
+    SNMP_FREE(accessMemo);
+#endif
+}
+
+/**
+ * Resolves the group and access entries that apply to a request, as
+ * vacm_getGroupEntry() followed by vacm_getAccessEntry() would, and
+ * remembers the answer until the VACM tables next change.
+ *
+ * @param securityModel the security model of the request
+ * @param securityName  the security name of the request
+ * @param securityLevel the security level of the request
+ * @param contextName   the context the request is for
+ * @param group         set to the group entry, or NULL if there is none
+ *
+ * @return the access entry, or NULL if there is none
+ */
+struct vacm_accessEntry *
+vacm_getAccessEntryFor(int securityModel, const char *securityName,
+                       int securityLevel, const char *contextName,
+                       struct vacm_groupEntry **group)
+{
+    struct vacm_accessMemoTable *memo;
+    struct vacm_accessMemo *mp;
+    size_t          slen, clen, i;
+    u_int           hash = 2166136261U;
+
+    *group = NULL;
+    slen = strlen(securityName);
+    clen = strlen(contextName);
+    if (slen > VACM_MAX_STRING || clen > VACM_MAX_STRING)
+        return NULL;
+
+    memo = _vacm_accessMemo();
+    if (memo == NULL) {
+        *group = vacm_getGroupEntry(securityModel, securityName);
+        if (*group == NULL)
+            return NULL;
+        return vacm_getAccessEntry((*group)->groupName, contextName,
+                                   securityModel, securityLevel);
+    }
+    if (memo->wraps != vacm_generationWraps) {
+        memset(memo->entries, 0, sizeof(memo->entries));
+        memo->wraps = vacm_generationWraps;
+    }
+
+    for (i = 0; i < slen; i++)
+        hash = (hash ^ (u_char) securityName[i]) * 16777619U;
+    for (i = 0; i < clen; i++)
+        hash = (hash ^ (u_char) contextName[i]) * 16777619U;
+    hash = (hash ^ securityModel) * 16777619U;
+    hash = (hash ^ securityLevel) * 16777619U;
+    mp = &memo->entries[hash % VACM_ACCESS_MEMO_SIZE];
+
+    if (mp->generation == vacm_generation
+        && mp->securityModel == securityModel
+        && mp->securityLevel == securityLevel
+        && mp->securityName[0] == (char) slen
+        && mp->contextName[0] == (char) clen
+        && memcmp(mp->securityName + 1, securityName, slen) == 0
+        && memcmp(mp->contextName + 1, contextName, clen) == 0) {
+        *group = mp->group;
+        return mp->access;
+    }
+
+    mp->group = vacm_getGroupEntry(securityModel, securityName);
+    mp->access = mp->group ?
+        vacm_getAccessEntry(mp->group->groupName, contextName,
+                            securityModel, securityLevel) : NULL;
+    mp->generation = vacm_generation;
+    mp->securityModel = securityModel;
+    mp->securityLevel = securityLevel;
+    mp->securityName[0] = slen;
+    memcpy(mp->securityName + 1, securityName, slen);
+    mp->contextName[0] = clen;
+    memcpy(mp->contextName + 1, contextName, clen);
+    *group = mp->group;
+    return mp->access;
+}
+
 void
 vacm_scanAccessInit(void)
 {
@@ -1037,6 +1244,7 @@ vacm_createAccessEntry(const char *groupName,
         accessList = vp;
     else
         op->next = vp;
+    vacm_tablesChanged();
     return vp;
 }
 
@@ -1070,6 +1278,7 @@ vacm_destroyAccessEntry(const char *groupName,
     if (vp->reserved)
         free(vp->reserved);
     free(vp);
+    vacm_tablesChanged();
     return;
 }
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
@@ -1084,6 +1293,8 @@ vacm_destroyAllAccessEntries(void)
             free(ap->reserved);
         free(ap);
     }
+    vacm_tablesChanged();
+    _vacm_accessMemo_free();
 }
 
 int
@@ -1119,6 +1330,285 @@ vacm_is_configured(void)
     return 1;
 }
 
+/*
+ * Called whenever the VACM tables change, to make the view index and the
+ * remembered group/access resolutions stale.
+ */
+static void
+vacm_tablesChanged(void)
+{
+    if (++vacm_generation == 0) {
+        vacm_generation = 1;
+        vacm_generationWraps++;
+        viewIndexGeneration = 0;
+    }
+}
+
+/**
+ * Tells the VACM code that an existing group, access or view entry was
+ * modified in a way that changes lookups: a group's groupName, an access
+ * entry's contextMatch, or a view's viewMask or viewType.  Creating and
+ * destroying entries needs no such call.
+ */
+void
+vacm_invalidateCaches(void)
+{
+    vacm_tablesChanged();
+}
+
+#define VIEW_TYPE_BIT(type) ((u_char) (1 << ((type) & 7)))
+
+static void
+_vacm_viewNode_free(struct vacm_viewNode *node)
+{
+    size_t          i;
+
+    if (node == NULL)
+        return;
+    for (i = 0; i < node->nchildren; i++)
+        _vacm_viewNode_free(node->children[i]);
+    _vacm_viewNode_free(node->wild);
+    SNMP_FREE(node->children);
+    SNMP_FREE(node->entries);
+    SNMP_FREE(node->order);
+    free(node);
+}
+
+static void
+_vacm_viewIndex_free(void)
+{
+    struct vacm_viewIndex *ip;
+
+    while ((ip = viewIndex)) {
+        viewIndex = ip->next;
+        _vacm_viewNode_free(ip->root);
+        free(ip);
+    }
+    viewIndexGeneration = 0;
+}
+
+/*
+ * Returns the child of node for subid, or the place it would go in
+ * node->children.
+ */
+static size_t
+_vacm_viewNode_search(struct vacm_viewNode *node, oid subid)
+{
+    size_t          lo = 0, hi = node->nchildren, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (node->children[mid]->subid < subid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static struct vacm_viewNode *
+_vacm_viewNode_add(struct vacm_viewNode *node, oid subid, int exact)
+{
+    struct vacm_viewNode *child, **children;
+    size_t          pos;
+
+    if (!exact) {
+        if (node->wild == NULL)
+            node->wild = SNMP_MALLOC_STRUCT(vacm_viewNode);
+        return node->wild;
+    }
+
+    pos = _vacm_viewNode_search(node, subid);
+    if (pos < node->nchildren && node->children[pos]->subid == subid)
+        return node->children[pos];
+
+    if (node->nchildren == node->maxchildren) {
+        children = (struct vacm_viewNode **)
+            realloc(node->children, (node->maxchildren * 2 + 4) *
+                    sizeof(struct vacm_viewNode *));
+        if (children == NULL)
+            return NULL;
+        node->children = children;
+        node->maxchildren = node->maxchildren * 2 + 4;
+    }
+    child = SNMP_MALLOC_STRUCT(vacm_viewNode);
+    if (child == NULL)
+        return NULL;
+    child->subid = subid;
+    memmove(node->children + pos + 1, node->children + pos,
+            (node->nchildren - pos) * sizeof(struct vacm_viewNode *));
+    node->children[pos] = child;
+    node->nchildren++;
+    return child;
+}
+
+/*
+ * Adds a view subtree to the index.  Sub-identifiers that the mask
+ * leaves out go to the wildcard child, so a lookup follows both it and
+ * the matching child.
+ */
+static int
+_vacm_viewIndex_add(struct vacm_viewEntry *vp, int order)
+{
+    struct vacm_viewIndex *ip;
+    struct vacm_viewNode *node;
+    struct vacm_viewEntry **entries;
+    int            *orders;
+    unsigned int    oidpos;
+
+    for (ip = viewIndex; ip; ip = ip->next)
+        if (!memcmp(ip->viewName, vp->viewName, vp->viewName[0] + 1))
+            break;
+    if (ip == NULL) {
+        ip = SNMP_MALLOC_STRUCT(vacm_viewIndex);
+        if (ip == NULL)
+            return -1;
+        ip->root = SNMP_MALLOC_STRUCT(vacm_viewNode);
+        if (ip->root == NULL) {
+            free(ip);
+            return -1;
+        }
+        memcpy(ip->viewName, vp->viewName, VACMSTRINGLEN);
+        ip->next = viewIndex;
+        viewIndex = ip;
+    }
+
+    node = ip->root;
+    for (oidpos = 0; oidpos < vp->viewSubtreeLen - 1; oidpos++) {
+        node->below |= VIEW_TYPE_BIT(vp->viewType);
+        node = _vacm_viewNode_add(node, vp->viewSubtree[oidpos + 1],
+                                  VIEW_MASK(vp, oidpos / 8,
+                                            0x80 >> (oidpos % 8)) != 0);
+        if (node == NULL)
+            return -1;
+    }
+
+    entries = (struct vacm_viewEntry **)
+        realloc(node->entries, (node->nentries + 1) * sizeof(*entries));
+    if (entries == NULL)
+        return -1;
+    node->entries = entries;
+    orders = (int *) realloc(node->order,
+                             (node->nentries + 1) * sizeof(int));
+    if (orders == NULL)
+        return -1;
+    node->order = orders;
+    node->entries[node->nentries] = vp;
+    node->order[node->nentries] = order;
+    node->nentries++;
+    return 0;
+}
+
+/**
+ * Rebuilds the index of the view subtrees from viewList, if the VACM
+ * tables changed since it was last built.  Lookups use viewList directly
+ * while the index is stale, or if it could not be built.
+ *
+ * Lookups only ever read the index, so this must not run while other
+ * threads may look views up.  It is called once the configuration has
+ * been read, and snmpd calls it before it lets its worker threads run
+ * again after locking them out.
+ */
+void
+vacm_buildIndexes(void)
+{
+    struct vacm_viewEntry *vp;
+    int             order = 0;
+
+    if (viewIndexGeneration == vacm_generation)
+        return;
+    _vacm_viewIndex_free();
+    for (vp = viewList; vp; vp = vp->next) {
+        if (_vacm_viewIndex_add(vp, order++) < 0) {
+            _vacm_viewIndex_free();
+            return;
+        }
+    }
+    viewIndexGeneration = vacm_generation;
+    DEBUGMSGTL(("vacm:viewIndex", "indexed %d view subtrees\n", order));
+}
+
+/*
+ * Finds the index of a view.  Returns -1 if the index is stale and
+ * can't be used.
+ */
+static int
+_vacm_viewIndex_find(const char *viewName, struct vacm_viewNode **root)
+{
+    struct vacm_viewIndex *ip;
+    size_t          glen;
+
+    *root = NULL;
+    if (viewIndexGeneration != vacm_generation)
+        return -1;
+
+    glen = strlen(viewName);
+    if (glen > VACM_MAX_STRING)
+        return 0;
+    for (ip = viewIndex; ip; ip = ip->next) {
+        if ((size_t) ip->viewName[0] == glen
+            && !memcmp(ip->viewName + 1, viewName, glen)) {
+            *root = ip->root;
+            break;
+        }
+    }
+    return 0;
+}
+
+struct vacm_viewMatch {
+    struct vacm_viewEntry *best;
+    int             order;
+    int             count;
+    u_char          below;
+};
+
+/*
+ * Collects the view subtrees that contain the OID: the longest one (the
+ * lexicographically greatest among equally long ones, then the first in
+ * viewList), how many there are, and the types of those that are longer
+ * than the OID but match all of it.
+ */
+static void
+_vacm_viewNode_match(struct vacm_viewNode *node, size_t depth,
+                     const oid * name, size_t len,
+                     struct vacm_viewMatch *match)
+{
+    struct vacm_viewEntry *vp;
+    size_t          pos;
+    int             i, cmp;
+
+    for (i = 0; i < node->nentries; i++) {
+        vp = node->entries[i];
+        match->count++;
+        if (match->best == NULL
+            || vp->viewSubtreeLen > match->best->viewSubtreeLen) {
+            match->best = vp;
+            match->order = node->order[i];
+            continue;
+        }
+        if (vp->viewSubtreeLen < match->best->viewSubtreeLen)
+            continue;
+        cmp = snmp_oid_compare(vp->viewSubtree + 1, vp->viewSubtreeLen - 1,
+                               match->best->viewSubtree + 1,
+                               match->best->viewSubtreeLen - 1);
+        if (cmp > 0 || (cmp == 0 && node->order[i] < match->order)) {
+            match->best = vp;
+            match->order = node->order[i];
+        }
+    }
+
+    if (depth == len) {
+        match->below |= node->below;
+        return;
+    }
+    pos = _vacm_viewNode_search(node, name[depth]);
+    if (pos < node->nchildren && node->children[pos]->subid == name[depth])
+        _vacm_viewNode_match(node->children[pos], depth + 1, name, len,
+                             match);
+    if (node->wild)
+        _vacm_viewNode_match(node->wild, depth + 1, name, len, match);
+}
+
 /*
  * backwards compatability
  */
@@ -1126,16 +1616,61 @@ struct vacm_viewEntry *
 vacm_getViewEntry(const char *viewName,
                   oid * viewSubtree, size_t viewSubtreeLen, int mode)
 {
-    return netsnmp_view_get( viewList, viewName, viewSubtree, viewSubtreeLen,
-                             mode);
+    struct vacm_viewNode *root;
+    struct vacm_viewMatch match;
+
+    if (mode == VACM_MODE_IGNORE_MASK
+        || _vacm_viewIndex_find(viewName, &root) < 0)
+        return netsnmp_view_get( viewList, viewName, viewSubtree,
+                                 viewSubtreeLen, mode);
+
+    memset(&match, 0, sizeof(match));
+    if (root)
+        _vacm_viewNode_match(root, 0, viewSubtree, viewSubtreeLen, &match);
+    DEBUGMSGTL(("vacm:getView", ", %s\n", (match.best) ? "found" : "none"));
+    if (mode == VACM_MODE_CHECK_SUBTREE && match.count > 1) {
+        return NULL;
+    }
+    return match.best;
 }
 
 int
 vacm_checkSubtree(const char *viewName,
                   oid * viewSubtree, size_t viewSubtreeLen)
 {
-    return netsnmp_view_subtree_check( viewList, viewName, viewSubtree,
-                                       viewSubtreeLen);
+    struct vacm_viewNode *root;
+    struct vacm_viewMatch match;
+
+    if (_vacm_viewIndex_find(viewName, &root) < 0)
+        return netsnmp_view_subtree_check( viewList, viewName, viewSubtree,
+                                           viewSubtreeLen);
+
+    memset(&match, 0, sizeof(match));
+    if (root)
+        _vacm_viewNode_match(root, 0, viewSubtree, viewSubtreeLen, &match);
+
+    /*
+     * The longer subtrees must all be of one type, which must agree with
+     * the longest shorter one (or be excluded, if there is none).  See
+     * netsnmp_view_subtree_check().
+     */
+    if (match.below
+        && ((match.below & (match.below - 1))
+            || (!match.best
+                && match.below != VIEW_TYPE_BIT(SNMP_VIEW_EXCLUDED))
+            || (match.best
+                && match.below != VIEW_TYPE_BIT(match.best->viewType)))) {
+        DEBUGMSGTL(("vacm:checkSubtree", ", %s\n", "unknown"));
+        return VACM_SUBTREE_UNKNOWN;
+    }
+
+    if (match.best && match.best->viewType != SNMP_VIEW_EXCLUDED) {
+        DEBUGMSGTL(("vacm:checkSubtree", ", %s\n", "included"));
+        return VACM_SUCCESS;
+    }
+
+    DEBUGMSGTL(("vacm:checkSubtree", ", %s\n", "excluded"));
+    return VACM_NOTINVIEW;
 }
 
 struct vacm_viewEntry *
@@ -1159,5 +1694,6 @@ void
 vacm_destroyAllViewEntries(void)
 {
     netsnmp_view_clear( &viewList );
+    _vacm_viewIndex_free();
 }
 
@@ -1,8 +1,16 @@
 /* HEADER Testing the container API */
 
-netsnmp_container *container;
+netsnmp_container *container, *dup;
+netsnmp_iterator *it;
+netsnmp_void_array *va;
 void *p;
 
+#define BTREE_ITEMS 2000
+#define BTREE_DUPS  100
+oid oids[BTREE_ITEMS][2], dup_oids[2] = { 7, 3 }, key_oids[2];
+netsnmp_index items[BTREE_ITEMS], dups[BTREE_DUPS], key, *ip, *prev;
+int i, j, rc, count, ordered;
+
 init_snmp("container-test");
 container = netsnmp_container_find("fifo");
 container->compare = (netsnmp_container_compare*) strcmp;
@@ -32,4 +40,151 @@ while ((p = CONTAINER_FIRST(container)))
   CONTAINER_REMOVE(container, p);
 CONTAINER_FREE(container);
 
+/*
+ * btree: enough items to split and merge nodes a few levels deep,
+ * inserted and removed in scrambled order
+ */
+container = netsnmp_container_find("btree");
+OK(container != NULL, "btree container found");
+container->compare = netsnmp_compare_netsnmp_index;
+container->ncompare = netsnmp_ncompare_netsnmp_index;
+
+for (i = 0; i < BTREE_ITEMS; ++i) {
+    oids[i][0] = i / 10;
+    oids[i][1] = i % 10;
+    items[i].oids = oids[i];
+    items[i].len = 2;
+}
+for (i = 0, rc = 0; i < BTREE_ITEMS; ++i)
+    rc |= CONTAINER_INSERT(container, &items[(i * 7919) % BTREE_ITEMS]);
+OK(rc == 0 && CONTAINER_SIZE(container) == BTREE_ITEMS,
+   "btree holds all the items inserted");
+
+OK(CONTAINER_INSERT(container, &items[3]) != 0 &&
+   CONTAINER_SIZE(container) == BTREE_ITEMS,
+   "btree rejects a duplicate key");
+
+for (i = 0, count = 0; i < BTREE_ITEMS; ++i)
+    if (CONTAINER_FIND(container, &items[i]) == &items[i])
+        ++count;
+OK(count == BTREE_ITEMS, "btree finds every item");
+
+key.oids = key_oids;
+key.len = 2;
+key_oids[0] = 5;
+key_oids[1] = 10;
+OK(CONTAINER_FIND(container, &key) == NULL &&
+   CONTAINER_NEXT(container, &key) == &items[60],
+   "btree find_next returns the item after a missing key");
+OK(CONTAINER_NEXT(container, &items[BTREE_ITEMS - 1]) == NULL,
+   "btree find_next of the last item returns nothing");
+
+count = 0;
+for (ip = CONTAINER_FIRST(container); ip; ip = CONTAINER_NEXT(container, ip))
+    if (ip == &items[count])
+        ++count;
+OK(count == BTREE_ITEMS, "btree find_next walks the items in order");
+
+key.len = 1;
+va = CONTAINER_GET_SUBSET(container, &key);
+OK(va != NULL && va->size == 10 && va->array[0] == &items[50] &&
+   va->array[9] == &items[59], "btree get_subset returns a whole prefix");
+if (va) {
+    free(va->array);
+    free(va);
+}
+key.len = 2;
+
+it = CONTAINER_ITERATOR(container);
+count = 0;
+for (ip = ITERATOR_FIRST(it); ip; ip = ITERATOR_NEXT(it))
+    if (ip == &items[count])
+        ++count;
+OK(count == BTREE_ITEMS && ITERATOR_LAST(it) == &items[BTREE_ITEMS - 1],
+   "btree iterator walks the items in order");
+CONTAINER_INSERT(container, &items[0]);
+OK(ITERATOR_FIRST(it) == &items[0], "btree iterator unchanged by a failed insert");
+CONTAINER_REMOVE(container, &items[0]);
+OK(ITERATOR_FIRST(it) == NULL, "btree iterator stops when the container changes");
+ITERATOR_RELEASE(it);
+CONTAINER_INSERT(container, &items[0]);
+
+dup = CONTAINER_DUP(container, NULL, 0);
+OK(dup != NULL && CONTAINER_SIZE(dup) == BTREE_ITEMS &&
+   CONTAINER_FIND(dup, &items[1234]) == &items[1234],
+   "btree duplicate holds the same items");
+if (dup)
+    CONTAINER_FREE(dup);
+
+for (i = 0, rc = 0; i < BTREE_ITEMS; ++i) {
+    j = (i * 7919) % BTREE_ITEMS;
+    if (j % 2)
+        rc |= CONTAINER_REMOVE(container, &items[j]);
+}
+OK(rc == 0 && CONTAINER_SIZE(container) == BTREE_ITEMS / 2,
+   "btree removes half of the items");
+OK(CONTAINER_REMOVE(container, &items[1]) != 0,
+   "btree refuses to remove a missing item");
+count = 0;
+for (ip = CONTAINER_FIRST(container); ip; ip = CONTAINER_NEXT(container, ip))
+    if (ip == &items[count * 2])
+        ++count;
+OK(count == BTREE_ITEMS / 2, "btree keeps the remaining items in order");
+
+/*
+ * duplicates spread over several leaves
+ */
+CONTAINER_SET_OPTIONS(container, CONTAINER_KEY_ALLOW_DUPLICATES, rc);
+OK(rc != -1, "btree accepts duplicate keys");
+for (i = 0, rc = 0; i < BTREE_DUPS; ++i) {
+    dups[i].oids = dup_oids;
+    dups[i].len = 2;
+    rc |= CONTAINER_INSERT(container, &dups[i]);
+}
+OK(rc == 0 && CONTAINER_SIZE(container) == BTREE_ITEMS / 2 + BTREE_DUPS,
+   "btree holds the duplicates");
+OK(CONTAINER_NEXT(container, &dups[0]) == &items[74],
+   "btree find_next skips all the duplicates");
+OK(CONTAINER_REMOVE(container, &dups[BTREE_DUPS / 2]) == 0,
+   "btree removes a duplicate");
+key.len = 1;
+key_oids[0] = 7;
+va = CONTAINER_GET_SUBSET(container, &key);
+OK(va != NULL && va->size == 5 + BTREE_DUPS - 1,
+   "btree get_subset returns the duplicates");
+for (i = 0, count = 0; va && i < va->size; ++i)
+    if (va->array[i] == &dups[BTREE_DUPS / 2])
+        ++count;
+OK(count == 0, "btree removed the duplicate asked for");
+if (va) {
+    free(va->array);
+    free(va);
+}
+
+count = 0;
+ordered = 1;
+prev = NULL;
+while ((ip = CONTAINER_FIRST(container))) {
+    if (prev && netsnmp_compare_netsnmp_index(prev, ip) > 0)
+        ordered = 0;
+    prev = ip;
+    if (CONTAINER_REMOVE(container, ip) != 0)
+        break;
+    ++count;
+}
+OK(ordered && count == BTREE_ITEMS / 2 + BTREE_DUPS - 1 &&
+   CONTAINER_SIZE(container) == 0, "btree empties in order");
+
+dup = netsnmp_container_find("table_container:btree");
+OK(dup != NULL && dup->insert == container->insert,
+   "table_container:btree selects the btree");
+if (dup)
+    CONTAINER_FREE(dup);
+dup = netsnmp_container_find("table_container");
+OK(dup != NULL && dup->insert != container->insert,
+   "table_container is still a binary_array");
+if (dup)
+    CONTAINER_FREE(dup);
+CONTAINER_FREE(container);
+
 snmp_shutdown("container-test");
@@ -0,0 +1,91 @@
+/* HEADER Testing subtree lookups via the subtree index */
+
+/*
+ * Registers a large number of subtrees, drops some of them again and
+ * verifies that netsnmp_subtree_find_prev() agrees with a linear walk of
+ * the subtree list.  The time taken by the lookups is reported as a
+ * comment so that this test doubles as a micro-benchmark.
+ */
+
+#define NREG    100000
+#define NLOOKUP 200000
+
+static const oid base[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 22 };
+oid name[MAX_OID_LEN];
+size_t base_len = OID_LENGTH(base);
+netsnmp_handler_registration **reg;
+netsnmp_subtree *found, *walk, *expected;
+struct timeval start, end, diff;
+size_t len;
+int i, j, failures, registered;
+
+init_agent("snmpd");
+init_snmp("snmpd");
+
+reg = calloc(NREG, sizeof(*reg));
+memcpy(name, base, sizeof(base));
+
+netsnmp_get_monotonic_clock(&start);
+for (i = 0, failures = 0; i < NREG; i++) {
+    name[base_len] = i / 100;
+    name[base_len + 1] = i % 100;
+    reg[i] = netsnmp_create_handler_registration("T022", NULL, name,
+                                                 base_len + 2,
+                                                 HANDLER_CAN_RONLY);
+    if (!reg[i] || netsnmp_register_handler(reg[i]) != MIB_REGISTERED_OK)
+        failures++;
+}
+netsnmp_get_monotonic_clock(&end);
+NETSNMP_TIMERSUB(&end, &start, &diff);
+OKF(failures == 0, ("Registered %d subtrees", NREG));
+printf("# registration of %d subtrees took %ld.%06ld s\n", NREG,
+       (long)diff.tv_sec, (long)diff.tv_usec);
+
+for (i = 0, failures = 0; i < NREG; i += 7) {
+    if (netsnmp_unregister_handler(reg[i]) != SNMPERR_SUCCESS)
+        failures++;
+    reg[i] = NULL;
+}
+OK(failures == 0, "Unregistered every seventh subtree");
+
+for (i = 0, failures = 0; i < 200; i++) {
+    j = (i * 7919) % NREG;
+    name[base_len] = j / 100;
+    name[base_len + 1] = j % 100;
+    name[base_len + 2] = i & 3;
+    len = base_len + 1 + i % 3;
+    found = netsnmp_subtree_find_prev(name, len, NULL, "");
+    expected = NULL;
+    for (walk = netsnmp_subtree_find_first(""); walk; walk = walk->next) {
+        if (snmp_oid_compare(name, len, walk->start_a, walk->start_len) < 0)
+            break;
+        expected = walk;
+    }
+    if (found != expected)
+        failures++;
+}
+OKF(failures == 0, ("Index agrees with a linear walk (%d mismatches)",
+                    failures));
+
+registered = 0;
+netsnmp_get_monotonic_clock(&start);
+for (i = 0; i < NLOOKUP; i++) {
+    j = (i * 7919) % NREG;
+    name[base_len] = j / 100;
+    name[base_len + 1] = j % 100;
+    if (netsnmp_subtree_find(name, base_len + 2, NULL, ""))
+        registered++;
+}
+netsnmp_get_monotonic_clock(&end);
+NETSNMP_TIMERSUB(&end, &start, &diff);
+/* Unregistered OIDs remain covered by the null registration of iso(1) */
+OKF(registered == NLOOKUP, ("Looked up %d OIDs", NLOOKUP));
+printf("# %d lookups took %ld.%06ld s\n", NLOOKUP,
+       (long)diff.tv_sec, (long)diff.tv_usec);
+
+for (i = 0; i < NREG; i++)
+    if (reg[i])
+        netsnmp_unregister_handler(reg[i]);
+free(reg);
+
+snmp_shutdown("snmpd");
@@ -0,0 +1,257 @@
+/*
+ * HEADER Reading sessions with select() and with epoll
+ *
+ * Opens NIDLE idle TCP sessions next to a UDP session that receives
+ * NPKT notifications, one at a time, and reads them once through
+ * select() and snmp_read2() and once through the epoll backend of the fd
+ * event manager.  The time taken is reported as a comment so that this
+ * test doubles as a benchmark.  Also checks that the epoll loop still
+ * times out requests and drops sessions whose peer disconnected.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/fd_event_manager.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#define NIDLE 5000
+#define NPKT  2000
+
+static int      received, timed_out;
+
+static int
+count_input(int op, netsnmp_session *session, int reqid,
+            netsnmp_pdu *pdu, void *magic)
+{
+    if (op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE)
+        received++;
+    return 1;
+}
+
+static int
+count_timeout(int op, netsnmp_session *session, int reqid,
+              netsnmp_pdu *pdu, void *magic)
+{
+    if (op == NETSNMP_CALLBACK_OP_TIMED_OUT)
+        timed_out++;
+    return 1;
+}
+
+static netsnmp_session *
+open_session(netsnmp_session *sess, const char *peer)
+{
+    snmp_sess_init(sess);
+    sess->peername = NETSNMP_REMOVE_CONST(char *, peer);
+    sess->version = SNMP_VERSION_2c;
+    sess->community = NETSNMP_REMOVE_CONST(u_char *, "public");
+    sess->community_len = strlen("public");
+    return snmp_open(sess);
+}
+
+/* one round trip of the event loop, the way snmpd runs it */
+static int
+read_once(int use_poll, netsnmp_large_fd_set *fds)
+{
+    struct timeval  tv = { 1, 0 };
+    int             numfds = 0, block = 1;
+
+    if (use_poll) {
+        snmp_select_info2(&numfds, NULL, &tv, &block);
+        if (netsnmp_fd_poll_wait(&tv) <= 0)
+            return 0;
+        netsnmp_fd_poll_dispatch();
+    } else {
+        NETSNMP_LARGE_FD_ZERO(fds);
+        snmp_select_info2(&numfds, fds, &tv, &block);
+        if (netsnmp_large_fd_set_select(numfds, fds, NULL, NULL, &tv) <= 0)
+            return 0;
+        snmp_read2(fds);
+    }
+    return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session sess, *udp = NULL, *client = NULL, **idle;
+    netsnmp_transport *transport;
+    netsnmp_large_fd_set fds;
+    netsnmp_pdu    *pdu;
+    struct sockaddr_in addr;
+    socklen_t       addr_len;
+    struct timeval  start, end, diff;
+    char            peer[64];
+    int             listener, *peers, nidle, use_poll, i, numfds, block;
+    int             before, after;
+    struct timeval  tv = { 0, 0 };
+
+    SOCK_STARTUP;
+    init_snmp("testing");
+    netsnmp_large_fd_set_init(&fds, FD_SETSIZE);
+
+    /*
+     * a plain TCP listener accepts the idle sessions 
+     */
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr_len = sizeof(addr);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener >= 0 &&
+        (bind(listener, (struct sockaddr *) &addr, addr_len) < 0 ||
+         listen(listener, 128) < 0 ||
+         getsockname(listener, (struct sockaddr *) &addr, &addr_len) < 0)) {
+        close(listener);
+        listener = -1;
+    }
+    OK(listener >= 0, "TCP listener");
+
+    idle = (netsnmp_session **) calloc(NIDLE, sizeof(*idle));
+    peers = (int *) calloc(NIDLE, sizeof(*peers));
+    snprintf(peer, sizeof(peer), "tcp:127.0.0.1:%d", ntohs(addr.sin_port));
+    for (nidle = 0; listener >= 0 && nidle < NIDLE; nidle++) {
+        idle[nidle] = open_session(&sess, peer);
+        if (!idle[nidle])
+            break;
+        peers[nidle] = accept(listener, NULL, NULL);
+        if (peers[nidle] < 0) {
+            snmp_close(idle[nidle]);
+            break;
+        }
+    }
+    /*
+     * the descriptor limit may not allow for all of them 
+     */
+    OKF(nidle > 0, ("Opened %d idle TCP sessions", nidle));
+
+    transport = netsnmp_transport_open_server("testing", "udp:127.0.0.1:0");
+    if (transport) {
+        snmp_sess_init(&sess);
+        sess.isAuthoritative = SNMP_SESS_UNKNOWNAUTH;
+        sess.callback = count_input;
+        udp = snmp_add(&sess, transport, NULL, NULL);
+    }
+    addr_len = sizeof(addr);
+    if (udp && getsockname(transport->sock, (struct sockaddr *) &addr,
+                           &addr_len) == 0) {
+        snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d",
+                 ntohs(addr.sin_port));
+        client = open_session(&sess, peer);
+    }
+    OK(udp && client, "UDP session and client");
+
+    for (use_poll = 0; client && use_poll < 2; use_poll++) {
+        if (use_poll && !netsnmp_fd_poll_enabled()) {
+            printf("# epoll is not available\n");
+            break;
+        }
+        received = 0;
+        netsnmp_get_monotonic_clock(&start);
+        for (i = 0; i < NPKT; i++) {
+            pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+            if (!snmp_send(client, pdu))
+                snmp_free_pdu(pdu);
+            read_once(use_poll, &fds);
+        }
+        netsnmp_get_monotonic_clock(&end);
+        NETSNMP_TIMERSUB(&end, &start, &diff);
+        OKF(received == NPKT, ("%s read %d of %d notifications",
+                               use_poll ? "epoll" : "select()", received,
+                               NPKT));
+        printf("# %s: %d notifications next to %d idle TCP sessions "
+               "took %ld.%06ld s\n", use_poll ? "epoll" : "select()", NPKT,
+               nidle, (long) diff.tv_sec, (long) diff.tv_usec);
+    }
+
+    if (client && netsnmp_fd_poll_enabled()) {
+        /*
+         * without an fdset only the session with a request outstanding
+         * is looked at, and its request still times out 
+         */
+        static const oid sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+
+        client->timeout = 100000;
+        client->retries = 0;
+        pdu = snmp_pdu_create(SNMP_MSG_GET);
+        snmp_add_null_var(pdu, sysUpTime, OID_LENGTH(sysUpTime));
+        if (!snmp_async_send(client, pdu, count_timeout, NULL))
+            snmp_free_pdu(pdu);
+        numfds = 0;
+        block = 1;
+        tv.tv_sec = 10;
+        before = snmp_select_info2(&numfds, NULL, &tv, &block);
+        OKF(before == 1 && !block && tv.tv_sec == 0,
+            ("%d session with a request, timeout %ld.%06ld s", before,
+             (long) tv.tv_sec, (long) tv.tv_usec));
+        for (i = 0; i < 50 && !timed_out; i++)
+            if (!read_once(1, &fds))
+                snmp_timeout();
+        numfds = 0;
+        block = 1;
+        after = snmp_select_info2(&numfds, NULL, &tv, &block);
+        OKF(timed_out == 1 && after == 0,
+            ("Request timed out (%d sessions with requests left)", after));
+    }
+
+    if (client && nidle > 0 && netsnmp_fd_poll_enabled()) {
+        /*
+         * a session whose peer went away is read once more and then
+         * dropped from the session list, and from the epoll set 
+         */
+        numfds = 0;
+        block = 1;
+        NETSNMP_LARGE_FD_ZERO(&fds);
+        before = snmp_select_info2(&numfds, &fds, &tv, &block);
+        close(peers[0]);
+        read_once(1, &fds);
+        snmp_select_info2(&numfds, NULL, &tv, &block);
+        NETSNMP_LARGE_FD_ZERO(&fds);
+        after = snmp_select_info2(&numfds, &fds, &tv, &block);
+        OKF(after == before - 1,
+            ("Closed session dropped (%d -> %d sessions)", before, after));
+        idle[0] = NULL;
+        peers[0] = -1;
+    }
+
+    for (i = 0; i < nidle; i++) {
+        if (idle[i])
+            snmp_close(idle[i]);
+        if (peers[i] >= 0)
+            close(peers[i]);
+    }
+    free(idle);
+    free(peers);
+    if (client)
+        snmp_close(client);
+    if (udp)
+        snmp_close(udp);
+    if (listener >= 0)
+        close(listener);
+    netsnmp_large_fd_set_cleanup(&fds);
+
+    snmp_shutdown("testing");
+    SOCK_CLEANUP;
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}
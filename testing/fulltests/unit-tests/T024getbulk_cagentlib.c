@@ -0,0 +1,131 @@
+/* HEADER Walking a large table with GETBULK */
+
+/*
+ * Registers a table of NROW rows by NCOL integer columns, shaped like
+ * ifXTable, and walks it with GETBULK requests sent to the agent over a
+ * loopback UDP session.  Checks that every repetition comes back in row
+ * order and that the walk ends in endOfMibView.  The
+ * time taken by the walk is reported as a comment so that this test
+ * doubles as a benchmark.
+ */
+
+#define NROW    5000
+#define NCOL    20
+#define NREP    50
+
+static const oid base[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 24 };
+size_t base_len = OID_LENGTH(base);
+oid name[MAX_OID_LEN];
+int *values;
+netsnmp_transport *transport;
+netsnmp_session sess, *ss;
+netsnmp_pdu *pdu, *response;
+netsnmp_variable_list *vb;
+netsnmp_sockaddr_storage addr;
+socklen_t addr_len = sizeof(addr);
+struct timeval start, end, diff;
+char peer[64];
+long row, next_row;
+int i, col, failures, requests, received, eom, status;
+
+init_agent("snmpd");
+netsnmp_config_remember((char *) "rocommunity public 127.0.0.1");
+init_snmp("snmpd");
+netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
+                   NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES, NCOL * NREP);
+
+values = calloc(NROW * NCOL, sizeof(int));
+memcpy(name, base, sizeof(base));
+for (i = 0, failures = 0; i < NROW * NCOL; i++) {
+    values[i] = i;
+    name[base_len] = 1 + i % NCOL;
+    name[base_len + 1] = 1 + i / NCOL;
+    if (netsnmp_register_int_instance("T024", name, base_len + 2,
+                                      &values[i], NULL) != MIB_REGISTERED_OK)
+        failures++;
+}
+OKF(failures == 0, ("Registered %d columns of %d rows", NCOL, NROW));
+
+transport = netsnmp_transport_open_server("snmp", "udp:127.0.0.1:0");
+OK(transport != NULL, "Opened the agent endpoint");
+OK(transport && netsnmp_register_agent_nsap(transport) > 0,
+   "Registered the agent endpoint");
+getsockname(transport->sock, &addr.sa, &addr_len);
+snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", ntohs(addr.sin.sin_port));
+
+snmp_sess_init(&sess);
+sess.peername = peer;
+sess.version = SNMP_VERSION_2c;
+sess.community = (u_char *) "public";
+sess.community_len = strlen("public");
+sess.timeout = 5000000;
+ss = snmp_open(&sess);
+OK(ss != NULL, "Opened the manager session");
+
+netsnmp_get_monotonic_clock(&start);
+row = 0;
+requests = received = eom = failures = 0;
+while (ss && !eom && !failures) {
+    pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    pdu->non_repeaters = 0;
+    pdu->max_repetitions = NREP;
+    for (col = 1; col <= NCOL; col++) {
+        name[base_len] = col;
+        name[base_len + 1] = row;
+        snmp_add_null_var(pdu, name, row ? base_len + 2 : base_len + 1);
+    }
+    status = snmp_synch_response(ss, pdu, &response);
+    requests++;
+    if (status != STAT_SUCCESS || response->errstat != SNMP_ERR_NOERROR) {
+        failures++;
+        break;
+    }
+
+    next_row = row;
+    for (vb = response->variables, i = 0; vb; vb = vb->next_variable, i++) {
+        col = 1 + i % NCOL;
+        if (vb->type == SNMP_ENDOFMIBVIEW) {
+            eom++;
+            continue;
+        }
+        if (vb->name_length != base_len + 2 ||
+            netsnmp_oid_equals(vb->name, base_len, base, base_len) != 0) {
+            /* the last column runs into the first one of the next row */
+            if (col == NCOL && vb->name_length == base_len + 2 &&
+                vb->name[base_len] != NCOL)
+                continue;
+            failures++;
+            break;
+        }
+        if (vb->name[base_len] != col && col != NCOL)
+            continue;   /* walked past the end of a column */
+        if (vb->type != ASN_INTEGER || vb->name[base_len] != col ||
+            *vb->val.integer !=
+            (long)((vb->name[base_len + 1] - 1) * NCOL + col - 1)) {
+            failures++;
+            break;
+        }
+        if (col == 1) {
+            next_row = vb->name[base_len + 1];
+            received++;
+        }
+    }
+    snmp_free_pdu(response);
+    if (next_row == row)
+        break;
+    row = next_row;
+}
+netsnmp_get_monotonic_clock(&end);
+NETSNMP_TIMERSUB(&end, &start, &diff);
+
+OKF(failures == 0, ("Every repetition came back in row order"));
+OKF(received == NROW, ("Walked %d rows (expected %d)", received, NROW));
+OKF(eom > 0, ("The walk ended in endOfMibView"));
+printf("# %d GETBULK requests of %d x %d took %ld.%06ld s\n", requests,
+       NCOL, NREP, (long)diff.tv_sec, (long)diff.tv_usec);
+
+if (ss)
+    snmp_close(ss);
+free(values);
+
+snmp_shutdown("snmpd");
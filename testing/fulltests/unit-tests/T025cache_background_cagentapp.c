@@ -0,0 +1,157 @@
+/*
+ * HEADER Cache reloads in the background
+ *
+ * Loads a cache whose load routine takes LOAD_MS, and checks that once
+ * it has expired requests are answered from the previous data while a
+ * background thread reloads it, that the new data is swapped in by the
+ * main loop, that the staleness bound makes requests wait for the
+ * reload and that a failed reload keeps the previous data.  The time
+ * requests took while the cache was reloaded is reported as a comment.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define LOAD_MS 200
+
+static int      generation;
+static int      fail_load;
+
+static int
+slow_load(netsnmp_cache *cache, void *magic)
+{
+    if (generation > 0)
+        usleep(LOAD_MS * 1000);
+    if (fail_load)
+        return -1;
+    *(int *) magic = ++generation;
+    return 0;
+}
+
+static void
+slow_free(netsnmp_cache *cache, void *magic)
+{
+    *(int *) magic = 0;
+}
+
+#ifdef NETSNMP_REENTRANT
+static u_long
+elapsed_ms(const struct timeval *start)
+{
+    struct timeval  now, diff;
+
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, start, &diff);
+    return diff.tv_sec * 1000 + diff.tv_usec / 1000;
+}
+
+/*
+ * runs the main loop until the cache has been loaded count times
+ */
+static void
+wait_for_loads(netsnmp_cache *cache, u_long count)
+{
+    int             i;
+
+    for (i = 0; i < 500 && cache->load_count < count; i++) {
+        agent_check_and_process(0);
+        usleep(10000);
+    }
+}
+#endif
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_cache  *cache;
+    int             data[2] = { 0, 0 };
+#ifdef NETSNMP_REENTRANT
+    struct timeval  start;
+    u_long          ms;
+#endif
+
+    init_snmp("testing");
+
+    cache = netsnmp_cache_create(-1, slow_load, slow_free, NULL, 0);
+    cache->flags = NETSNMP_CACHE_BACKGROUND_RELOAD |
+        NETSNMP_CACHE_DONT_FREE_EXPIRED;
+    cache->magic = &data[0];
+    cache->spare_magic = &data[1];
+
+    netsnmp_cache_check_and_reload(cache);
+    OKF(cache->valid && *(int *) cache->magic == 1,
+        ("The first load happens inline"));
+
+#ifdef NETSNMP_REENTRANT
+    netsnmp_get_monotonic_clock(&start);
+    netsnmp_cache_check_and_reload(cache);
+    ms = elapsed_ms(&start);
+    OKF(*(int *) cache->magic == 1 && cache->reloading,
+        ("Expired data is served while it is reloaded"));
+    OKF(ms < LOAD_MS, ("Request took %lu ms (a load takes %d ms)", ms,
+                       LOAD_MS));
+    netsnmp_cache_check_and_reload(cache);
+    wait_for_loads(cache, 2);
+    OKF(*(int *) cache->magic == 2 && cache->magic == &data[1] &&
+        !cache->reloading, ("The reloaded data is swapped in"));
+    OKF(cache->load_count == 2 && cache->load_time_max >= LOAD_MS * 1000,
+        ("%lu loads, the longest took %lu us", cache->load_count,
+         cache->load_time_max));
+
+    /*
+     * data older than the bound is not served
+     */
+    cache->stale_limit = 1;
+    netsnmp_cache_check_and_reload(cache);
+    OK(cache->reloading, "Reloading data within the staleness bound");
+    sleep(1);
+    netsnmp_cache_check_and_reload(cache);
+    OKF(*(int *) cache->magic == 3 && !cache->reloading,
+        ("Stale data waits for the reload under way"));
+    sleep(1);
+    netsnmp_get_monotonic_clock(&start);
+    netsnmp_cache_check_and_reload(cache);
+    ms = elapsed_ms(&start);
+    OKF(*(int *) cache->magic == 4 && ms >= LOAD_MS,
+        ("Stale data is reloaded inline (%lu ms)", ms));
+
+    /*
+     * a failed reload leaves the previous data in place
+     */
+    cache->stale_limit = 0;
+    fail_load = 1;
+    netsnmp_cache_check_and_reload(cache);
+    wait_for_loads(cache, 5);
+    OKF(cache->valid && *(int *) cache->magic == 4 &&
+        cache->load_failures == 1, ("A failed reload keeps the old data"));
+    fail_load = 0;
+
+    /*
+     * freeing the cache waits for its reload
+     */
+    netsnmp_cache_check_and_reload(cache);
+    OK(cache->reloading, "Reloading before the cache is freed");
+    netsnmp_cache_free(cache);
+    OKF(data[0] == 0 && data[1] == 0, ("Both data sets were freed"));
+#else
+    OKF(1, ("Skipped: background reloads need --enable-reentrant"));
+    netsnmp_cache_free(cache);
+#endif
+
+    snmp_shutdown("testing");
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}
@@ -0,0 +1,335 @@
+/*
+ * HEADER Iterator tables answered from a sorted snapshot
+ *
+ * Registers two cached iterator tables of NROW rows, returned by their
+ * hooks in no particular order, one of them with
+ * NETSNMP_ITERATOR_FLAG_SNAPSHOT set.  Walks the snapshot table with
+ * GETBULK requests sent to the agent over a loopback UDP session and
+ * checks that the rows come back in index order, that GET and GETNEXT
+ * requests at the edges of the table are answered as before and that
+ * the snapshot follows the cache when it is loaded again.  The time
+ * taken by the walk, and by a walk of the first LOOP_ROWS rows of the
+ * other table, is reported as a comment so that this test doubles as a
+ * benchmark.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#define NROW      50000
+#define LOOP_ROWS 500
+#define NREP      50
+#define PRIME     7919      /* steps through the rows in a scrambled order */
+
+typedef struct row_s {
+    long            index;
+    long            value;
+} row_t;
+
+static row_t    rows[NROW];
+static long     removed;        /* index of a row left out, or 0 */
+
+static const oid snap_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 26, 1 };
+static const oid loop_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 26, 2 };
+#define TABLE_LEN OID_LENGTH(snap_oid)
+
+static netsnmp_session *ss;
+
+static netsnmp_variable_list *
+row_next(void **loop_context, void **data_context,
+         netsnmp_variable_list *put_index_data, netsnmp_iterator_info *iinfo)
+{
+    intptr_t        pos = (intptr_t) *loop_context;
+
+    if (pos < NROW && rows[pos].index == removed)
+        pos++;
+    if (pos >= NROW)
+        return NULL;
+    snmp_set_var_value(put_index_data, &rows[pos].index, sizeof(long));
+    *data_context = &rows[pos];
+    *loop_context = (void *) (pos + 1);
+    return put_index_data;
+}
+
+static netsnmp_variable_list *
+row_first(void **loop_context, void **data_context,
+          netsnmp_variable_list *put_index_data, netsnmp_iterator_info *iinfo)
+{
+    *loop_context = NULL;
+    return row_next(loop_context, data_context, put_index_data, iinfo);
+}
+
+static int
+row_load(netsnmp_cache *cache, void *magic)
+{
+    return 0;
+}
+
+static int
+row_handler(netsnmp_mib_handler *handler,
+            netsnmp_handler_registration *reginfo,
+            netsnmp_agent_request_info *reqinfo,
+            netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request;
+    netsnmp_table_request_info *table_info;
+    row_t          *row;
+
+    if (reqinfo->mode != MODE_GET)
+        return SNMP_ERR_NOERROR;
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        row = (row_t *) netsnmp_extract_iterator_context(request);
+        table_info = netsnmp_extract_table_info(request);
+        if (!row || !table_info) {
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHINSTANCE);
+            continue;
+        }
+        snmp_set_var_typed_integer(request->requestvb, ASN_INTEGER,
+                                   table_info->colnum == 1 ?
+                                   row->value : row->index);
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static netsnmp_cache *
+register_table(const char *name, const oid *table, int flags)
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_table_registration_info *table_info;
+    netsnmp_iterator_info *iinfo;
+    netsnmp_mib_handler *handler;
+
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    netsnmp_table_helper_add_indexes(table_info, ASN_INTEGER, 0);
+    table_info->min_column = 1;
+    table_info->max_column = 2;
+
+    iinfo = SNMP_MALLOC_TYPEDEF(netsnmp_iterator_info);
+    iinfo->get_first_data_point = row_first;
+    iinfo->get_next_data_point = row_next;
+    iinfo->table_reginfo = table_info;
+    iinfo->flags |= flags;
+
+    reginfo = netsnmp_create_handler_registration(name, row_handler, table,
+                                                  TABLE_LEN,
+                                                  HANDLER_CAN_RONLY);
+    if (netsnmp_register_table_iterator2(reginfo, iinfo) != MIB_REGISTERED_OK)
+        return NULL;
+    handler = netsnmp_get_cache_handler(300, row_load, NULL, table,
+                                        TABLE_LEN);
+    netsnmp_inject_handler(reginfo, handler);
+    return (netsnmp_cache *) handler->myvoid;
+}
+
+/*
+ * sends a request for one variable, returning the response
+ */
+static netsnmp_pdu *
+request(int command, const oid *name, size_t name_len)
+{
+    netsnmp_pdu    *pdu, *response = NULL;
+
+    pdu = snmp_pdu_create(command);
+    if (command == SNMP_MSG_GETBULK) {
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = NREP;
+    }
+    snmp_add_null_var(pdu, name, name_len);
+    if (snmp_synch_response(ss, pdu, &response) != STAT_SUCCESS ||
+        response->errstat != SNMP_ERR_NOERROR) {
+        if (response)
+            snmp_free_pdu(response);
+        return NULL;
+    }
+    return response;
+}
+
+/*
+ * walks the first column of a table with GETBULK requests, up to
+ * max_rows rows, and counts the rows that were not in order
+ */
+static long
+walk(const oid *table, long max_rows, int *bad, struct timeval *took)
+{
+    oid             name[MAX_OID_LEN];
+    size_t          name_len = TABLE_LEN + 2;
+    struct timeval  start, end;
+    netsnmp_pdu    *response;
+    netsnmp_variable_list *vb;
+    long            count = 0;
+    int             done = 0;
+
+    memcpy(name, table, TABLE_LEN * sizeof(oid));
+    name[TABLE_LEN] = 1;
+    name[TABLE_LEN + 1] = 1;
+    *bad = 0;
+
+    netsnmp_get_monotonic_clock(&start);
+    while (!done && count < max_rows) {
+        response = request(SNMP_MSG_GETBULK, name, name_len);
+        if (!response) {
+            (*bad)++;
+            break;
+        }
+        for (vb = response->variables; vb && count < max_rows;
+             vb = vb->next_variable) {
+            if (vb->name_length != TABLE_LEN + 3 ||
+                snmp_oid_compare(vb->name, TABLE_LEN + 2,
+                                 name, TABLE_LEN + 2) != 0) {
+                done = 1;
+                break;
+            }
+            if (vb->type != ASN_INTEGER ||
+                vb->name[TABLE_LEN + 2] != (oid) count + 1 ||
+                *vb->val.integer != (long) vb->name[TABLE_LEN + 2] * 3)
+                (*bad)++;
+            count++;
+            memcpy(name, vb->name, vb->name_length * sizeof(oid));
+            name_len = vb->name_length;
+        }
+        snmp_free_pdu(response);
+    }
+    netsnmp_get_monotonic_clock(&end);
+    NETSNMP_TIMERSUB(&end, &start, took);
+    return count;
+}
+
+/*
+ * sends a GET or GETNEXT for table.1.column.index, and returns the
+ * response's first variable as "<column>.<index>=<value>"
+ */
+static const char *
+ask(int command, long column, long index)
+{
+    static char     buf[64];
+    oid             name[MAX_OID_LEN];
+    netsnmp_pdu    *response;
+    netsnmp_variable_list *vb;
+
+    memcpy(name, snap_oid, sizeof(snap_oid));
+    name[TABLE_LEN] = 1;
+    name[TABLE_LEN + 1] = column;
+    name[TABLE_LEN + 2] = index;
+    response = request(command, name, TABLE_LEN + 3);
+    if (!response)
+        return "error";
+    vb = response->variables;
+    if (vb->type == SNMP_NOSUCHINSTANCE)
+        snprintf(buf, sizeof(buf), "noSuchInstance");
+    else if (vb->name_length != TABLE_LEN + 3 ||
+             snmp_oid_compare(vb->name, TABLE_LEN + 1,
+                              name, TABLE_LEN + 1) != 0)
+        snprintf(buf, sizeof(buf), "outside");
+    else if (vb->type != ASN_INTEGER)
+        snprintf(buf, sizeof(buf), "type %d", vb->type);
+    else
+        snprintf(buf, sizeof(buf), "%lu.%lu=%ld",
+                 (unsigned long) vb->name[TABLE_LEN + 1],
+                 (unsigned long) vb->name[TABLE_LEN + 2], *vb->val.integer);
+    snmp_free_pdu(response);
+    return buf;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_cache  *snap_cache, *loop_cache;
+    netsnmp_transport *transport;
+    netsnmp_session sess;
+    netsnmp_sockaddr_storage addr;
+    socklen_t       addr_len = sizeof(addr);
+    struct timeval  took;
+    char            peer[64];
+    long            i, count;
+    int             bad;
+    u_long          loads;
+
+    for (i = 0; i < NROW; i++) {
+        rows[i].index = 1 + (i * PRIME) % NROW;
+        rows[i].value = rows[i].index * 3;
+    }
+
+    init_agent("snmpd");
+    netsnmp_config_remember((char *) "rocommunity public 127.0.0.1");
+    init_snmp("snmpd");
+
+    snap_cache = register_table("T026snapshot", snap_oid,
+                                NETSNMP_ITERATOR_FLAG_SNAPSHOT);
+    loop_cache = register_table("T026loop", loop_oid, 0);
+    OK(snap_cache && loop_cache, "Registered both tables");
+
+    transport = netsnmp_transport_open_server("snmp", "udp:127.0.0.1:0");
+    OK(transport && netsnmp_register_agent_nsap(transport) > 0,
+       "Opened the agent endpoint");
+    getsockname(transport->sock, &addr.sa, &addr_len);
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d",
+             ntohs(addr.sin.sin_port));
+
+    snmp_sess_init(&sess);
+    sess.peername = peer;
+    sess.version = SNMP_VERSION_2c;
+    sess.community = (u_char *) "public";
+    sess.community_len = strlen("public");
+    sess.timeout = 30000000;
+    ss = snmp_open(&sess);
+    OK(ss != NULL, "Opened the manager session");
+    if (!ss || !snap_cache || !loop_cache)
+        return 1;
+
+    count = walk(snap_oid, NROW + 1, &bad, &took);
+    OKF(count == NROW && bad == 0,
+        ("Walked %ld rows in index order (%d out of order)", count, bad));
+    printf("# walking %d rows from the snapshot took %ld.%06ld s\n", NROW,
+           (long) took.tv_sec, (long) took.tv_usec);
+    OKF(snap_cache->load_count == 1, ("The cache was loaded %lu times",
+                                      snap_cache->load_count));
+
+    count = walk(loop_oid, LOOP_ROWS, &bad, &took);
+    OKF(count == LOOP_ROWS && bad == 0,
+        ("Walked the first %ld rows without a snapshot", count));
+    printf("# walking %d rows by looping over the table took %ld.%06ld s\n",
+           LOOP_ROWS, (long) took.tv_sec, (long) took.tv_usec);
+
+    OKF(strcmp(ask(SNMP_MSG_GET, 2, 777), "2.777=777") == 0,
+        ("GET of an existing row"));
+    OKF(strcmp(ask(SNMP_MSG_GET, 1, NROW + 1), "noSuchInstance") == 0,
+        ("GET of a missing row"));
+    OKF(strcmp(ask(SNMP_MSG_GETNEXT, 1, NROW), "2.1=1") == 0,
+        ("GETNEXT from the last row goes on to the next column"));
+    OKF(strcmp(ask(SNMP_MSG_GETNEXT, 2, NROW), "outside") == 0,
+        ("GETNEXT from the last cell leaves the table"));
+
+    /*
+     * the snapshot is only rebuilt when the cache is loaded again
+     */
+    removed = 5;
+    OKF(strcmp(ask(SNMP_MSG_GET, 1, 5), "1.5=15") == 0,
+        ("The snapshot is kept while the cache is valid"));
+    loads = snap_cache->load_count;
+    snap_cache->expired = 1;
+    OKF(strcmp(ask(SNMP_MSG_GET, 1, 5), "noSuchInstance") == 0 &&
+        snap_cache->load_count == loads + 1,
+        ("The snapshot is rebuilt after the cache is loaded"));
+    OKF(strcmp(ask(SNMP_MSG_GETNEXT, 1, 4), "1.6=18") == 0,
+        ("GETNEXT skips the row left out"));
+
+    snmp_close(ss);
+    snmp_shutdown("snmpd");
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}
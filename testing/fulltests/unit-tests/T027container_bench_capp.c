@@ -0,0 +1,117 @@
+/*
+ * HEADER Container insert, find and next timings
+ *
+ * Fills btree, binary_array and sorted_singly_linked_list containers
+ * with NITEMS two-subidentifier indexes in scrambled order, looks each
+ * of them up, walks them with find_next and then removes and reinserts
+ * NCHURN of them, as a table reloaded row by row would.  The items are
+ * checked to come back in order and the time each step took is
+ * reported as a comment, so that this test doubles as a benchmark of
+ * the containers.  The linked list gets NITEMS / 20 items, as each of
+ * its operations walks the list.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#define NITEMS 100000
+#define NCHURN 20000
+#define PRIME  7919
+
+static u_long
+elapsed_us(const struct timeval *start)
+{
+    struct timeval  now, diff;
+
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, start, &diff);
+    return diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+static void
+bench(const char *type, netsnmp_index *items, int count)
+{
+    netsnmp_container *c;
+    netsnmp_index  *ip;
+    struct timeval  start;
+    u_long          insert_us, find_us, next_us, churn_us;
+    int             i, j, rc = 0, found = 0, ordered = 0;
+
+    c = netsnmp_container_find(type);
+    if (NULL == c) {
+        OKF(0, ("%s container found", type));
+        return;
+    }
+    c->compare = netsnmp_compare_netsnmp_index;
+
+    netsnmp_get_monotonic_clock(&start);
+    for (i = 0; i < count; ++i)
+        rc |= CONTAINER_INSERT(c, &items[(i * PRIME) % count]);
+    insert_us = elapsed_us(&start);
+
+    netsnmp_get_monotonic_clock(&start);
+    for (i = 0; i < count; ++i)
+        if (CONTAINER_FIND(c, &items[(i * PRIME) % count]) ==
+            &items[(i * PRIME) % count])
+            ++found;
+    find_us = elapsed_us(&start);
+
+    netsnmp_get_monotonic_clock(&start);
+    for (ip = CONTAINER_FIRST(c); ip; ip = CONTAINER_NEXT(c, ip))
+        if (ip == &items[ordered])
+            ++ordered;
+    next_us = elapsed_us(&start);
+
+    netsnmp_get_monotonic_clock(&start);
+    for (i = 0; i < NCHURN; ++i) {
+        j = (i * PRIME * 3) % count;
+        rc |= CONTAINER_REMOVE(c, &items[j]);
+        rc |= CONTAINER_INSERT(c, &items[j]);
+    }
+    churn_us = elapsed_us(&start);
+
+    OKF(rc == 0 && found == count && ordered == count &&
+        CONTAINER_SIZE(c) == count,
+        ("%s: %d items inserted, found and walked in order", type, count));
+    printf("# %-26s insert %8lu us, find %8lu us, next %8lu us,"
+           " %d remove+insert %8lu us\n", type, insert_us, find_us,
+           next_us, NCHURN, churn_us);
+
+    CONTAINER_CLEAR(c, NULL, NULL);
+    CONTAINER_FREE(c);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static oid      oids[NITEMS][2];
+    static netsnmp_index items[NITEMS];
+    int             i;
+
+    init_snmp("container-bench");
+
+    for (i = 0; i < NITEMS; ++i) {
+        oids[i][0] = i / 256;
+        oids[i][1] = i % 256;
+        items[i].oids = oids[i];
+        items[i].len = 2;
+    }
+
+    bench("btree", items, NITEMS);
+    bench("binary_array", items, NITEMS);
+    bench("sorted_singly_linked_list", items, NITEMS / 20);
+    bench("btree", items, NITEMS / 20);
+
+    snmp_shutdown("container-bench");
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * HEADER Merging reloaded rows into a table container
+ *
+ * Loads NROWS rows into a table container, then merges fresh sets of
+ * rows into it in which some rows were added, removed or changed, and
+ * checks that the container ends up holding the fresh data, that rows
+ * which were kept are the original rows and that the counts reported
+ * by netsnmp_container_table_merge() match.  Rows whose update fails
+ * must be replaced by the fresh row.  Finally NBIG rows are merged into
+ * a table holding every other one of them, and the time that took is
+ * reported as a comment.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#define NROWS 100
+#define NBIG  100000
+
+typedef struct test_row_s {
+    netsnmp_index   index;
+    oid             oid_idx[1];
+    int             value;
+} test_row;
+
+static int      released;
+
+static test_row *
+row_create(int idx, int value)
+{
+    test_row       *row = calloc(1, sizeof(*row));
+
+    row->oid_idx[0] = idx;
+    row->index.oids = row->oid_idx;
+    row->index.len = 1;
+    row->value = value;
+    return row;
+}
+
+static void
+row_release(void *row, void *context)
+{
+    ++released;
+    free(row);
+}
+
+/*
+ * copies the value of a fresh row; odd values cannot be copied, so that
+ * the row is replaced
+ */
+static int
+row_update(void *row, void *fresh, void *context)
+{
+    test_row       *old = (test_row *) row, *new_row = (test_row *) fresh;
+
+    if (old->value == new_row->value)
+        return 0;
+    if (new_row->value & 1)
+        return -1;
+    old->value = new_row->value;
+    return 1;
+}
+
+static netsnmp_container *
+container_create(const char *name)
+{
+    netsnmp_container *c = netsnmp_container_find(name);
+
+    if (c)
+        c->compare = netsnmp_compare_netsnmp_index;
+    return c;
+}
+
+/*
+ * checks that the table holds rows 0 .. NROWS - 1 with their value
+ * given by value(), skipping those for which value() returns -1
+ */
+static int
+check_table(netsnmp_container *table, int (*value)(int))
+{
+    test_row       *row;
+    int             i = 0;
+
+    for (row = CONTAINER_FIRST(table); row;
+         row = CONTAINER_NEXT(table, row), ++i) {
+        while (i < NROWS && value(i) < 0)
+            ++i;
+        if (i >= NROWS || row->oid_idx[0] != i || row->value != value(i))
+            return 0;
+    }
+    while (i < NROWS && value(i) < 0)
+        ++i;
+    return i == NROWS;
+}
+
+static int
+value_initial(int i)
+{
+    return (i % 2) ? -1 : 2 * i;
+}
+
+/*
+ * rows divisible by 3 went away, odd rows appeared, every fifth row
+ * changed (to an odd value for every tenth, which cannot be copied)
+ */
+static int
+value_reloaded(int i)
+{
+    if (i % 3 == 0)
+        return -1;
+    if (i % 2)
+        return i;
+    if (i % 10 == 0)
+        return 2 * i + 1;
+    if (i % 5 == 0)
+        return 2 * i + 2;
+    return 2 * i;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_container *table, *fresh;
+    netsnmp_container_table_merge_stats stats;
+    test_row       *rows[NROWS], *row, key;
+    int             i, added = 0, deleted = 0, changed = 0, unchanged = 0;
+    int             kept;
+    struct timeval  start, end, diff;
+
+    init_snmp("testing");
+
+    table = container_create("table_container");
+    fresh = container_create("table_container");
+    if (!table || !fresh) {
+        OKF(0, ("table_container containers found"));
+        snmp_shutdown("testing");
+        PLAN(__test_counter);
+        return 0;
+    }
+
+    /*
+     * merging into an empty table adds every row
+     */
+    for (i = 0; i < NROWS; ++i)
+        if (value_initial(i) >= 0)
+            CONTAINER_INSERT(fresh, row_create(i, value_initial(i)));
+    netsnmp_container_table_merge(table, fresh, row_update, row_release,
+                                  NULL, &stats);
+    OKF(stats.added == NROWS / 2 && stats.deleted == 0 &&
+        stats.changed == 0 && stats.unchanged == 0 && released == 0,
+        ("Initial merge added %u rows", stats.added));
+    OKF(check_table(table, value_initial) && CONTAINER_SIZE(fresh) == 0,
+        ("The table holds the initial rows"));
+    key.index.oids = key.oid_idx;
+    key.index.len = 1;
+    for (i = 0; i < NROWS; ++i) {
+        key.oid_idx[0] = i;
+        rows[i] = CONTAINER_FIND(table, &key);
+    }
+
+    /*
+     * merge a reload which adds, removes and changes rows
+     */
+    for (i = 0; i < NROWS; ++i) {
+        if (value_reloaded(i) < 0)
+            continue;
+        CONTAINER_INSERT(fresh, row_create(i, value_reloaded(i)));
+        if (value_initial(i) < 0)
+            ++added;
+        else if (value_initial(i) == value_reloaded(i))
+            ++unchanged;
+        else
+            ++changed;
+    }
+    for (i = 0; i < NROWS; ++i)
+        if (value_initial(i) >= 0 && value_reloaded(i) < 0)
+            ++deleted;
+    released = 0;
+    netsnmp_container_table_merge(table, fresh, row_update, row_release,
+                                  NULL, &stats);
+    OKF(stats.added == added && stats.deleted == deleted &&
+        stats.changed == changed && stats.unchanged == unchanged,
+        ("Reload merged: %u added, %u deleted, %u changed, %u unchanged",
+         stats.added, stats.deleted, stats.changed, stats.unchanged));
+    OKF(check_table(table, value_reloaded) && CONTAINER_SIZE(fresh) == 0,
+        ("The table holds the reloaded rows"));
+    OKF(released == deleted + changed + unchanged,
+        ("%d old and fresh rows were released", released));
+
+    /*
+     * rows which were kept must be the original rows, unless their
+     * update failed
+     */
+    for (i = 0, kept = 1; i < NROWS; ++i) {
+        if (value_initial(i) < 0 || value_reloaded(i) < 0)
+            continue;
+        key.oid_idx[0] = i;
+        row = CONTAINER_FIND(table, &key);
+        if ((value_reloaded(i) & 1) ? (row == rows[i]) : (row != rows[i]))
+            kept = 0;
+    }
+    OK(kept, "Updated rows were kept and failed updates replaced");
+
+    /*
+     * merging an empty reload removes every row
+     */
+    released = 0;
+    netsnmp_container_table_merge(table, fresh, row_update, row_release,
+                                  NULL, &stats);
+    OKF(CONTAINER_SIZE(table) == 0 && stats.deleted == released &&
+        stats.added == 0, ("Empty reload deleted %u rows", stats.deleted));
+
+    /*
+     * a reload which doubles a large table
+     */
+    for (i = 0; i < NBIG; i += 2)
+        CONTAINER_INSERT(table, row_create(i, 0));
+    for (i = 0; i < NBIG; ++i)
+        CONTAINER_INSERT(fresh, row_create(i, 0));
+    CONTAINER_FIRST(table);
+    CONTAINER_FIRST(fresh);
+    released = 0;
+    netsnmp_get_monotonic_clock(&start);
+    netsnmp_container_table_merge(table, fresh, row_update, row_release,
+                                  NULL, &stats);
+    netsnmp_get_monotonic_clock(&end);
+    NETSNMP_TIMERSUB(&end, &start, &diff);
+    OKF(stats.added == NBIG / 2 && stats.unchanged == NBIG / 2 &&
+        CONTAINER_SIZE(table) == NBIG,
+        ("Merged %d rows into a table of %d", NBIG, NBIG / 2));
+    printf("# merging %d rows into %d took %ld.%06ld s\n", NBIG, NBIG / 2,
+           (long) diff.tv_sec, (long) diff.tv_usec);
+
+    /*
+     * a reload which changes a few rows is applied row by row: the
+     * first row went away, one was added and one is replaced
+     */
+    for (i = 1; i <= NBIG; ++i)
+        CONTAINER_INSERT(fresh, row_create(i, i == 2 ? 3 : 0));
+    released = 0;
+    netsnmp_container_table_merge(table, fresh, row_update, row_release,
+                                  NULL, &stats);
+    key.oid_idx[0] = 2;
+    row = CONTAINER_FIND(table, &key);
+    key.oid_idx[0] = 0;
+    OKF(stats.added == 1 && stats.deleted == 1 && stats.changed == 1 &&
+        CONTAINER_SIZE(table) == NBIG && row && row->value == 3 &&
+        !CONTAINER_FIND(table, &key) && released == NBIG,
+        ("Small reload: %u added, %u deleted, %u changed", stats.added,
+         stats.deleted, stats.changed));
+    CONTAINER_CLEAR(table, row_release, NULL);
+
+    CONTAINER_FREE(fresh);
+    CONTAINER_FREE(table);
+
+    snmp_shutdown("testing");
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* HEADER PDU arenas */
+
+/*
+ * Parses and clones a PDU into an arena, large enough to need several
+ * blocks, and checks that the varbinds behave as malloc'd ones do: values
+ * can be replaced, and a varbind taken off the PDU outlives it.
+ */
+
+#define NVARS 50
+
+netsnmp_pdu *pdu, *parsed, *clone;
+netsnmp_variable_list *vp, *cvp, *stolen;
+u_char *packet, *end;
+size_t len;
+oid name[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 104, 0 };
+oid value_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 3, 2, 10 };
+u_char longstr[200], otherstr[300];
+long ival;
+int i, count, rc;
+
+init_snmp("testing");
+
+memset(longstr, 'x', sizeof(longstr));
+memset(otherstr, 'y', sizeof(otherstr));
+pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OCTET_STR,
+                      longstr, sizeof(longstr));
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OBJECT_ID,
+                      value_oid, sizeof(value_oid));
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OCTET_STR,
+                      "short", 5);
+for (i = 0; i < NVARS; i++) {
+    ival = i;
+    name[OID_LENGTH(name) - 1] = i;
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_INTEGER,
+                          &ival, sizeof(ival));
+}
+
+len = 8192;
+packet = malloc(len);
+end = snmp_pdu_build(pdu, packet, &len);
+OKF(end != NULL, ("Built a PDU of %d varbinds", NVARS + 3));
+
+parsed = snmp_pdu_create(SNMP_MSG_RESPONSE);
+OKF(netsnmp_pdu_arena_init(parsed, 0) == SNMPERR_SUCCESS,
+    ("Set up an arena"));
+len = end - packet;
+rc = snmp_pdu_parse(parsed, packet, &len);
+OKF(rc == 0, ("Parsed the PDU into the arena"));
+
+vp = parsed->variables;
+OKF(vp && (vp->flags & NETSNMP_VAR_FLAG_ARENA) &&
+    vp->val_len == sizeof(longstr) &&
+    vp->val.string == NETSNMP_VAR_ARENA_VAL(vp) &&
+    memcmp(vp->val.string, longstr, sizeof(longstr)) == 0,
+    ("A long string value is kept in the arena"));
+vp = vp ? vp->next_variable : NULL;
+OKF(vp && vp->type == ASN_OBJECT_ID &&
+    vp->val_len == sizeof(value_oid) &&
+    vp->val.objid == (oid *) NETSNMP_VAR_ARENA_VAL(vp) &&
+    memcmp(vp->val.objid, value_oid, sizeof(value_oid)) == 0,
+    ("An OID value is kept in the arena"));
+vp = vp ? vp->next_variable : NULL;
+OKF(vp && vp->val.string == vp->buf && vp->val_len == 5,
+    ("A short string value is kept in the varbind"));
+
+for (count = 0, vp = vp ? vp->next_variable : NULL; vp;
+     vp = vp->next_variable, count++)
+    if (!(vp->flags & NETSNMP_VAR_FLAG_ARENA) || vp->type != ASN_INTEGER ||
+        *vp->val.integer != count)
+        break;
+OKF(count == NVARS, ("Parsed %d integers (expected %d)", count, NVARS));
+
+vp = parsed->variables;
+snmp_set_var_value(vp, otherstr, sizeof(otherstr));
+OKF(vp->val.string != NETSNMP_VAR_ARENA_VAL(vp) &&
+    !NETSNMP_VAR_VAL_IS_LOCAL(vp) && vp->val_len == sizeof(otherstr),
+    ("A value in the arena can be replaced by a larger one"));
+
+clone = snmp_clone_pdu(parsed);
+OKF(clone && clone->arena && clone->arena != parsed->arena,
+    ("The clone of an arena PDU gets an arena of its own"));
+for (count = 0, vp = parsed->variables, cvp = clone ? clone->variables : NULL;
+     vp && cvp; vp = vp->next_variable, cvp = cvp->next_variable, count++)
+    if (!(cvp->flags & NETSNMP_VAR_FLAG_ARENA) || cvp->type != vp->type ||
+        cvp->val_len != vp->val_len ||
+        memcmp(cvp->val.string, vp->val.string, vp->val_len) != 0)
+        break;
+OKF(count == NVARS + 3 && !vp && !cvp,
+    ("The clone has the same %d varbinds", count));
+
+/* unlink the last varbind and free the PDU under it */
+for (vp = parsed->variables; vp->next_variable->next_variable;
+     vp = vp->next_variable)
+    ;
+stolen = vp->next_variable;
+vp->next_variable = NULL;
+snmp_free_pdu(parsed);
+OKF(stolen->type == ASN_INTEGER && *stolen->val.integer == NVARS - 1,
+    ("An unlinked varbind outlives its PDU"));
+snmp_free_var(stolen);
+
+snmp_free_pdu(clone);
+snmp_free_pdu(pdu);
+free(packet);
+
+snmp_shutdown("testing");
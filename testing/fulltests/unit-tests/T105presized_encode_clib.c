@@ -0,0 +1,212 @@
+/* HEADER presized PDU encoding */
+
+/*
+ * Encodes the same PDUs with snmp_pdu_realloc_rbuild() and
+ * snmp_pdu_presized_rbuild(), starting from buffers that are too small,
+ * and checks that the packets are identical.
+ */
+
+SOCK_STARTUP;
+
+netsnmp_pdu *pdu, *trap, *bulk;
+netsnmp_variable_list *vp;
+netsnmp_session session, *ss;
+u_char *rbuf, *pbuf, *str;
+size_t rbuf_len, pbuf_len, roffset, poffset;
+oid name[] = { 1, 3, 6, 1, 2, 1, 31, 1, 1, 1, 6, 0 };
+oid oids[][6] = {
+    { 1, 3, 6, 1, 4, 1 },
+    { 2, 999, 127, 128, 16383, 16384 },
+    { 0, 0, 0xffffffffUL, 268435455, 268435456, 1 },
+};
+oid ent_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 3, 2, 10 };
+oid bad_oid[] = { 3, 1 };
+long ints[] = { 0, 1, -1, 127, 128, -128, -129, 255, 256, 32767, 32768,
+    -32769, 8388607, 8388608, 2147483647L, -2147483647L - 1 };
+u_long uints[] = { 0, 1, 127, 128, 255, 256, 65535, 65536, 16777215,
+    16777216, 2147483647UL, 2147483648UL, 4294967295UL };
+struct counter64 c64s[] = { { 0, 0 }, { 0, 127 }, { 0, 128 },
+    { 0, 4294967295UL }, { 1, 0 }, { 127, 1 }, { 128, 1 },
+    { 4294967295UL, 4294967295UL } };
+size_t strlens[] = { 0, 1, 127, 128, 255, 256, 65535, 65536 };
+u_char addr[4] = { 192, 0, 2, 1 };
+u_char bits[2] = { 0xa5, 0x80 };
+int i, rc1, rc2, same;
+
+/* prototype copied from snmp_api.c */
+int             snmp_build(u_char ** pkt, size_t * pkt_len,
+                           size_t * offset, netsnmp_session * pss,
+                           netsnmp_pdu *pdu);
+
+init_snmp("testing");
+
+str = malloc(65536);
+for (i = 0; i < 65536; i++)
+    str[i] = (u_char) i;
+
+pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+pdu->reqid = 0x12345678;
+pdu->errstat = SNMP_ERR_NOERROR;
+pdu->errindex = 0;
+for (i = 0; i < sizeof(ints) / sizeof(ints[0]); i++)
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_INTEGER,
+                          &ints[i], sizeof(ints[i]));
+for (i = 0; i < sizeof(uints) / sizeof(uints[0]); i++) {
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_GAUGE,
+                          &uints[i], sizeof(uints[i]));
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_TIMETICKS,
+                          &uints[i], sizeof(uints[i]));
+}
+for (i = 0; i < sizeof(c64s) / sizeof(c64s[0]); i++)
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_COUNTER64,
+                          &c64s[i], sizeof(c64s[i]));
+for (i = 0; i < sizeof(strlens) / sizeof(strlens[0]); i++)
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OCTET_STR,
+                          str, strlens[i]);
+for (i = 0; i < sizeof(oids) / sizeof(oids[0]); i++) {
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OBJECT_ID,
+                          oids[i], sizeof(oids[i]));
+    /* also use it as a name */
+    snmp_pdu_add_variable(pdu, oids[i], OID_LENGTH(oids[i]), ASN_NULL,
+                          NULL, 0);
+}
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OBJECT_ID,
+                      oids[0], sizeof(oid));
+snmp_pdu_add_variable(pdu, name, 1, ASN_IPADDRESS, addr, sizeof(addr));
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_BIT_STR,
+                      bits, sizeof(bits));
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), SNMP_NOSUCHOBJECT,
+                      NULL, 0);
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), SNMP_NOSUCHINSTANCE,
+                      NULL, 0);
+snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), SNMP_ENDOFMIBVIEW,
+                      NULL, 0);
+/* an empty OID value */
+vp = snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OBJECT_ID,
+                           NULL, 0);
+vp->type = ASN_OBJECT_ID;
+
+rbuf_len = pbuf_len = 16;
+rbuf = malloc(rbuf_len);
+pbuf = malloc(pbuf_len);
+roffset = poffset = 0;
+rc1 = snmp_pdu_realloc_rbuild(&rbuf, &rbuf_len, &roffset, pdu);
+rc2 = snmp_pdu_presized_rbuild(&pbuf, &pbuf_len, &poffset, pdu);
+OKF(rc1 && rc2, ("Encoded a response PDU both ways"));
+OKF(roffset == poffset &&
+    memcmp(rbuf + rbuf_len - roffset, pbuf + pbuf_len - poffset,
+           roffset) == 0,
+    ("The response PDUs are identical (%lu and %lu octets)",
+     (unsigned long) roffset, (unsigned long) poffset));
+OKF(pbuf_len == poffset, ("The buffer was grown to the exact size"));
+
+/*
+ * Values in front of ones already encoded.
+ */
+pdu->errstat = SNMP_ERR_TOOBIG;
+pdu->errindex = 300;
+rc1 = snmp_pdu_realloc_rbuild(&rbuf, &rbuf_len, &roffset, pdu);
+rc2 = snmp_pdu_presized_rbuild(&pbuf, &pbuf_len, &poffset, pdu);
+OKF(rc1 && rc2 && roffset == poffset &&
+    memcmp(rbuf + rbuf_len - roffset, pbuf + pbuf_len - poffset,
+           roffset) == 0,
+    ("A second PDU in front of the first is identical too"));
+
+/*
+ * PDUs whose lengths, with or without their header, straddle the
+ * boundaries of the length encodings.
+ */
+snmp_free_pdu(pdu);
+pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+pdu->reqid = 0x12345678;
+vp = snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OCTET_STR,
+                           str, 0);
+for (i = 64, same = 1; i < 320 && same; i++) {
+    snmp_set_var_value(vp, str, i);
+    roffset = poffset = 0;
+    rc1 = snmp_pdu_realloc_rbuild(&rbuf, &rbuf_len, &roffset, pdu);
+    rc2 = snmp_pdu_presized_rbuild(&pbuf, &pbuf_len, &poffset, pdu);
+    same = rc1 && rc2 && roffset == poffset &&
+        memcmp(rbuf + rbuf_len - roffset, pbuf + pbuf_len - poffset,
+               roffset) == 0;
+}
+OKF(same, ("PDUs of 100 to 350 octets are identical (up to %lu octets)",
+           (unsigned long) poffset));
+
+trap = snmp_pdu_create(SNMP_MSG_TRAP);
+trap->enterprise = snmp_duplicate_objid(ent_oid, OID_LENGTH(ent_oid));
+trap->enterprise_length = OID_LENGTH(ent_oid);
+memcpy(trap->agent_addr, addr, sizeof(addr));
+trap->trap_type = SNMP_TRAP_ENTERPRISESPECIFIC;
+trap->specific_type = 200;
+trap->time = 4294967295UL;
+snmp_pdu_add_variable(trap, name, OID_LENGTH(name), ASN_OCTET_STR,
+                      str, 10);
+roffset = poffset = 0;
+rc1 = snmp_pdu_realloc_rbuild(&rbuf, &rbuf_len, &roffset, trap);
+rc2 = snmp_pdu_presized_rbuild(&pbuf, &pbuf_len, &poffset, trap);
+OKF(rc1 && rc2 && roffset == poffset &&
+    memcmp(rbuf + rbuf_len - roffset, pbuf + pbuf_len - poffset,
+           roffset) == 0,
+    ("The SNMPv1 trap PDUs are identical"));
+
+snmp_pdu_add_variable(trap, bad_oid, OID_LENGTH(bad_oid), ASN_NULL,
+                      NULL, 0);
+roffset = poffset = 0;
+rc1 = snmp_pdu_realloc_rbuild(&rbuf, &rbuf_len, &roffset, trap);
+rc2 = snmp_pdu_presized_rbuild(&pbuf, &pbuf_len, &poffset, trap);
+OKF(!rc1 && !rc2, ("A bad name fails both ways"));
+
+/*
+ * A large GETBULK-style response through snmp_build(), with and without
+ * presizing.
+ */
+snmp_sess_init(&session);
+session.version = SNMP_VERSION_2c;
+session.peername = strdup("udp:127.0.0.1"); /* we won't actually connect */
+session.community = (u_char *) strdup("public");
+session.community_len = strlen((char *) session.community);
+ss = snmp_open(&session);
+OKF(ss != NULL, ("Opened a session"));
+
+bulk = snmp_pdu_create(SNMP_MSG_RESPONSE);
+bulk->version = SNMP_VERSION_2c;
+for (i = 0; i < 2000; i++) {
+    name[OID_LENGTH(name) - 1] = i;
+    snmp_pdu_add_variable(bulk, name, OID_LENGTH(name), ASN_COUNTER64,
+                          &c64s[i % 8], sizeof(c64s[0]));
+}
+
+if (ss) {
+    rbuf_len = pbuf_len = 2048;
+    rbuf = realloc(rbuf, rbuf_len);
+    pbuf = realloc(pbuf, pbuf_len);
+    roffset = poffset = 0;
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_NO_PRESIZED_ENCODE, 1);
+    rc1 = snmp_build(&rbuf, &rbuf_len, &roffset, ss, bulk);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_NO_PRESIZED_ENCODE, 0);
+    rc2 = snmp_build(&pbuf, &pbuf_len, &poffset, ss, bulk);
+    OKF(rc1 == 0 && rc2 == 0 && roffset == poffset &&
+        memcmp(rbuf + rbuf_len - roffset, pbuf + pbuf_len - poffset,
+               roffset) == 0,
+        ("The SNMPv2c messages are identical (%lu octets)",
+         (unsigned long) poffset));
+    OKF(pbuf_len == poffset,
+        ("The message buffer was grown to the exact size"));
+    snmp_close(ss);
+}
+
+snmp_free_pdu(bulk);
+snmp_free_pdu(trap);
+snmp_free_pdu(pdu);
+free(rbuf);
+free(pbuf);
+free(str);
+free(session.peername);
+free(session.community);
+
+snmp_shutdown("testing");
+
+SOCK_CLEANUP;
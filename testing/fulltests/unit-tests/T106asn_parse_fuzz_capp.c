@@ -0,0 +1,289 @@
+/*
+ * HEADER BER integer and OID decoding against a reference decoder
+ *
+ * Feeds valid encodings, random bytes and mutated encodings to
+ * asn_parse_int(), asn_parse_unsigned_int() and asn_parse_objid(), and
+ * checks that they accept and reject the same inputs as a straightforward
+ * byte-at-a-time decoder, consume the same number of bytes and return the
+ * same values.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NCASES  200000
+#define MAXOID  32
+
+static u_long
+truncate_u(u_long value)
+{
+#if SIZEOF_LONG != 4
+    if (value > 0xffffffffUL)
+        value &= 0xffffffffUL;
+#endif
+    return value;
+}
+
+static long
+truncate_s(long value)
+{
+#if SIZEOF_LONG != 4
+    if (value > 0x7fffffffL)
+        value &= 0xffffffffL;
+    else if (value < -0x7fffffffL - 1)
+        value = 0 - (value & 0xffffffffL);
+#endif
+    return value;
+}
+
+/*
+ * Parses the type and length of an object, with the checks every decoder
+ * makes.  Returns a pointer to the contents, or NULL.
+ */
+static u_char *
+ref_header(u_char *data, size_t *datalength, u_char *type, u_long *len)
+{
+    u_char         *bufp;
+    size_t          hl;
+
+    *type = *data;
+    bufp = asn_parse_length(data + 1, len);
+    if (bufp == NULL)
+        return NULL;
+    hl = bufp - data;
+    if (*len > 0x7fffffff || *len + hl > *datalength)
+        return NULL;
+    return bufp;
+}
+
+static u_char *
+ref_parse_int(u_char *data, size_t *datalength, u_char *type, long *intp)
+{
+    u_char         *bufp;
+    u_long          len;
+    long            value;
+
+    if (*data != ASN_INTEGER)
+        return NULL;
+    bufp = ref_header(data, datalength, type, &len);
+    if (bufp == NULL || len == 0 || len > sizeof(long))
+        return NULL;
+    *datalength -= len + (bufp - data);
+    value = (*bufp & 0x80) ? -1 : 0;
+    while (len--)
+        value = (value << 8) | *bufp++;
+    *intp = truncate_s(value);
+    return bufp;
+}
+
+static u_char *
+ref_parse_unsigned_int(u_char *data, size_t *datalength, u_char *type,
+                       u_long *intp)
+{
+    u_char         *bufp;
+    u_long          len, value = 0;
+
+    if (*data != ASN_COUNTER && *data != ASN_GAUGE &&
+        *data != ASN_TIMETICKS && *data != ASN_UINTEGER)
+        return NULL;
+    bufp = ref_header(data, datalength, type, &len);
+    if (bufp == NULL || len == 0 || len > sizeof(long) + 1 ||
+        (len == sizeof(long) + 1 && *bufp != 0))
+        return NULL;
+    *datalength -= len + (bufp - data);
+    if (*bufp & 0x80)
+        value = ~value;
+    while (len--)
+        value = (value << 8) | *bufp++;
+    *intp = truncate_u(value);
+    return bufp;
+}
+
+static u_char *
+ref_parse_objid(u_char *data, size_t *datalength, u_char *type,
+                oid *objid, size_t *objidlength)
+{
+    u_char         *bufp;
+    u_long          len, subid;
+    size_t          n = 1;
+
+    if (*data != ASN_OBJECT_ID)
+        return NULL;
+    bufp = ref_header(data, datalength, type, &len);
+    if (bufp == NULL)
+        return NULL;
+    *datalength -= len + (bufp - data);
+    if (len == 0)
+        objid[0] = objid[1] = 0;
+    while (len > 0) {
+        if (n >= *objidlength)
+            return NULL;
+        subid = 0;
+        do {
+            subid = (subid << 7) + (*bufp & 0x7f);
+            len--;
+        } while ((*bufp++ & 0x80) && len > 0);
+        if (len == 0 && (bufp[-1] & 0x80))
+            return NULL;
+        if (subid > MAX_SUBID)
+            return NULL;
+        objid[n++] = subid;
+    }
+    subid = objid[1];
+    if (subid < 40) {
+        objid[0] = 0;
+    } else if (subid < 80) {
+        objid[0] = 1;
+        objid[1] = subid - 40;
+    } else {
+        objid[0] = 2;
+        objid[1] = subid - 80;
+    }
+    *objidlength = n;
+    return bufp;
+}
+
+/*
+ * Writes a random, mostly well-formed, encoding of the given type.
+ */
+static size_t
+random_encoding(u_char *buf, u_char type)
+{
+    size_t          len, i, n;
+    u_long          subid;
+
+    switch (random() % 8) {
+    case 0:
+        /* random bytes */
+        len = random() % 12;
+        for (i = 0; i < len; i++)
+            buf[i] = random();
+        return len;
+    case 1:
+        /* long form length */
+        len = random() % 10;
+        buf[0] = type;
+        buf[1] = 0x81;
+        buf[2] = len;
+        for (i = 0; i < len; i++)
+            buf[3 + i] = random();
+        return 3 + len;
+    default:
+        break;
+    }
+
+    buf[0] = type;
+    if (type != ASN_OBJECT_ID) {
+        len = random() % (sizeof(long) + 3);
+        buf[1] = len;
+        for (i = 0; i < len; i++)
+            buf[2 + i] = (random() % 4) ? random() : 0;
+        return 2 + len;
+    }
+
+    /* sub-identifiers, mostly single bytes */
+    n = random() % (MAXOID + 4);
+    len = 2;
+    for (i = 0; i < n && len < 120; i++) {
+        switch (random() % 6) {
+        case 0:
+            subid = random() % 0x4000;
+            break;
+        case 1:
+            subid = random();
+            break;
+        default:
+            subid = random() % 0x80;
+            break;
+        }
+        if (subid >= 0x10000000)
+            buf[len++] = 0x80 | (subid >> 28);
+        if (subid >= 0x200000)
+            buf[len++] = 0x80 | ((subid >> 21) & 0x7f);
+        if (subid >= 0x4000)
+            buf[len++] = 0x80 | ((subid >> 14) & 0x7f);
+        if (subid >= 0x80)
+            buf[len++] = 0x80 | ((subid >> 7) & 0x7f);
+        buf[len++] = subid & 0x7f;
+    }
+    buf[1] = len - 2;
+    return len;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const u_char types[] = { ASN_INTEGER, ASN_COUNTER, ASN_GAUGE,
+        ASN_TIMETICKS, ASN_OBJECT_ID };
+    u_char          buf[256], type1, type2, *r1, *r2;
+    oid             oid1[MAXOID], oid2[MAXOID];
+    size_t          len, dlen1, dlen2, olen1, olen2;
+    long            i1, i2;
+    u_long          u1, u2;
+    int             i, errors[3] = { 0, 0, 0 }, accepted[3] = { 0, 0, 0 };
+
+    srandom(argc > 1 ? atoi(argv[1]) : 1);
+
+    for (i = 0; i < NCASES; i++) {
+        u_char          type = types[random() % sizeof(types)];
+
+        memset(buf, 0, sizeof(buf));
+        len = random_encoding(buf, type);
+        if (len && random() % 10 == 0)
+            buf[random() % len] ^= 1 << (random() % 8);
+        /* sometimes pretend the buffer is shorter than the object */
+        dlen1 = dlen2 = (random() % 10 == 0 && len) ? random() % len : len;
+
+        if (type == ASN_INTEGER) {
+            i1 = i2 = 0;
+            r1 = asn_parse_int(buf, &dlen1, &type1, &i1, sizeof(i1));
+            r2 = ref_parse_int(buf, &dlen2, &type2, &i2);
+            if ((r1 == NULL) != (r2 == NULL) ||
+                (r1 && (r1 != r2 || dlen1 != dlen2 || i1 != i2)))
+                errors[0]++;
+            if (r1)
+                accepted[0]++;
+        } else if (type == ASN_OBJECT_ID) {
+            olen1 = olen2 = 2 + random() % (MAXOID - 2);
+            r1 = asn_parse_objid(buf, &dlen1, &type1, oid1, &olen1);
+            r2 = ref_parse_objid(buf, &dlen2, &type2, oid2, &olen2);
+            if ((r1 == NULL) != (r2 == NULL) ||
+                (r1 && (r1 != r2 || dlen1 != dlen2 || olen1 != olen2 ||
+                        memcmp(oid1, oid2, olen1 * sizeof(oid)) != 0)))
+                errors[2]++;
+            if (r1)
+                accepted[2]++;
+        } else {
+            u1 = u2 = 0;
+            r1 = asn_parse_unsigned_int(buf, &dlen1, &type1, &u1,
+                                        sizeof(u1));
+            r2 = ref_parse_unsigned_int(buf, &dlen2, &type2, &u2);
+            if ((r1 == NULL) != (r2 == NULL) ||
+                (r1 && (r1 != r2 || dlen1 != dlen2 || u1 != u2)))
+                errors[1]++;
+            if (r1)
+                accepted[1]++;
+        }
+    }
+
+    OKF(errors[0] == 0 && accepted[0] > 0,
+        ("asn_parse_int: %d differences, %d encodings accepted",
+         errors[0], accepted[0]));
+    OKF(errors[1] == 0 && accepted[1] > 0,
+        ("asn_parse_unsigned_int: %d differences, %d encodings accepted",
+         errors[1], accepted[1]));
+    OKF(errors[2] == 0 && accepted[2] > 0,
+        ("asn_parse_objid: %d differences, %d encodings accepted",
+         errors[2], accepted[2]));
+    PLAN(3);
+    return 0;
+}
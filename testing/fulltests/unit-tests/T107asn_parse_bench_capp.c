@@ -0,0 +1,117 @@
+/*
+ * HEADER Parsing a 64-varbind ifTable response
+ *
+ * Encodes a GETBULK-style response holding NROW rows of NCOL ifTable
+ * columns and parses it NLOOP times with snmp_pdu_parse().  The time
+ * taken is reported as a comment so that this test doubles as a
+ * benchmark of the BER decoders.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NROW  8
+#define NCOL  8
+#define NLOOP 20000
+
+int
+main(int argc, char *argv[])
+{
+    /* ifDescr, ifType, ifMtu, ifSpeed, ifPhysAddress, ifOperStatus,
+     * ifLastChange, ifInOctets */
+    static const int columns[NCOL] = { 2, 3, 4, 5, 6, 8, 9, 10 };
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 0, 0 };
+    netsnmp_pdu    *pdu, *parsed;
+    netsnmp_variable_list *vp;
+    u_char          packet[8192], *end, mac[6] = { 0, 0x16, 0x3e, 1, 2, 3 };
+    char            descr[32];
+    size_t          len;
+    struct timeval  start, stop, diff;
+    long            ival;
+    u_long          uval;
+    int             row, col, i, count, failed = 0;
+
+    pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+    pdu->reqid = 0x1234;
+    for (row = 0; row < NROW; row++) {
+        for (col = 0; col < NCOL; col++) {
+            name[9] = columns[col];
+            name[10] = 1000 + row * 37;
+            switch (columns[col]) {
+            case 2:
+                snprintf(descr, sizeof(descr), "GigabitEthernet0/%d", row);
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_OCTET_STR, descr, strlen(descr));
+                break;
+            case 6:
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_OCTET_STR, mac, sizeof(mac));
+                break;
+            case 5:
+                uval = 1000000000UL;
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_GAUGE, &uval, sizeof(uval));
+                break;
+            case 9:
+                uval = 123456 + row;
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_TIMETICKS, &uval, sizeof(uval));
+                break;
+            case 10:
+                uval = 3000000000UL + row * 7919;
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_COUNTER, &uval, sizeof(uval));
+                break;
+            default:
+                ival = columns[col] == 4 ? 1500 : 6;
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_INTEGER, &ival, sizeof(ival));
+                break;
+            }
+        }
+    }
+
+    len = sizeof(packet);
+    end = snmp_pdu_build(pdu, packet, &len);
+    OKF(end != NULL, ("Encoded a response of %d varbinds (%d bytes)",
+                      NROW * NCOL, end ? (int) (end - packet) : 0));
+    if (end == NULL) {
+        PLAN(1);
+        return 0;
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP; i++) {
+        parsed = snmp_pdu_create(SNMP_MSG_RESPONSE);
+        len = end - packet;
+        if (snmp_pdu_parse(parsed, packet, &len) != 0)
+            failed++;
+        if (i == 0) {
+            for (count = 0, vp = parsed->variables; vp;
+                 vp = vp->next_variable, count++)
+                ;
+            OKF(count == NROW * NCOL, ("Parsed %d varbinds", count));
+        }
+        snmp_free_pdu(parsed);
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+
+    OKF(failed == 0, ("Parsed the response %d times (%d failures)",
+                      NLOOP, failed));
+    printf("# %.2f us per response\n",
+           (diff.tv_sec * 1e6 + diff.tv_usec) / NLOOP);
+
+    snmp_free_pdu(pdu);
+    PLAN(3);
+    return 0;
+}
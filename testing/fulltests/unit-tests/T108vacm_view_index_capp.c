@@ -0,0 +1,294 @@
+/*
+ * HEADER VACM view index and access resolution
+ *
+ * Builds random views in viewList and, identically, in a list of our own,
+ * and checks that vacm_getViewEntry() and vacm_checkSubtree(), which use
+ * the view index, agree with netsnmp_view_get() and
+ * netsnmp_view_subtree_check(), which walk the list, before and after
+ * entries are changed and destroyed, both while the index is stale and
+ * after vacm_buildIndexes() rebuilt it.  Does the same for
+ * vacm_getAccessEntryFor() against vacm_getGroupEntry() and
+ * vacm_getAccessEntry().  Finally times lookups in a view of 200
+ * subtrees both ways.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/vacm.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NVIEWS   300
+#define NQUERIES 20000
+#define NBENCH   200
+#define NLOOP    2000
+
+static const char *names[] = { "v0", "v1", "v2", "a-much-longer-view-name" };
+
+static struct vacm_viewEntry *head = NULL;
+
+/*
+ * Returns the position of an entry in its list, so that the entries the
+ * two lookups return can be compared.
+ */
+static int
+list_position(struct vacm_viewEntry *list, struct vacm_viewEntry *vp)
+{
+    int             pos = 0;
+
+    if (vp == NULL)
+        return -1;
+    for (; list; list = list->next, pos++)
+        if (list == vp)
+            return pos;
+    return -2;
+}
+
+static struct vacm_viewEntry *
+view_list(void)
+{
+    struct vacm_viewEntry *first;
+
+    vacm_scanViewInit();
+    first = vacm_scanViewNext();
+    return first;
+}
+
+static size_t
+random_oid(oid * name, size_t maxlen)
+{
+    size_t          len = random() % (maxlen + 1), i;
+
+    for (i = 0; i < len; i++)
+        name[i] = 1 + random() % 3;
+    return len;
+}
+
+static void
+add_view(void)
+{
+    struct vacm_viewEntry *vp1, *vp2;
+    const char     *name = names[random() % 4];
+    oid             subtree[MAX_OID_LEN];
+    size_t          len = random_oid(subtree, 8), i;
+
+    vp1 = vacm_createViewEntry(name, subtree, len);
+    vp2 = netsnmp_view_create(&head, name, subtree, len);
+    if (vp1 == NULL || vp2 == NULL)
+        return;
+    vp1->viewType = vp2->viewType = 1 + random() % 2;
+    vp1->viewMaskLen = vp2->viewMaskLen = random() % 3;
+    for (i = 0; i < vp1->viewMaskLen; i++)
+        vp1->viewMask[i] = vp2->viewMask[i] = random() | 0x81;
+    if (random() % 4 == 0 && vp1->viewMaskLen)
+        vp1->viewMask[0] = vp2->viewMask[0] = random();
+}
+
+/*
+ * Returns the number of queries for which the two lookups differ.
+ */
+static int
+compare_lookups(int nqueries)
+{
+    oid             query[MAX_OID_LEN];
+    size_t          len;
+    const char     *name;
+    int             i, errors = 0;
+    int             modes[] = { VACM_MODE_FIND, VACM_MODE_CHECK_SUBTREE,
+        VACM_MODE_IGNORE_MASK };
+
+    for (i = 0; i < nqueries; i++) {
+        int             mode = modes[i % 3];
+
+        name = i % 50 ? names[random() % 4] : "no-such-view";
+        len = random_oid(query, 10);
+        if (list_position(view_list(),
+                          vacm_getViewEntry(name, query, len, mode)) !=
+            list_position(head, netsnmp_view_get(head, name, query, len,
+                                                 mode)))
+            errors++;
+        if (vacm_checkSubtree(name, query, len) !=
+            netsnmp_view_subtree_check(head, name, query, len))
+            errors++;
+    }
+    return errors;
+}
+
+static int
+compare_access(void)
+{
+    static const char *users[] = { "alice", "bob", "carol", "dave", "" };
+    static const char *contexts[] = { "", "ctx", "ctx1", "other" };
+    struct vacm_groupEntry *gp1, *gp2;
+    struct vacm_accessEntry *ap1, *ap2;
+    int             u, c, model, level, errors = 0;
+
+    for (u = 0; u < 5; u++)
+        for (c = 0; c < 4; c++)
+            for (model = 1; model <= 3; model++)
+                for (level = 1; level <= 3; level++) {
+                    ap1 = vacm_getAccessEntryFor(model, users[u], level,
+                                                 contexts[c], &gp1);
+                    gp2 = vacm_getGroupEntry(model, users[u]);
+                    ap2 = gp2 ? vacm_getAccessEntry(gp2->groupName,
+                                                    contexts[c], model,
+                                                    level) : NULL;
+                    if (gp1 != gp2 || ap1 != ap2)
+                        errors++;
+                }
+    return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct vacm_viewEntry *vp1, *vp2, *next;
+    struct vacm_groupEntry *gp;
+    struct vacm_accessEntry *ap;
+    oid             subtree[MAX_OID_LEN], query[MAX_OID_LEN];
+    oid             bench_oid[] = { 1, 3, 6, 1, 2, 1, 0, 0, 1, 7 };
+    char            name[VACMSTRINGLEN];
+    struct timeval  start, stop, diff;
+    double          linear_us, index_us;
+    size_t          len;
+    int             i, errors, found1 = 0, found2 = 0;
+
+    srandom(argc > 1 ? atoi(argv[1]) : 1);
+
+    for (i = 0; i < NVIEWS; i++)
+        add_view();
+    vacm_buildIndexes();
+    errors = compare_lookups(NQUERIES);
+    OKF(errors == 0, ("%d views: %d lookups differ", NVIEWS, errors));
+
+    /* change some masks and types in place */
+    for (i = 0, vp1 = view_list(), vp2 = head; vp1 && vp2;
+         vp1 = vp1->next, vp2 = vp2->next, i++) {
+        if (i % 5 == 0) {
+            vp1->viewType = vp2->viewType = 3 - vp1->viewType;
+            vp1->viewMaskLen = vp2->viewMaskLen = 1;
+            vp1->viewMask[0] = vp2->viewMask[0] = random();
+        }
+    }
+    vacm_invalidateCaches();
+    errors = compare_lookups(NQUERIES);
+    OKF(errors == 0, ("Stale index: %d lookups differ", errors));
+    vacm_buildIndexes();
+    errors = compare_lookups(NQUERIES);
+    OKF(errors == 0, ("After changing views: %d lookups differ", errors));
+
+    /* destroy half of them and add some more */
+    for (i = 0, vp1 = view_list(); vp1; vp1 = next, i++) {
+        next = vp1->next;
+        if (i % 2 == 0) {
+            /* the first matching entry goes, the same one in both lists */
+            strcpy(name, vp1->viewName + 1);
+            len = vp1->viewSubtreeLen;
+            memcpy(subtree, vp1->viewSubtree, len * sizeof(oid));
+            vacm_destroyViewEntry(name, subtree, len);
+            netsnmp_view_destroy(&head, name, subtree, len);
+        }
+    }
+    for (i = 0; i < NVIEWS / 4; i++)
+        add_view();
+    vacm_buildIndexes();
+    errors = compare_lookups(NQUERIES);
+    OKF(errors == 0, ("After destroying views: %d lookups differ", errors));
+
+    vacm_destroyAllViewEntries();
+    netsnmp_view_clear(&head);
+    vacm_buildIndexes();
+    errors = compare_lookups(1000);
+    OKF(errors == 0, ("With no views: %d lookups differ", errors));
+
+    /*
+     * Group and access resolution.
+     */
+    gp = vacm_createGroupEntry(3, "alice");
+    strcpy(gp->groupName, "g1");
+    gp = vacm_createGroupEntry(SNMP_SEC_MODEL_ANY, "bob");
+    strcpy(gp->groupName, "g2");
+    gp = vacm_createGroupEntry(2, "carol");
+    strcpy(gp->groupName, "g1");
+    ap = vacm_createAccessEntry("g1", "", SNMP_SEC_MODEL_ANY, 1);
+    ap->contextMatch = CONTEXT_MATCH_EXACT;
+    ap = vacm_createAccessEntry("g1", "ctx", 3, 2);
+    ap->contextMatch = CONTEXT_MATCH_PREFIX;
+    ap = vacm_createAccessEntry("g2", "", 3, 3);
+    ap->contextMatch = CONTEXT_MATCH_PREFIX;
+    errors = compare_access();
+    errors += compare_access();
+    OKF(errors == 0, ("Access resolution: %d differences", errors));
+
+    ap->contextMatch = CONTEXT_MATCH_EXACT;
+    vacm_invalidateCaches();
+    gp = vacm_getGroupEntry(2, "carol");
+    strcpy(gp->groupName, "g2");
+    vacm_invalidateCaches();
+    errors = compare_access();
+    vacm_createGroupEntry(1, "dave");
+    errors += compare_access();
+    vacm_destroyAccessEntry("g1", "ctx", 3, 2);
+    errors += compare_access();
+    vacm_destroyAllGroupEntries();
+    errors += compare_access();
+    OKF(errors == 0, ("Access resolution after changes: %d differences",
+                      errors));
+    vacm_destroyAllAccessEntries();
+
+    /*
+     * 200 subtrees under one view name, like a per-table view.
+     */
+    for (i = 0; i < NBENCH; i++) {
+        oid             base[] = { 1, 3, 6, 1, 2, 1, 0, 0 };
+
+        base[6] = 2 + i / 20;
+        base[7] = i % 20 + 1;
+        vp1 = vacm_createViewEntry("big", base, OID_LENGTH(base));
+        vp2 = netsnmp_view_create(&head, "big", base, OID_LENGTH(base));
+        vp1->viewType = vp2->viewType = (i % 7) ? SNMP_VIEW_INCLUDED :
+            SNMP_VIEW_EXCLUDED;
+    }
+    vacm_buildIndexes();
+    memcpy(query, bench_oid, sizeof(bench_oid));
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP * NBENCH; i++) {
+        query[6] = 2 + (i % NBENCH) / 20;
+        query[7] = i % 23 + 1;
+        if (netsnmp_view_get(head, "big", query, 10, VACM_MODE_FIND))
+            found1++;
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    linear_us = (diff.tv_sec * 1e6 + diff.tv_usec) / (NLOOP * NBENCH);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP * NBENCH; i++) {
+        query[6] = 2 + (i % NBENCH) / 20;
+        query[7] = i % 23 + 1;
+        if (vacm_getViewEntry("big", query, 10, VACM_MODE_FIND))
+            found2++;
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    index_us = (diff.tv_sec * 1e6 + diff.tv_usec) / (NLOOP * NBENCH);
+
+    OKF(found1 == found2 && found1 > 0,
+        ("%d views: both lookups found %d of %d OIDs", NBENCH, found2,
+         NLOOP * NBENCH));
+    printf("# %.3f us per lookup walking the list\n", linear_us);
+    printf("# %.3f us per lookup in the index\n", index_us);
+
+    vacm_destroyAllViewEntries();
+    netsnmp_view_clear(&head);
+    PLAN(8);
+    return 0;
+}
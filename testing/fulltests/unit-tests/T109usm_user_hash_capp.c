@@ -0,0 +1,209 @@
+/*
+ * HEADER USM user lookups with many users
+ *
+ * Fills the USM user list with 1000, 10000 and 100000 users and checks
+ * that usm_get_user() finds each of them, as a walk of the list does,
+ * also after users are removed and added back.  Then builds authNoPriv
+ * messages for some of the users and times how long it takes to parse
+ * and authenticate them, as a comment, so that this test doubles as a
+ * benchmark of the user lookup.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/snmpusm.h>
+#include <net-snmp/library/transform_oids.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NMSGS  64
+#define NLOOP  200
+
+/* prototype copied from snmp_api.c */
+int             snmp_build(u_char ** pkt, size_t * pkt_len,
+                           size_t * offset, netsnmp_session * pss,
+                           netsnmp_pdu *pdu);
+
+static u_char   engineID[SNMP_MAXBUF_SMALL];
+static size_t   engineIDLen;
+
+static struct usmUser *
+make_user(int i)
+{
+    struct usmUser *user = usm_create_user();
+    char            name[32];
+    int             j;
+
+    snprintf(name, sizeof(name), "user%06d", i);
+    user->name = strdup(name);
+    user->secName = strdup(name);
+    user->engineID = netsnmp_memdup(engineID, engineIDLen);
+    user->engineIDLen = engineIDLen;
+    SNMP_FREE(user->authProtocol);
+    user->authProtocol = snmp_duplicate_objid(usmHMACSHA1AuthProtocol,
+                                              USM_AUTH_PROTO_SHA_LEN);
+    user->authProtocolLen = USM_AUTH_PROTO_SHA_LEN;
+    user->authKey = (u_char *) malloc(20);
+    for (j = 0; j < 20; j++)
+        user->authKey[j] = i + j;
+    user->authKeyLen = 20;
+    user->userStatus = RS_ACTIVE;
+    user->userStorageType = ST_READONLY;
+    return user;
+}
+
+static struct usmUser *
+get_user(int i)
+{
+    char            name[32];
+
+    snprintf(name, sizeof(name), "user%06d", i);
+    return usm_get_user(engineID, engineIDLen, name);
+}
+
+/*
+ * Walks the list and checks that usm_get_user() finds each user, and
+ * that the users that should be there are.  Returns the number of
+ * differences.
+ */
+static int
+check_users(int n, int removed)
+{
+    struct usmUser *user;
+    int             i, count = 0, expected = 0, errors = 0;
+
+    for (user = usm_get_userList(); user; user = user->next, count++)
+        if (usm_get_user(user->engineID, user->engineIDLen, user->name) !=
+            user)
+            errors++;
+    for (i = 0; i < n + 10; i++) {
+        int             present = i < n && !(removed && i % 30 == 0 &&
+                                             i % 50 != 0);
+
+        if ((get_user(i) != NULL) != present)
+            errors++;
+        expected += present;
+    }
+    return errors + (count != expected);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int counts[] = { 1000, 10000, 100000 };
+    netsnmp_pdu    *pdu;
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    netsnmp_session session, receiver, *ss = NULL;
+    struct usmUser *user;
+    u_char         *packets[NMSGS], *buffers[NMSGS], scratch[1024];
+    size_t          lengths[NMSGS], pkt_len, offset, len;
+    struct timeval  start, stop, diff;
+    int             c, i, n, errors, failed;
+    char            secname[32];
+
+    init_snmp("testing");
+    engineIDLen = snmpv3_get_engineID(engineID, sizeof(engineID));
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_3;
+    session.peername = strdup("udp:127.0.0.1"); /* we won't actually connect */
+    session.securityModel = SNMP_SEC_MODEL_USM;
+    session.securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
+    session.securityName = strdup("user000000");
+    session.securityNameLen = strlen(session.securityName);
+    session.securityEngineID = netsnmp_memdup(engineID, engineIDLen);
+    session.securityEngineIDLen = engineIDLen;
+    snmp_sess_init(&receiver);
+    receiver.isAuthoritative = SNMP_SESS_AUTHORITATIVE;
+
+    for (c = 0; c < 3; c++) {
+        n = counts[c];
+        clear_user_list();
+        /* in descending order, which puts each one at the head */
+        for (i = n - 1; i >= 0; i--)
+            usm_add_user(make_user(i));
+
+        errors = check_users(n, 0);
+        OKF(errors == 0, ("%d users: %d lookups differ", n, errors));
+
+        /* remove every 30th user and put every 50th back */
+        for (i = 0; i < n; i += 30) {
+            user = get_user(i);
+            usm_remove_user(user);
+            usm_free_user(user);
+        }
+        for (i = 0; i < n; i += 50)
+            usm_add_user(make_user(i));
+        errors = check_users(n, 1);
+        OKF(errors == 0, ("%d users after changes: %d lookups differ", n,
+                          errors));
+
+        /*
+         * messages from users spread over the list
+         */
+        if (c == 0 && (ss = snmp_open(&session)) == NULL) {
+            OKF(0, ("Opened a session"));
+            break;
+        }
+        for (i = 0; i < NMSGS; i++) {
+            pdu = snmp_pdu_create(SNMP_MSG_GET);
+            pdu->version = SNMP_VERSION_3;
+            snprintf(secname, sizeof(secname), "user%06d",
+                     (i * (n / NMSGS)) | 1);
+            pdu->securityName = strdup(secname);
+            pdu->securityNameLen = strlen(secname);
+            snmp_add_null_var(pdu, name, OID_LENGTH(name));
+            pkt_len = 256;
+            buffers[i] = (u_char *) malloc(pkt_len);
+            offset = 0;
+            if (snmp_build(&buffers[i], &pkt_len, &offset, ss, pdu) == 0 &&
+                offset <= sizeof(scratch)) {
+                packets[i] = buffers[i] + pkt_len - offset;
+                lengths[i] = offset;
+            } else {
+                packets[i] = NULL;
+            }
+            snmp_free_pdu(pdu);
+        }
+
+        failed = 0;
+        gettimeofday(&start, NULL);
+        for (i = 0; i < NLOOP * NMSGS; i++) {
+            if (packets[i % NMSGS] == NULL) {
+                failed++;
+                continue;
+            }
+            /* the digest is checked in place, so work on a copy */
+            pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+            len = lengths[i % NMSGS];
+            memcpy(scratch, packets[i % NMSGS], len);
+            if (snmpv3_parse(pdu, scratch, &len, NULL,
+                             &receiver) !=
+                SNMPERR_SUCCESS)
+                failed++;
+            snmp_free_pdu(pdu);
+        }
+        gettimeofday(&stop, NULL);
+        NETSNMP_TIMERSUB(&stop, &start, &diff);
+        OKF(failed == 0, ("%d users: authenticated %d messages (%d failed)",
+                          n, NLOOP * NMSGS, failed));
+        printf("# %d users: %.2f us per message\n", n,
+               (diff.tv_sec * 1e6 + diff.tv_usec) / (NLOOP * NMSGS));
+        for (i = 0; i < NMSGS; i++)
+            free(buffers[i]);
+    }
+
+    if (ss)
+        snmp_close(ss);
+    clear_user_list();
+    snmp_shutdown("testing");
+    PLAN(9);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * HEADER Precomputed keyed hashes
+ *
+ * Checks that sc_generate_prepared_keyed_hash() and
+ * sc_check_prepared_keyed_hash() agree with sc_generate_keyed_hash() and
+ * sc_check_keyed_hash() for HMAC-MD5 and HMAC-SHA1 over random keys and
+ * messages, and that a USM user's keyed hash follows changes of its key.
+ * The time both ways take for a message is reported as a comment.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/snmpusm.h>
+#include <net-snmp/library/transform_oids.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NCASES 2000
+#define NLOOP  100000
+#define MSGLEN 1400
+
+/* prototype copied from snmp_api.c */
+int             snmp_build(u_char ** pkt, size_t * pkt_len,
+                           size_t * offset, netsnmp_session * pss,
+                           netsnmp_pdu *pdu);
+
+static u_char   engineID[SNMP_MAXBUF_SMALL];
+static size_t   engineIDLen;
+
+/*
+ * Returns the number of random messages for which the two ways differ.
+ */
+static int
+compare_hashes(const oid * proto, size_t keylen)
+{
+    netsnmp_keyed_hash *kh;
+    u_char          key[20], msg[MSGLEN + 8], mac1[20], mac2[20];
+    size_t          len, maclen1, maclen2, i;
+    int             c, off, rc1, rc2, errors = 0;
+
+    for (c = 0; c < NCASES; c++) {
+        for (i = 0; i < keylen; i++)
+            key[i] = random();
+        kh = sc_keyed_hash_create(proto, USM_LENGTH_OID_TRANSFORM, key,
+                                  keylen);
+        if (kh == NULL)
+            return -1;
+        len = 1 + random() % MSGLEN;
+        off = random() % 8;     /* also unaligned messages */
+        for (i = 0; i < len; i++)
+            msg[off + i] = random();
+        maclen1 = maclen2 = (c % 2) ? USM_MD5_AND_SHA_AUTH_LEN : 20;
+        rc1 = sc_generate_keyed_hash(proto, USM_LENGTH_OID_TRANSFORM, key,
+                                     keylen, msg + off, len, mac1,
+                                     &maclen1);
+        rc2 = sc_generate_prepared_keyed_hash(kh, msg + off, len, mac2,
+                                              &maclen2);
+        if (rc1 != rc2 || maclen1 != maclen2 ||
+            memcmp(mac1, mac2, maclen1) != 0)
+            errors++;
+
+        /* a good MAC, a bad one, and a good one of the wrong length */
+        if (c % 3 == 1)
+            mac1[random() % USM_MD5_AND_SHA_AUTH_LEN] ^= 0x10;
+        maclen1 = (c % 3 == 2) ? 11 : USM_MD5_AND_SHA_AUTH_LEN;
+        rc1 = sc_check_keyed_hash(proto, USM_LENGTH_OID_TRANSFORM, key,
+                                  keylen, msg + off, len, mac1, maclen1);
+        rc2 = sc_check_prepared_keyed_hash(kh, msg + off, len, mac1,
+                                           maclen1);
+        if (rc1 != rc2 || (rc1 == SNMPERR_SUCCESS) != (c % 3 == 0 &&
+                                                       len >= maclen1))
+            errors++;
+
+        if (!sc_keyed_hash_matches(kh, proto, USM_LENGTH_OID_TRANSFORM,
+                                   key, keylen))
+            errors++;
+        key[random() % keylen] ^= 1;
+        if (sc_keyed_hash_matches(kh, proto, USM_LENGTH_OID_TRANSFORM,
+                                  key, keylen))
+            errors++;
+        sc_keyed_hash_free(kh);
+    }
+    return errors;
+}
+
+/*
+ * Builds an authNoPriv message from the user and returns whether a receiver
+ * authenticates it.
+ */
+static int
+authenticates(netsnmp_session * ss, const char *secName)
+{
+    netsnmp_session receiver;
+    netsnmp_pdu    *pdu;
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    u_char         *buf;
+    size_t          pkt_len = 256, offset = 0;
+    int             rc = 0;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GET);
+    pdu->version = SNMP_VERSION_3;
+    pdu->securityName = strdup(secName);
+    pdu->securityNameLen = strlen(secName);
+    snmp_add_null_var(pdu, name, OID_LENGTH(name));
+    buf = (u_char *) malloc(pkt_len);
+    if (snmp_build(&buf, &pkt_len, &offset, ss, pdu) == 0) {
+        snmp_free_pdu(pdu);
+        snmp_sess_init(&receiver);
+        receiver.isAuthoritative = SNMP_SESS_AUTHORITATIVE;
+        pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+        rc = snmpv3_parse(pdu, buf + pkt_len - offset, &offset, NULL,
+                          &receiver) == SNMPERR_SUCCESS;
+    }
+    snmp_free_pdu(pdu);
+    free(buf);
+    return rc;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const u_char badkey[70] = { 1 };
+    char            pass1[] = "hmac password", pass2[] = "another password";
+    netsnmp_keyed_hash *kh;
+    netsnmp_session session, *ss;
+    struct usmUser *user;
+    u_char          key[20], msg[MSGLEN], mac[20];
+    size_t          maclen;
+    struct timeval  start, stop, diff;
+    double          oneshot_us, prepared_us;
+    int             i, errors;
+
+    srandom(argc > 1 ? atoi(argv[1]) : 1);
+    init_snmp("testing");
+
+#ifndef NETSNMP_DISABLE_MD5
+    errors = compare_hashes(usmHMACMD5AuthProtocol, 16);
+    OKF(errors == 0, ("HMAC-MD5: %d differences", errors));
+#else
+    OKF(1, ("HMAC-MD5 is disabled"));
+#endif
+    errors = compare_hashes(usmHMACSHA1AuthProtocol, 20);
+    OKF(errors == 0, ("HMAC-SHA1: %d differences", errors));
+
+    OKF(sc_keyed_hash_create(usmHMACSHA1AuthProtocol,
+                             USM_LENGTH_OID_TRANSFORM, badkey, 10) == NULL &&
+        sc_keyed_hash_create(usmHMACSHA1AuthProtocol,
+                             USM_LENGTH_OID_TRANSFORM, badkey,
+                             sizeof(badkey)) == NULL &&
+        sc_keyed_hash_create(usmNoAuthProtocol,
+                             OID_LENGTH(usmNoAuthProtocol), badkey,
+                             20) == NULL,
+        ("No keyed hash for short or long keys or other protocols"));
+
+    /*
+     * A USM user whose key changes under it.
+     */
+    engineIDLen = snmpv3_get_engineID(engineID, sizeof(engineID));
+    user = usm_create_user();
+    user->name = strdup("hmacuser");
+    user->secName = strdup("hmacuser");
+    user->engineID = netsnmp_memdup(engineID, engineIDLen);
+    user->engineIDLen = engineIDLen;
+    SNMP_FREE(user->authProtocol);
+    user->authProtocol = snmp_duplicate_objid(usmHMACSHA1AuthProtocol,
+                                              USM_AUTH_PROTO_SHA_LEN);
+    user->authProtocolLen = USM_AUTH_PROTO_SHA_LEN;
+    user->userStatus = RS_ACTIVE;
+    user->userStorageType = ST_READONLY;
+    usm_add_user(user);
+    usm_set_user_password(user, "userSetAuthPass", pass1);
+    OKF(user->authKeyHash != NULL, ("Setting a password prepares the hash"));
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_3;
+    session.peername = strdup("udp:127.0.0.1"); /* we won't actually connect */
+    session.securityModel = SNMP_SEC_MODEL_USM;
+    session.securityLevel = SNMP_SEC_LEVEL_AUTHNOPRIV;
+    session.securityName = strdup("hmacuser");
+    session.securityNameLen = strlen(session.securityName);
+    session.securityEngineID = netsnmp_memdup(engineID, engineIDLen);
+    session.securityEngineIDLen = engineIDLen;
+    ss = snmp_open(&session);
+    OKF(ss != NULL && authenticates(ss, "hmacuser"),
+        ("A message from the user authenticates"));
+
+    /* as a key change through usmUserAuthKeyChange does */
+    user->authKey[0] ^= 0xff;
+    OKF(ss != NULL && authenticates(ss, "hmacuser") &&
+        sc_keyed_hash_matches(user->authKeyHash, user->authProtocol,
+                              user->authProtocolLen, user->authKey,
+                              user->authKeyLen),
+        ("After changing the key in place it still does"));
+    usm_set_user_password(user, "userSetAuthPass", pass2);
+    OKF(ss != NULL && authenticates(ss, "hmacuser"),
+        ("After setting another password it still does"));
+    if (ss)
+        snmp_close(ss);
+
+    /*
+     * The time it takes to sign a full size message.
+     */
+    for (i = 0; i < 20; i++)
+        key[i] = i;
+    for (i = 0; i < MSGLEN; i++)
+        msg[i] = i;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP; i++) {
+        maclen = USM_MD5_AND_SHA_AUTH_LEN;
+        sc_generate_keyed_hash(usmHMACSHA1AuthProtocol,
+                               USM_LENGTH_OID_TRANSFORM, key, 20,
+                               msg, 100 + i % 8, mac, &maclen);
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    oneshot_us = (diff.tv_sec * 1e6 + diff.tv_usec) / NLOOP;
+
+    kh = sc_keyed_hash_create(usmHMACSHA1AuthProtocol,
+                              USM_LENGTH_OID_TRANSFORM, key, 20);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP; i++) {
+        maclen = USM_MD5_AND_SHA_AUTH_LEN;
+        sc_generate_prepared_keyed_hash(kh, msg, 100 + i % 8, mac, &maclen);
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    prepared_us = (diff.tv_sec * 1e6 + diff.tv_usec) / NLOOP;
+    sc_keyed_hash_free(kh);
+
+    printf("# HMAC-SHA1 of a 100 byte message: %.3f us one-shot, "
+           "%.3f us prepared\n", oneshot_us, prepared_us);
+
+    clear_user_list();
+    snmp_shutdown("testing");
+    PLAN(7);
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * HEADER Prepared cipher keys and authPriv messages
+ *
+ * Checks that sc_encrypt_prepared() and sc_decrypt_prepared() agree with
+ * sc_encrypt() and sc_decrypt() for DES and AES, also when encrypting and
+ * decrypting in place.  Then builds and parses SHA/AES and SHA/DES
+ * authPriv GETs, checking that they survive the round trip, and reports
+ * the number of GETs a second as a comment, so that this test doubles as
+ * a throughput benchmark.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/snmpusm.h>
+#include <net-snmp/library/transform_oids.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NCASES 2000
+#define MAXLEN 1500
+#define NLOOP  20000
+
+/* prototype copied from snmp_api.c */
+int             snmp_build(u_char ** pkt, size_t * pkt_len,
+                           size_t * offset, netsnmp_session * pss,
+                           netsnmp_pdu *pdu);
+
+static u_char   engineID[SNMP_MAXBUF_SMALL];
+static size_t   engineIDLen;
+
+/*
+ * Returns the number of random plaintexts for which the two ways differ.
+ */
+static int
+compare_ciphers(oid * proto, u_int ivlen)
+{
+    netsnmp_cipher_key *ck;
+    u_char          key[20], iv[16], pt[MAXLEN], ct1[MAXLEN + 16],
+        ct2[MAXLEN + 16], buf[MAXLEN + 16];
+    size_t          ptlen, ctlen1, ctlen2, len, i;
+    int             c, rc1, rc2, errors = 0;
+
+    for (c = 0; c < NCASES; c++) {
+        for (i = 0; i < sizeof(key); i++)
+            key[i] = random();
+        for (i = 0; i < sizeof(iv); i++)
+            iv[i] = random();
+        ck = sc_cipher_key_create(proto, USM_LENGTH_OID_TRANSFORM, key,
+                                  sizeof(key));
+        if (ck == NULL)
+            return -1;
+        ptlen = 1 + random() % MAXLEN;
+        for (i = 0; i < ptlen; i++)
+            pt[i] = random();
+
+        ctlen1 = ctlen2 = sizeof(ct1);
+        rc1 = sc_encrypt(proto, USM_LENGTH_OID_TRANSFORM, key, sizeof(key),
+                         iv, ivlen, pt, ptlen, ct1, &ctlen1);
+        rc2 = sc_encrypt_prepared(ck, iv, ivlen, pt, ptlen, ct2, &ctlen2);
+        if (rc1 != SNMPERR_SUCCESS || rc2 != SNMPERR_SUCCESS ||
+            ctlen1 != ctlen2 || memcmp(ct1, ct2, ctlen1) != 0)
+            errors++;
+
+        /* in place */
+        memcpy(buf, pt, ptlen);
+        len = sizeof(buf);
+        if (sc_encrypt_prepared(ck, iv, ivlen, buf, ptlen, buf, &len) !=
+            SNMPERR_SUCCESS || len != ctlen1 || memcmp(buf, ct1, len) != 0)
+            errors++;
+        if (sc_decrypt_prepared(ck, iv, ivlen, buf, len, buf, &len) !=
+            SNMPERR_SUCCESS || memcmp(buf, pt, ptlen) != 0)
+            errors++;
+
+        len = sizeof(buf);
+        if (sc_decrypt(proto, USM_LENGTH_OID_TRANSFORM, key, sizeof(key),
+                       iv, ivlen, ct2, ctlen2, buf, &len) !=
+            SNMPERR_SUCCESS || memcmp(buf, pt, ptlen) != 0)
+            errors++;
+
+        if (!sc_cipher_key_matches(ck, proto, USM_LENGTH_OID_TRANSFORM,
+                                   key, sizeof(key)))
+            errors++;
+        key[random() % sizeof(key)] ^= 1;
+        if (sc_cipher_key_matches(ck, proto, USM_LENGTH_OID_TRANSFORM,
+                                  key, sizeof(key)))
+            errors++;
+        sc_cipher_key_free(ck);
+    }
+    return errors;
+}
+
+static struct usmUser *
+make_user(const char *name, oid * privProtocol)
+{
+    struct usmUser *user = usm_create_user();
+    char            authPass[] = "auth password", privPass[] = "priv password";
+
+    user->name = strdup(name);
+    user->secName = strdup(name);
+    user->engineID = netsnmp_memdup(engineID, engineIDLen);
+    user->engineIDLen = engineIDLen;
+    SNMP_FREE(user->authProtocol);
+    user->authProtocol = snmp_duplicate_objid(usmHMACSHA1AuthProtocol,
+                                              USM_AUTH_PROTO_SHA_LEN);
+    user->authProtocolLen = USM_AUTH_PROTO_SHA_LEN;
+    SNMP_FREE(user->privProtocol);
+    user->privProtocol = snmp_duplicate_objid(privProtocol,
+                                              USM_PRIV_PROTO_AES_LEN);
+    user->privProtocolLen = USM_PRIV_PROTO_AES_LEN;
+    user->userStatus = RS_ACTIVE;
+    user->userStorageType = ST_READONLY;
+    usm_add_user(user);
+    usm_set_user_password(user, "userSetAuthPass", authPass);
+    usm_set_user_password(user, "userSetPrivPass", privPass);
+    return user;
+}
+
+/*
+ * Builds and parses authPriv GETs from a user, and returns the number
+ * that did not come back intact.  Sets *us to the time taken for each.
+ */
+static int
+round_trips(netsnmp_session * ss, const char *secName, int n, double *us)
+{
+    netsnmp_session receiver;
+    netsnmp_pdu    *pdu, *parsed;
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 10, 0 };
+    u_char         *buf;
+    size_t          buf_len = 512, pkt_len, offset, len;
+    struct timeval  start, stop, diff;
+    int             i, failed = 0;
+
+    snmp_sess_init(&receiver);
+    receiver.isAuthoritative = SNMP_SESS_AUTHORITATIVE;
+    buf = (u_char *) malloc(buf_len);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < n; i++) {
+        pdu = snmp_pdu_create(SNMP_MSG_GET);
+        pdu->version = SNMP_VERSION_3;
+        pdu->securityName = strdup(secName);
+        pdu->securityNameLen = strlen(secName);
+        name[OID_LENGTH(name) - 1] = i % 100;
+        snmp_add_null_var(pdu, name, OID_LENGTH(name));
+        snmp_add_null_var(pdu, name, OID_LENGTH(name) - 1);
+        pkt_len = buf_len;
+        offset = 0;
+        if (snmp_build(&buf, &pkt_len, &offset, ss, pdu) != 0) {
+            failed++;
+        } else {
+            parsed = snmp_pdu_create(SNMP_MSG_RESPONSE);
+            len = offset;
+            if (snmpv3_parse(parsed, buf + pkt_len - offset, &len, NULL,
+                             &receiver) != SNMPERR_SUCCESS ||
+                parsed->command != SNMP_MSG_GET ||
+                parsed->variables == NULL ||
+                snmp_oid_compare(parsed->variables->name,
+                                 parsed->variables->name_length, name,
+                                 OID_LENGTH(name)) != 0)
+                failed++;
+            snmp_free_pdu(parsed);
+        }
+        buf_len = pkt_len;
+        snmp_free_pdu(pdu);
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    *us = (diff.tv_sec * 1e6 + diff.tv_usec) / n;
+    free(buf);
+    return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session, *ss;
+    double          us = 0;
+    int             errors;
+
+    srandom(argc > 1 ? atoi(argv[1]) : 1);
+    init_snmp("testing");
+
+#ifdef HAVE_AES
+    errors = compare_ciphers(usmAESPrivProtocol, 16);
+    OKF(errors == 0, ("AES: %d differences", errors));
+#else
+    OKF(1, ("AES is not available"));
+#endif
+#ifndef NETSNMP_DISABLE_DES
+    errors = compare_ciphers(usmDESPrivProtocol, 8);
+    OKF(errors == 0, ("DES: %d differences", errors));
+#else
+    OKF(1, ("DES is disabled"));
+#endif
+
+    engineIDLen = snmpv3_get_engineID(engineID, sizeof(engineID));
+#ifdef HAVE_AES
+    make_user("aesuser", usmAESPrivProtocol);
+#endif
+#ifndef NETSNMP_DISABLE_DES
+    make_user("desuser", usmDESPrivProtocol);
+#endif
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_3;
+    session.peername = strdup("udp:127.0.0.1"); /* we won't actually connect */
+    session.securityModel = SNMP_SEC_MODEL_USM;
+    session.securityLevel = SNMP_SEC_LEVEL_AUTHPRIV;
+    session.securityName = strdup("aesuser");
+    session.securityNameLen = strlen(session.securityName);
+    session.securityEngineID = netsnmp_memdup(engineID, engineIDLen);
+    session.securityEngineIDLen = engineIDLen;
+    ss = snmp_open(&session);
+    OKF(ss != NULL, ("Opened a session"));
+
+#ifdef HAVE_AES
+    errors = ss ? round_trips(ss, "aesuser", NLOOP, &us) : -1;
+    OKF(errors == 0, ("SHA/AES: %d of %d GETs failed", errors, NLOOP));
+    printf("# SHA/AES authPriv GET build and parse: %.2f us, %.0f/s\n",
+           us, 1e6 / us);
+#else
+    OKF(1, ("AES is not available"));
+#endif
+#ifndef NETSNMP_DISABLE_DES
+    errors = ss ? round_trips(ss, "desuser", NLOOP, &us) : -1;
+    OKF(errors == 0, ("SHA/DES: %d of %d GETs failed", errors, NLOOP));
+    printf("# SHA/DES authPriv GET build and parse: %.2f us, %.0f/s\n",
+           us, 1e6 / us);
+#else
+    OKF(1, ("DES is disabled"));
+#endif
+
+    if (ss)
+        snmp_close(ss);
+    clear_user_list();
+    snmp_shutdown("testing");
+    PLAN(5);
+    return 0;
+}
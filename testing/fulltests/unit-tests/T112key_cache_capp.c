@@ -0,0 +1,248 @@
+/*
+ * HEADER Ku and Kul caches
+ *
+ * Derives keys for a few passphrases and engineIDs with the key cache
+ * turned off and on, and checks that generate_Ku() and generate_kul()
+ * return the same keys either way.  Then checks that the key cache file
+ * is created readable by its owner only, that keys are read back from it
+ * and that it is ignored if others can read it or is a symbolic link
+ * that would send the keys elsewhere.  The time taken to set up
+ * keys for NAGENTS agents that share three passphrases is reported as a
+ * comment, with and without the cache.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/keytools.h>
+#include <net-snmp/library/transform_oids.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
+#define NPASS    3
+#define NENGINES 8
+#define NAGENTS  100
+
+static const char *passphrases[NPASS] = {
+    "maplesyrup", "a much longer passphrase than that", "12345678"
+};
+
+struct keys {
+    u_char          ku[SNMP_MAXBUF_SMALL];
+    size_t          kulen;
+    u_char          kul[NENGINES][SNMP_MAXBUF_SMALL];
+    size_t          kullen[NENGINES];
+};
+
+static const oid *
+hash_type(int i)
+{
+#ifndef NETSNMP_DISABLE_MD5
+    if (i % 2)
+        return usmHMACMD5AuthProtocol;
+#endif
+    return usmHMACSHA1AuthProtocol;
+}
+
+static void
+engine_id(int i, u_char * engineID, size_t * len)
+{
+    static const u_char prefix[] = { 0x80, 0x00, 0x1f, 0x88, 0x80 };
+
+    memcpy(engineID, prefix, sizeof(prefix));
+    memset(engineID + sizeof(prefix), i, 10);
+    *len = sizeof(prefix) + 8 + i % 3;
+}
+
+/*
+ * Derives Ku and the Kul for each engineID, returning the number of
+ * failures.
+ */
+static int
+derive(int p, const oid * type, struct keys *k)
+{
+    u_char          engineID[32];
+    size_t          engineIDLen;
+    int             e, failed = 0;
+
+    k->kulen = sizeof(k->ku);
+    if (generate_Ku(type, USM_LENGTH_OID_TRANSFORM,
+                    (const u_char *) passphrases[p],
+                    strlen(passphrases[p]), k->ku,
+                    &k->kulen) != SNMPERR_SUCCESS)
+        return 1;
+    for (e = 0; e < NENGINES; e++) {
+        engine_id(e, engineID, &engineIDLen);
+        k->kullen[e] = sizeof(k->kul[e]);
+        if (generate_kul(type, USM_LENGTH_OID_TRANSFORM, engineID,
+                         engineIDLen, k->ku, k->kulen, k->kul[e],
+                         &k->kullen[e]) != SNMPERR_SUCCESS)
+            failed++;
+    }
+    return failed;
+}
+
+static int
+same_keys(const struct keys *a, const struct keys *b)
+{
+    int             e;
+
+    if (a->kulen != b->kulen || memcmp(a->ku, b->ku, a->kulen) != 0)
+        return 0;
+    for (e = 0; e < NENGINES; e++)
+        if (a->kullen[e] != b->kullen[e] ||
+            memcmp(a->kul[e], b->kul[e], a->kullen[e]) != 0)
+            return 0;
+    return 1;
+}
+
+/*
+ * Sets up the keys a manager needs for NAGENTS agents, returning the
+ * time taken in milliseconds.
+ */
+static double
+setup_agents(void)
+{
+    struct timeval  start, stop, diff;
+    u_char          ku[SNMP_MAXBUF_SMALL], kul[SNMP_MAXBUF_SMALL];
+    u_char          engineID[32];
+    size_t          kulen, kullen, engineIDLen;
+    int             i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NAGENTS; i++) {
+        kulen = sizeof(ku);
+        generate_Ku(usmHMACSHA1AuthProtocol, USM_LENGTH_OID_TRANSFORM,
+                    (const u_char *) passphrases[i % NPASS],
+                    strlen(passphrases[i % NPASS]), ku, &kulen);
+        engine_id(i, engineID, &engineIDLen);
+        kullen = sizeof(kul);
+        generate_kul(usmHMACSHA1AuthProtocol, USM_LENGTH_OID_TRANSFORM,
+                     engineID, engineIDLen, ku, kulen, kul, &kullen);
+    }
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    return diff.tv_sec * 1e3 + diff.tv_usec / 1e3;
+}
+
+static off_t
+file_size(const char *file)
+{
+    struct stat     st;
+
+    return stat(file, &st) == 0 ? st.st_size : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct keys     ref[2][NPASS], got;
+    struct stat     st;
+    char            file[SNMP_MAXPATH], target[SNMP_MAXPATH + 8];
+    const char     *tmp;
+    double          uncached_ms, cached_ms;
+    off_t           size;
+    int             p, t, failed = 0, differ = 0;
+
+    init_snmp("testing");
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_NO_KEY_CACHE, 1);
+    for (t = 0; t < 2; t++)
+        for (p = 0; p < NPASS; p++)
+            failed += derive(p, hash_type(t), &ref[t][p]);
+    uncached_ms = setup_agents();
+    OKF(failed == 0, ("Derived keys without the cache (%d failures)",
+                      failed));
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_NO_KEY_CACHE, 0);
+    failed = 0;
+    /* twice, so that the second round comes from the cache */
+    for (t = 0; t < 4; t++)
+        for (p = 0; p < NPASS; p++) {
+            failed += derive(p, hash_type(t % 2), &got);
+            differ += !same_keys(&got, &ref[t % 2][p]);
+        }
+    OKF(failed == 0 && differ == 0,
+        ("The cache returns the same keys (%d failures, %d differ)",
+         failed, differ));
+
+    netsnmp_key_cache_clear();
+    setup_agents();
+    cached_ms = setup_agents();
+    printf("# %d agents, %d passphrases: %.2f ms without the cache, "
+           "%.2f ms with it\n", NAGENTS, NPASS, uncached_ms, cached_ms);
+
+    /*
+     * The key cache file.
+     */
+    tmp = getenv("SNMP_TMPDIR");
+    snprintf(file, sizeof(file), "%s/T112keycache.%d", tmp ? tmp : "/tmp",
+             (int) getpid());
+    unlink(file);
+    netsnmp_ds_set_string(NETSNMP_DS_LIBRARY_ID,
+                          NETSNMP_DS_LIB_KEY_CACHE_FILE, file);
+    netsnmp_key_cache_clear();
+    failed = derive(0, hash_type(0), &got) + derive(1, hash_type(1), &got);
+    OKF(failed == 0 && stat(file, &st) == 0 &&
+        (st.st_mode & 0777) == 0600,
+        ("The key cache file was created with mode 0%o",
+         (u_int) (st.st_mode & 0777)));
+
+    size = file_size(file);
+    netsnmp_key_cache_clear();
+    failed = derive(0, hash_type(0), &got);
+    differ = !same_keys(&got, &ref[0][0]);
+    failed += derive(1, hash_type(1), &got);
+    differ += !same_keys(&got, &ref[1][1]);
+    OKF(failed == 0 && differ == 0 && file_size(file) == size,
+        ("Keys are read back from the file (%d failures, %d differ)",
+         failed, differ));
+
+    failed = derive(2, hash_type(0), &got);
+    OKF(failed == 0 && file_size(file) > size,
+        ("New keys are added to the file"));
+
+    chmod(file, 0644);
+    size = file_size(file);
+    netsnmp_key_cache_clear();
+    failed = derive(2, hash_type(1), &got);
+    differ = !same_keys(&got, &ref[1][2]);
+    OKF(failed == 0 && differ == 0 && file_size(file) == size,
+        ("A file others can read is not used"));
+
+    unlink(file);
+
+    /*
+     * keys must not be written through a symbolic link
+     */
+    snprintf(target, sizeof(target), "%s.target", file);
+    unlink(target);
+    if (symlink(target, file) == 0) {
+        netsnmp_key_cache_clear();
+        failed = derive(0, hash_type(1), &got);
+        differ = !same_keys(&got, &ref[1][0]);
+        OKF(failed == 0 && differ == 0 && file_size(target) < 0,
+            ("Keys are not written through a symbolic link"));
+        unlink(file);
+        unlink(target);
+    } else
+        OKF(1, ("Skipped: cannot create a symbolic link"));
+
+    netsnmp_ds_set_string(NETSNMP_DS_LIBRARY_ID,
+                          NETSNMP_DS_LIB_KEY_CACHE_FILE, NULL);
+    snmp_shutdown("testing");
+    PLAN(7);
+    return 0;
+}
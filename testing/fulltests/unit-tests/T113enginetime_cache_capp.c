@@ -0,0 +1,130 @@
+/*
+ * HEADER Engine time cache with many engines
+ *
+ * Records boots and time for up to 100000 engineIDs and checks that
+ * get_enginetime() returns them, that free_enginetime() forgets only the
+ * engine it is given, and that with engineTimeCacheSize set the least
+ * recently used engines are the ones forgotten, with the hits, misses
+ * and evictions counted.  The time taken by a lookup among NBENCH
+ * engines is reported as a comment.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+#include <net-snmp/library/lcd_time.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define NENGINES 100000
+#define NLIMIT   1000
+#define NBENCH   20000
+#define NLOOP    20
+
+static u_char   engineID[32];
+
+static u_int
+engine_id(int i)
+{
+    static const u_char prefix[] = { 0x80, 0x00, 0x1f, 0x88, 0x04 };
+
+    memcpy(engineID, prefix, sizeof(prefix));
+    snprintf((char *) engineID + sizeof(prefix),
+             sizeof(engineID) - sizeof(prefix), "engine%d", i);
+    return sizeof(prefix) + strlen((char *) engineID + sizeof(prefix));
+}
+
+static void
+set_engine(int i)
+{
+    u_int           len = engine_id(i);
+
+    set_enginetime(engineID, len, i + 1, 1000 + i, TRUE);
+}
+
+/*
+ * Returns 1 if the engine is known with the boots value it was given.
+ */
+static int
+known(int i)
+{
+    u_int           len = engine_id(i), boots, etime;
+
+    return get_enginetime(engineID, len, &boots, &etime, TRUE) ==
+        SNMPERR_SUCCESS && boots == (u_int) i + 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct timeval  start, stop, diff;
+    u_int           hits, misses, evictions;
+    int             i, missing = 0, found = 0, wrong = 0;
+
+    init_snmp("testing");
+
+    for (i = 0; i < NENGINES; i++)
+        set_engine(i);
+    for (i = 0; i < NENGINES; i++)
+        missing += !known(i);
+    OKF(missing == 0, ("%d engines: %d not found", NENGINES, missing));
+
+    free_enginetime(engineID, engine_id(NENGINES / 2));
+    for (i = 0; i < NENGINES; i++)
+        if (known(i) != (i != NENGINES / 2))
+            wrong++;
+    OKF(wrong == 0, ("free_enginetime() forgot only its engine "
+                     "(%d wrong)", wrong));
+    free_etimelist();
+    OKF(!known(0) && !known(NENGINES - 1), ("free_etimelist() forgot all"));
+
+    /*
+     * With a limit, touching engine 0 between additions keeps it.
+     */
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                       NETSNMP_DS_LIB_ENGINETIME_CACHE_SIZE, NLIMIT);
+    hits = snmp_get_statistic(STAT_LCD_ENGINETIME_HITS);
+    misses = snmp_get_statistic(STAT_LCD_ENGINETIME_MISSES);
+    evictions = snmp_get_statistic(STAT_LCD_ENGINETIME_EVICTIONS);
+    for (i = 0; i < 5 * NLIMIT; i++) {
+        set_engine(i);
+        known(0);
+    }
+    for (i = 0; i < 5 * NLIMIT; i++)
+        found += known(i);
+    OKF(known(0) && known(5 * NLIMIT - 1) && !known(1) &&
+        found == NLIMIT,
+        ("%d engines with room for %d: %d kept", 5 * NLIMIT, NLIMIT, found));
+    hits = snmp_get_statistic(STAT_LCD_ENGINETIME_HITS) - hits;
+    misses = snmp_get_statistic(STAT_LCD_ENGINETIME_MISSES) - misses;
+    evictions = snmp_get_statistic(STAT_LCD_ENGINETIME_EVICTIONS) -
+        evictions;
+    OKF(evictions == 4 * NLIMIT,
+        ("%u evictions, %u hits, %u misses", evictions, hits, misses));
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                       NETSNMP_DS_LIB_ENGINETIME_CACHE_SIZE, 0);
+    free_etimelist();
+
+    for (i = 0; i < NBENCH; i++)
+        set_engine(i);
+    missing = 0;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NLOOP * NBENCH; i++)
+        missing += !known(i % NBENCH);
+    gettimeofday(&stop, NULL);
+    NETSNMP_TIMERSUB(&stop, &start, &diff);
+    OKF(missing == 0, ("%d lookups among %d engines", NLOOP * NBENCH,
+                       NBENCH));
+    printf("# %.3f us per lookup among %d engines\n",
+           (diff.tv_sec * 1e6 + diff.tv_usec) / (NLOOP * NBENCH), NBENCH);
+
+    snmp_shutdown("testing");
+    PLAN(6);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * HEADER snmptrapd handler lookup among many directives
+ *
+ * Registers NHANDLERS trap-specific handlers, exact, subtree ("oid*")
+ * and strict subtree ("oid.*") ones, some of them twice, and looks up
+ * NTRAPS trap OIDs, some of them registered, some below a registered
+ * OID and some unknown.  Each lookup by netsnmp_get_traphandler() is
+ * checked against a walk of the handler list, which is how the lookup
+ * used to be done, and the time both took for NROUNDS rounds is
+ * reported as a comment, so that this test doubles as a benchmark.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "snmptrapd_handlers.h"
+
+#define NHANDLERS 5000
+#define NTRAPS    1000
+#define NROUNDS   20
+#define TRAP_LEN  10
+
+extern netsnmp_trapd_handler *netsnmp_specific_traphandlers;
+extern netsnmp_trapd_handler *netsnmp_default_traphandlers;
+void            snmptrapd_free_traphandle(void);
+
+static int
+dummy_handler(netsnmp_pdu *pdu, netsnmp_transport *transport,
+              netsnmp_trapd_handler *handler)
+{
+    return NETSNMPTRAPD_HANDLER_OK;
+}
+
+/*
+ * the handlers for a trap OID, found by walking the list
+ */
+static netsnmp_trapd_handler *
+walk_traphandlers(oid *trapOid, int trapOidLen)
+{
+    netsnmp_trapd_handler *traph;
+
+    for (traph = netsnmp_specific_traphandlers; traph; traph = traph->nextt) {
+        if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE)) {
+            if (snmp_oid_compare(traph->trapoid, traph->trapoid_len,
+                                 trapOid, trapOidLen) == 0)
+                return traph;
+        } else if (snmp_oidsubtree_compare(traph->trapoid,
+                                           traph->trapoid_len,
+                                           trapOid, trapOidLen) == 0) {
+            if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE) ||
+                snmp_oid_compare(traph->trapoid, traph->trapoid_len,
+                                 trapOid, trapOidLen) != 0)
+                return traph;
+        }
+    }
+    return netsnmp_default_traphandlers;
+}
+
+static u_long
+elapsed_us(const struct timeval *start)
+{
+    struct timeval  now, diff;
+
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, start, &diff);
+    return diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static oid      traps[NTRAPS][TRAP_LEN];
+    int             trap_len[NTRAPS];
+    oid             trapoid[] = { 1, 3, 6, 1, 4, 1, 0, 0, 0 };
+    netsnmp_trapd_handler *traph;
+    struct timeval  start;
+    u_long          walk_us, lookup_us;
+    int             i, j, len, mismatches = 0, specific = 0;
+
+    init_snmp("testing");
+
+    netsnmp_add_default_traphandler(dummy_handler);
+
+    /*
+     * a tenth of the handlers are for a subtree, a tenth for a strict
+     * subtree; every third OID gets a second handler
+     */
+    for (i = 0; i < NHANDLERS; ++i) {
+        trapoid[6] = 1000 + i % 700;
+        trapoid[7] = i % 7;
+        trapoid[8] = i;
+        len = OID_LENGTH(trapoid);
+        traph = NULL;
+        for (j = 0; j <= (i % 3 == 0); ++j) {
+            switch (i % 10) {
+            case 0:
+                traph = netsnmp_add_traphandler(dummy_handler, trapoid,
+                                                len - 2);
+                if (traph)
+                    traph->flags = NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE;
+                break;
+            case 1:
+                traph = netsnmp_add_traphandler(dummy_handler, trapoid,
+                                                len - 1);
+                if (traph)
+                    traph->flags = NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE |
+                        NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE;
+                break;
+            default:
+                traph = netsnmp_add_traphandler(dummy_handler, trapoid, len);
+                break;
+            }
+        }
+        if (NULL == traph)
+            break;
+    }
+    OKF(i == NHANDLERS, ("Registered %d handlers", i));
+
+    /*
+     * trap OIDs of 7 to 10 subidentifiers: mostly those of a handler, or
+     * their prefixes or OIDs below them, and some unknown ones
+     */
+    srandom(1);
+    for (i = 0; i < NTRAPS; ++i) {
+        memcpy(traps[i], trapoid, 6 * sizeof(oid));
+        j = random() % NHANDLERS;
+        if (i % 4) {
+            traps[i][6] = 1000 + j % 700;
+            traps[i][7] = j % 7;
+            traps[i][8] = j;
+        } else {
+            traps[i][6] = 1000 + random() % 800;
+            traps[i][7] = random() % 8;
+            traps[i][8] = j;
+        }
+        traps[i][9] = random() % 3;
+        trap_len[i] = 7 + random() % 4;
+    }
+
+    for (i = 0; i < NTRAPS; ++i) {
+        traph = walk_traphandlers(traps[i], trap_len[i]);
+        if (traph != netsnmp_get_traphandler(traps[i], trap_len[i]))
+            ++mismatches;
+        if (traph != netsnmp_default_traphandlers)
+            ++specific;
+    }
+    OKF(mismatches == 0,
+        ("%d of %d lookups differ from a walk of the handler list "
+         "(%d found specific handlers)", mismatches, NTRAPS, specific));
+
+    netsnmp_get_monotonic_clock(&start);
+    for (j = 0; j < NROUNDS; ++j)
+        for (i = 0; i < NTRAPS; ++i)
+            walk_traphandlers(traps[i], trap_len[i]);
+    walk_us = elapsed_us(&start);
+
+    netsnmp_get_monotonic_clock(&start);
+    for (j = 0; j < NROUNDS; ++j)
+        for (i = 0; i < NTRAPS; ++i)
+            netsnmp_get_traphandler(traps[i], trap_len[i]);
+    lookup_us = elapsed_us(&start);
+
+    printf("# %d lookups among %d handlers: list walk %lu us, "
+           "netsnmp_get_traphandler() %lu us\n", NROUNDS * NTRAPS,
+           NHANDLERS, walk_us, lookup_us);
+
+    snmptrapd_free_traphandle();
+    OK(netsnmp_specific_traphandlers == NULL &&
+       netsnmp_get_traphandler(traps[0], trap_len[0]) ==
+       netsnmp_default_traphandlers, "Handlers freed");
+
+    snmp_shutdown("testing");
+
+    if (__did_plan == 0) {
+        PLAN(__test_counter);
+    }
+    return 0;
+}